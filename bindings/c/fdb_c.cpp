@@ -471,11 +471,16 @@ FDBFuture* fdb_transaction_get_range_impl(
 	/* length(iteration_progression) */
 	static const int max_iteration = sizeof(iteration_progression) / sizeof(int);
 
-	if(mode == FDB_STREAMING_MODE_WANT_ALL)
+	/* _WANT_ALL asks for batches that storage servers stream in
+	   several pieces, when range reads are streamed */
+	bool want_all = mode == FDB_STREAMING_MODE_WANT_ALL;
+	if(want_all)
 		mode = FDB_STREAMING_MODE_SERIAL;
 
 	int mode_bytes;
-	if (mode == FDB_STREAMING_MODE_ITERATOR) {
+	if (want_all && CLIENT_KNOBS->RANGE_STREAM_MAX_BYTES > 0)
+		mode_bytes = std::max(CLIENT_KNOBS->WANT_ALL_BYTE_LIMIT, mode_bytes_array[FDB_STREAMING_MODE_SERIAL]);
+	else if (mode == FDB_STREAMING_MODE_ITERATOR) {
 		if (iteration <= 0)
 			return TSAV_ERROR(Standalone<RangeResultRef>, client_invalid_operation);
 
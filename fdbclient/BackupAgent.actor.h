@@ -504,6 +504,15 @@ ACTOR Future<Void> applyMutations(Database cx, Key uid, Key addPrefix, Key remov
                                   Version* endVersion, RequestStream<CommitTransactionRequest> commit,
                                   NotifiedVersion* committedVersion, Reference<KeyRangeMap<Version>> keyVersion);
 
+namespace fileBackup {
+	// Decodes one block of a range file.  The first and last keys returned are the bounds of the block's key range
+	// rather than key value pairs.
+	ACTOR Future<Standalone<VectorRef<KeyValueRef>>> decodeRangeFileBlock(Reference<IAsyncFile> file, int64_t offset, int len);
+
+	// Writes data, which must be sorted and within range, to file as a complete range file with the given block size
+	Future<Void> writeRangeFile(Reference<IBackupFile> const& file, int const& blockSize, KeyRange const& range, Standalone<VectorRef<KeyValueRef>> const& data);
+}
+
 typedef BackupAgentBase::enumState EBackupState;
 template<> inline Tuple Codec<EBackupState>::pack(EBackupState const &val) { return Tuple().append(val); }
 template<> inline EBackupState Codec<EBackupState>::unpack(Tuple const &val) { return (EBackupState)val.getInt(0); }
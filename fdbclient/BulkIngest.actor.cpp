@@ -0,0 +1,209 @@
+/*
+ * BulkIngest.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2019 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/BulkIngest.actor.h"
+#include "fdbclient/BackupAgent.actor.h"
+#include "fdbclient/KeyRangeMap.h"
+#include "fdbclient/StorageServerInterface.h"
+#include "fdbclient/SystemData.h"
+#include "flow/actorcompiler.h" // This must be the last #include.
+
+ACTOR Future<Void> BulkIngestFileBuilder::add_impl(BulkIngestFileBuilder* self, Standalone<VectorRef<KeyValueRef>> kvs) {
+	state int i = 0;
+
+	std::sort(kvs.begin(), kvs.end(), KeyValueRef::OrderByKey());
+	for(; i < kvs.size(); i++) {
+		KeyRef key = kvs[i].key;
+		if(!self->keys.contains(key) || key < self->fileBegin || (self->pending.size() && key <= self->pending.back().key))
+			throw client_invalid_operation();
+
+		self->pending.push_back_deep(self->pending.arena(), kvs[i]);
+		self->pendingBytes += kvs[i].expectedSize();
+		if(self->pendingBytes >= CLIENT_KNOBS->BULK_INGEST_FILE_BYTES) {
+			wait(BulkIngestFileBuilder::writeNextFile(self, keyAfter(key)));
+		}
+	}
+
+	return Void();
+}
+
+ACTOR Future<std::vector<BulkIngestFile>> BulkIngestFileBuilder::finish_impl(BulkIngestFileBuilder* self) {
+	if(self->fileBegin < self->keys.end) {
+		wait(BulkIngestFileBuilder::writeNextFile(self, self->keys.end));
+	}
+	return self->files;
+}
+
+ACTOR Future<Void> BulkIngestFileBuilder::writeNextFile(BulkIngestFileBuilder* self, Key end) {
+	state KeyRange range = KeyRangeRef(self->fileBegin, end);
+	state Standalone<VectorRef<KeyValueRef>> data = self->pending;
+	state int blockSize = CLIENT_KNOBS->BACKUP_RANGEFILE_BLOCK_SIZE;
+
+	self->pending = Standalone<VectorRef<KeyValueRef>>();
+	self->pendingBytes = 0;
+	self->fileBegin = end;
+
+	state Reference<IBackupFile> file = wait(self->container->writeRangeFile(0, self->files.size(), 0, blockSize));
+	wait(fileBackup::writeRangeFile(file, blockSize, range, data));
+
+	TraceEvent("BulkIngestWroteFile")
+		.suppressFor(60)
+		.detail("FileName", file->getFileName())
+		.detail("Size", file->size())
+		.detail("Keys", data.size())
+		.detail("BeginKey", range.begin)
+		.detail("EndKey", range.end);
+
+	self->files.push_back(BulkIngestFile(range, self->container->getURL(), file->getFileName(), file->size(), blockSize));
+	return Void();
+}
+
+// Returns true if the storage server has applied the bulk ingest markers committed before minVersion and can serve keys,
+// and false if it cannot yet or did not answer
+ACTOR static Future<bool> bulkIngestLoaded(StorageServerInterface ssi, KeyRange keys, Version minVersion) {
+	ErrorOr<std::pair<Version, Version>> rep = wait(ssi.getShardState.getReplyUnlessFailedFor(GetShardStateRequest(keys, GetShardStateRequest::READABLE), CLIENT_KNOBS->BULK_INGEST_CHECK_DELAY, 0));
+	return rep.present() && rep.get().first >= minVersion;
+}
+
+// Waits until every storage server responsible for keys, including the destinations of in-flight moves, has loaded them
+ACTOR static Future<Void> waitForBulkIngestLoaded(Database cx, KeyRange keys) {
+	state Transaction tr(cx);
+	state Key begin = keys.begin;
+
+	while(begin < keys.end) {
+		try {
+			tr.setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+			state Standalone<RangeResultRef> shards = wait(krmGetRanges(&tr, keyServersPrefix, KeyRangeRef(begin, keys.end)));
+			state std::vector<std::pair<KeyRange, UID>> shardServers;
+			state std::vector<Future<Optional<Value>>> serverListValues;
+			for(int s = 0; s < shards.size() - 1; s++) {
+				std::vector<UID> src, dest;
+				decodeKeyServersValue(shards[s].value, src, dest);
+				for(auto& id : src)
+					shardServers.push_back(std::make_pair(KeyRangeRef(shards[s].key, shards[s+1].key), id));
+				for(auto& id : dest)
+					shardServers.push_back(std::make_pair(KeyRangeRef(shards[s].key, shards[s+1].key), id));
+			}
+			for(auto& ss : shardServers)
+				serverListValues.push_back(tr.get(serverListKeyFor(ss.second)));
+			wait(waitForAll(serverListValues));
+
+			state std::vector<Future<bool>> loaded;
+			for(int s = 0; s < shardServers.size(); s++) {
+				// A server which has been removed is no longer in the team once the removal is visible
+				if(serverListValues[s].get().present())
+					loaded.push_back(bulkIngestLoaded(decodeServerListValue(serverListValues[s].get().get()), shardServers[s].first, tr.getReadVersion().get()));
+				else
+					loaded.push_back(false);
+			}
+			wait(waitForAll(loaded));
+
+			bool allLoaded = true;
+			for(auto& l : loaded)
+				allLoaded = allLoaded && l.get();
+			if(allLoaded) {
+				begin = shards.back().key;
+				tr.reset();
+			} else {
+				TEST(true); // Bulk ingest is still loading
+				wait(delay(CLIENT_KNOBS->BULK_INGEST_CHECK_DELAY));
+				tr.reset();
+			}
+		} catch(Error& e) {
+			wait(tr.onError(e));
+		}
+	}
+
+	return Void();
+}
+
+ACTOR Future<Void> bulkIngest(Database cx, std::vector<BulkIngestFile> files) {
+	state Transaction tr(cx);
+	state int i;
+
+	std::sort(files.begin(), files.end(), [](BulkIngestFile const& a, BulkIngestFile const& b) { return a.keys.begin < b.keys.begin; });
+	for(i = 0; i < files.size(); i++) {
+		if(!normalKeys.contains(files[i].keys) || (i > 0 && files[i-1].keys.end > files[i].keys.begin))
+			throw client_invalid_operation();
+	}
+
+	loop {
+		try {
+			tr.setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+
+			// If an earlier attempt committed, a file's ingest may still be in progress, and reading its range would wait for it.
+			// Setting its marker again would start the ingest over.
+			state std::vector<Future<Optional<Value>>> started;
+			for(auto& file : files)
+				started.push_back(tr.get(bulkIngestKeyFor(file.keys.begin)));
+			wait(waitForAll(started));
+
+			state std::vector<int> notStarted;
+			state std::vector<Future<Standalone<RangeResultRef>>> contents;
+			for(i = 0; i < files.size(); i++) {
+				if(started[i].get() != Optional<Value>(bulkIngestValue(files[i]))) {
+					notStarted.push_back(i);
+					contents.push_back(tr.getRange(files[i].keys, 1));
+				}
+			}
+			wait(waitForAll(contents));
+
+			for(auto& c : contents) {
+				if(c.get().size()) {
+					TraceEvent(SevWarnAlways, "BulkIngestRangeNotEmpty").detail("Key", c.get()[0].key);
+					throw restore_destination_not_empty();
+				}
+			}
+			if(notStarted.empty())
+				break;
+
+			for(int f : notStarted)
+				tr.set(bulkIngestKeyFor(files[f].keys.begin), bulkIngestValue(files[f]));
+			wait(tr.commit());
+			TraceEvent("BulkIngestStarted").detail("Files", notStarted.size()).detail("Version", tr.getCommittedVersion());
+			break;
+		} catch(Error& e) {
+			wait(tr.onError(e));
+		}
+	}
+
+	// Reads of a range succeed once any one of its storage servers has loaded the file, but the others may still be loading it
+	state std::vector<Future<Void>> loaded;
+	for(auto& file : files)
+		loaded.push_back(waitForBulkIngestLoaded(cx, file.keys));
+	wait(waitForAll(loaded));
+
+	// The markers are only needed while storage servers are loading the files
+	tr.reset();
+	loop {
+		try {
+			tr.setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+			for(auto& file : files)
+				tr.clear(bulkIngestKeyFor(file.keys.begin));
+			wait(tr.commit());
+			break;
+		} catch(Error& e) {
+			wait(tr.onError(e));
+		}
+	}
+
+	TraceEvent("BulkIngestComplete").detail("Files", files.size());
+	return Void();
+}
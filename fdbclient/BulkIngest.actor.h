@@ -0,0 +1,71 @@
+/*
+ * BulkIngest.actor.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2019 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#if defined(NO_INTELLISENSE) && !defined(FDBCLIENT_BULKINGEST_ACTOR_G_H)
+	#define FDBCLIENT_BULKINGEST_ACTOR_G_H
+	#include "fdbclient/BulkIngest.actor.g.h"
+#elif !defined(FDBCLIENT_BULKINGEST_ACTOR_H)
+	#define FDBCLIENT_BULKINGEST_ACTOR_H
+
+/* Bulk ingest loads large amounts of data into empty key ranges without going through the commit path.  A client
+builds sorted range files (the same format as backup snapshots) in a backup container with BulkIngestFileBuilder, and
+bulkIngest() then has the storage servers responsible for each file's range read it from the container and adopt its
+contents, the same way they adopt a shard fetched from other storage servers during data distribution.
+
+The container must be readable from the storage servers.  Writes to a range while it is being ingested are applied on
+top of the file's contents, including by a storage server which reboots and loads the file again. */
+
+#include "fdbclient/NativeAPI.actor.h"
+#include "fdbclient/BackupContainer.h"
+#include "flow/actorcompiler.h" // has to be last include
+
+// Sorts key value pairs and splits them into range files of about CLIENT_KNOBS->BULK_INGEST_FILE_BYTES, which
+// together cover keys.  Instances must be kept alive while any member actors are in progress.
+struct BulkIngestFileBuilder {
+	BulkIngestFileBuilder() : pendingBytes(0) {}
+	BulkIngestFileBuilder(Reference<IBackupContainer> container, KeyRange keys)
+	  : container(container), keys(keys), fileBegin(keys.begin), pendingBytes(0) {}
+
+	// Adds kvs, which must be within keys and after all of the keys added by earlier calls, but need not be sorted
+	Future<Void> add(Standalone<VectorRef<KeyValueRef>> kvs) { return add_impl(this, kvs); }
+
+	// Writes the remaining data and returns the files, in key order
+	Future<std::vector<BulkIngestFile>> finish() { return finish_impl(this); }
+
+	ACTOR static Future<Void> add_impl(BulkIngestFileBuilder* self, Standalone<VectorRef<KeyValueRef>> kvs);
+	ACTOR static Future<std::vector<BulkIngestFile>> finish_impl(BulkIngestFileBuilder* self);
+	ACTOR static Future<Void> writeNextFile(BulkIngestFileBuilder* self, Key end);
+
+	Reference<IBackupContainer> container;
+	KeyRange keys;
+	Key fileBegin;
+	Standalone<VectorRef<KeyValueRef>> pending;  // Data for the file beginning at fileBegin
+	int64_t pendingBytes;
+	std::vector<BulkIngestFile> files;
+};
+
+// Loads files, which must not overlap, into their key ranges, which must be empty.  Throws
+// restore_destination_not_empty if any of them is not.  Returns once every storage server responsible for the ranges has
+// loaded the data.
+ACTOR Future<Void> bulkIngest(Database cx, std::vector<BulkIngestFile> files);
+
+#include "flow/unactorcompiler.h"
+#endif
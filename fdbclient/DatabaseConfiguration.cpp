@@ -266,6 +266,8 @@ StatusObject DatabaseConfiguration::toJSON(bool noPolicies) const {
 			result["storage_engine"] = "ssd-2";
 		} else if( tLogDataStoreType == KeyValueStoreType::SSD_BTREE_V2 && storageServerStoreType == KeyValueStoreType::SSD_REDWOOD_V1 ) {
 			result["storage_engine"] = "ssd-redwood-experimental";
+		} else if( tLogDataStoreType == KeyValueStoreType::SSD_BTREE_V2 && storageServerStoreType == KeyValueStoreType::SSD_TIERED_V1 ) {
+			result["storage_engine"] = "ssd-tiered-experimental";
 		} else if( tLogDataStoreType == KeyValueStoreType::MEMORY && storageServerStoreType == KeyValueStoreType::MEMORY ) {
 			result["storage_engine"] = "memory-1";
 		} else if( tLogDataStoreType == KeyValueStoreType::SSD_BTREE_V2 && storageServerStoreType == KeyValueStoreType::MEMORY ) {
@@ -407,7 +409,7 @@ bool DatabaseConfiguration::setInternal(KeyRef key, ValueRef value) {
 	}
 	else if (ck == LiteralStringRef("log_engine")) { parse((&type), value); tLogDataStoreType = (KeyValueStoreType::StoreType)type; 
 		// TODO:  Remove this once Redwood works as a log engine
-		if(tLogDataStoreType == KeyValueStoreType::SSD_REDWOOD_V1)
+		if(tLogDataStoreType == KeyValueStoreType::SSD_REDWOOD_V1 || tLogDataStoreType == KeyValueStoreType::SSD_TIERED_V1)
 			tLogDataStoreType = KeyValueStoreType::SSD_BTREE_V2;
 	}
 	else if (ck == LiteralStringRef("log_spill")) { parse((&type), value); tLogSpillType = (TLogSpillType::SpillType)type; }
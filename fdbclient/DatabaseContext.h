@@ -132,6 +132,17 @@ public:
 	};
 	std::map<uint32_t, VersionBatcher> versionBatcher;
 
+	// Point read batching: reads at the same version from the same storage team that arrive within
+	// GET_VALUES_BATCH_DELAY of each other are sent as one GetValuesRequest
+	struct BatchedRead {
+		Reference<LocationInfo> location;
+		Key key;
+		Version version;
+		Promise<GetValueReply> reply;
+	};
+	PromiseStream<BatchedRead> batchedReads;
+	Future<Void> readBatcher;
+
 	AsyncTrigger connectionFileChangedTrigger;
 
 	// Disallow any reads at a read version lower than minAcceptableReadVersion.  This way the client does not have to
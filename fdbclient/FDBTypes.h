@@ -597,6 +597,7 @@ struct KeyValueStoreType {
 		MEMORY,
 		SSD_BTREE_V2,
 		SSD_REDWOOD_V1,
+		SSD_TIERED_V1,
 		END
 	};
 
@@ -615,6 +616,7 @@ struct KeyValueStoreType {
 			case SSD_BTREE_V1: return "ssd-1";
 			case SSD_BTREE_V2: return "ssd-2";
 			case SSD_REDWOOD_V1: return "ssd-redwood-experimental";
+			case SSD_TIERED_V1: return "ssd-tiered-experimental";
 			case MEMORY: return "memory";
 			default: return "unknown";
 		}
@@ -732,6 +734,28 @@ struct StorageBytes {
 	}
 };
 
+// A range file in a backup container which storage servers load directly to populate an empty key range
+struct BulkIngestFile {
+	KeyRange keys;           // The keys loaded from the file; any other keys in it are ignored
+	std::string container;   // URL of the backup container holding the file
+	std::string fileName;
+	int64_t fileSize;
+	int blockSize;
+
+	BulkIngestFile() : fileSize(0), blockSize(0) {}
+	BulkIngestFile(KeyRangeRef keys, std::string container, std::string fileName, int64_t fileSize, int blockSize)
+		: keys(keys), container(container), fileName(fileName), fileSize(fileSize), blockSize(blockSize) {}
+
+	std::string toString() const {
+		return format("%s:%s [%s,%s)", container.c_str(), fileName.c_str(), printable(keys.begin).c_str(), printable(keys.end).c_str());
+	}
+
+	template <class Ar>
+	void serialize(Ar& ar) {
+		serializer(ar, keys, container, fileName, fileSize, blockSize);
+	}
+};
+
 struct LogMessageVersion {
 	// Each message pushed into the log system has a unique, totally ordered LogMessageVersion
 	// See ILogSystem::push() for how these are assigned
@@ -641,6 +641,21 @@ namespace fileBackup {
 		}
 	}
 
+	ACTOR Future<Void> writeRangeFile(Reference<IBackupFile> file, int blockSize, KeyRange range, Standalone<VectorRef<KeyValueRef>> data) {
+		state RangeFileWriter rangeFile(file, blockSize);
+		state int i = 0;
+
+		wait(rangeFile.writeKey(range.begin));
+		for(; i < data.size(); i++) {
+			ASSERT(range.contains(data[i].key) && (i == 0 || data[i-1].key < data[i].key));
+			wait(rangeFile.writeKV(data[i].key, data[i].value));
+		}
+		wait(rangeFile.writeKey(range.end));
+
+		wait(file->finish());
+		return Void();
+	}
+
 
 	// Very simple format compared to KeyRange files.
 	// Header, [Key, Value]... Key len
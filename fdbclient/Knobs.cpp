@@ -68,6 +68,11 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	init( MAX_BATCH_SIZE,                         1000 ); if( randomize && BUGGIFY ) MAX_BATCH_SIZE = 1;
 	init( GRV_BATCH_TIMEOUT,                     0.005 ); if( randomize && BUGGIFY ) GRV_BATCH_TIMEOUT = 0.1;
 	init( BROADCAST_BATCH_SIZE,                     20 ); if( randomize && BUGGIFY ) BROADCAST_BATCH_SIZE = 1;
+	init( GET_VALUES_BATCH_MAX_KEYS,               100 ); if( randomize && BUGGIFY ) GET_VALUES_BATCH_MAX_KEYS = deterministicRandom()->randomInt(1, 4);
+	init( GET_VALUES_BATCH_DELAY,                  0.0 ); if( randomize && BUGGIFY ) GET_VALUES_BATCH_DELAY = 0.005;
+	init( RANGE_STREAM_MAX_BYTES,                  1e7 ); if( randomize && BUGGIFY ) RANGE_STREAM_MAX_BYTES = deterministicRandom()->coinflip() ? 0 : 200000;
+	init( RANGE_STREAM_MIN_ROWS,                  1000 ); if( randomize && BUGGIFY ) RANGE_STREAM_MIN_ROWS = 2;
+	init( WANT_ALL_BYTE_LIMIT,                     1e6 );
 
 	init( LOCATION_CACHE_EVICTION_SIZE,         300000 );
 	init( LOCATION_CACHE_EVICTION_SIZE_SIM,         10 ); if( randomize && BUGGIFY ) LOCATION_CACHE_EVICTION_SIZE_SIM = 3;
@@ -133,6 +138,8 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	init( SIM_BACKUP_TASKS_PER_AGENT,               10 );
 	init( BACKUP_RANGEFILE_BLOCK_SIZE,      1024 * 1024);
 	init( BACKUP_LOGFILE_BLOCK_SIZE,        1024 * 1024);
+	init( BULK_INGEST_FILE_BYTES,                  1e8 ); if( randomize && BUGGIFY ) BULK_INGEST_FILE_BYTES = 1e4;
+	init( BULK_INGEST_CHECK_DELAY,                 1.0 );
 	init( BACKUP_DISPATCH_ADDTASK_SIZE,             50 );
 	init( RESTORE_DISPATCH_ADDTASK_SIZE,           150 );
 	init( RESTORE_DISPATCH_BATCH_SIZE,           30000 ); if( randomize && BUGGIFY ) RESTORE_DISPATCH_BATCH_SIZE = 20;
@@ -66,6 +66,11 @@ public:
 	int MAX_BATCH_SIZE;
 	double GRV_BATCH_TIMEOUT;
 	int BROADCAST_BATCH_SIZE;
+	int GET_VALUES_BATCH_MAX_KEYS; // Point reads are sent one per request if this is 1 or less
+	double GET_VALUES_BATCH_DELAY;
+	int RANGE_STREAM_MAX_BYTES; // Range reads are never streamed if this is 0
+	int RANGE_STREAM_MIN_ROWS; // Reads with a row limit must allow more than this many rows to be streamed
+	int WANT_ALL_BYTE_LIMIT; // The batch size for the WANT_ALL streaming mode when range reads are streamed
 
 	// When locationCache in DatabaseContext gets to be this size, items will be evicted
 	int LOCATION_CACHE_EVICTION_SIZE;
@@ -135,6 +140,8 @@ public:
 	int SIM_BACKUP_TASKS_PER_AGENT;
 	int BACKUP_RANGEFILE_BLOCK_SIZE;
 	int BACKUP_LOGFILE_BLOCK_SIZE;
+	int64_t BULK_INGEST_FILE_BYTES;
+	double BULK_INGEST_CHECK_DELAY; // Delay between checks of whether every storage server has loaded the files passed to bulkIngest()
 	int BACKUP_DISPATCH_ADDTASK_SIZE;
 	int RESTORE_DISPATCH_ADDTASK_SIZE;
 	int RESTORE_DISPATCH_BATCH_SIZE;
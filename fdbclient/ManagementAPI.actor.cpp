@@ -94,6 +94,9 @@ std::map<std::string, std::string> configForToken( std::string const& mode ) {
 	} else if (mode == "ssd-redwood-experimental") {
 		logType = KeyValueStoreType::SSD_BTREE_V2;
 		storeType = KeyValueStoreType::SSD_REDWOOD_V1;
+	} else if (mode == "ssd-tiered-experimental") {
+		logType = KeyValueStoreType::SSD_BTREE_V2;
+		storeType = KeyValueStoreType::SSD_TIERED_V1;
 	} else if (mode == "memory" || mode == "memory-2") {
 		logType = KeyValueStoreType::SSD_BTREE_V2;
 		storeType= KeyValueStoreType::MEMORY;
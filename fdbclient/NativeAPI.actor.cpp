@@ -1294,6 +1294,86 @@ Future<Void> Transaction::warmRange(Database cx, KeyRange keys) {
 	return warmRange_impl(this, cx, keys);
 }
 
+ACTOR Future<Void> sendGetValuesBatch( DatabaseContext* cx, std::vector<DatabaseContext::BatchedRead> batch ) {
+	std::sort( batch.begin(), batch.end(), [](DatabaseContext::BatchedRead const& a, DatabaseContext::BatchedRead const& b) { return a.key < b.key; } );
+	state GetValuesRequest req;
+	req.version = batch[0].version;
+	for(auto& r : batch)
+		if (!req.keys.size() || req.keys.back() != r.key)
+			req.keys.push_back_deep( req.arena, r.key );
+
+	try {
+		if (req.keys.size() == 1) {
+			GetValueReply reply = wait( loadBalance( batch[0].location, &StorageServerInterface::getValue, GetValueRequest( batch[0].key, req.version, Optional<UID>() ),
+			                                         TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : nullptr ) );
+			for(auto& r : batch)
+				r.reply.send( reply );
+			return Void();
+		}
+
+		GetValuesReply reply = wait( loadBalance( batch[0].location, &StorageServerInterface::getValues, req,
+		                                          TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : nullptr ) );
+		auto d = reply.data.begin();
+		for(auto& r : batch) {
+			while (d != reply.data.end() && d->key < r.key)
+				++d;
+			if (d != reply.data.end() && d->key == r.key)
+				r.reply.send( GetValueReply( Value( d->value, reply.arena ) ) );
+			else
+				r.reply.send( GetValueReply() );
+		}
+	} catch (Error& e) {
+		if (e.code() == error_code_actor_cancelled)
+			throw;
+		for(auto& r : batch)
+			r.reply.sendError( e );
+	}
+	return Void();
+}
+
+ACTOR Future<Void> getValuesBatcher( DatabaseContext* cx, FutureStream<DatabaseContext::BatchedRead> reads ) {
+	state std::map<std::pair<LocationInfo*, Version>, std::vector<DatabaseContext::BatchedRead>> pending;
+	state PromiseStream< Future<Void> > addActor;
+	state Future<Void> collection = actorCollection( addActor.getFuture() );
+	state Future<Void> timeout;
+
+	loop {
+		choose {
+			when(DatabaseContext::BatchedRead read = waitNext(reads)) {
+				auto batch = pending.emplace( std::make_pair( read.location.getPtr(), read.version ), std::vector<DatabaseContext::BatchedRead>() ).first;
+				batch->second.push_back( read );
+				if (batch->second.size() >= CLIENT_KNOBS->GET_VALUES_BATCH_MAX_KEYS) {
+					addActor.send( sendGetValuesBatch( cx, std::move(batch->second) ) );
+					pending.erase( batch );
+				} else if (!timeout.isValid()) {
+					timeout = delay( CLIENT_KNOBS->GET_VALUES_BATCH_DELAY, TaskPriority::DefaultPromiseEndpoint );
+				}
+			}
+			when(wait(timeout.isValid() ? timeout : Never())) {
+				for(auto& batch : pending)
+					addActor.send( sendGetValuesBatch( cx, std::move(batch.second) ) );
+				pending.clear();
+				timeout = Future<Void>();
+			}
+			when(wait(collection)){} // for errors
+		}
+	}
+}
+
+// Reads key through the point read batcher, which may combine it with other reads of the same storage team
+Future<GetValueReply> batchedGetValue( DatabaseContext* cx, Reference<LocationInfo> const& location, Key const& key, Version version ) {
+	if (!cx->readBatcher.isValid())
+		cx->readBatcher = getValuesBatcher( cx, cx->batchedReads.getFuture() );
+
+	DatabaseContext::BatchedRead read;
+	read.location = location;
+	read.key = key;
+	read.version = version;
+	Future<GetValueReply> reply = read.reply.getFuture();
+	cx->batchedReads.send( read );
+	return reply;
+}
+
 ACTOR Future<Optional<Value>> getValue( Future<Version> version, Key key, Database cx, TransactionInfo info, Reference<TransactionLogInfo> trLogInfo )
 {
 	state Version ver = wait( version );
@@ -1328,12 +1408,18 @@ ACTOR Future<Optional<Value>> getValue( Future<Version> version, Key key, Databa
 					std::vector<Error>{ transaction_too_old(), future_version() });
 			}
 			state GetValueReply reply;
+			state Future<GetValueReply> replyFuture;
+			// Debug reads are not batched so that their trace events stay attached to a single request
+			if (CLIENT_KNOBS->GET_VALUES_BATCH_MAX_KEYS > 1 && !getValueID.present()) {
+				replyFuture = batchedGetValue(cx.getPtr(), ssi.second, key, ver);
+			} else {
+				replyFuture = loadBalance(ssi.second, &StorageServerInterface::getValue,
+				                          GetValueRequest(key, ver, getValueID), TaskPriority::DefaultPromiseEndpoint, false,
+				                          cx->enableLocalityLoadBalance ? &cx->queueModel : nullptr);
+			}
 			choose {
 				when(wait(cx->connectionFileChanged())) { throw transaction_too_old(); }
-				when(GetValueReply _reply =
-				         wait(loadBalance(ssi.second, &StorageServerInterface::getValue,
-				                          GetValueRequest(key, ver, getValueID), TaskPriority::DefaultPromiseEndpoint, false,
-				                          cx->enableLocalityLoadBalance ? &cx->queueModel : nullptr))) {
+				when(GetValueReply _reply = wait(replyFuture)) {
 					reply = _reply;
 				}
 			}
@@ -1538,7 +1624,7 @@ void transformRangeLimits(GetRangeLimits limits, bool reverse, GetKeyValuesReque
 }
 
 ACTOR Future<Standalone<RangeResultRef>> getExactRange( Database cx, Version version,
-	KeyRange keys, GetRangeLimits limits, bool reverse, TransactionInfo info )
+	KeyRange keys, GetRangeLimits limits, bool reverse, TransactionInfo info, Optional<RangeFilter> filter = Optional<RangeFilter>() )
 {
 	state Standalone<RangeResultRef> output;
 
@@ -1560,6 +1646,8 @@ ACTOR Future<Standalone<RangeResultRef>> getExactRange( Database cx, Version ver
 
 			//FIXME: buggify byte limits on internal functions that use them, instead of globally
 			req.debugID = info.debugID;
+			if( filter.present() )
+				req.filter = filter.get();
 
 			try {
 				if( info.debugID.present() ) {
@@ -1605,7 +1693,13 @@ ACTOR Future<Standalone<RangeResultRef>> getExactRange( Database cx, Version ver
 				if( reverse && more && rep.data.size() > 0 && output[output.size()-1].key == locations[shard].first.begin )
 					more = false;
 
-				if (more) {
+				if (more && rep.scannedThrough.present()) {
+					TEST(true);   // Filtered GetKeyValuesReply stopped at its scan limit in getExactRange
+					if( reverse )
+						locations[shard].first = KeyRangeRef( locations[shard].first.begin, rep.scannedThrough.get() );
+					else
+						locations[shard].first = KeyRangeRef( keyAfter( rep.scannedThrough.get() ), locations[shard].first.end );
+				} else if (more) {
 					if( !rep.data.size() ) {
 						TraceEvent(SevError, "GetExactRangeError").detail("Reason", "More data indicated but no rows present")
 							.detail("LimitBytes", limits.bytes).detail("LimitRows", limits.rows)
@@ -1684,7 +1778,7 @@ Future<Key> resolveKey( Database const& cx, KeySelector const& key, Version cons
 }
 
 ACTOR Future<Standalone<RangeResultRef>> getRangeFallback( Database cx, Version version,
-	KeySelector begin, KeySelector end, GetRangeLimits limits, bool reverse, TransactionInfo info )
+	KeySelector begin, KeySelector end, GetRangeLimits limits, bool reverse, TransactionInfo info, Optional<RangeFilter> filter )
 {
 	if(version == latestVersion) {
 		state Transaction transaction(cx);
@@ -1708,7 +1802,7 @@ ACTOR Future<Standalone<RangeResultRef>> getRangeFallback( Database cx, Version
 	//if b is allKeys.begin, we have either read through the beginning of the database,
 	//or allKeys.begin exists in the database and will be part of the conflict range anyways
 
-	Standalone<RangeResultRef> _r = wait( getExactRange(cx, version, KeyRangeRef(b, e), limits, reverse, info) );
+	Standalone<RangeResultRef> _r = wait( getExactRange(cx, version, KeyRangeRef(b, e), limits, reverse, info, filter) );
 	Standalone<RangeResultRef> r = _r;
 
 	if(b == allKeys.begin && ((reverse && !r.more) || !reverse))
@@ -1777,9 +1871,109 @@ void getRangeFinished(Reference<TransactionLogInfo> trLogInfo, double startTime,
 	}
 }
 
+// True if a read of shard with these limits may need more than one GetKeyValuesReply, and so is worth streaming.  A stream
+// goes to a single server without load balancing, so system keys, which are few and read by every process, are not streamed.
+bool shouldStreamRange( KeyRangeRef shard, GetRangeLimits limits ) {
+	return CLIENT_KNOBS->RANGE_STREAM_MAX_BYTES > CLIENT_KNOBS->REPLY_BYTE_LIMIT && limits.bytes != 0 && shard.end <= systemKeys.begin &&
+	       (!limits.hasByteLimit() || limits.bytes > CLIENT_KNOBS->REPLY_BYTE_LIMIT) &&
+	       (!limits.hasRowLimit() || limits.rows > CLIENT_KNOBS->RANGE_STREAM_MIN_ROWS);
+}
+
+// Reads [begin, end) from a single shard with a GetKeyValuesStreamRequest, acknowledging each chunk as it arrives, and returns
+// the chunks as one reply.  If the stream fails in transit, falls back to a single GetKeyValuesRequest.
+ACTOR Future<GetKeyValuesReply> getKeyValuesStream( Database cx, Reference<LocationInfo> location, KeySelectorRef begin, KeySelectorRef end,
+	Version version, GetRangeLimits limits, bool reverse, TransactionInfo info )
+{
+	state GetKeyValuesStreamRequest req;
+	req.begin = KeySelectorRef( req.arena, begin );
+	req.end = KeySelectorRef( req.arena, end );
+	req.version = version;
+	req.isFetchKeys = (info.taskID == TaskPriority::FetchKeys);
+	req.debugID = info.debugID;
+	req.limit = limits.hasRowLimit() ? limits.rows : std::numeric_limits<int>::max();
+	if( reverse )
+		req.limit *= -1;
+	req.limitBytes = limits.hasByteLimit() ? std::min( limits.bytes, CLIENT_KNOBS->RANGE_STREAM_MAX_BYTES ) : CLIENT_KNOBS->RANGE_STREAM_MAX_BYTES;
+
+	try {
+		// Stream from one of the closest servers that is not known to be failed
+		state int alternative = -1;
+		int start = deterministicRandom()->randomInt( 0, std::max( 1, location->countBest() ) );
+		for(int i = 0; i < location->size(); i++) {
+			int a = (start + i) % location->size();
+			if( !IFailureMonitor::failureMonitor().getState( location->get( a, &StorageServerInterface::getKeyValuesStream ).getEndpoint() ).failed ) {
+				alternative = a;
+				break;
+			}
+		}
+		if( alternative < 0 )
+			throw request_maybe_delivered();
+
+		state RequestStream<GetKeyValuesStreamRequest> stream = location->get( alternative, &StorageServerInterface::getKeyValuesStream );
+		state FutureStream<GetKeyValuesStreamChunk> chunks = req.chunks.getFuture();
+		state Future<ErrorOr<GetKeyValuesStreamReply>> done = stream.tryGetReply( req, TaskPriority::DefaultPromiseEndpoint );
+		state Future<Void> disconnected = stream.getEndpoint().isLocal() ? Never() : IFailureMonitor::failureMonitor().onDisconnectOrFailure( stream.getEndpoint() );
+		state Optional<RequestStream<GetKeyValuesStreamAck>> acknowledge;
+		state Optional<int64_t> chunkCount;
+		state int64_t received = 0;
+		state int64_t bytes = 0;
+		state GetKeyValuesReply result;
+
+		while( !chunkCount.present() || received < chunkCount.get() ) {
+			choose {
+				when( GetKeyValuesStreamChunk chunk = waitNext( chunks ) ) {
+					if( chunk.sequence != received ) {
+						TEST(true); // Range stream chunk lost
+						throw request_maybe_delivered();
+					}
+					++received;
+					if( chunk.acknowledge.present() )
+						acknowledge = chunk.acknowledge;
+
+					result.arena.dependsOn( chunk.arena );
+					result.data.append( result.arena, chunk.data.begin(), chunk.data.size() );
+					result.version = chunk.version;
+					result.more = chunk.more;
+
+					bytes += chunk.data.expectedSize();
+					if( acknowledge.present() )
+						acknowledge.get().send( GetKeyValuesStreamAck( bytes ) );
+				}
+				when( ErrorOr<GetKeyValuesStreamReply> reply = wait( done ) ) {
+					if( reply.isError() )
+						throw reply.getError();
+					if( reply.get().error.present() )
+						throw reply.get().error.get();
+					chunkCount = reply.get().chunks;
+					done = Never();
+				}
+				when( wait( disconnected ) ) {
+					throw request_maybe_delivered();
+				}
+			}
+		}
+		return result;
+	} catch( Error& e ) {
+		if( e.code() != error_code_request_maybe_delivered && e.code() != error_code_broken_promise && e.code() != error_code_server_overloaded )
+			throw;
+	}
+
+	TEST(true); // Range stream fell back to a GetKeyValuesRequest
+	state GetKeyValuesRequest fallback;
+	fallback.arena = req.arena;
+	fallback.begin = req.begin;
+	fallback.end = req.end;
+	fallback.version = req.version;
+	fallback.isFetchKeys = req.isFetchKeys;
+	fallback.debugID = req.debugID;
+	transformRangeLimits( limits, reverse, fallback );
+	GetKeyValuesReply rep = wait( loadBalance( location, &StorageServerInterface::getKeyValues, fallback, TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL ) );
+	return rep;
+}
+
 ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<TransactionLogInfo> trLogInfo, Future<Version> fVersion,
 	KeySelector begin, KeySelector end, GetRangeLimits limits, Promise<std::pair<Key, Key>> conflictRange, bool snapshot, bool reverse,
-	TransactionInfo info )
+	TransactionInfo info, Optional<RangeFilter> filter )
 {
 	state GetRangeLimits originalLimits( limits );
 	state KeySelector originalBegin = begin;
@@ -1836,6 +2030,8 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 			ASSERT(req.limitBytes > 0 && req.limit != 0 && req.limit < 0 == reverse);
 
 			req.debugID = info.debugID;
+			if( filter.present() )
+				req.filter = filter.get();
 			try {
 				if( info.debugID.present() ) {
 					g_traceBatch.addEvent("TransactionDebug", info.debugID.get().first(), "NativeAPI.getRange.Before");
@@ -1861,7 +2057,13 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 							transaction_too_old(), future_version()
 								});
 				}
-				GetKeyValuesReply rep = wait( loadBalance(beginServer.second, &StorageServerInterface::getKeyValues, req, TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL ) );
+				state Future<GetKeyValuesReply> replyFuture;
+				if( shouldStreamRange( shard, limits ) && !filter.present() ) {
+					replyFuture = getKeyValuesStream( cx, beginServer.second, req.begin, req.end, req.version, limits, reverse, info );
+				} else {
+					replyFuture = loadBalance( beginServer.second, &StorageServerInterface::getKeyValues, req, TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL );
+				}
+				GetKeyValuesReply rep = wait( replyFuture );
 
 				if( info.debugID.present() ) {
 					g_traceBatch.addEvent("TransactionDebug", info.debugID.get().first(), "NativeAPI.getRange.After");//.detail("SizeOf", rep.data.size());
@@ -1873,7 +2075,7 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 						.detail("RowsReturned", rep.data.size());*/
 				}
 
-				ASSERT( !rep.more || rep.data.size() );
+				ASSERT( !rep.more || rep.data.size() || rep.scannedThrough.present() );
 				ASSERT( !limits.hasRowLimit() || rep.data.size() <= limits.rows );
 
 				limits.decrement( rep.data );
@@ -1930,8 +2132,9 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 					ASSERT( modifiedSelectors );
 					TEST(true);  // !GetKeyValuesReply.more and modifiedSelectors in getRange
 
-					if( !rep.data.size() ) {
-						Standalone<RangeResultRef> result = wait( getRangeFallback(cx, version, originalBegin, originalEnd, originalLimits, reverse, info ) );
+					// With a filter an empty reply is expected, and says nothing about where the selectors lead
+					if( !rep.data.size() && !filter.present() ) {
+						Standalone<RangeResultRef> result = wait( getRangeFallback(cx, version, originalBegin, originalEnd, originalLimits, reverse, info, filter ) );
 						getRangeFinished(trLogInfo, startTime, originalBegin, originalEnd, snapshot, conflictRange, reverse, result);
 						return result;
 					}
@@ -1940,6 +2143,12 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 						end = firstGreaterOrEqual( shard.begin );
 					else
 						begin = firstGreaterOrEqual( shard.end );
+				} else if( rep.scannedThrough.present() ) {
+					TEST(true);  // Filtered GetKeyValuesReply stopped at its scan limit in getRange
+					if( reverse )
+						end = KeySelector( firstGreaterOrEqual( rep.scannedThrough.get() ), rep.arena );
+					else
+						begin = KeySelector( firstGreaterThan( rep.scannedThrough.get() ), rep.arena );
 				} else {
 					TEST(true);  // GetKeyValuesReply.more in getRange
 					if( reverse )
@@ -1960,7 +2169,7 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 					cx->invalidateCache( reverse ? end.getKey() : begin.getKey(), reverse ? (end-1).isBackward() : begin.isBackward() );
 
 					if (e.code() == error_code_wrong_shard_server) {
-						Standalone<RangeResultRef> result = wait( getRangeFallback(cx, version, originalBegin, originalEnd, originalLimits, reverse, info ) );
+						Standalone<RangeResultRef> result = wait( getRangeFallback(cx, version, originalBegin, originalEnd, originalLimits, reverse, info, filter ) );
 						getRangeFinished(trLogInfo, startTime, originalBegin, originalEnd, snapshot, conflictRange, reverse, result);
 						return result;
 					}
@@ -1987,7 +2196,65 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 Future<Standalone<RangeResultRef>> getRange( Database const& cx, Future<Version> const& fVersion, KeySelector const& begin, KeySelector const& end,
 	GetRangeLimits const& limits, bool const& reverse, TransactionInfo const& info )
 {
-	return getRange(cx, Reference<TransactionLogInfo>(), fVersion, begin, end, limits, Promise<std::pair<Key, Key>>(), true, reverse, info);
+	return getRange(cx, Reference<TransactionLogInfo>(), fVersion, begin, end, limits, Promise<std::pair<Key, Key>>(), true, reverse, info, Optional<RangeFilter>());
+}
+
+ACTOR Future<RangeAggregate> getRangeAggregate( Database cx, Future<Version> fVersion, KeyRange keys, Optional<RangeFilter> filter, TransactionInfo info );
+
+// Aggregates keys, which were last known to be a single shard served by location, following the storage server's scan
+// limit.  If the shard has moved the rest of keys is aggregated by getRangeAggregate after refreshing the location cache.
+ACTOR Future<RangeAggregate> getShardRangeAggregate( Database cx, Version version, KeyRange keys, Reference<LocationInfo> location,
+	Optional<RangeFilter> filter, TransactionInfo info )
+{
+	state RangeAggregate result;
+	try {
+		loop {
+			GetRangeAggregateRequest req;
+			req.keys = keys;
+			req.version = version;
+			if( filter.present() )
+				req.filter = filter.get();
+			req.debugID = info.debugID;
+
+			GetRangeAggregateReply rep = wait( loadBalance( location, &StorageServerInterface::getRangeAggregate, req, TaskPriority::DefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL ) );
+			result.add( rep.aggregate );
+			if( !rep.scannedThrough.present() )
+				return result;
+
+			TEST(true); // GetRangeAggregateReply stopped at its scan limit
+			keys = KeyRange( KeyRangeRef( keyAfter( rep.scannedThrough.get() ), keys.end ) );
+		}
+	} catch (Error& e) {
+		if (e.code() != error_code_wrong_shard_server && e.code() != error_code_all_alternatives_failed)
+			throw;
+		cx->invalidateCache( keys );
+		wait( delay( CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID ) );
+	}
+
+	RangeAggregate rest = wait( getRangeAggregate( cx, version, keys, filter, info ) );
+	result.add( rest );
+	return result;
+}
+
+// Aggregates every shard of keys in parallel, up to GET_RANGE_SHARD_LIMIT shards at a time
+ACTOR Future<RangeAggregate> getRangeAggregate( Database cx, Future<Version> fVersion, KeyRange keys, Optional<RangeFilter> filter, TransactionInfo info )
+{
+	state Version version = wait( fVersion );
+	state RangeAggregate result;
+
+	while( !keys.empty() ) {
+		state vector< pair<KeyRange, Reference<LocationInfo>> > locations = wait( getKeyRangeLocations( cx, keys, CLIENT_KNOBS->GET_RANGE_SHARD_LIMIT, false, &StorageServerInterface::getRangeAggregate, info ) );
+
+		state vector<Future<RangeAggregate>> shards;
+		for(auto& it : locations)
+			shards.push_back( getShardRangeAggregate( cx, version, it.first, it.second, filter, info ) );
+		wait( waitForAll( shards ) );
+
+		for(auto& f : shards)
+			result.add( f.get() );
+		keys = KeyRange( KeyRangeRef( locations.back().first.end, keys.end ) );
+	}
+	return result;
 }
 
 Transaction::Transaction( Database const& cx )
@@ -2204,6 +2471,17 @@ Future< Standalone<RangeResultRef> > Transaction::getRange(
 	GetRangeLimits limits,
 	bool snapshot,
 	bool reverse )
+{
+	return getRange( begin, end, limits, Optional<RangeFilter>(), snapshot, reverse );
+}
+
+Future< Standalone<RangeResultRef> > Transaction::getRange(
+	const KeySelector& begin,
+	const KeySelector& end,
+	GetRangeLimits limits,
+	Optional<RangeFilter> const& filter,
+	bool snapshot,
+	bool reverse )
 {
 	++cx->transactionLogicalReads;
 
@@ -2237,7 +2515,7 @@ Future< Standalone<RangeResultRef> > Transaction::getRange(
 		extraConflictRanges.push_back( conflictRange.getFuture() );
 	}
 
-	return ::getRange(cx, trLogInfo, getReadVersion(), b, e, limits, conflictRange, snapshot, reverse, info);
+	return ::getRange(cx, trLogInfo, getReadVersion(), b, e, limits, conflictRange, snapshot, reverse, info, filter);
 }
 
 Future< Standalone<RangeResultRef> > Transaction::getRange(
@@ -2250,6 +2528,18 @@ Future< Standalone<RangeResultRef> > Transaction::getRange(
 	return getRange( begin, end, GetRangeLimits( limit ), snapshot, reverse );
 }
 
+Future<RangeAggregate> Transaction::getRangeAggregate( const KeyRange& keys, Optional<RangeFilter> const& filter, bool snapshot ) {
+	++cx->transactionLogicalReads;
+
+	if( keys.empty() )
+		return RangeAggregate();
+
+	if( !snapshot )
+		tr.transaction.read_conflict_ranges.push_back( tr.arena, keys );
+
+	return ::getRangeAggregate( cx, getReadVersion(), keys, filter, info );
+}
+
 void Transaction::addReadConflictRange( KeyRangeRef const& keys ) {
 	ASSERT( !keys.empty() );
 
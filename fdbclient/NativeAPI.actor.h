@@ -29,6 +29,7 @@
 #include "flow/flow.h"
 #include "flow/TDMetric.actor.h"
 #include "fdbclient/FDBTypes.h"
+#include "fdbclient/RangeFilter.h"
 #include "fdbclient/MasterProxyInterface.h"
 #include "fdbclient/FDBOptions.g.h"
 #include "fdbclient/CoordinationInterface.h"
@@ -230,6 +231,22 @@ public:
 		return getRange(KeySelector(firstGreaterOrEqual(keys.begin), keys.arena()),
 		                KeySelector(firstGreaterOrEqual(keys.end), keys.arena()), limits, snapshot, reverse);
 	}
+	// Storage servers return only the rows that pass filter, so limits count matching rows.  Unless snapshot is set the
+	// read conflict range still covers every key that was scanned, matching or not.
+	[[nodiscard]] Future<Standalone<RangeResultRef>> getRange(const KeySelector& begin, const KeySelector& end,
+	                                                          GetRangeLimits limits, Optional<RangeFilter> const& filter,
+	                                                          bool snapshot = false, bool reverse = false);
+	[[nodiscard]] Future<Standalone<RangeResultRef>> getRange(const KeyRange& keys, GetRangeLimits limits,
+	                                                          Optional<RangeFilter> const& filter, bool snapshot = false,
+	                                                          bool reverse = false) {
+		return getRange(KeySelector(firstGreaterOrEqual(keys.begin), keys.arena()),
+		                KeySelector(firstGreaterOrEqual(keys.end), keys.arena()), limits, filter, snapshot, reverse);
+	}
+	// Counts and sums the rows of keys that pass filter on the storage servers, without reading them into the client.
+	// Unless snapshot is set the whole of keys is added to the read conflict ranges.
+	[[nodiscard]] Future<RangeAggregate> getRangeAggregate(const KeyRange& keys,
+	                                                       Optional<RangeFilter> const& filter = Optional<RangeFilter>(),
+	                                                       bool snapshot = false);
 
 	[[nodiscard]] Future<Standalone<VectorRef<const char*>>> getAddressesForKey(const Key& key);
 
@@ -0,0 +1,109 @@
+/*
+ * RangeFilter.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/RangeFilter.h"
+#include "fdbclient/Tuple.h"
+#include "flow/UnitTest.h"
+
+void RangeFilterRef::setTupleEquals( Arena& a, int index, StringRef packedValue ) {
+	// keyAfter(packedValue) is the least string greater than packedValue
+	tupleElement = index;
+	tupleBegin = KeyRef( a, packedValue );
+	tupleEnd = keyAfter( packedValue, a );
+}
+
+bool RangeFilterRef::matches( KeyValueRef const& kv ) const {
+	if (!kv.key.startsWith(keyPrefix) || !kv.value.startsWith(valuePrefix))
+		return false;
+
+	if (tupleElement >= 0) {
+		Optional<StringRef> element = Tuple::packedElement( kv.key.substr(keyPrefix.size()), tupleElement );
+		if (!element.present())
+			return false;
+		if (tupleBegin.present() && element.get() < tupleBegin.get())
+			return false;
+		if (tupleEnd.present() && !(element.get() < tupleEnd.get()))
+			return false;
+	}
+	return true;
+}
+
+void RangeFilterRef::apply( Arena& arena, VectorRef<KeyValueRef, VecSerStrategy::String>& data ) const {
+	int kept = 0;
+	for(int i = 0; i < data.size(); i++) {
+		if (matches(data[i]))
+			data[kept++] = project(data[i]);
+	}
+	data.resize( arena, kept );
+}
+
+std::string RangeFilterRef::toString() const {
+	return format("KeyPrefix:%s TupleElement:%d TupleBegin:%s TupleEnd:%s ValuePrefix:%s MaxValueLength:%d",
+		printable(keyPrefix).c_str(), tupleElement, tupleBegin.present() ? printable(tupleBegin.get()).c_str() : "none",
+		tupleEnd.present() ? printable(tupleEnd.get()).c_str() : "none", printable(valuePrefix).c_str(), maxValueLength);
+}
+
+TEST_CASE("/fdbclient/RangeFilter/matches") {
+	Arena arena;
+	Key prefix = LiteralStringRef("\x15\x01");
+	auto row = [&](Tuple const& t, StringRef value) {
+		return KeyValueRef( KeyRef(arena, prefix.withSuffix(t.pack())), value );
+	};
+	KeyValueRef a = row(Tuple().append(LiteralStringRef("red")).append(7), LiteralStringRef("apple"));
+	KeyValueRef b = row(Tuple().append(LiteralStringRef("green")).append(12), LiteralStringRef("pear"));
+	KeyValueRef c = row(Tuple().append(LiteralStringRef("red")), LiteralStringRef("cherry"));
+
+	RangeFilterRef all;
+	ASSERT( all.matches(a) && all.matches(b) && all.matches(c) );
+
+	RangeFilterRef red;
+	red.keyPrefix = prefix;
+	red.setTupleEquals( arena, 0, Tuple().append(LiteralStringRef("red")).pack() );
+	ASSERT( red.matches(a) && !red.matches(b) && red.matches(c) );
+
+	RangeFilterRef atLeastTen;
+	atLeastTen.keyPrefix = prefix;
+	atLeastTen.tupleElement = 1;
+	atLeastTen.tupleBegin = KeyRef( arena, Tuple().append(10).pack() );
+	ASSERT( !atLeastTen.matches(a) && atLeastTen.matches(b) && !atLeastTen.matches(c) );
+
+	RangeFilterRef valuePrefix;
+	valuePrefix.valuePrefix = LiteralStringRef("ch");
+	valuePrefix.maxValueLength = 3;
+	ASSERT( !valuePrefix.matches(a) && valuePrefix.matches(c) );
+	ASSERT( valuePrefix.project(c).value == LiteralStringRef("che") );
+
+	RangeFilterRef otherPrefix;
+	otherPrefix.keyPrefix = LiteralStringRef("\x15\x02");
+	ASSERT( !otherPrefix.matches(a) );
+
+	// Keys that are not tuples after the prefix never match a tuple condition
+	KeyValueRef notTuple( KeyRef(arena, prefix.withSuffix(LiteralStringRef("\xff\xff"))), ValueRef() );
+	ASSERT( all.matches(notTuple) && !red.matches(notTuple) );
+
+	VectorRef<KeyValueRef, VecSerStrategy::String> data;
+	data.push_back( arena, a );
+	data.push_back( arena, b );
+	data.push_back( arena, c );
+	red.apply( arena, data );
+	ASSERT( data.size() == 2 && data[0] == a && data[1] == c );
+
+	return Void();
+}
@@ -0,0 +1,79 @@
+/*
+ * RangeFilter.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBCLIENT_RANGEFILTER_H
+#define FDBCLIENT_RANGEFILTER_H
+#pragma once
+
+#include "fdbclient/FDBTypes.h"
+
+// Selects which rows of a range read are returned, and how much of their values, so that rows the client would discard
+// never leave the storage server.  A row is returned only if every condition that is set holds.  Limits on the read
+// apply to the rows that are returned, after values are truncated.
+struct RangeFilterRef {
+	constexpr static FileIdentifier file_identifier = 5127382;
+
+	KeyRef keyPrefix;				// Keys must start with this
+	int32_t tupleElement;			// If >= 0, the rest of the key after keyPrefix is read as a packed tuple, and the packed
+									// encoding of this element of it must lie in [tupleBegin, tupleEnd).  Keys with fewer
+									// elements never match.
+	Optional<KeyRef> tupleBegin;	// No lower bound if not present
+	Optional<KeyRef> tupleEnd;		// No upper bound if not present
+	ValueRef valuePrefix;			// Values must start with this
+	int32_t maxValueLength;			// If >= 0, values are truncated to this many bytes, as readValuePrefix() does
+
+	RangeFilterRef() : tupleElement(-1), maxValueLength(-1) {}
+	RangeFilterRef( Arena& a, const RangeFilterRef& copyFrom )
+	  : keyPrefix(a, copyFrom.keyPrefix), tupleElement(copyFrom.tupleElement), valuePrefix(a, copyFrom.valuePrefix),
+	    maxValueLength(copyFrom.maxValueLength) {
+		if (copyFrom.tupleBegin.present()) tupleBegin = KeyRef(a, copyFrom.tupleBegin.get());
+		if (copyFrom.tupleEnd.present()) tupleEnd = KeyRef(a, copyFrom.tupleEnd.get());
+	}
+
+	// Restricts element index of the tuple after keyPrefix to be equal to packedValue, the packed encoding of a
+	// single element (as produced by e.g. Tuple().append(value).pack())
+	void setTupleEquals( Arena& a, int index, StringRef packedValue );
+
+	bool matches( KeyValueRef const& kv ) const;
+	KeyValueRef project( KeyValueRef const& kv ) const {
+		if (maxValueLength >= 0 && kv.value.size() > maxValueLength)
+			return KeyValueRef( kv.key, kv.value.substr(0, maxValueLength) );
+		return kv;
+	}
+
+	// Removes the rows of data that do not match and projects the rest, keeping their order
+	void apply( Arena& arena, VectorRef<KeyValueRef, VecSerStrategy::String>& data ) const;
+
+	int expectedSize() const {
+		return keyPrefix.expectedSize() + valuePrefix.expectedSize() + (tupleBegin.present() ? tupleBegin.get().expectedSize() : 0) +
+		       (tupleEnd.present() ? tupleEnd.get().expectedSize() : 0);
+	}
+
+	std::string toString() const;
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, keyPrefix, tupleElement, tupleBegin, tupleEnd, valuePrefix, maxValueLength);
+	}
+};
+
+typedef Standalone<RangeFilterRef> RangeFilter;
+
+#endif
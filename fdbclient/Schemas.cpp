@@ -67,6 +67,17 @@ const KeyRef JSONSchemas::statusSchema = LiteralStringRef(R"statusSchema(
                   "kvstore_available_bytes":12341234,
                   "kvstore_free_bytes":12341234,
                   "kvstore_total_bytes":12341234,
+                  "kvstore_bytes_per_kv":12341234,
+                  "kvstore_reclaimed_bytes":{
+                     "hz":0.0,
+                     "counter":0,
+                     "roughness":0.0
+                  },
+                  "kvstore_released_bytes":{
+                     "hz":0.0,
+                     "counter":0,
+                     "roughness":0.0
+                  },
                   "durable_bytes":{
                      "hz":0.0,
                      "counter":0,
@@ -544,6 +555,7 @@ const KeyRef JSONSchemas::statusSchema = LiteralStringRef(R"statusSchema(
              "ssd-1",
              "ssd-2",
              "ssd-redwood-experimental",
+             "ssd-tiered-experimental",
              "memory",
              "memory-1",
              "memory-2"
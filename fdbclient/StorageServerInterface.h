@@ -23,6 +23,7 @@
 #pragma once
 
 #include "fdbclient/FDBTypes.h"
+#include "fdbclient/RangeFilter.h"
 #include "fdbrpc/Locality.h"
 #include "fdbrpc/QueueModel.h"
 #include "fdbrpc/fdbrpc.h"
@@ -42,11 +43,16 @@ struct StorageServerInterface {
 
 	RequestStream<ReplyPromise<Version>> getVersion;
 	RequestStream<struct GetValueRequest> getValue;
+	RequestStream<struct GetValuesRequest> getValues;
 	RequestStream<struct GetKeyRequest> getKey;
 
 	// Throws a wrong_shard_server if the keys in the request or result depend on data outside this server OR if a large selector offset prevents
 	// all data from being read in one range read
 	RequestStream<struct GetKeyValuesRequest> getKeyValues;
+	// Like getKeyValues, but the result is pushed back in chunks until the limits are reached, with flow control
+	RequestStream<struct GetKeyValuesStreamRequest> getKeyValuesStream;
+	// Computes a RangeAggregate of the rows in a range of a single shard without returning them
+	RequestStream<struct GetRangeAggregateRequest> getRangeAggregate;
 
 	RequestStream<struct GetShardStateRequest> getShardState;
 	RequestStream<struct WaitMetricsRequest> waitMetrics;
@@ -72,18 +78,24 @@ struct StorageServerInterface {
 			serializer(ar, uniqueID, locality, getVersion, getValue, getKey, getKeyValues, getShardState, waitMetrics,
 			           splitMetrics, getStorageMetrics, waitFailure, getQueuingMetrics, getKeyValueStoreType);
 			if (ar.protocolVersion().hasWatches()) serializer(ar, watchValue);
+			if (ar.protocolVersion().hasMultiGet()) serializer(ar, getValues);
+			if (ar.protocolVersion().hasRangeStream()) serializer(ar, getKeyValuesStream);
+			if (ar.protocolVersion().hasRangeAggregate()) serializer(ar, getRangeAggregate);
 		} else {
 			serializer(ar, uniqueID, locality, getVersion, getValue, getKey, getKeyValues, getShardState, waitMetrics,
 			           splitMetrics, getStorageMetrics, waitFailure, getQueuingMetrics, getKeyValueStoreType,
-			           watchValue);
+			           watchValue, getValues, getKeyValuesStream, getRangeAggregate);
 		}
 	}
 	bool operator == (StorageServerInterface const& s) const { return uniqueID == s.uniqueID; }
 	bool operator < (StorageServerInterface const& s) const { return uniqueID < s.uniqueID; }
 	void initEndpoints() {
 		getValue.getEndpoint( TaskPriority::LoadBalancedEndpoint );
+		getValues.getEndpoint( TaskPriority::LoadBalancedEndpoint );
 		getKey.getEndpoint( TaskPriority::LoadBalancedEndpoint );
 		getKeyValues.getEndpoint( TaskPriority::LoadBalancedEndpoint );
+		getKeyValuesStream.getEndpoint( TaskPriority::LoadBalancedEndpoint );
+		getRangeAggregate.getEndpoint( TaskPriority::LoadBalancedEndpoint );
 	}
 };
 
@@ -140,6 +152,37 @@ struct GetValueRequest : TimedRequest {
 	}
 };
 
+struct GetValuesReply : public LoadBalancedReply {
+	constexpr static FileIdentifier file_identifier = 13516370;
+	Arena arena;
+	VectorRef<KeyValueRef, VecSerStrategy::String> data;	// The keys of the request that have values, in the same order
+
+	GetValuesReply() {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, LoadBalancedReply::penalty, LoadBalancedReply::error, data, arena);
+	}
+};
+
+// Reads several keys at the same version with a single request.  Throws wrong_shard_server if any of the keys are
+// not readable on this server.
+struct GetValuesRequest : TimedRequest {
+	constexpr static FileIdentifier file_identifier = 6259402;
+	Arena arena;
+	VectorRef<KeyRef> keys;		// Sorted and unique
+	Version version;
+	Optional<UID> debugID;
+	ReplyPromise<GetValuesReply> reply;
+
+	GetValuesRequest() {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, keys, version, debugID, reply, arena);
+	}
+};
+
 struct WatchValueRequest {
 	constexpr static FileIdentifier file_identifier = 14747733;
 	Key key;
@@ -163,12 +206,13 @@ struct GetKeyValuesReply : public LoadBalancedReply {
 	VectorRef<KeyValueRef, VecSerStrategy::String> data;
 	Version version; // useful when latestVersion was requested
 	bool more;
+	Optional<KeyRef> scannedThrough;	// Only with a filter: the last key examined, when the scan stopped before the limits were reached
 
 	GetKeyValuesReply() : version(invalidVersion), more(false) {}
 
 	template <class Ar>
 	void serialize( Ar& ar ) {
-		serializer(ar, LoadBalancedReply::penalty, LoadBalancedReply::error, data, version, more, arena);
+		serializer(ar, LoadBalancedReply::penalty, LoadBalancedReply::error, data, version, more, scannedThrough, arena);
 	}
 };
 
@@ -180,13 +224,153 @@ struct GetKeyValuesRequest : TimedRequest {
 	int limit, limitBytes;
 	bool isFetchKeys;
 	Optional<UID> debugID;
+	Optional<RangeFilterRef> filter;	// The limits apply to the rows that pass the filter
 	ReplyPromise<GetKeyValuesReply> reply;
 
 	GetKeyValuesRequest() : isFetchKeys(false) {}
 //	GetKeyValuesRequest(const KeySelectorRef& begin, const KeySelectorRef& end, Version version, int limit, int limitBytes, Optional<UID> debugID) : begin(begin), end(end), version(version), limit(limit), limitBytes(limitBytes) {}
 	template <class Ar>
 	void serialize( Ar& ar ) {
-		serializer(ar, begin, end, version, limit, limitBytes, isFetchKeys, debugID, reply, arena);
+		serializer(ar, begin, end, version, limit, limitBytes, isFetchKeys, debugID, filter, reply, arena);
+	}
+};
+
+struct GetKeyValuesStreamAck {
+	constexpr static FileIdentifier file_identifier = 11904275;
+	int64_t bytes;		// Total size of the chunks the client has received
+
+	GetKeyValuesStreamAck() : bytes(0) {}
+	explicit GetKeyValuesStreamAck(int64_t bytes) : bytes(bytes) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, bytes);
+	}
+};
+
+struct GetKeyValuesStreamChunk {
+	constexpr static FileIdentifier file_identifier = 4591876;
+	Arena arena;
+	VectorRef<KeyValueRef, VecSerStrategy::String> data;
+	Version version;
+	int64_t sequence;	// Chunks are numbered from zero, so that the client can tell if one was lost
+	bool more;			// As in GetKeyValuesReply; only meaningful in the last chunk
+	Optional<RequestStream<GetKeyValuesStreamAck>> acknowledge;		// Only in the first chunk
+
+	GetKeyValuesStreamChunk() : version(invalidVersion), sequence(0), more(false) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, data, version, sequence, more, acknowledge, arena);
+	}
+};
+
+struct GetKeyValuesStreamReply : public LoadBalancedReply {
+	constexpr static FileIdentifier file_identifier = 9285021;
+	int64_t chunks;		// The number of chunks that were sent
+
+	GetKeyValuesStreamReply() : chunks(0) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, LoadBalancedReply::penalty, LoadBalancedReply::error, chunks);
+	}
+};
+
+// Reads a range like GetKeyValuesRequest, but rather than returning at most one reply's worth of data the storage
+// server sends the result over chunks in pieces, staying at most RANGE_STREAM_WINDOW_BYTES ahead of the client's
+// acknowledgements, and then replies with the number of chunks it sent.  limit and limitBytes apply to the whole stream.
+struct GetKeyValuesStreamRequest : TimedRequest {
+	constexpr static FileIdentifier file_identifier = 13780462;
+	Arena arena;
+	KeySelectorRef begin, end;
+	Version version;		// or latestVersion
+	int limit, limitBytes;
+	bool isFetchKeys;
+	Optional<UID> debugID;
+	ReplyPromiseStream<GetKeyValuesStreamChunk> chunks;
+	ReplyPromise<GetKeyValuesStreamReply> reply;
+
+	GetKeyValuesStreamRequest() : isFetchKeys(false) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, begin, end, version, limit, limitBytes, isFetchKeys, debugID, chunks, reply, arena);
+	}
+};
+
+// Summarizes a set of rows.  Values are read as little endian signed integers the way AddValue reads them with an eight
+// byte operand: shorter values are zero extended and longer ones truncated.  sum wraps on overflow, as AddValue does, and
+// minValue and maxValue are meaningful only if count > 0.
+struct RangeAggregate {
+	constexpr static FileIdentifier file_identifier = 9873564;
+	int64_t count;
+	int64_t bytes;			// Sum of the key and value sizes
+	int64_t sum;
+	int64_t minValue, maxValue;
+
+	RangeAggregate() : count(0), bytes(0), sum(0), minValue(std::numeric_limits<int64_t>::max()), maxValue(std::numeric_limits<int64_t>::min()) {}
+
+	static int64_t valueAsInteger( ValueRef const& value ) {
+		uint64_t v = 0;
+		for(int i = std::min(value.size(), 8) - 1; i >= 0; i--)
+			v = (v << 8) | value[i];
+		return (int64_t)v;
+	}
+
+	void add( KeyValueRef const& kv ) {
+		int64_t v = valueAsInteger(kv.value);
+		++count;
+		bytes += kv.key.size() + kv.value.size();
+		sum = (int64_t)((uint64_t)sum + (uint64_t)v);
+		minValue = std::min(minValue, v);
+		maxValue = std::max(maxValue, v);
+	}
+
+	void add( RangeAggregate const& r ) {
+		count += r.count;
+		bytes += r.bytes;
+		sum = (int64_t)((uint64_t)sum + (uint64_t)r.sum);
+		minValue = std::min(minValue, r.minValue);
+		maxValue = std::max(maxValue, r.maxValue);
+	}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, count, bytes, sum, minValue, maxValue);
+	}
+};
+
+struct GetRangeAggregateReply : public LoadBalancedReply {
+	constexpr static FileIdentifier file_identifier = 3590267;
+	Arena arena;
+	RangeAggregate aggregate;
+	Optional<KeyRef> scannedThrough;	// If present, only the rows up to and including this key were aggregated
+
+	GetRangeAggregateReply() {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, LoadBalancedReply::penalty, LoadBalancedReply::error, aggregate, scannedThrough, arena);
+	}
+};
+
+// Aggregates the rows of keys, which must lie in one shard of the server, that pass filter.  The storage server scans at
+// most about RANGE_AGGREGATE_SCAN_BYTES per request, so the client continues after scannedThrough until it is absent.
+struct GetRangeAggregateRequest : TimedRequest {
+	constexpr static FileIdentifier file_identifier = 15338410;
+	Arena arena;
+	KeyRangeRef keys;
+	Version version;
+	Optional<RangeFilterRef> filter;
+	Optional<UID> debugID;
+	ReplyPromise<GetRangeAggregateReply> reply;
+
+	GetRangeAggregateRequest() {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		serializer(ar, keys, version, filter, debugID, reply, arena);
 	}
 };
 
@@ -103,6 +103,26 @@ bool serverHasKey( ValueRef storedValue ) {
 	return storedValue == serverKeysTrue;
 }
 
+const KeyRangeRef bulkIngestKeys(
+	LiteralStringRef("\xff/bulkIngest/"),
+	LiteralStringRef("\xff/bulkIngest0") );
+const KeyRef bulkIngestPrefix = bulkIngestKeys.begin;
+
+const Key bulkIngestKeyFor( KeyRef const& begin ) {
+	return begin.withPrefix( bulkIngestPrefix );
+}
+const Value bulkIngestValue( BulkIngestFile const& file ) {
+	BinaryWriter wr(IncludeVersion());
+	wr << file;
+	return wr.toValue();
+}
+BulkIngestFile decodeBulkIngestValue( ValueRef const& value ) {
+	BulkIngestFile file;
+	BinaryReader reader( value, IncludeVersion() );
+	reader >> file;
+	return file;
+}
+
 const KeyRangeRef serverTagKeys(
 	LiteralStringRef("\xff/serverTag/"),
 	LiteralStringRef("\xff/serverTag0") );
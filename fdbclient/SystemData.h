@@ -52,6 +52,15 @@ const Key serverKeysPrefixFor( UID serverID );
 UID serverKeysDecodeServer( const KeyRef& key );
 bool serverHasKey( ValueRef storedValue );
 
+//    "\xff/bulkIngest/[[begin]]" := "[[BulkIngestFile]]"
+// Setting one of these keys makes the storage servers responsible for the file's key range load it in place of the
+// range's (empty) contents.  They are only records of past ingests after that.
+extern const KeyRangeRef bulkIngestKeys;
+extern const KeyRef bulkIngestPrefix;
+const Key bulkIngestKeyFor( KeyRef const& begin );
+const Value bulkIngestValue( BulkIngestFile const& );
+BulkIngestFile decodeBulkIngestValue( ValueRef const& );
+
 extern const KeyRangeRef serverTagKeys;
 extern const KeyRef serverTagPrefix;
 extern const KeyRangeRef serverTagMaxKeys;
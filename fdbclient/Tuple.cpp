@@ -29,6 +29,20 @@ static size_t find_string_terminator(const StringRef data, size_t offset) {
 	return i;
 }
 
+// Returns the offset just past the element of str that starts at offset i, or 0 if the element's type is invalid
+static size_t find_element_end(const StringRef str, size_t i) {
+	if(str[i] == '\x01' || str[i] == '\x02') {
+		return find_string_terminator(str, i+1) + 1;
+	}
+	else if(str[i] >= '\x0c' && str[i] <= '\x1c') {
+		return i + abs(str[i] - '\x14') + 1;
+	}
+	else if(str[i] == '\x00') {
+		return i + 1;
+	}
+	return 0;
+}
+
 Tuple::Tuple(StringRef const& str, bool exclude_incomplete) {
 	data.append(data.arena(), str.begin(), str.size());
 
@@ -36,16 +50,8 @@ Tuple::Tuple(StringRef const& str, bool exclude_incomplete) {
 	while(i < data.size()) {
 		offsets.push_back(i);
 
-		if(data[i] == '\x01' || data[i] == '\x02') {
-			i = find_string_terminator(str, i+1) + 1;
-		}
-		else if(data[i] >= '\x0c' && data[i] <= '\x1c') {
-			i += abs(data[i] - '\x14') + 1;
-		}
-		else if(data[i] == '\x00') {
-			i += 1;
-		}
-		else {
+		i = find_element_end(str, i);
+		if(!i) {
 			throw invalid_tuple_data_type();
 		}
 	}
@@ -59,6 +65,21 @@ Tuple Tuple::unpack(StringRef const& str, bool exclude_incomplete) {
 	return Tuple(str, exclude_incomplete);
 }
 
+Optional<StringRef> Tuple::packedElement(StringRef const& str, size_t index) {
+	size_t i = 0;
+	for(size_t e = 0; i < str.size(); e++) {
+		size_t end = find_element_end(str, i);
+		if(!end || end > str.size()) {
+			return Optional<StringRef>();
+		}
+		if(e == index) {
+			return str.substr(i, end - i);
+		}
+		i = end;
+	}
+	return Optional<StringRef>();
+}
+
 Tuple& Tuple::append(Tuple const& tuple) {
 	for(size_t offset : tuple.offsets) {
 		offsets.push_back(offset + data.size());
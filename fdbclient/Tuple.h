@@ -35,6 +35,10 @@ struct Tuple {
 	// byte string is considered the end of the string in lieu of a specific end.
 	static Tuple unpack(StringRef const& str, bool exclude_incomplete = false);
 
+	// Returns the packed encoding of element index of the packed tuple str without unpacking the rest of it, or
+	// an empty Optional if str has fewer elements or is not a valid tuple up to that element.
+	static Optional<StringRef> packedElement(StringRef const& str, size_t index);
+
 	Tuple& append(Tuple const& tuple);
 	Tuple& append(StringRef const& str, bool utf8=false);
 	Tuple& append(int64_t);
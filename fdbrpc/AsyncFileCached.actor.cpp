@@ -19,6 +19,7 @@
  */
 
 #include "fdbrpc/AsyncFileCached.actor.h"
+#include "flow/UnitTest.h"
 
 //Page caches used in non-simulated environments
 Optional<Reference<EvictablePageCache>> pc4k, pc64k;
@@ -39,6 +40,8 @@ EvictablePage::~EvictablePage() {
 			pageCache->pages[index]->index = index;
 			pageCache->pages.pop_back();
 		}
+	} else if (isProtected) {
+		pageCache->protectedPages.erase(EvictablePageCache::List::s_iterator_to(*this));
 	} else {
 		// remove it from the LRU
 		pageCache->lruPages.erase(EvictablePageCache::List::s_iterator_to(*this));
@@ -290,3 +293,72 @@ AsyncFileCached::~AsyncFileCached() {
 	}
 	openFiles.erase( filename );
 }
+
+namespace {
+
+struct TestEvictablePage : EvictablePage {
+	std::map<int, TestEvictablePage*>* resident;
+	int id;
+
+	TestEvictablePage(Reference<EvictablePageCache> pageCache, std::map<int, TestEvictablePage*>* resident, int id)
+	  : EvictablePage(pageCache), resident(resident), id(id) {
+		pageCache->allocate(this);
+		(*resident)[id] = this;
+	}
+
+	virtual bool evict() {
+		resident->erase(id);
+		delete this;
+		return true;
+	}
+};
+
+// Returns the fraction of random accesses to a small hot set of pages that hit, when every round of hot accesses is
+// followed by a scan of more pages than the cache holds
+double hotPageHitRate(EvictablePageCache::CacheEvictionType type) {
+	const int cachePages = 100, hotPages = 50, scanPages = 150, rounds = 20;
+	Reference<EvictablePageCache> cache(new EvictablePageCache(4096, cachePages * 4096, type));
+	cache->maxProtectedPages = cachePages * 4 / 5;
+	std::map<int, TestEvictablePage*> resident;
+	int nextScanPage = hotPages;
+	int hits = 0, accesses = 0;
+
+	auto access = [&](int id) {
+		auto p = resident.find(id);
+		if (p == resident.end()) {
+			new TestEvictablePage(cache, &resident, id);
+			return false;
+		}
+		cache->updateHit(p->second);
+		return true;
+	};
+
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < 2 * hotPages; i++) {
+			bool hit = access(deterministicRandom()->randomInt(0, hotPages));
+			if (r >= 5) {
+				hits += hit;
+				++accesses;
+			}
+		}
+		for (int i = 0; i < scanPages; i++)
+			access(nextScanPage++);
+	}
+
+	while (!resident.empty())
+		resident.begin()->second->evict();
+	return double(hits) / accesses;
+}
+
+} // namespace
+
+TEST_CASE("/fdbrpc/AsyncFileCached/scanResistance") {
+	double lru = hotPageHitRate(EvictablePageCache::LRU);
+	double slru = hotPageHitRate(EvictablePageCache::SLRU);
+	printf("Hot page hit rate with scans: lru %f slru %f\n", lru, slru);
+
+	// A scan between rounds flushes every hot page out of an LRU, but SLRU keeps the pages that were reused
+	ASSERT(lru < 0.7);
+	ASSERT(slru > 0.95);
+	return Void();
+}
@@ -40,39 +40,57 @@ namespace bi = boost::intrusive;
 struct EvictablePage {
 	void* data;
 	int index;
+	bool isProtected; // for SLRU, whether the page is in the protected segment
 	class Reference<struct EvictablePageCache> pageCache;
 	bi::list_member_hook<> member_hook;
 
 	virtual bool evict() = 0; // true if page was evicted, false if it isn't immediately evictable (but will be evicted regardless if possible)
 
-	EvictablePage(Reference<EvictablePageCache> pageCache) : data(0), index(-1), pageCache(pageCache) {}
+	EvictablePage(Reference<EvictablePageCache> pageCache) : data(0), index(-1), isProtected(false), pageCache(pageCache) {}
 	virtual ~EvictablePage();
 };
 
 struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 	using List = bi::list< EvictablePage, bi::member_hook< EvictablePage, bi::list_member_hook<>, &EvictablePage::member_hook>>;
-	enum CacheEvictionType { RANDOM = 0, LRU = 1 };
+	// SLRU (segmented LRU) is scan resistant: pages start in a probationary LRU (lruPages) and move to a protected LRU
+	// (protectedPages) only when they are hit again, so a scan that reads each page once can only displace other pages
+	// that have not been reused.  Pages leaving the protected LRU go back to the tail of the probationary one.
+	enum CacheEvictionType { RANDOM = 0, LRU = 1, SLRU = 2 };
 
 	static CacheEvictionType evictionPolicyStringToEnum(const std::string &policy) {
 		std::string cep = policy;
 		std::transform(cep.begin(), cep.end(), cep.begin(), ::tolower);
-		if (cep != "random" && cep != "lru")
+		if (cep != "random" && cep != "lru" && cep != "slru")
 			throw invalid_cache_eviction_policy();
 
 		if (cep == "random")
 			return RANDOM;
+		if (cep == "slru")
+			return SLRU;
 		return LRU;
 	}
 
-	EvictablePageCache() : pageSize(0), maxPages(0), cacheEvictionType(RANDOM) {}
+	static const char* evictionPolicyName(CacheEvictionType type) {
+		return type == RANDOM ? "random" : type == SLRU ? "slru" : "lru";
+	}
+
+	EvictablePageCache() : pageSize(0), maxPages(0), maxProtectedPages(0), cacheEvictionType(RANDOM) {}
+
+	explicit EvictablePageCache(int pageSize, int64_t maxSize) : EvictablePageCache(pageSize, maxSize, evictionPolicyStringToEnum(FLOW_KNOBS->CACHE_EVICTION_POLICY)) {}
 
-	explicit EvictablePageCache(int pageSize, int64_t maxSize) : pageSize(pageSize), maxPages(maxSize / pageSize), cacheEvictionType(evictionPolicyStringToEnum(FLOW_KNOBS->CACHE_EVICTION_POLICY)) {
+	EvictablePageCache(int pageSize, int64_t maxSize, CacheEvictionType cacheEvictionType)
+	  : pageSize(pageSize), maxPages(maxSize / pageSize), maxProtectedPages(maxPages * FLOW_KNOBS->CACHE_PROTECTED_FRACTION),
+	    cacheEvictionType(cacheEvictionType) {
+		StringRef policy((const uint8_t*)evictionPolicyName(cacheEvictionType), strlen(evictionPolicyName(cacheEvictionType)));
 		cacheEvictions.init(LiteralStringRef("EvictablePageCache.CacheEvictions"));
+		cacheHits.init(LiteralStringRef("EvictablePageCache.CacheHits"), policy);
+		cacheMisses.init(LiteralStringRef("EvictablePageCache.CacheMisses"), policy);
 	}
 
 	void allocate(EvictablePage* page) {
 		try_evict();
 		try_evict();
+		++cacheMisses;
 		page->data = pageSize == 4096 ? FastAllocator<4096>::allocate() : aligned_alloc(4096,pageSize);
 		if (RANDOM == cacheEvictionType) {
 			page->index = pages.size();
@@ -83,7 +101,25 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 	}
 
 	void updateHit(EvictablePage* page) {
-		if (RANDOM != cacheEvictionType) {
+		++cacheHits;
+		if (SLRU == cacheEvictionType) {
+			if (page->isProtected) {
+				protectedPages.erase(List::s_iterator_to(*page));
+				protectedPages.push_back(*page);
+			} else if (&lruPages.back() != page) {
+				// A hit on the most recently used probationary page is most likely the same access continuing (e.g. a
+				// scan reading the rest of a page), so it does not count as reuse
+				lruPages.erase(List::s_iterator_to(*page));
+				page->isProtected = true;
+				protectedPages.push_back(*page);
+				if (protectedPages.size() > (uint64_t)maxProtectedPages) {
+					EvictablePage& demoted = protectedPages.front();
+					protectedPages.pop_front();
+					demoted.isProtected = false;
+					lruPages.push_back(demoted);
+				}
+			}
+		} else if (RANDOM != cacheEvictionType) {
 			// on a hit, update page's location in the LRU so that it's most recent (tail)
 			lruPages.erase(List::s_iterator_to(*page));
 			lruPages.push_back(*page);
@@ -102,8 +138,8 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 				}
 			}
 		} else {
-			// For now, LRU is the only other CACHE_EVICTION option
-			if (lruPages.size() >= (uint64_t)maxPages) {
+			// LRU, or SLRU, which evicts from the probationary LRU first and then from the protected one
+			if (lruPages.size() + protectedPages.size() >= (uint64_t)maxPages) {
 				int i = 0;
 				// try the least recently used pages first (starting at head of the LRU list)
 				for (List::iterator it = lruPages.begin();
@@ -111,7 +147,15 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 				     ++it, ++i) { // If we don't manage to evict anything, just go ahead and exceed the cache limit
 					if (it->evict()) {
 						++cacheEvictions;
-						break;
+						return;
+					}
+				}
+				for (List::iterator it = protectedPages.begin();
+				     it != protectedPages.end() && i < FLOW_KNOBS->MAX_EVICT_ATTEMPTS;
+				     ++it, ++i) {
+					if (it->evict()) {
+						++cacheEvictions;
+						return;
 					}
 				}
 			}
@@ -120,9 +164,13 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 
 	std::vector<EvictablePage*> pages;
 	List lruPages;
+	List protectedPages; // for SLRU only
 	int pageSize;
 	int64_t maxPages;
+	int64_t maxProtectedPages;
 	Int64MetricHandle cacheEvictions;
+	Int64MetricHandle cacheHits;
+	Int64MetricHandle cacheMisses;
 	const CacheEvictionType cacheEvictionType;
 };
 
@@ -193,6 +241,11 @@ public:
 		return write_impl(this, data, length, offset);
 	}
 
+	// Cached pages in the range are left alone, since they are allowed to keep their previous contents
+	virtual Future<Void> punchHole( int64_t offset, int64_t length ) {
+		return uncached->punchHole( offset, length );
+	}
+
 	virtual Future<Void> readZeroCopy( void** data, int* length, int64_t offset );
 	virtual void releaseZeroCopy( void* data, int length, int64_t offset );
 
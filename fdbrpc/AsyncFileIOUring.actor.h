@@ -0,0 +1,720 @@
+/*
+ * AsyncFileIOUring.actor.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifdef __linux__
+
+// When actually compiled (NO_INTELLISENSE), include the generated version of this file.  In intellisense use the source version.
+#if defined(NO_INTELLISENSE) && !defined(FLOW_ASYNCFILEIOURING_ACTOR_G_H)
+	#define FLOW_ASYNCFILEIOURING_ACTOR_G_H
+	#include "fdbrpc/AsyncFileIOUring.actor.g.h"
+#elif !defined(FLOW_ASYNCFILEIOURING_ACTOR_H)
+	#define FLOW_ASYNCFILEIOURING_ACTOR_H
+
+#include "fdbrpc/IAsyncFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "fdbrpc/linux_io_uring.h"
+#include "flow/Knobs.h"
+#include "flow/UnitTest.h"
+#include "flow/genericactors.actor.h"
+#include "flow/actorcompiler.h"  // This must be the last #include.
+
+// An IAsyncFile for unbuffered files which does its I/O through a Linux io_uring instead of kernel AIO.
+//
+// Requests made during an iteration of the run loop are queued by priority like AsyncFileKAIO's, and launch(), which the
+// network calls once per iteration, writes them all to the submission ring and submits them with a single system call.
+// Syncs are submitted to the ring as fdatasync requests instead of being run on the libeio thread pool.  Completions
+// are reaped from the completion ring by launch() without a system call; the ring signals the network's eventfd, which
+// AsyncFileKAIO::poll() is waiting on, so that the run loop wakes up when one arrives.
+//
+// The page magazines of FastAllocator<4096> are registered with the ring as fixed buffers as they are allocated, so
+// reads and writes of pages from it do not have to map their memory in the kernel on every request.
+class AsyncFileIOUring : public IAsyncFile, public ReferenceCounted<AsyncFileIOUring> {
+public:
+	static Future<Reference<IAsyncFile>> open( std::string filename, int flags, int mode, void* ignore ) {
+		ASSERT( flags & OPEN_UNBUFFERED );
+
+		if (flags & OPEN_LOCK)
+			mode |= 02000;  // Enable mandatory locking for this file if it is supported by the filesystem
+
+		std::string open_filename = filename;
+		if (flags & OPEN_ATOMIC_WRITE_AND_CREATE) {
+			ASSERT( (flags & OPEN_CREATE) && (flags & OPEN_READWRITE) && !(flags & OPEN_EXCLUSIVE) );
+			open_filename = filename + ".part";
+		}
+
+		int fd = ::open( open_filename.c_str(), openFlags(flags), mode );
+		if (fd<0) {
+			Error e = errno==ENOENT ? file_not_found() : io_error();
+			TraceEvent("AsyncFileIOUringOpenFailed").error(e).detail("Filename", filename).detailf("Flags", "%x", flags)
+				.detailf("OSFlags", "%x", openFlags(flags)).detailf("Mode", "0%o", mode).GetLastError();
+			return e;
+		} else {
+			TraceEvent("AsyncFileIOUringOpen")
+				.detail("Filename", filename)
+				.detail("Flags", flags)
+				.detail("Mode", mode)
+				.detail("Fd", fd);
+		}
+
+		Reference<AsyncFileIOUring> r(new AsyncFileIOUring( fd, flags, filename ));
+
+		if (flags & OPEN_LOCK) {
+			// Acquire a "write" lock for the entire file
+			flock lockDesc;
+			lockDesc.l_type = F_WRLCK;
+			lockDesc.l_whence = SEEK_SET;
+			lockDesc.l_start = 0;
+			lockDesc.l_len = 0;
+			lockDesc.l_pid = 0;
+			if (fcntl(fd, F_SETLK, &lockDesc) == -1) {
+				TraceEvent(SevError, "UnableToLockFile").detail("Filename", filename).GetLastError();
+				return io_error();
+			}
+		}
+
+		struct stat buf;
+		if (fstat( fd, &buf )) {
+			TraceEvent("AsyncFileIOUringFStatError").detail("Fd",fd).detail("Filename", filename).GetLastError();
+			return io_error();
+		}
+
+		r->lastFileSize = r->nextFileSize = buf.st_size;
+		return Reference<IAsyncFile>(std::move(r));
+	}
+
+	// Sets up the ring and has it signal ev when requests complete.  Returns false if the kernel does not support
+	// io_uring, in which case files must not be opened with this class.
+	static bool init( Reference<IEventFD> ev, double ioTimeout ) {
+		ASSERT( ctx.ringFd < 0 );
+
+		linux_io_uring_params p;
+		memset( &p, 0, sizeof(p) );
+		int ringFd = io_uring_setup( FLOW_KNOBS->MAX_OUTSTANDING, &p );
+		if (ringFd < 0) {
+			TraceEvent("IOUringSetupError").GetLastError();
+			return false;
+		}
+		if (!(p.features & IO_URING_FEAT_SINGLE_MMAP)) {
+			TraceEvent("IOUringUnsupported").detail("Features", p.features);
+			::close(ringFd);
+			return false;
+		}
+
+		size_t ringBytes = std::max<size_t>( p.sq_off.array + p.sq_entries * sizeof(uint32_t), p.cq_off.cqes + p.cq_entries * sizeof(linux_io_uring_cqe) );
+		size_t sqeBytes = p.sq_entries * sizeof(linux_io_uring_sqe);
+		void* ring = mmap( nullptr, ringBytes, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, IO_URING_OFF_SQ_RING );
+		void* sqes = mmap( nullptr, sqeBytes, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, IO_URING_OFF_SQES );
+		int evfd = ev->getFD();
+		if (ring == MAP_FAILED || sqes == MAP_FAILED || io_uring_register( ringFd, IO_URING_REGISTER_EVENTFD, &evfd, 1 ) < 0) {
+			TraceEvent("IOUringInitError").GetLastError();
+			if (ring != MAP_FAILED) munmap( ring, ringBytes );
+			if (sqes != MAP_FAILED) munmap( sqes, sqeBytes );
+			::close(ringFd);
+			return false;
+		}
+
+		uint8_t* r = (uint8_t*)ring;
+		ctx.sqTail = (uint32_t*)(r + p.sq_off.tail);
+		ctx.sqMask = *(uint32_t*)(r + p.sq_off.ring_mask);
+		ctx.sqArray = (uint32_t*)(r + p.sq_off.array);
+		ctx.sqes = (linux_io_uring_sqe*)sqes;
+		ctx.cqHead = (uint32_t*)(r + p.cq_off.head);
+		ctx.cqTail = (uint32_t*)(r + p.cq_off.tail);
+		ctx.cqMask = *(uint32_t*)(r + p.cq_off.ring_mask);
+		ctx.cqes = (linux_io_uring_cqe*)(r + p.cq_off.cqes);
+		ctx.ringFd = ringFd;
+		ctx.ev = ev;
+		setTimeout(ioTimeout);
+
+		// Register a table of empty slots, which page magazines are put in by launch() as they are allocated.  Kernels
+		// before 5.13 do not accept empty slots, and are left to do every request without fixed buffers.
+		if (FLOW_KNOBS->IO_URING_REGISTERED_BUFFERS > 0) {
+			std::vector<iovec> slots( FLOW_KNOBS->IO_URING_REGISTERED_BUFFERS );
+			if (io_uring_register( ringFd, IO_URING_REGISTER_BUFFERS, slots.data(), slots.size() ) == 0) {
+				ctx.bufferSlots = slots.size();
+				setFastAllocatorPageMagazineFunction( &AsyncFileIOUring::addPageMagazine );
+			} else {
+				TraceEvent("IOUringFixedBuffersUnsupported").GetLastError();
+			}
+		}
+
+		if( !g_network->isSimulated() ) {
+			ctx.countIOUringSubmit.init(LiteralStringRef("AsyncFile.CountIOUringSubmit"));
+			ctx.countIOUringCollect.init(LiteralStringRef("AsyncFile.CountIOUringCollect"));
+			ctx.countFixedBufferIO.init(LiteralStringRef("AsyncFile.CountIOUringFixedBufferIO"));
+		}
+
+		TraceEvent("IOUringInit").detail("Entries", p.sq_entries).detail("FixedBufferSlots", ctx.bufferSlots);
+		return true;
+	}
+
+	static bool available() { return ctx.ringFd >= 0; }
+	static void setTimeout(double ioTimeout) { ctx.setIOTimeout(ioTimeout); }
+
+	virtual void addref() { ReferenceCounted<AsyncFileIOUring>::addref(); }
+	virtual void delref() { ReferenceCounted<AsyncFileIOUring>::delref(); }
+
+	virtual Future<int> read( void* data, int length, int64_t offset ) {
+		++countFileLogicalReads;
+		++countLogicalReads;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IO_URING_OP_READV, fd);
+		io->buf = data;
+		io->nbytes = length;
+		io->offset = offset;
+
+		enqueue(io, this);
+		return io->result.getFuture();
+	}
+	virtual Future<Void> write( void const* data, int length, int64_t offset ) {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IO_URING_OP_WRITEV, fd);
+		io->buf = (void*)data;
+		io->nbytes = length;
+		io->offset = offset;
+
+		nextFileSize = std::max( nextFileSize, offset+length );
+
+		enqueue(io, this);
+		return success(io->result.getFuture());
+	}
+#ifndef FALLOC_FL_ZERO_RANGE
+#define FALLOC_FL_ZERO_RANGE 0x10
+#endif
+	virtual Future<Void> zeroRange( int64_t offset, int64_t length ) override {
+		bool success = false;
+		if (ctx.fallocateZeroSupported) {
+			int rc = fallocate( fd, FALLOC_FL_ZERO_RANGE, offset, length );
+			if (rc == EOPNOTSUPP) {
+				ctx.fallocateZeroSupported = false;
+			}
+			if (rc == 0) {
+				success = true;
+			}
+		}
+		return success ? Void() : IAsyncFile::zeroRange(offset, length);
+	}
+	virtual Future<Void> punchHole( int64_t offset, int64_t length ) override {
+		if (ctx.fallocatePunchHoleSupported) {
+			int rc = fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length );
+			if (rc != 0 && errno == EOPNOTSUPP) {
+				ctx.fallocatePunchHoleSupported = false;
+			}
+		}
+		return Void();
+	}
+	virtual Future<Void> truncate( int64_t size ) {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		int result = -1;
+		bool completed = false;
+		double begin = timer_monotonic();
+
+		if( ctx.fallocateSupported && size >= lastFileSize ) {
+			// Only the new end of the file is allocated, so that ranges released by punchHole stay released
+			result = size > lastFileSize ? fallocate( fd, 0, lastFileSize, size - lastFileSize ) : 0;
+			if (result != 0) {
+				int fallocateErrCode = errno;
+				TraceEvent("AsyncFileIOUringAllocateError").detail("Fd",fd).detail("Filename", filename).detail("Size", size).GetLastError();
+				if ( fallocateErrCode == EOPNOTSUPP ) {
+					// Mark fallocate as unsupported. Try again with truncate.
+					ctx.fallocateSupported = false;
+				} else {
+					return io_error();
+				}
+			} else {
+				completed = true;
+			}
+		}
+		if ( !completed )
+			result = ftruncate(fd, size);
+
+		double end = timer_monotonic();
+		if(nondeterministicRandom()->random01() < end-begin) {
+			TraceEvent("SlowIOUringTruncate")
+				.detail("TruncateTime", end - begin)
+				.detail("TruncateBytes", size - lastFileSize);
+		}
+
+		if(result != 0) {
+			TraceEvent("AsyncFileIOUringTruncateError").detail("Fd",fd).detail("Filename", filename).GetLastError();
+			return io_error();
+		}
+
+		lastFileSize = nextFileSize = size;
+
+		return Void();
+	}
+
+	virtual Future<Void> sync() {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IO_URING_OP_FSYNC, fd);
+		enqueue(io, this);
+		Future<Void> fsync = success(io->result.getFuture());
+
+		if (flags & OPEN_ATOMIC_WRITE_AND_CREATE) {
+			flags &= ~OPEN_ATOMIC_WRITE_AND_CREATE;
+
+			return AsyncFileEIO::waitAndAtomicRename( fsync, filename+".part", filename );
+		}
+
+		return fsync;
+	}
+	virtual Future<int64_t> size() { return nextFileSize; }
+	virtual int64_t debugFD() {
+		return fd;
+	}
+	virtual std::string getFilename() {
+		return filename;
+	}
+	~AsyncFileIOUring() {
+		close(fd);
+	}
+
+	static void launch() {
+		if (ctx.ringFd < 0) return;
+
+		reap();
+		registerPageMagazines();
+
+		if (ctx.queue.size() && ctx.outstanding < FLOW_KNOBS->MAX_OUTSTANDING - FLOW_KNOBS->MIN_SUBMIT) {
+			double begin = timer_monotonic();
+			if (!ctx.outstanding) ctx.ioStallBegin = begin;
+
+			int n = std::min<size_t>(FLOW_KNOBS->MAX_OUTSTANDING - ctx.outstanding, ctx.queue.size());
+			uint32_t tail = *ctx.sqTail;  // Only this thread writes the tail
+			for(int i=0; i<n; i++) {
+				auto io = ctx.queue.top();
+				ctx.queue.pop();
+				io->startTime = now();
+
+				if(ctx.ioTimeout > 0) {
+					ctx.appendToRequestList(io);
+				}
+
+				if (io->owner->lastFileSize != io->owner->nextFileSize) {
+					int64_t truncateSize = io->owner->nextFileSize - io->owner->lastFileSize;
+					ASSERT(truncateSize > 0);
+					io->owner->truncate(io->owner->nextFileSize);
+				}
+
+				uint32_t index = tail & ctx.sqMask;
+				io->prepare( &ctx.sqes[index] );
+				ctx.sqArray[index] = index;
+				++tail;
+			}
+			__atomic_store_n( ctx.sqTail, tail, __ATOMIC_RELEASE );
+			ctx.outstanding += n;
+			ctx.unsubmitted += n;
+
+			submit();
+
+			double elapsed = timer_monotonic() - begin;
+			g_network->networkMetrics.secSquaredSubmit += elapsed*elapsed/2;
+		} else if (ctx.unsubmitted) {
+			submit();
+		}
+	}
+
+	bool failed;
+private:
+	int fd, flags;
+	int64_t lastFileSize, nextFileSize;
+	std::string filename;
+	Int64MetricHandle countFileLogicalWrites;
+	Int64MetricHandle countFileLogicalReads;
+
+	Int64MetricHandle countLogicalWrites;
+	Int64MetricHandle countLogicalReads;
+
+	struct IOBlock : FastAllocated<IOBlock> {
+		int opcode;  // IO_URING_OP_READV, IO_URING_OP_WRITEV or IO_URING_OP_FSYNC
+		int fd;
+		void* buf;
+		int64_t nbytes;
+		int64_t offset;
+		iovec iov;  // Must stay valid until the request completes
+		Promise<int> result;
+		Reference<AsyncFileIOUring> owner;
+		int64_t prio;
+		IOBlock *prev;
+		IOBlock *next;
+		double startTime;
+
+		struct indirect_order_by_priority { bool operator () ( IOBlock* a, IOBlock* b ) { return a->prio < b->prio; } };
+
+		IOBlock(int opcode, int fd) : opcode(opcode), fd(fd), buf(nullptr), nbytes(0), offset(0), prev(nullptr), next(nullptr), startTime(0) {}
+
+		TaskPriority getTask() const { return static_cast<TaskPriority>((prio>>32)+1); }
+
+		void prepare( linux_io_uring_sqe* sqe ) {
+			memset( sqe, 0, sizeof(*sqe) );
+			sqe->fd = fd;
+			sqe->user_data = (uint64_t)this;
+
+			if (opcode == IO_URING_OP_FSYNC) {
+				sqe->opcode = opcode;
+				sqe->op_flags = IO_URING_FSYNC_DATASYNC;
+				return;
+			}
+
+			sqe->off = offset;
+			int slot = fixedBufferSlot( buf, nbytes );
+			if (slot >= 0) {
+				sqe->opcode = opcode == IO_URING_OP_READV ? IO_URING_OP_READ_FIXED : IO_URING_OP_WRITE_FIXED;
+				sqe->addr = (uint64_t)buf;
+				sqe->len = nbytes;
+				sqe->buf_index = slot;
+				++ctx.countFixedBufferIO;
+			} else {
+				iov.iov_base = buf;
+				iov.iov_len = nbytes;
+				sqe->opcode = opcode;
+				sqe->addr = (uint64_t)&iov;
+				sqe->len = 1;
+			}
+		}
+
+		ACTOR static void deliver( Promise<int> result, bool failed, int r, TaskPriority task ) {
+			wait( delay(0, task) );
+			if (failed) result.sendError(io_timeout());
+			else if (r < 0) result.sendError(io_error());
+			else result.send(r);
+		}
+
+		void setResult( int r ) {
+			if (r<0) {
+				struct stat fst;
+				fstat( fd, &fst );
+
+				errno = -r;
+				TraceEvent("AsyncFileIOUringIOError").GetLastError().detail("Fd", fd).detail("Op", opcode).detail("Nbytes", nbytes).detail("Offset", offset).detail("Ptr", int64_t(buf))
+					.detail("Size", fst.st_size).detail("Filename", owner->filename);
+			}
+			deliver( result, owner->failed, r, getTask() );
+			delete this;
+		}
+
+		void timeout(bool warnOnly) {
+			TraceEvent(SevWarnAlways, "AsyncFileIOUringTimeout").detail("Fd", fd).detail("Op", opcode).detail("Nbytes", nbytes).detail("Offset", offset).detail("Ptr", int64_t(buf))
+				.detail("Filename", owner->filename);
+			g_network->setGlobal(INetwork::enASIOTimedOut, (flowGlobalType)true);
+
+			if(!warnOnly)
+				owner->failed = true;
+		}
+	};
+
+	struct Context {
+		int ringFd;
+		Reference<IEventFD> ev;
+		uint32_t* sqTail;
+		uint32_t sqMask;
+		uint32_t* sqArray;
+		linux_io_uring_sqe* sqes;
+		uint32_t* cqHead;
+		uint32_t* cqTail;
+		uint32_t cqMask;
+		linux_io_uring_cqe* cqes;
+
+		int outstanding;  // Requests written to the submission ring which have not completed
+		int unsubmitted;  // Requests written to the submission ring which the kernel has not accepted yet
+		double ioStallBegin;
+		bool fallocateSupported;
+		bool fallocateZeroSupported;
+		bool fallocatePunchHoleSupported;
+		std::priority_queue<IOBlock*, std::vector<IOBlock*>, IOBlock::indirect_order_by_priority> queue;
+		Int64MetricHandle countIOUringSubmit;
+		Int64MetricHandle countIOUringCollect;
+		Int64MetricHandle countFixedBufferIO;
+
+		// Registered buffers, from the address they begin at to the address they end at and their slot
+		std::map<uintptr_t, std::pair<uintptr_t, int>> fixedBuffers;
+		int bufferSlots;
+		ThreadSpinLock newPageMagazinesLock;
+		std::vector<std::pair<uint8_t*, size_t>> newPageMagazines;  // Allocated by any thread and not yet registered
+
+		double ioTimeout;
+		bool timeoutWarnOnly;
+		IOBlock *submittedRequestList;
+
+		uint32_t opsIssued;
+		Context() : ringFd(-1), sqTail(nullptr), sqMask(0), sqArray(nullptr), sqes(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+			outstanding(0), unsubmitted(0), ioStallBegin(0), fallocateSupported(true), fallocateZeroSupported(true), fallocatePunchHoleSupported(true), bufferSlots(0),
+			submittedRequestList(nullptr), opsIssued(0) {
+			setIOTimeout(0);
+		}
+
+		void setIOTimeout(double timeout) {
+			ioTimeout = fabs(timeout);
+			timeoutWarnOnly = timeout < 0;
+		}
+
+		void appendToRequestList(IOBlock *io) {
+			ASSERT(!io->next && !io->prev);
+
+			if(submittedRequestList) {
+				io->prev = submittedRequestList->prev;
+				io->prev->next = io;
+
+				submittedRequestList->prev = io;
+				io->next = submittedRequestList;
+			}
+			else {
+				submittedRequestList = io;
+				io->next = io->prev = io;
+			}
+		}
+
+		void removeFromRequestList(IOBlock *io) {
+			if(io->next == nullptr) {
+				ASSERT(io->prev == nullptr);
+				return;
+			}
+
+			ASSERT(io->prev != nullptr);
+
+			if(io == io->next) {
+				ASSERT(io == submittedRequestList && io == io->prev);
+				submittedRequestList = nullptr;
+			}
+			else {
+				io->next->prev = io->prev;
+				io->prev->next = io->next;
+
+				if(submittedRequestList == io) {
+					submittedRequestList = io->next;
+				}
+			}
+
+			io->next = io->prev = nullptr;
+		}
+	};
+	static Context ctx;
+
+	explicit AsyncFileIOUring(int fd, int flags, std::string const& filename) : fd(fd), flags(flags), filename(filename), failed(false) {
+		if( !g_network->isSimulated() ) {
+			countFileLogicalWrites.init(LiteralStringRef("AsyncFile.CountFileLogicalWrites"), filename);
+			countFileLogicalReads.init( LiteralStringRef("AsyncFile.CountFileLogicalReads"), filename);
+			countLogicalWrites.init(LiteralStringRef("AsyncFile.CountLogicalWrites"));
+			countLogicalReads.init( LiteralStringRef("AsyncFile.CountLogicalReads"));
+		}
+	}
+
+	void enqueue( IOBlock* io, AsyncFileIOUring* owner ) {
+		ASSERT( io->opcode == IO_URING_OP_FSYNC || (int64_t(io->buf) % 4096 == 0 && io->offset % 4096 == 0 && io->nbytes % 4096 == 0) );
+
+		io->prio = (int64_t(g_network->getCurrentTask())<<32) - (++ctx.opsIssued);
+		io->owner = Reference<AsyncFileIOUring>::addRef(owner);
+
+		ctx.queue.push(io);
+	}
+
+	static int openFlags(int flags) {
+		int oflags = O_DIRECT | O_CLOEXEC;
+		ASSERT( bool(flags & OPEN_READONLY) != bool(flags & OPEN_READWRITE) );  // readonly xor readwrite
+		if( flags & OPEN_EXCLUSIVE ) oflags |= O_EXCL;
+		if( flags & OPEN_CREATE )    oflags |= O_CREAT;
+		if( flags & OPEN_READONLY )  oflags |= O_RDONLY;
+		if( flags & OPEN_READWRITE ) oflags |= O_RDWR;
+		if( flags & OPEN_ATOMIC_WRITE_AND_CREATE ) oflags |= O_TRUNC;
+		return oflags;
+	}
+
+	static void submit() {
+		int rc = io_uring_enter( ctx.ringFd, ctx.unsubmitted, 0, 0 );
+		++ctx.countIOUringSubmit;
+		if (rc >= 0) {
+			ctx.unsubmitted -= rc;
+		} else if (errno != EAGAIN && errno != EBUSY && errno != EINTR) {
+			// The requests stay in the submission ring and are submitted again by the next launch()
+			TraceEvent(SevWarnAlways, "IOUringSubmitError").GetLastError().detail("Unsubmitted", ctx.unsubmitted);
+		}
+	}
+
+	static void reap() {
+		uint32_t head = *ctx.cqHead;
+		uint32_t tail = __atomic_load_n( ctx.cqTail, __ATOMIC_ACQUIRE );
+		if (head == tail) return;
+
+		++ctx.countIOUringCollect;
+		double t = timer_monotonic();
+		double elapsed = t - ctx.ioStallBegin;
+		ctx.ioStallBegin = t;
+		g_network->networkMetrics.secSquaredDiskStall += elapsed*elapsed/2;
+
+		if(ctx.ioTimeout > 0) {
+			double currentTime = now();
+			while(ctx.submittedRequestList && currentTime - ctx.submittedRequestList->startTime > ctx.ioTimeout) {
+				ctx.submittedRequestList->timeout(ctx.timeoutWarnOnly);
+				ctx.removeFromRequestList(ctx.submittedRequestList);
+			}
+		}
+
+		for(; head != tail; ++head) {
+			linux_io_uring_cqe const& cqe = ctx.cqes[head & ctx.cqMask];
+			IOBlock* io = (IOBlock*)cqe.user_data;
+			int r = cqe.res;
+			--ctx.outstanding;
+
+			if(ctx.ioTimeout > 0) {
+				ctx.removeFromRequestList(io);
+			}
+
+			io->setResult( r );
+		}
+		__atomic_store_n( ctx.cqHead, head, __ATOMIC_RELEASE );
+	}
+
+	static void addPageMagazine( void* begin, size_t size ) {
+		ThreadSpinLockHolder holder( ctx.newPageMagazinesLock );
+		ctx.newPageMagazines.push_back( std::make_pair( (uint8_t*)begin, size ) );
+	}
+
+	static void registerPageMagazines() {
+		std::vector<std::pair<uint8_t*, size_t>> magazines;
+		{
+			ThreadSpinLockHolder holder( ctx.newPageMagazinesLock );
+			magazines.swap( ctx.newPageMagazines );
+		}
+
+		for(auto& m : magazines) {
+			if (ctx.fixedBuffers.size() >= ctx.bufferSlots)
+				break;
+
+			iovec iov;
+			iov.iov_base = m.first;
+			iov.iov_len = m.second;
+			linux_io_uring_rsrc_update2 update;
+			memset( &update, 0, sizeof(update) );
+			update.offset = ctx.fixedBuffers.size();
+			update.data = (uint64_t)&iov;
+			update.nr = 1;
+			if (io_uring_register( ctx.ringFd, IO_URING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update) ) < 0) {
+				// Registered buffers are locked in memory, so this is most likely RLIMIT_MEMLOCK
+				TraceEvent(SevWarnAlways, "IOUringRegisterBufferError").GetLastError().detail("Registered", ctx.fixedBuffers.size());
+				ctx.bufferSlots = ctx.fixedBuffers.size();
+				break;
+			}
+			int slot = ctx.fixedBuffers.size();
+			ctx.fixedBuffers[ (uintptr_t)m.first ] = std::make_pair( (uintptr_t)m.first + m.second, slot );
+		}
+	}
+
+	// Returns the slot of the registered buffer containing [buf, buf+nbytes), or -1 if there is none
+	static int fixedBufferSlot( void* buf, int64_t nbytes ) {
+		auto b = ctx.fixedBuffers.upper_bound( (uintptr_t)buf );
+		if (b == ctx.fixedBuffers.begin())
+			return -1;
+		--b;
+		if ((uintptr_t)buf + nbytes > b->second.first)
+			return -1;
+		return b->second.second;
+	}
+};
+
+TEST_CASE("/fdbrpc/AsyncFileIOUring/ReadWrite") {
+	// This test does nothing in simulation, or on kernels without io_uring
+	if (!g_network->isSimulated() && AsyncFileIOUring::available()) {
+		state Reference<IAsyncFile> f;
+		state std::vector<void*> pages;
+		state int i;
+		try {
+			Reference<IAsyncFile> f_ = wait(AsyncFileIOUring::open(
+			    "/tmp/__IO_URING_TEST_FILE__",
+			    IAsyncFile::OPEN_UNBUFFERED | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_CREATE, 0666, nullptr));
+			f = f_;
+			state int pageCount = 64;
+			wait(f->truncate(pageCount * 4096));
+
+			// Pages from FastAllocator<4096> are written and read through fixed buffers once their magazine is
+			// registered, and a larger buffer from elsewhere never is
+			for(i = 0; i < pageCount; i++) {
+				pages.push_back(FastAllocator<4096>::allocate());
+				memset(pages.back(), i, 4096);
+			}
+			state std::vector<Future<Void>> writes;
+			for(i = 0; i < pageCount; i++)
+				writes.push_back(f->write(pages[i], 4096, i * 4096));
+			wait(waitForAll(writes));
+			wait(f->sync());
+
+			for(i = 0; i < pageCount; i++)
+				memset(pages[i], 0xff, 4096);
+			state std::vector<Future<int>> reads;
+			for(i = 0; i < pageCount; i++)
+				reads.push_back(f->read(pages[deterministicRandom()->randomInt(0, pageCount)], 4096, i * 4096));
+			wait(waitForAll(reads));
+
+			state Standalone<StringRef> whole = makeAlignedString(4096, pageCount * 4096);
+			int r = wait(f->read(mutateString(whole), whole.size(), 0));
+			ASSERT(r == whole.size());
+			for(i = 0; i < pageCount; i++)
+				ASSERT(whole[i * 4096] == uint8_t(i) && whole[i * 4096 + 4095] == uint8_t(i));
+
+			int64_t size = wait(f->size());
+			ASSERT(size == pageCount * 4096);
+		} catch (Error& e) {
+			state Error err = e;
+			if(f) {
+				wait(AsyncFileEIO::deleteFile(f->getFilename(), true));
+			}
+			throw err;
+		}
+
+		for(auto p : pages)
+			FastAllocator<4096>::release(p);
+		wait(AsyncFileEIO::deleteFile(f->getFilename(), true));
+	}
+
+	return Void();
+}
+
+AsyncFileIOUring::Context AsyncFileIOUring::ctx;
+
+#include "flow/unactorcompiler.h"
+#endif
+#endif
@@ -245,6 +245,15 @@ public:
 		}
 		return success ? Void() : IAsyncFile::zeroRange(offset, length);
 	}
+	virtual Future<Void> punchHole( int64_t offset, int64_t length ) override {
+		if (ctx.fallocatePunchHoleSupported) {
+			int rc = fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length );
+			if (rc != 0 && errno == EOPNOTSUPP) {
+				ctx.fallocatePunchHoleSupported = false;
+			}
+		}
+		return Void();
+	}
 	virtual Future<Void> truncate( int64_t size ) {
 		++countFileLogicalWrites;
 		++countLogicalWrites;
@@ -262,7 +271,8 @@ public:
 		double begin = timer_monotonic();
 
 		if( ctx.fallocateSupported && size >= lastFileSize ) {
-			result = fallocate( fd, 0, 0, size);
+			// Only the new end of the file is allocated, so that ranges released by punchHole stay released
+			result = size > lastFileSize ? fallocate( fd, 0, lastFileSize, size - lastFileSize ) : 0;
 			if (result != 0) {
 				int fallocateErrCode = errno;
 				TraceEvent("AsyncFileKAIOAllocateError").detail("Fd",fd).detail("Filename", filename).detail("Size", size).GetLastError();
@@ -511,6 +521,7 @@ private:
 		double ioStallBegin;
 		bool fallocateSupported;
 		bool fallocateZeroSupported;
+		bool fallocatePunchHoleSupported;
 		std::priority_queue<IOBlock*, std::vector<IOBlock*>, IOBlock::indirect_order_by_priority> queue;
 		Int64MetricHandle countAIOSubmit;
 		Int64MetricHandle countAIOCollect;
@@ -526,7 +537,7 @@ private:
 		EventMetricHandle<SlowAioSubmit> slowAioSubmitMetric;
 
 		uint32_t opsIssued;
-		Context() : iocx(0), evfd(-1), outstanding(0), opsIssued(0), ioStallBegin(0), fallocateSupported(true), fallocateZeroSupported(true), submittedRequestList(nullptr) {
+		Context() : iocx(0), evfd(-1), outstanding(0), opsIssued(0), ioStallBegin(0), fallocateSupported(true), fallocateZeroSupported(true), fallocatePunchHoleSupported(true), submittedRequestList(nullptr) {
 			setIOTimeout(0);
 		}
 
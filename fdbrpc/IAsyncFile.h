@@ -48,7 +48,8 @@ public:
 		OPEN_ATOMIC_WRITE_AND_CREATE = 0x80000,  // A temporary file is opened, and on the first call to sync() it is atomically renamed to the given filename
 		OPEN_LARGE_PAGES = 0x100000, 
 		OPEN_NO_AIO = 0x200000,                   // Don't use AsyncFileKAIO or similar implementations that rely on filesystem support for AIO
-		OPEN_CACHED_READ_ONLY = 0x400000          // AsyncFileCached opens files read/write even if you specify read only
+		OPEN_CACHED_READ_ONLY = 0x400000,         // AsyncFileCached opens files read/write even if you specify read only
+		OPEN_IO_URING = 0x800000                  // Use AsyncFileIOUring for an unbuffered file, if the kernel supports it, even if ENABLE_IO_URING is not set
 	};  
 
 	virtual void addref() = 0;
@@ -60,6 +61,9 @@ public:
 	// The zeroed data is not guaranteed to be durable after `zeroRange` returns.  A call to sync() would be required.
 	// This operation holds a reference to the AsyncFile, and does not need to be cancelled before a reference is dropped.
 	virtual Future<Void> zeroRange( int64_t offset, int64_t length );
+	// Hints that the contents of the range are no longer needed, so that the file system can release the space that holds
+	// them.  Afterwards the range may read as zeros or as its previous contents.  By default this does nothing.
+	virtual Future<Void> punchHole( int64_t offset, int64_t length ) { return Void(); }
 	virtual Future<Void> truncate( int64_t size ) = 0;
 	virtual Future<Void> sync() = 0;
 	virtual Future<Void> flush() { return Void();  }      // Sends previous writes to the OS if they have been buffered in memory, but does not make them power safe
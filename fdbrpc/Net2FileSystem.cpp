@@ -35,6 +35,7 @@
 #include "fdbrpc/AsyncFileEIO.actor.h"
 #include "fdbrpc/AsyncFileWinASIO.actor.h"
 #include "fdbrpc/AsyncFileKAIO.actor.h"
+#include "fdbrpc/AsyncFileIOUring.actor.h"
 #include "flow/AsioReactor.h"
 #include "flow/Platform.h"
 #include "fdbrpc/AsyncFileWriteChecker.h"
@@ -63,6 +64,10 @@ Future< Reference<class IAsyncFile> > Net2FileSystem::open( std::string filename
 	// or AIO at all. In such cases, DISABLE_POSIX_KERNEL_AIO knob can be enabled to fallback to
 	// EIO instead of Kernel AIO.
 	if ((flags & IAsyncFile::OPEN_UNBUFFERED) && !(flags & IAsyncFile::OPEN_NO_AIO) &&
+	    !FLOW_KNOBS->DISABLE_POSIX_KERNEL_AIO &&
+	    (FLOW_KNOBS->ENABLE_IO_URING || (flags & IAsyncFile::OPEN_IO_URING)) && initIOUring())
+		f = AsyncFileIOUring::open(filename, flags, mode, NULL);
+	else if ((flags & IAsyncFile::OPEN_UNBUFFERED) && !(flags & IAsyncFile::OPEN_NO_AIO) &&
 	    !FLOW_KNOBS->DISABLE_POSIX_KERNEL_AIO)
 		f = AsyncFileKAIO::open(filename, flags, mode, NULL);
 	else
@@ -88,11 +93,35 @@ void Net2FileSystem::newFileSystem(double ioTimeout, std::string fileSystemPath)
 	g_network->setGlobal(INetwork::enFileSystem, (flowGlobalType) new Net2FileSystem(ioTimeout, fileSystemPath));
 }
 
+#ifdef __linux__
+static void launchAsyncIO() {
+	AsyncFileKAIO::launch();
+	AsyncFileIOUring::launch();
+}
+
+// Sets up the ring the first time it is needed, and returns whether AsyncFileIOUring can be used
+bool Net2FileSystem::initIOUring() {
+	if (!ioUringInitialized) {
+		ioUringInitialized = true;
+		// The ring signals the same eventfd that AsyncFileKAIO polls, which wakes the run loop to reap its completions
+		if (AsyncFileIOUring::init( Reference<IEventFD>(N2::ASIOReactor::getEventFD()), ioTimeout ))
+			g_network->setGlobal(INetwork::enRunCycleFunc, (flowGlobalType) &launchAsyncIO);
+	}
+	return AsyncFileIOUring::available();
+}
+#endif
+
 Net2FileSystem::Net2FileSystem(double ioTimeout, std::string fileSystemPath)
 {
 	Net2AsyncFile::init();
 #ifdef __linux__
 	AsyncFileKAIO::init( Reference<IEventFD>(N2::ASIOReactor::getEventFD()), ioTimeout );
+	this->ioTimeout = ioTimeout;
+	ioUringInitialized = false;
+	// With ENABLE_IO_URING every unbuffered file uses the ring, so set it up before any page magazine is allocated and
+	// all of them can be registered.  Otherwise it waits for the first file opened with OPEN_IO_URING.
+	if (FLOW_KNOBS->ENABLE_IO_URING && !FLOW_KNOBS->DISABLE_POSIX_KERNEL_AIO)
+		initIOUring();
 
 	if (fileSystemPath.empty()) {
 		checkFileSystem = false;
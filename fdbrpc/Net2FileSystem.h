@@ -46,6 +46,11 @@ public:
 #ifdef __linux__
 	dev_t fileSystemDeviceId;
 	bool checkFileSystem;
+
+	// The io_uring ring registers buffers and hooks the FastAllocator, so it is only set up once a file may use it
+	double ioTimeout;
+	bool ioUringInitialized;
+	bool initIOUring();
 #endif
 };
 
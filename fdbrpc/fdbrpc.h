@@ -441,5 +441,52 @@ struct serializable_traits<RequestStream<T>> : std::true_type {
 	}
 };
 
+// A stream of replies to a single request.  Like a ReplyPromise, only the endpoint's token is serialized, and the
+// receiver addresses it at the process the request came from, so it works for clients with no public address.
+// Each send() is unreliable: a reply is delivered zero or one times, and the replies that are delivered arrive in order.
+// The requester should watch the responder for failure and number its replies if it must detect a lost one.
+template <class T>
+class ReplyPromiseStream {
+public:
+	void send(const T& value) const { stream.send(value); }
+
+	FutureStream<T> getFuture() const { return stream.getFuture(); }
+	const Endpoint getEndpoint(TaskPriority taskID = TaskPriority::DefaultPromiseEndpoint) const { return stream.getEndpoint(taskID); }
+
+	ReplyPromiseStream() {}
+	explicit ReplyPromiseStream(const Endpoint& endpoint) : stream(endpoint) {}
+
+private:
+	RequestStream<T> stream;
+};
+
+template <class Ar, class T>
+void save(Ar& ar, const ReplyPromiseStream<T>& value) {
+	auto const& ep = value.getEndpoint().token;
+	ar << ep;
+}
+
+template <class Ar, class T>
+void load(Ar& ar, ReplyPromiseStream<T>& value) {
+	UID token;
+	ar >> token;
+	value = ReplyPromiseStream<T>(FlowTransport::transport().loadedEndpoint(token));
+}
+
+template <class T>
+struct serializable_traits<ReplyPromiseStream<T>> : std::true_type {
+	template<class Archiver>
+	static void serialize(Archiver& ar, ReplyPromiseStream<T>& p) {
+		if constexpr (Archiver::isDeserializing) {
+			UID token;
+			serializer(ar, token);
+			p = ReplyPromiseStream<T>(FlowTransport::transport().loadedEndpoint(token));
+		} else {
+			const auto& ep = p.getEndpoint().token;
+			serializer(ar, ep);
+		}
+	}
+};
+
 #endif
 #include "fdbrpc/genericactors.actor.h"
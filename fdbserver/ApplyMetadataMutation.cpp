@@ -94,6 +94,27 @@ void applyMetadataMutations(UID const& dbgid, Arena &arena, VectorRef<MutationRe
 					toCommit->addTag( decodeServerTagValue( txnStateStore->readValue( serverTagKeyFor( serverKeysDecodeServer(m.param1) ) ).get().get() ) );
 					toCommit->addTypedMessage(privatized);
 				}
+			} else if (m.param1.startsWith(bulkIngestPrefix)) {
+				if(toCommit && keyInfo) {
+					// Every storage server which receives mutations for the file's range (including the destination of an in-flight
+					// move) loads its part of the file
+					MutationRef privatized = m;
+					privatized.param1 = m.param1.withPrefix(systemKeys.begin, arena);
+					BulkIngestFile file = decodeBulkIngestValue(m.param2);
+					std::set<Tag> tags;
+					auto ranges = keyInfo->intersectingRanges(file.keys);
+					for(auto r = ranges.begin(); r != ranges.end(); ++r) {
+						for(auto& info : r->value().src_info)
+							tags.insert( info->tag );
+						for(auto& info : r->value().dest_info)
+							tags.insert( info->tag );
+					}
+					TraceEvent("SendingBulkIngest", dbgid).detail("File", file.toString()).detail("Servers", tags.size());
+
+					for(auto& tag : tags)
+						toCommit->addTag( tag );
+					toCommit->addTypedMessage(privatized);
+				}
 			} else if (m.param1.startsWith(serverTagPrefix)) {
 				UID id = decodeServerTagKey(m.param1);
 				Tag tag = decodeServerTagValue(m.param2);
@@ -0,0 +1,424 @@
+/*
+ * CompactKeyValueMap.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbserver/CompactKeyValueMap.h"
+#include "flow/KeyCompare.h"
+#include "flow/UnitTest.h"
+
+static int varintSize(uint32_t v) {
+	int n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		++n;
+	}
+	return n;
+}
+
+static uint8_t* writeVarint(uint8_t* p, uint32_t v) {
+	while (v >= 0x80) {
+		*p++ = uint8_t(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = uint8_t(v);
+	return p;
+}
+
+static const uint8_t* readVarint(const uint8_t* p, uint32_t& v) {
+	v = 0;
+	int shift = 0;
+	while (*p & 0x80) {
+		v |= uint32_t(*p++ & 0x7f) << shift;
+		shift += 7;
+	}
+	v |= uint32_t(*p++) << shift;
+	return p;
+}
+
+static int sharedPrefix(KeyRef prev, KeyRef key) {
+	return commonPrefixLength(prev.begin(), key.begin(), std::min(prev.size(), key.size()));
+}
+
+static int encodedSize(int shared, KeyValueRef const& kv) {
+	int suffix = kv.key.size() - shared;
+	return varintSize(shared) + varintSize(suffix) + varintSize(kv.value.size()) + suffix + kv.value.size();
+}
+
+void CompactKeyValueMap::iterator::decode() {
+	const uint8_t* base = block->second.buf.get();
+	const uint8_t* p = base + offset;
+	uint32_t shared, suffix, valueLength;
+	p = readVarint(p, shared);
+	p = readVarint(p, suffix);
+	p = readVarint(p, valueLength);
+	keyBuf.resize(shared + suffix);
+	if (suffix)
+		memcpy(keyBuf.data() + shared, p, suffix);
+	p += suffix;
+	value = ValueRef(p, valueLength);
+	nextOffset = p + valueLength - base;
+}
+
+void CompactKeyValueMap::iterator::seekFirst(Index::const_iterator b) {
+	block = b;
+	offset = 0;
+	keyBuf.clear();
+	if (block != indexEnd)
+		decode();
+}
+
+void CompactKeyValueMap::iterator::operator++() {
+	offset = nextOffset;
+	if (offset == block->second.size)
+		seekFirst(std::next(block));
+	else
+		decode();
+}
+
+CompactKeyValueMap::iterator CompactKeyValueMap::begin() const {
+	iterator i(index.begin(), index.end());
+	i.seekFirst(index.begin());
+	return i;
+}
+
+CompactKeyValueMap::iterator CompactKeyValueMap::seek(KeyRef key, bool after) const {
+	auto b = index.upper_bound(key);
+	if (b == index.begin())
+		return begin();
+	--b;
+
+	iterator i(b, index.end());
+	i.seekFirst(b);
+	while (i.block == b) {
+		if (after ? key < i->key : !(i->key < key))
+			break;
+		++i;
+	}
+	return i;
+}
+
+CompactKeyValueMap::iterator CompactKeyValueMap::find(KeyRef key) const {
+	iterator i = lower_bound(key);
+	if (i != end() && i->key == key)
+		return i;
+	return end();
+}
+
+CompactKeyValueMap::iterator CompactKeyValueMap::previous(iterator i) const {
+	Index::const_iterator b;
+	int target;
+	if (i.block == index.end()) {
+		if (index.empty())
+			return end();
+		b = std::prev(index.end());
+		target = b->second.size;
+	} else if (i.offset == 0) {
+		if (i.block == index.begin())
+			return end();
+		b = std::prev(i.block);
+		target = b->second.size;
+	} else {
+		b = i.block;
+		target = i.offset;
+	}
+
+	iterator r(b, index.end());
+	r.seekFirst(b);
+	while (r.nextOffset != target) {
+		r.offset = r.nextOffset;
+		r.decode();
+	}
+	return r;
+}
+
+CompactKeyValueMap::Index::iterator CompactKeyValueMap::blockFor(KeyRef key) {
+	auto b = index.upper_bound(key);
+	if (b != index.begin())
+		--b;
+	return b;
+}
+
+void CompactKeyValueMap::decodeBlock(Block const& block, Arena& arena, std::vector<KeyValueRef>& out) {
+	const uint8_t* p = block.buf.get();
+	const uint8_t* end = p + block.size;
+	KeyRef prev;
+	while (p != end) {
+		uint32_t shared, suffix, valueLength;
+		p = readVarint(p, shared);
+		p = readVarint(p, suffix);
+		p = readVarint(p, valueLength);
+		uint8_t* key = new (arena) uint8_t[shared + suffix];
+		if (shared)
+			memcpy(key, prev.begin(), shared);
+		if (suffix)
+			memcpy(key + shared, p, suffix);
+		p += suffix;
+		prev = KeyRef(key, shared + suffix);
+		out.push_back(KeyValueRef(prev, ValueRef(arena, ValueRef(p, valueLength))));
+		p += valueLength;
+	}
+}
+
+int64_t CompactKeyValueMap::blockBytes(Block const& block) {
+	// The index node holds a Block and its key, plus the tree's pointers and the allocator's headers
+	return block.size + sizeof(Index::value_type) + 48;
+}
+
+CompactKeyValueMap::Index::iterator CompactKeyValueMap::addBlock(Index::iterator hint, KeyValueRef const* begin,
+                                                                 KeyValueRef const* end) {
+	ASSERT(begin != end);
+	int size = 0;
+	KeyRef prev;
+	for (auto kv = begin; kv != end; ++kv) {
+		size += encodedSize(kv == begin ? 0 : sharedPrefix(prev, kv->key), *kv);
+		prev = kv->key;
+	}
+
+	Block block;
+	block.buf.reset(new uint8_t[size]);
+	block.size = size;
+	block.count = end - begin;
+
+	uint8_t* p = block.buf.get();
+	const uint8_t* firstKey = nullptr;
+	for (auto kv = begin; kv != end; ++kv) {
+		int shared = kv == begin ? 0 : sharedPrefix(prev, kv->key);
+		int suffix = kv->key.size() - shared;
+		p = writeVarint(p, shared);
+		p = writeVarint(p, suffix);
+		p = writeVarint(p, kv->value.size());
+		if (kv == begin)
+			firstKey = p;
+		memcpy(p, kv->key.begin() + shared, suffix);
+		p += suffix;
+		memcpy(p, kv->value.begin(), kv->value.size());
+		p += kv->value.size();
+		prev = kv->key;
+	}
+	ASSERT(p == block.buf.get() + size);
+
+	auto b = index.emplace_hint(hint, StringRef(firstKey, begin->key.size()), std::move(block));
+	memoryBytes += blockBytes(b->second);
+	return b;
+}
+
+void CompactKeyValueMap::removeBlock(Index::iterator b) {
+	memoryBytes -= blockBytes(b->second);
+	index.erase(b);
+}
+
+void CompactKeyValueMap::rewrite(Index::iterator b, std::vector<KeyValueRef> const& pairs) {
+	auto hint = std::next(b);
+	removeBlock(b);
+	if (pairs.empty())
+		return;
+
+	int total = 0;
+	for (int i = 0; i < pairs.size(); i++)
+		total += encodedSize(i ? sharedPrefix(pairs[i-1].key, pairs[i].key) : 0, pairs[i]);
+
+	if (total <= 2 * targetBlockBytes) {
+		addBlock(hint, pairs.data(), pairs.data() + pairs.size());
+		return;
+	}
+
+	// Cut into blocks of about targetBlockBytes, without leaving a small block at the end
+	int begin = 0, blockSize = 0, consumed = 0;
+	for (int i = 0; i < pairs.size(); i++) {
+		int s = encodedSize(i != begin ? sharedPrefix(pairs[i-1].key, pairs[i].key) : 0, pairs[i]);
+		blockSize += s;
+		consumed += s;
+		if (blockSize >= targetBlockBytes && total - consumed >= targetBlockBytes / 2 && i + 1 < pairs.size()) {
+			addBlock(hint, pairs.data() + begin, pairs.data() + i + 1);
+			begin = i + 1;
+			blockSize = 0;
+		}
+	}
+	addBlock(hint, pairs.data() + begin, pairs.data() + pairs.size());
+}
+
+void CompactKeyValueMap::merge(Index::iterator b) {
+	if (b == index.end() || b->second.size >= targetBlockBytes / 4 || index.size() < 2)
+		return;
+
+	auto first = b, second = std::next(b);
+	if (second == index.end()) {
+		second = b;
+		first = std::prev(b);
+	}
+
+	Arena arena;
+	std::vector<KeyValueRef> pairs;
+	decodeBlock(first->second, arena, pairs);
+	decodeBlock(second->second, arena, pairs);
+	removeBlock(second);
+	rewrite(first, pairs);
+}
+
+void CompactKeyValueMap::insert(KeyRef key, ValueRef value) {
+	auto b = blockFor(key);
+	if (b == index.end()) {
+		KeyValueRef kv(key, value);
+		addBlock(index.end(), &kv, &kv + 1);
+		++pairCount;
+		return;
+	}
+
+	Arena arena;
+	std::vector<KeyValueRef> pairs;
+	pairs.reserve(b->second.count + 1);
+	decodeBlock(b->second, arena, pairs);
+	auto p = std::lower_bound(pairs.begin(), pairs.end(), key,
+	                          [](KeyValueRef const& kv, KeyRef const& k) { return kv.key < k; });
+	if (p != pairs.end() && p->key == key) {
+		p->value = value;
+	} else {
+		pairs.insert(p, KeyValueRef(key, value));
+		++pairCount;
+	}
+	rewrite(b, pairs);
+}
+
+void CompactKeyValueMap::eraseRange(KeyRef begin, Optional<KeyRef> end) {
+	if (end.present() && !(begin < end.get()))
+		return;
+
+	auto b = blockFor(begin);
+	while (b != index.end() && (!end.present() || b->first < end.get())) {
+		auto next = std::next(b);
+		// Every key of b is before the first key of the next block
+		if (!(b->first < begin) && next != index.end() && (!end.present() || next->first <= end.get())) {
+			pairCount -= b->second.count;
+			removeBlock(b);
+		} else {
+			Arena arena;
+			std::vector<KeyValueRef> pairs;
+			decodeBlock(b->second, arena, pairs);
+			auto compare = [](KeyValueRef const& kv, KeyRef const& k) { return kv.key < k; };
+			auto first = std::lower_bound(pairs.begin(), pairs.end(), begin, compare);
+			auto last = end.present() ? std::lower_bound(first, pairs.end(), end.get(), compare) : pairs.end();
+			if (first != last) {
+				pairCount -= last - first;
+				pairs.erase(first, last);
+				rewrite(b, pairs);
+			}
+		}
+		b = next;
+	}
+
+	// Only the blocks at either end of the range can have been left small
+	merge(blockFor(begin));
+	merge(index.lower_bound(begin));
+}
+
+void CompactKeyValueMap::clear() {
+	index.clear();
+	pairCount = 0;
+	memoryBytes = 0;
+}
+
+TEST_CASE("/fdbserver/CompactKeyValueMap/randomOps") {
+	int blockBytes = deterministicRandom()->coinflip() ? deterministicRandom()->randomInt(1, 64) : 1024;
+	CompactKeyValueMap map(blockBytes);
+	std::map<std::string, std::string> model;
+
+	auto randomKey = []() {
+		// A small alphabet so that keys share long prefixes
+		std::string s = "prefix/";
+		int len = deterministicRandom()->randomInt(0, 8);
+		for (int i = 0; i < len; i++)
+			s += (char)('a' + deterministicRandom()->randomInt(0, 4));
+		return s;
+	};
+
+	for (int op = 0; op < 20000; op++) {
+		int r = deterministicRandom()->randomInt(0, 100);
+		if (r < 60) {
+			std::string k = randomKey();
+			std::string v(deterministicRandom()->randomInt(0, 20), (char)deterministicRandom()->randomInt(0, 256));
+			map.insert(StringRef(k), StringRef(v));
+			model[k] = v;
+		} else if (r < 70) {
+			std::string a = randomKey(), b = randomKey();
+			map.erase(StringRef(a), StringRef(b));
+			if (a < b)
+				model.erase(model.lower_bound(a), model.lower_bound(b));
+		} else if (r < 71) {
+			std::string a = randomKey();
+			map.eraseToEnd(StringRef(a));
+			model.erase(model.lower_bound(a), model.end());
+		} else {
+			std::string k = randomKey();
+			auto lb = map.lower_bound(StringRef(k));
+			auto mlb = model.lower_bound(k);
+			ASSERT((lb == map.end()) == (mlb == model.end()));
+			if (mlb != model.end()) {
+				ASSERT(lb->key == StringRef(mlb->first) && lb->value == StringRef(mlb->second));
+			}
+
+			auto ub = map.upper_bound(StringRef(k));
+			auto mub = model.upper_bound(k);
+			ASSERT((ub == map.end()) == (mub == model.end()));
+			if (mub != model.end()) {
+				ASSERT(ub->key == StringRef(mub->first));
+			}
+
+			auto f = map.find(StringRef(k));
+			ASSERT((f == map.end()) == !model.count(k));
+
+			auto p = map.previous(lb);
+			if (mlb == model.begin()) {
+				ASSERT(p == map.end());
+			} else {
+				ASSERT(p->key == StringRef(std::prev(mlb)->first));
+			}
+		}
+		ASSERT(map.size() == model.size());
+	}
+
+	auto m = model.begin();
+	for (auto i = map.begin(); i != map.end(); ++i, ++m)
+		ASSERT(i->key == StringRef(m->first) && i->value == StringRef(m->second));
+	ASSERT(m == model.end());
+
+	auto rm = model.rbegin();
+	for (auto i = map.previous(map.end()); i != map.end(); i = map.previous(i), ++rm)
+		ASSERT(i->key == StringRef(rm->first));
+	ASSERT(rm == model.rend());
+
+	map.clear();
+	ASSERT(map.size() == 0 && map.bytes() == 0 && map.begin() == map.end());
+	return Void();
+}
+
+TEST_CASE("/fdbserver/CompactKeyValueMap/bytesPerPair") {
+	// Tuple encoded style keys with a common prefix and small values
+	CompactKeyValueMap map;
+	int count = 100000;
+	for (int i = 0; i < count; i++) {
+		std::string k = format("\x15\x01users/%08d/name", i);
+		map.insert(StringRef(k), LiteralStringRef("12345678"));
+	}
+	double bytesPerPair = double(map.bytes()) / map.size();
+	printf("CompactKeyValueMap: %d pairs of %d key bytes and 8 value bytes use %.1f bytes each\n", count,
+	       (int)strlen("\x15\x01users/00000000/name"), bytesPerPair);
+	// The node based layout uses more than 100 bytes per pair for the same data
+	ASSERT(bytesPerPair < 32);
+	return Void();
+}
@@ -0,0 +1,128 @@
+/*
+ * CompactKeyValueMap.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_COMPACTKEYVALUEMAP_H
+#define FDBSERVER_COMPACTKEYVALUEMAP_H
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "fdbclient/FDBTypes.h"
+
+// An ordered map from keys to values for the memory storage engine which keeps its contents in blocks of sorted pairs
+// instead of one tree node and arena per pair.  Within a block each key is stored as the length of the prefix it shares
+// with the previous key followed by the rest of it, so a pair costs its unshared key bytes, its value bytes and a few
+// bytes of lengths.  Blocks are found through an index on their first keys.
+//
+// Each entry of a block is encoded as
+//   [varint shared][varint suffixLength][varint valueLength][suffix bytes][value bytes]
+// and the first entry of a block always has shared == 0.
+//
+// Modifying the map invalidates all of its iterators and any KeyRef or ValueRef read through them.
+class CompactKeyValueMap : NonCopyable {
+	struct Block {
+		std::unique_ptr<uint8_t[]> buf;
+		int size;
+		int count;
+		Block() : size(0), count(0) {}
+	};
+	typedef std::map<StringRef, Block> Index;
+
+public:
+	struct Entry {
+		KeyRef key;
+		ValueRef value;
+	};
+
+	class iterator {
+	public:
+		iterator() : block(), offset(0), nextOffset(0) {}
+
+		const Entry& operator*() const { return *operator->(); }
+		const Entry* operator->() const {
+			entry.key = KeyRef(keyBuf.data(), keyBuf.size());
+			entry.value = value;
+			return &entry;
+		}
+
+		void operator++();
+
+		bool operator==(iterator const& r) const { return block == r.block && offset == r.offset; }
+		bool operator!=(iterator const& r) const { return !(*this == r); }
+
+	private:
+		friend class CompactKeyValueMap;
+		iterator(Index::const_iterator block, Index::const_iterator indexEnd) : block(block), indexEnd(indexEnd), offset(0), nextOffset(0) {}
+
+		// Decodes the entry at offset, given that keyBuf holds the key of the entry before it in the block
+		void decode();
+		void seekFirst(Index::const_iterator b);
+
+		Index::const_iterator block, indexEnd;
+		int offset, nextOffset;
+		std::vector<uint8_t> keyBuf;
+		ValueRef value;
+		mutable Entry entry;
+	};
+
+	explicit CompactKeyValueMap(int targetBlockBytes = 1024) : targetBlockBytes(targetBlockBytes), pairCount(0), memoryBytes(0) {}
+
+	iterator begin() const;
+	iterator end() const { return iterator(index.end(), index.end()); }
+	iterator lower_bound(KeyRef key) const { return seek(key, false); }
+	iterator upper_bound(KeyRef key) const { return seek(key, true); }
+	iterator find(KeyRef key) const;
+	// Returns the entry before i, or end() if i is begin(); previous(end()) is the last entry
+	iterator previous(iterator i) const;
+
+	// Sets key to value, replacing any existing value
+	void insert(KeyRef key, ValueRef value);
+	// Removes every key in [begin, end)
+	void erase(KeyRef begin, KeyRef end) { eraseRange(begin, end); }
+	// Removes every key >= begin
+	void eraseToEnd(KeyRef begin) { eraseRange(begin, Optional<KeyRef>()); }
+	void clear();
+
+	int64_t size() const { return pairCount; }
+	// Approximate memory used by the map, including the index and allocation overhead
+	int64_t bytes() const { return memoryBytes; }
+
+private:
+	iterator seek(KeyRef key, bool after) const;
+	Index::iterator blockFor(KeyRef key);
+	void eraseRange(KeyRef begin, Optional<KeyRef> end);
+
+	// Replaces the block at b with blocks holding pairs, splitting it if it has grown too large and removing it if pairs
+	// is empty
+	void rewrite(Index::iterator b, std::vector<KeyValueRef> const& pairs);
+	void merge(Index::iterator b);
+	void removeBlock(Index::iterator b);
+	Index::iterator addBlock(Index::iterator hint, KeyValueRef const* begin, KeyValueRef const* end);
+	static void decodeBlock(Block const& block, Arena& arena, std::vector<KeyValueRef>& out);
+	static int64_t blockBytes(Block const& block);
+
+	Index index;
+	int targetBlockBytes;
+	int64_t pairCount;
+	int64_t memoryBytes;
+};
+
+#endif
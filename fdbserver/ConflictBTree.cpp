@@ -0,0 +1,446 @@
+/*
+ * ConflictBTree.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbserver/ConflictBTree.h"
+#include "flow/KeyCompare.h"
+#include "flow/UnitTest.h"
+
+ConflictBTree::ConflictBTree( Version version ) : entries(0), allocatedBytes(0) {
+	root = newNode(true);
+	setKey(root, 0, StringRef());
+	root->version[0] = version;
+	root->count = 1;
+	entries = 1;
+}
+
+ConflictBTree::~ConflictBTree() {
+	if (root)
+		freeSubtree(root);
+}
+
+void ConflictBTree::swap( ConflictBTree& other ) {
+	std::swap(root, other.root);
+	std::swap(entries, other.entries);
+	std::swap(allocatedBytes, other.allocatedBytes);
+}
+
+Version ConflictBTree::Node::maxVersion() const {
+	Version v = version[0];
+	for(int i=1; i<count; i++)
+		v = std::max(v, version[i]);
+	return v;
+}
+
+uint64_t ConflictBTree::prefixOf( StringRef key ) {
+	uint64_t x = 0;
+	if (key.size())
+		memcpy(&x, key.begin(), std::min(key.size(), 8));
+	return bigEndian64(x);
+}
+
+// Compares the i'th key of n with key.  Zero padded prefixes order the same way as the keys they came from
+// whenever they differ, so the full key is only looked at when the prefixes are equal.
+int ConflictBTree::compare( const Node* n, int i, uint64_t prefix, StringRef key ) {
+	if (n->prefix[i] != prefix)
+		return n->prefix[i] < prefix ? -1 : 1;
+	return compareKeys(n->keyData[i], n->keyLength[i], key.begin(), key.size());
+}
+
+// Returns the index of the last key in n that is <= key, or -1 if there is none
+int ConflictBTree::floor( const Node* n, uint64_t prefix, StringRef key ) {
+	int lo = 0, hi = n->count;
+	while (lo < hi) {
+		int mid = (lo+hi)/2;
+		if (compare(n, mid, prefix, key) <= 0)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo-1;
+}
+
+// Returns the index of the first key in n that is >= key, or n->count if there is none
+int ConflictBTree::lowerBound( const Node* n, uint64_t prefix, StringRef key ) {
+	int lo = 0, hi = n->count;
+	while (lo < hi) {
+		int mid = (lo+hi)/2;
+		if (compare(n, mid, prefix, key) < 0)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+ConflictBTree::Node* ConflictBTree::newNode( bool leaf ) {
+	Node* n;
+	if (leaf) {
+		n = new Node;
+		allocatedBytes += sizeof(Node);
+		INSTRUMENT_ALLOCATE("ConflictBTreeLeaf");
+	} else {
+		n = new Interior;
+		allocatedBytes += sizeof(Interior);
+		INSTRUMENT_ALLOCATE("ConflictBTreeInterior");
+	}
+	n->leaf = leaf;
+	n->count = 0;
+	return n;
+}
+
+// Frees n itself; the keys it still holds must already have been freed or moved elsewhere
+void ConflictBTree::freeNode( Node* n ) {
+	if (n->leaf) {
+		allocatedBytes -= sizeof(Node);
+		delete n;
+		INSTRUMENT_RELEASE("ConflictBTreeLeaf");
+	} else {
+		allocatedBytes -= sizeof(Interior);
+		delete (Interior*)n;
+		INSTRUMENT_RELEASE("ConflictBTreeInterior");
+	}
+}
+
+void ConflictBTree::freeSubtree( Node* n ) {
+	if (n->leaf)
+		entries -= n->count;
+	else
+		for(int i=0; i<n->count; i++)
+			freeSubtree( ((Interior*)n)->child[i] );
+	for(int i=0; i<n->count; i++)
+		freeKey(n, i);
+	freeNode(n);
+}
+
+void ConflictBTree::setKey( Node* n, int i, StringRef key ) {
+	n->prefix[i] = prefixOf(key);
+	n->keyLength[i] = key.size();
+	n->keyData[i] = key.size() ? (uint8_t*)allocateFast(key.size()) : nullptr;
+	if (key.size())
+		memcpy(n->keyData[i], key.begin(), key.size());
+	allocatedBytes += key.size();
+}
+
+void ConflictBTree::freeKey( Node* n, int i ) {
+	allocatedBytes -= n->keyLength[i];
+	if (n->keyLength[i])
+		freeFast(n->keyLength[i], n->keyData[i]);
+	n->keyData[i] = nullptr;
+	n->keyLength[i] = 0;
+}
+
+// Copies count entries (and children) from from[fromIndex...] to to[toIndex...], which may overlap.
+// Ownership of the keys moves with them; counts are left to the caller.
+void ConflictBTree::moveEntries( Node* to, int toIndex, Node* from, int fromIndex, int count ) {
+	if (count <= 0) return;
+	memmove(&to->prefix[toIndex], &from->prefix[fromIndex], count*sizeof(to->prefix[0]));
+	memmove(&to->version[toIndex], &from->version[fromIndex], count*sizeof(to->version[0]));
+	memmove(&to->keyData[toIndex], &from->keyData[fromIndex], count*sizeof(to->keyData[0]));
+	memmove(&to->keyLength[toIndex], &from->keyLength[fromIndex], count*sizeof(to->keyLength[0]));
+	if (!to->leaf)
+		memmove(&((Interior*)to)->child[toIndex], &((Interior*)from)->child[fromIndex], count*sizeof(Node*));
+}
+
+// Removes entries [begin, end) of n and frees their keys, but not the children they point to
+void ConflictBTree::removeEntries( Node* n, int begin, int end ) {
+	if (begin >= end) return;
+	for(int i=begin; i<end; i++)
+		freeKey(n, i);
+	moveEntries(n, begin, n, end, n->count - end);
+	n->count -= end-begin;
+}
+
+Version ConflictBTree::versionAt( StringRef key ) const {
+	uint64_t prefix = prefixOf(key);
+	const Node* n = root;
+	const Node* left = nullptr;
+	while (!n->leaf) {
+		int i = std::max(0, floor(n, prefix, key));
+		if (i > 0)
+			left = ((const Interior*)n)->child[i-1];
+		n = ((const Interior*)n)->child[i];
+	}
+	int i = floor(n, prefix, key);
+	if (i >= 0)
+		return n->version[i];
+
+	// Separators are not tightened when entries are erased, so the entry covering key can be the last one in
+	// the nearest subtree to the left of the path we took
+	ASSERT(left);
+	while (!left->leaf)
+		left = ((const Interior*)left)->child[left->count-1];
+	return left->version[left->count-1];
+}
+
+// Returns true if any entry of the subtree n with a key strictly between begin and end has a version greater
+// than readVersion
+bool ConflictBTree::anyAbove( const Node* n, StringRef begin, StringRef end, Version readVersion ) const {
+	uint64_t beginPrefix = prefixOf(begin), endPrefix = prefixOf(end);
+	if (n->leaf) {
+		for(int i = floor(n, beginPrefix, begin)+1; i < n->count && compare(n, i, endPrefix, end) < 0; i++)
+			if (n->version[i] > readVersion)
+				return true;
+		return false;
+	}
+
+	// Children strictly between s and t lie entirely inside (begin, end), so their summaries are exact
+	const Interior* in = (const Interior*)n;
+	int s = std::max(0, floor(n, beginPrefix, begin));
+	int t = std::max(s, lowerBound(n, endPrefix, end) - 1);
+	for(int i = s+1; i < t; i++)
+		if (n->version[i] > readVersion)
+			return true;
+	if (n->version[s] > readVersion && anyAbove(in->child[s], begin, end, readVersion))
+		return true;
+	return t != s && n->version[t] > readVersion && anyAbove(in->child[t], begin, end, readVersion);
+}
+
+bool ConflictBTree::hasConflict( StringRef begin, StringRef end, Version readVersion ) const {
+	return versionAt(begin) > readVersion || anyAbove(root, begin, end, readVersion);
+}
+
+// Inserts (key, version) into the subtree n, or updates the version of an existing entry for key unless
+// onlyIfAbsent.  Returns the new right sibling if n had to be split.
+ConflictBTree::Node* ConflictBTree::insert( Node* n, StringRef key, uint64_t prefix, Version version, bool onlyIfAbsent ) {
+	Node* split = nullptr;
+	int pos;
+	if (n->leaf) {
+		int i = floor(n, prefix, key);
+		if (i >= 0 && compare(n, i, prefix, key) == 0) {
+			if (!onlyIfAbsent)
+				n->version[i] = version;
+			return nullptr;
+		}
+		pos = i+1;
+		entries++;
+	} else {
+		Interior* in = (Interior*)n;
+		int i = std::max(0, floor(n, prefix, key));
+		split = insert(in->child[i], key, prefix, version, onlyIfAbsent);
+		in->version[i] = in->child[i]->maxVersion();
+		if (!split)
+			return nullptr;
+		pos = i+1;
+	}
+
+	Node* right = nullptr;
+	Node* target = n;
+	if (n->count == Capacity) {
+		right = newNode(n->leaf);
+		int half = Capacity/2;
+		moveEntries(right, 0, n, half, Capacity-half);
+		right->count = Capacity-half;
+		n->count = half;
+		if (pos > half) {
+			target = right;
+			pos -= half;
+		}
+	}
+
+	moveEntries(target, pos+1, target, pos, target->count-pos);
+	target->count++;
+	if (split) {
+		setKey(target, pos, split->key(0));
+		target->version[pos] = split->maxVersion();
+		((Interior*)target)->child[pos] = split;
+	} else {
+		setKey(target, pos, key);
+		target->version[pos] = version;
+	}
+	return right;
+}
+
+void ConflictBTree::insert( StringRef key, Version version, bool onlyIfAbsent ) {
+	Node* split = insert(root, key, prefixOf(key), version, onlyIfAbsent);
+	if (split) {
+		Interior* r = (Interior*)newNode(false);
+		setKey(r, 0, root->key(0));
+		r->version[0] = root->maxVersion();
+		r->child[0] = root;
+		setKey(r, 1, split->key(0));
+		r->version[1] = split->maxVersion();
+		r->child[1] = split;
+		r->count = 2;
+		root = r;
+	}
+}
+
+// Merges child i+1 of n into child i
+void ConflictBTree::mergeChildren( Interior* n, int i ) {
+	Node* l = n->child[i];
+	Node* r = n->child[i+1];
+	if (!r->leaf) {
+		// The first separator of an interior node is never searched, so it may be stale; the parent's is not
+		freeKey(r, 0);
+		setKey(r, 0, n->key(i+1));
+	}
+	moveEntries(l, l->count, r, 0, r->count);
+	l->count += r->count;
+	r->count = 0;
+	freeNode(r);
+	removeEntries(n, i+1, i+2);
+	n->version[i] = l->maxVersion();
+}
+
+// Restores the summary of child i of n after it has lost entries, removing it if it is empty and merging it
+// with a neighbor if it is sparse enough to fit in one
+void ConflictBTree::fixChild( Interior* n, int i ) {
+	Node* c = n->child[i];
+	if (c->count == 0) {
+		freeNode(c);
+		removeEntries(n, i, i+1);
+		return;
+	}
+	n->version[i] = c->maxVersion();
+	if (c->count >= MinFill)
+		return;
+	if (i > 0 && n->child[i-1]->count + c->count <= Capacity)
+		mergeChildren(n, i-1);
+	else if (i+1 < n->count && c->count + n->child[i+1]->count <= Capacity)
+		mergeChildren(n, i);
+}
+
+// Erases the entries of the subtree n with keys in (begin, end), or [begin, end) if includeBegin
+void ConflictBTree::erase( Node* n, StringRef begin, StringRef end, bool includeBegin ) {
+	uint64_t beginPrefix = prefixOf(begin), endPrefix = prefixOf(end);
+	if (n->leaf) {
+		int lo = includeBegin ? lowerBound(n, beginPrefix, begin) : floor(n, beginPrefix, begin)+1;
+		int hi = lowerBound(n, endPrefix, end);
+		if (lo < hi) {
+			entries -= hi-lo;
+			removeEntries(n, lo, hi);
+		}
+		return;
+	}
+
+	Interior* in = (Interior*)n;
+	int s = std::max(0, floor(n, beginPrefix, begin));
+	int t = std::max(s, lowerBound(n, endPrefix, end) - 1);
+	if (t != s)
+		erase(in->child[t], begin, end, includeBegin);
+	for(int i = s+1; i < t; i++)
+		freeSubtree(in->child[i]);
+	removeEntries(n, s+1, t);
+	erase(in->child[s], begin, end, includeBegin);
+
+	if (t != s)
+		fixChild(in, s+1);
+	fixChild(in, s);
+}
+
+void ConflictBTree::erase( StringRef begin, StringRef end, bool includeBegin ) {
+	erase(root, begin, end, includeBegin);
+	while (!root->leaf && root->count == 1) {
+		Node* child = ((Interior*)root)->child[0];
+		removeEntries(root, 0, 1);
+		freeNode(root);
+		root = child;
+	}
+	ASSERT(root->count > 0);
+}
+
+void ConflictBTree::addConflictRange( StringRef begin, StringRef end, Version version ) {
+	Version endVersion = versionAt(end);
+	insert(begin, version, false);
+	erase(begin, end, false);
+	insert(end, endVersion, true);
+}
+
+// Appends copies of the entries of n with keys >= begin to out, until it holds limit entries
+void ConflictBTree::collect( const Node* n, StringRef begin, int limit, Arena& arena, std::vector<std::pair<StringRef, Version>>& out ) const {
+	uint64_t prefix = prefixOf(begin);
+	if (n->leaf) {
+		for(int i = lowerBound(n, prefix, begin); i < n->count && out.size() < limit; i++)
+			out.emplace_back( StringRef(arena, n->key(i)), n->version[i] );
+		return;
+	}
+	for(int i = std::max(0, floor(n, prefix, begin)); i < n->count && out.size() < limit; i++)
+		collect( ((const Interior*)n)->child[i], begin, limit, arena, out );
+}
+
+int ConflictBTree::removeBefore( Version oldestVersion, Key& removalKey, int entryCount ) {
+	Arena arena;
+	std::vector<std::pair<StringRef, Version>> examined;
+	collect(root, removalKey, entryCount+1, arena, examined);
+
+	// Removable entries are erased a run at a time
+	int removed = 0;
+	int runBegin = -1;
+	bool wasAbove = true;
+	int end = std::min<int>(entryCount, examined.size());
+	for(int i=0; i<=end; i++) {
+		bool remove = false;
+		if (i < end) {
+			bool isAbove = examined[i].second >= oldestVersion;
+			remove = !isAbove && !wasAbove;
+			wasAbove = isAbove;
+		}
+		if (remove && runBegin < 0) {
+			runBegin = i;
+		} else if (!remove && runBegin >= 0) {
+			erase(examined[runBegin].first, i < examined.size() ? examined[i].first : keyAfter(examined[i-1].first, arena), true);
+			removed += i - runBegin;
+			runBegin = -1;
+		}
+	}
+
+	if (examined.size() > entryCount)
+		removalKey = examined[entryCount].first;
+	else
+		removalKey = Key();
+	return removed;
+}
+
+TEST_CASE("/fdbserver/ConflictBTree/randomized") {
+	// Compare against a brute force map from every key in a small key space to its version
+	const int keySpace = 200;
+	std::vector<Version> versions( keySpace+1, 0 );
+	ConflictBTree tree;
+	Key removalKey;
+
+	auto keyFor = [](int i) {
+		return Key(format("%05d", i));
+	};
+
+	Version version = 0;
+	Version oldest = 0;
+	for(int step=0; step<20000; step++) {
+		int b = deterministicRandom()->randomInt(0, keySpace);
+		int e = deterministicRandom()->randomInt(b+1, std::min(keySpace, b+20)+1);
+		if (deterministicRandom()->random01() < 0.5) {
+			version++;
+			tree.addConflictRange(keyFor(b), keyFor(e), version);
+			for(int i=b; i<e; i++)
+				versions[i] = version;
+		} else {
+			Version readVersion = deterministicRandom()->randomInt64(oldest, version+1);
+			bool expected = false;
+			for(int i=b; i<e; i++)
+				expected = expected || versions[i] > readVersion;
+			ASSERT( tree.hasConflict(keyFor(b), keyFor(e), readVersion) == expected );
+		}
+		if (deterministicRandom()->random01() < 0.05) {
+			oldest = std::max<Version>(oldest, version - 50);
+			tree.removeBefore(oldest, removalKey, deterministicRandom()->randomInt(1, 50));
+		}
+	}
+
+	return Void();
+}
@@ -0,0 +1,103 @@
+/*
+ * ConflictBTree.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_CONFLICTBTREE_H
+#define FDBSERVER_CONFLICTBTREE_H
+#pragma once
+
+#include "fdbclient/FDBTypes.h"
+
+// A B+-tree holding the resolver's version history, as an alternative to the SkipList in SkipList.cpp.
+// An entry (k, v) means that every key in [k, next entry's key) was last written at version v; the tree
+// always contains an entry for the empty key.
+//
+// Each node stores its keys as an array of big endian 8 byte prefixes next to (but separate from) the
+// full key pointers, so a search within a node normally touches only a few cache lines.  Interior nodes
+// keep the maximum version of every child subtree, so checking a read conflict range visits the two
+// root-to-leaf paths at its ends rather than every entry it spans.
+class ConflictBTree : NonCopyable {
+public:
+	explicit ConflictBTree( Version version = 0 );
+	~ConflictBTree();
+
+	// Returns true if any key in [begin, end) was written at a version greater than readVersion
+	bool hasConflict( StringRef begin, StringRef end, Version readVersion ) const;
+
+	// Records that every key in [begin, end) was written at version, which must be at least as large as
+	// every version already in the tree
+	void addConflictRange( StringRef begin, StringRef end, Version version );
+
+	// Examines up to entryCount entries starting at removalKey and removes those that, like the entry
+	// before them, are older than oldestVersion.  removalKey is advanced past the examined entries,
+	// wrapping around to the beginning of the key space.  Returns the number of entries removed.
+	int removeBefore( Version oldestVersion, Key& removalKey, int entryCount );
+
+	int count() const { return entries; }
+	int64_t bytes() const { return allocatedBytes; }
+	void swap( ConflictBTree& other );
+
+private:
+	enum { Capacity = 32, MinFill = Capacity/4 };
+
+	struct Node {
+		int count;
+		bool leaf;
+		uint64_t prefix[Capacity];
+		Version version[Capacity];		// Leaf: version of the entry.  Interior: max version in the child's subtree.
+		uint8_t* keyData[Capacity];
+		int keyLength[Capacity];
+
+		StringRef key( int i ) const { return StringRef( keyData[i], keyLength[i] ); }
+		Version maxVersion() const;
+	};
+
+	struct Interior : Node {
+		Node* child[Capacity];
+	};
+
+	Node* root;
+	int entries;
+	int64_t allocatedBytes;
+
+	static uint64_t prefixOf( StringRef key );
+	static int compare( const Node* n, int i, uint64_t prefix, StringRef key );
+	static int floor( const Node* n, uint64_t prefix, StringRef key );
+	static int lowerBound( const Node* n, uint64_t prefix, StringRef key );
+
+	Node* newNode( bool leaf );
+	void freeNode( Node* n );
+	void freeSubtree( Node* n );
+	void setKey( Node* n, int i, StringRef key );
+	void freeKey( Node* n, int i );
+	void moveEntries( Node* to, int toIndex, Node* from, int fromIndex, int count );
+	void removeEntries( Node* n, int begin, int end );
+
+	Version versionAt( StringRef key ) const;
+	bool anyAbove( const Node* n, StringRef begin, StringRef end, Version readVersion ) const;
+	Node* insert( Node* n, StringRef key, uint64_t prefix, Version version, bool onlyIfAbsent );
+	void insert( StringRef key, Version version, bool onlyIfAbsent );
+	void erase( Node* n, StringRef begin, StringRef end, bool includeBegin );
+	void erase( StringRef begin, StringRef end, bool includeBegin );
+	void fixChild( Interior* n, int i );
+	void mergeChildren( Interior* n, int i );
+	void collect( const Node* n, StringRef begin, int limit, Arena& arena, std::vector<std::pair<StringRef, Version>>& out ) const;
+};
+
+#endif
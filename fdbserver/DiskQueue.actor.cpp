@@ -23,10 +23,13 @@
 #include "fdbserver/Knobs.h"
 #include "fdbrpc/simulator.h"
 #include "fdbrpc/crc32c.h"
+#include "fdbserver/CoroFlow.h"
 #include "flow/genericactors.actor.h"
+#include "flow/IThreadPool.h"
 #include "flow/actorcompiler.h"  // This must be the last #include.
 
 typedef bool(*compare_pages)(void*,void*);
+typedef bool(*check_page)(const uint8_t*);
 typedef int64_t loc_t;
 
 // 0 -> 0
@@ -163,7 +166,8 @@ public:
 		: basename(basename), fileExtension(fileExtension), onError(delayed(error.getFuture())), onStopped(stopped.getFuture()),
 		readingFile(-1), readingPage(-1), writingPos(-1), dbgid(dbgid),
 		dbg_file0BeginSeq(0), fileExtensionBytes(SERVER_KNOBS->DISK_QUEUE_FILE_EXTENSION_BYTES),
-		fileShrinkBytes(SERVER_KNOBS->DISK_QUEUE_FILE_SHRINK_BYTES), readingBuffer( dbgid ),
+		fileShrinkBytes(SERVER_KNOBS->DISK_QUEUE_FILE_SHRINK_BYTES), readingChunkPos(0), readAheadFile(-1), readAheadPage(-1),
+		readAheadBytes(0), checkPage(NULL), lastPageChecked(false),
 		readyToPush(Void()), fileSizeWarningLimit(fileSizeWarningLimit), lastCommit(Void()), isFirstCommit(true)
 	{
 		if (BUGGIFY)
@@ -202,8 +206,20 @@ public:
 		TraceEvent("RDQSetStart", dbgid).detail("FileNum",file).detail("PageNum",page).detail("File0Name", files[0].dbgFilename);
 		readingFile = file;
 		readingPage = page;
+		readAheadFile = file;
+		readAheadPage = page;
+
+		if (checkPage && SERVER_KNOBS->DISK_QUEUE_RECOVERY_CHECKSUM_THREADS > 0) {
+			recoveryThreads = g_network->isSimulated() ? CoroThreadPool::createThreadPool() : createGenericThreadPool();
+			for(int i = 0; i < SERVER_KNOBS->DISK_QUEUE_RECOVERY_CHECKSUM_THREADS; i++)
+				recoveryThreads->addThread( new PageChecker );
+		}
 	}
 
+	// Pages returned by readNextPage() are checked with checkPage on recoveryThreads, if it is set, while later pages
+	// are still being read
+	void setPageChecker( check_page checkPage ) { this->checkPage = checkPage; }
+
 	Future<Void> setPoppedPage( int file, int64_t page, int64_t debugSeq ) { return setPoppedPage(this, file, page, debugSeq); }
 
 	// FIXME: let the caller pass in where to write the data.
@@ -260,9 +276,47 @@ public:
 	Future<Void> lastCommit;
 	bool isFirstCommit;
 
-	StringBuffer readingBuffer; // Pages that have been read and not yet returned
-	int readingFile;  // File index where the next page (after readingBuffer) should be read from, i.e., files[readingFile]. readingFile = 2 if recovery is complete (all files have been read). 
-	int64_t readingPage;  // Page within readingFile that is the next page after readingBuffer
+	int readingFile;  // File index of the next page readNextPage() returns, i.e., files[readingFile]. readingFile = 2 if recovery is complete (all files have been read).
+	int64_t readingPage;  // Page within readingFile that readNextPage() returns next
+
+	// During recovery the queue is read in chunks, and up to DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES of the chunks after
+	// the one being returned are read (and their pages checked) while the caller decodes earlier pages.
+	struct ReadChunk {
+		Standalone<StringRef> pages;
+		std::vector<bool> checked;  // checked[i] is true if page i is known to have a valid checksum
+	};
+	struct PendingRead {
+		int file;
+		int64_t page;
+		Future<ReadChunk> chunk;
+	};
+	ReadChunk readingChunk; // Pages that have been read and not yet returned start at readingChunkPos
+	int readingChunkPos;
+	std::deque<PendingRead> readAhead;
+	int readAheadFile;  // File and page where the next chunk will be read from
+	int64_t readAheadPage;
+	int64_t readAheadBytes;
+	check_page checkPage;
+	Reference<IThreadPool> recoveryThreads;
+	bool lastPageChecked;  // The page most recently returned by readNextPage() has a valid checksum
+
+	struct PageChecker : IThreadPoolReceiver {
+		virtual void init() {}
+
+		struct CheckAction : TypedAction<PageChecker, CheckAction>, FastAllocated<CheckAction> {
+			Standalone<StringRef> pages;
+			check_page checkPage;
+			ThreadReturnPromise<std::vector<bool>> result;
+			CheckAction( Standalone<StringRef> const& pages, check_page checkPage ) : pages(pages), checkPage(checkPage) {}
+			virtual double getTimeEstimate() { return 0; }
+		};
+		void action( CheckAction& a ) {
+			std::vector<bool> checked( a.pages.size() / sizeof(Page) );
+			for(int i = 0; i < checked.size(); i++)
+				checked[i] = a.checkPage( a.pages.begin() + i * sizeof(Page) );
+			a.result.send( checked );
+		}
+	};
 
 	int64_t writingPos;  // Position within files[1] that will be next written
 
@@ -672,29 +726,53 @@ public:
 		return result;
 	}
 
-	Future<int> fillReadingBuffer() {
-		// If we're right at the end of a file...
-		if ( readingPage*sizeof(Page) >= (size_t)files[readingFile].size ) {
-			readingFile++;
-			readingPage = 0;
-			if (readingFile>=2) {
-				// Recovery complete
-				readingBuffer.clear();
-				writingPos = files[1].size;
-				return 0;
-			}
+	ACTOR static Future<ReadChunk> readChunk(RawDiskQueue_TwoFiles* self, int file, int64_t page, int nPages) {
+		state TrackMe trackMe(self);
+		state ReadChunk chunk;
+		Standalone<StringRef> pages = wait( read(self, file, page, nPages) );
+		chunk.pages = pages;
+
+		if (self->recoveryThreads) {
+			auto action = new PageChecker::CheckAction( pages, self->checkPage );
+			state Future<std::vector<bool>> checked = action->result.getFuture();
+			self->recoveryThreads->post( action );
+			std::vector<bool> c = wait( checked );
+			chunk.checked = std::move(c);
 		}
+		return chunk;
+	}
 
-		// Read up to 1MB into readingBuffer
-		int len = std::min<int64_t>( (files[readingFile].size/sizeof(Page) - readingPage)*sizeof(Page), BUGGIFY_WITH_PROB(1.0) ? sizeof(Page)*deterministicRandom()->randomInt(1,4) : (1<<20) );
-		readingBuffer.clear();
-		readingBuffer.alignReserve( sizeof(Page), len );
-		void* p = readingBuffer.append(len);
+	// Starts reading chunks after the last one started until DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES are in flight, and
+	// at least one if needOne is set
+	void startReadAhead( bool needOne ) {
+		while ((needOne && readAhead.empty()) || readAheadBytes < SERVER_KNOBS->DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES) {
+			while (readAheadFile < 2 && readAheadPage*sizeof(Page) >= (size_t)files[readAheadFile].size) {
+				readAheadFile++;
+				readAheadPage = 0;
+			}
+			if (readAheadFile >= 2)
+				break;
+
+			int chunkPages = BUGGIFY_WITH_PROB(1.0) ? deterministicRandom()->randomInt(1,4) : SERVER_KNOBS->DISK_QUEUE_RECOVERY_READ_BYTES / sizeof(Page);
+			int nPages = std::min<int64_t>( files[readAheadFile].size/sizeof(Page) - readAheadPage, chunkPages );
+			readAhead.push_back( PendingRead{ readAheadFile, readAheadPage, readChunk(this, readAheadFile, readAheadPage, nPages) } );
+			readAheadPage += nPages;
+			readAheadBytes += nPages * sizeof(Page);
+		}
+	}
 
-		auto pos = readingPage * sizeof(Page);
-		readingPage += len / sizeof(Page);
-		ASSERT( int64_t(p) % sizeof(Page) == 0 );
-		return files[readingFile].f->read( p, len, pos );
+	ACTOR static Future<Void> stopReading( RawDiskQueue_TwoFiles* self ) {
+		// Reads cannot be cancelled while the file may still be writing into their buffers
+		state std::vector<Future<ReadChunk>> pending;
+		for(auto& r : self->readAhead)
+			pending.push_back( r.chunk );
+		wait( waitForAllReady(pending) );
+		self->readAhead.clear();
+		self->readAheadBytes = 0;
+		self->readingChunk = ReadChunk();
+		self->readingChunkPos = 0;
+		self->recoveryThreads.clear();
+		return Void();
 	}
 
 	ACTOR static UNCANCELLABLE Future<Standalone<StringRef>> readNextPage(RawDiskQueue_TwoFiles* self) {
@@ -704,20 +782,34 @@ public:
 			ASSERT( self->readingFile < 2 );
 			ASSERT( self->files[0].f && self->files[1].f );
 
+			if (self->readingChunkPos * sizeof(Page) == self->readingChunk.pages.size()) {
+				// If we're right at the end of a file...
+				while (self->readingFile < 2 && self->readingPage*sizeof(Page) >= (size_t)self->files[self->readingFile].size) {
+					self->readingFile++;
+					self->readingPage = 0;
+				}
+				if (self->readingFile >= 2) {
+					// Recovery complete
+					ASSERT( self->readAhead.empty() );
+					wait( stopReading(self) );
+					self->writingPos = self->files[1].size;
+					return Standalone<StringRef>();
+				}
 
-			if (!self->readingBuffer.size()) {
-				state Future<Void> f = Void();
-				//if (BUGGIFY) f = delay( deterministicRandom()->random01() * 0.1 );
-
-				int read = wait( self->fillReadingBuffer() );
-				ASSERT( read == self->readingBuffer.size() );
-
-				wait(f);
+				self->startReadAhead( true );
+				ASSERT( self->readAhead.front().file == self->readingFile && self->readAhead.front().page == self->readingPage );
+				ReadChunk chunk = wait( self->readAhead.front().chunk );
+				self->readAhead.pop_front();
+				self->readAheadBytes -= chunk.pages.size();
+				self->readingChunk = std::move(chunk);
+				self->readingChunkPos = 0;
+				self->startReadAhead( false );
 			}
-			if (!self->readingBuffer.size()) return Standalone<StringRef>();
 
-			ASSERT( self->readingBuffer.size() >= sizeof(Page) );
-			Standalone<StringRef> result = self->readingBuffer.pop_front( sizeof(Page) );
+			int pos = self->readingChunkPos++;
+			self->readingPage++;
+			self->lastPageChecked = pos < self->readingChunk.checked.size() && self->readingChunk.checked[pos];
+			Standalone<StringRef> result = self->readingChunk.pages.substr( pos * sizeof(Page), sizeof(Page) );
 			return result;
 		} catch (Error& e) {
 			TEST(true);  // Read next page error
@@ -744,16 +836,17 @@ public:
 	ACTOR static Future<Void> truncateBeforeLastReadPage( RawDiskQueue_TwoFiles* self ) {
 		try {
 			state int file = self->readingFile;
-			state int64_t pos = (self->readingPage - self->readingBuffer.size()/sizeof(Page) - 1) * sizeof(Page);
+			state int64_t pos = (self->readingPage - 1) * sizeof(Page);
 			state vector<Future<Void>> commits;
 			state bool swap = file==0;
 
 			TEST( file==0 ); // truncate before last read page on file 0
 			TEST( file==1 && pos != self->files[1].size ); // truncate before last read page on file 1
+			TEST( !self->readAhead.empty() ); // truncate before last read page with reads ahead of it in flight
 
 			self->readingFile = 2;
-			self->readingBuffer.clear();
 			self->writingPos = pos;
+			wait( stopReading(self) );
 
 			while (file < 2) {
 				commits.push_back(self->truncateFile(self, file, pos));
@@ -785,6 +878,7 @@ public:
 		: rawQueue( new RawDiskQueue_TwoFiles(basename, fileExtension, dbgid, fileSizeWarningLimit) ), dbgid(dbgid), diskQueueVersion(diskQueueVersion), anyPopped(false), nextPageSeq(0), poppedSeq(0), lastPoppedSeq(0),
 		  nextReadLocation(-1), readBufPage(NULL), readBufPos(0), pushed_page_buffer(NULL), recovered(false), initialized(false), lastCommittedSeq(-1), warnAlwaysForMemory(true)
 	{
+		rawQueue->setPageChecker( &checkPageHash );
 	}
 
 	virtual location push( StringRef contents ) {
@@ -995,6 +1089,10 @@ private:
 	static_assert( sizeof(Page) == _PAGE_SIZE, "Page must be 4k" );
 	#pragma pack(pop)
 
+	static bool checkPageHash( const uint8_t* page ) {
+		return ((Page*)page)->checkHash();
+	}
+
 	loc_t endLocation() const { return pushedPageCount() ? backPage().endSeq() : nextPageSeq; }
 
 	void addEmptyPage() {
@@ -1214,7 +1312,8 @@ private:
 
 			self->readBufArena = page.arena();
 			self->readBufPage = (Page*)page.begin();
-			if (!self->readBufPage->checkHash() || self->readBufPage->seq < pageFloor(self->nextReadLocation)) {
+			bool validHash = self->rawQueue->lastPageChecked || self->readBufPage->checkHash();
+			if (!validHash || self->readBufPage->seq < pageFloor(self->nextReadLocation)) {
 				TraceEvent("DQRecInvalidPage", self->dbgid).detail("NextReadLocation", self->nextReadLocation).detail("HashCheck", self->readBufPage->checkHash())
 					.detail("Seq", self->readBufPage->seq).detail("Expect", pageFloor(self->nextReadLocation)).detail("File0Name", self->rawQueue->files[0].dbgFilename);
 				wait( self->rawQueue->truncateBeforeLastReadPage() );
@@ -54,9 +54,22 @@ public:
 	//Returns the amount of free and total space for this store, in bytes
 	virtual StorageBytes getStorageBytes() = 0;
 
+	// The memory used per stored key-value pair by a store that keeps all of its contents in memory, or 0
+	virtual int64_t getResidentBytesPerKV() { return 0; }
+
 	virtual void resyncLog() {}
 
 	virtual void enableSnapshot() {}
+
+	// A versioned store keeps the contents as of each committed write version readable until forgetVersionsBefore()
+	// is called with a later version.  Sets and clears apply at the version most recently passed to setWriteVersion(),
+	// which must not decrease.  Reads at a version that has been forgotten throw transaction_too_old.
+	virtual bool isVersioned() { return false; }
+	virtual void setWriteVersion( Version v ) {}
+	virtual void forgetVersionsBefore( Version v ) {}
+	virtual Future<Optional<Value>> readValueAtVersion( KeyRef key, Version v, Optional<UID> debugID = Optional<UID>() ) { UNREACHABLE(); }
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRangeAtVersion( KeyRangeRef keys, Version v, int rowLimit = 1<<30, int byteLimit = 1<<30 ) { UNREACHABLE(); }
+
 	/*
 	Concurrency contract
 		Causal consistency:
@@ -81,6 +94,7 @@ protected:
 
 extern IKeyValueStore* keyValueStoreSQLite( std::string const& filename, UID logID, KeyValueStoreType storeType, bool checkChecksums=false, bool checkIntegrity=false );
 extern IKeyValueStore* keyValueStoreRedwoodV1( std::string const& filename, UID logID);
+extern IKeyValueStore* keyValueStoreTiered( IKeyValueStore* hot, std::string const& filePrefix, UID logID );
 extern IKeyValueStore* keyValueStoreMemory( std::string const& basename, UID logID, int64_t memoryLimit, std::string ext = "fdq");
 extern IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery );
 
@@ -94,6 +108,8 @@ inline IKeyValueStore* openKVStore( KeyValueStoreType storeType, std::string con
 		return keyValueStoreMemory( filename, logID, memoryLimit );
 	case KeyValueStoreType::SSD_REDWOOD_V1:
 		return keyValueStoreRedwoodV1( filename, logID );
+	case KeyValueStoreType::SSD_TIERED_V1:
+		return keyValueStoreTiered( keyValueStoreSQLite(filename, logID, KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity), filename, logID );
 	default:
 		UNREACHABLE();
 	}
@@ -249,6 +249,18 @@ ACTOR Future<Void> recover(IndirectShadowPager *pager) {
 				while(nextPhysicalPageID < pager->pagerFile.pagesAllocated) {
 					pager->pagerFile.freePage(nextPhysicalPageID++);
 				}
+
+				for(LogicalPageID pageID = 0; pageID < pager->pageTable.size(); ++pageID) {
+					auto &pageVersionMap = pager->pageTable[pageID];
+					for(int i = 1; i < pageVersionMap.size(); ++i) {
+						pager->supersededPages.push_back(std::make_pair(pageVersionMap[i].first, pageID));
+					}
+					if(pageVersionMap.size() == 1 && pageVersionMap[0].second == PagerFile::INVALID_PAGE) {
+						pager->supersededPages.push_back(std::make_pair(pageVersionMap[0].first, pageID));
+					}
+				}
+				std::sort(pager->supersededPages.begin(), pager->supersededPages.end());
+				pager->forgetSupersededVersions();
 			}
 		}
 
@@ -345,7 +357,8 @@ ACTOR Future<Void> forwardError(Future<Void> f, Promise<Void> target) {
 }
 
 IndirectShadowPager::IndirectShadowPager(std::string basename) 
-	: basename(basename), latestVersion(0), committedVersion(0), committing(Void()), oldestVersion(0), pagerFile(this)
+	: basename(basename), latestVersion(0), committedVersion(0), committing(Void()), oldestVersion(0),
+	  pageCache(SERVER_KNOBS->PAGER_CACHE_BYTES / IndirectShadowPage::PAGE_BYTES), pagerFile(this)
 {
 	pageFileName = basename;
 	recovery = forwardError(recover(this), errorPromise);
@@ -371,7 +384,9 @@ Reference<IPagerSnapshot> IndirectShadowPager::getReadSnapshot(Version version)
 	debug_printf("%s: Getting read snapshot v%lld  latest v%lld  oldest v%lld\n", pageFileName.c_str(), version, latestVersion, oldestVersion);
 	ASSERT(recovery.isReady());
 	ASSERT(version <= latestVersion);
-	ASSERT(version >= oldestVersion);
+	if(version < oldestVersion) {
+		throw transaction_too_old();
+	}
 
 	return Reference<IPagerSnapshot>(new IndirectShadowPagerSnapshot(this, version));
 }
@@ -428,6 +443,7 @@ void IndirectShadowPager::freeLogicalPage(LogicalPageID pageID, Version version)
 	else if(pageVersionMap.back().second != PagerFile::INVALID_PAGE) {
 		pageVersionMap.push_back(std::make_pair(version, PagerFile::INVALID_PAGE));
 		logPageTableUpdate(pageID, version, PagerFile::INVALID_PAGE);
+		supersededPages.push_back(std::make_pair(version, pageID));
 	}
 }
 
@@ -442,9 +458,51 @@ ACTOR Future<Void> waitAndFreePhysicalPageID(IndirectShadowPager *pager, Physica
 // have been committed and so the physical page should still contain its previous data but it's been overwritten.
 void IndirectShadowPager::freePhysicalPageID(PhysicalPageID pageID) {
 	debug_printf("%s: Freeing physical %u\n", pageFileName.c_str(), pageID);
+	pageCache.erase(pageID);
 	pagerFile.freePage(pageID);
 }
 
+// Drops the page versions which can't be read at or after oldestVersion.  Their physical pages are freed after the
+// next commit, and a logical page which was freed as of a forgotten version is freed entirely.
+void IndirectShadowPager::forgetSupersededVersions() {
+	while(!supersededPages.empty() && supersededPages.front().first <= oldestVersion) {
+		LogicalPageID pageID = supersededPages.front().second;
+		supersededPages.pop_front();
+
+		PageVersionMap &pageVersionMap = pageTable[pageID];
+
+		// Find the version of the page that is read at oldestVersion, everything before it is unreachable
+		auto itr = pageVersionMapUpperBound(pageVersionMap, oldestVersion);
+		if(itr == pageVersionMap.begin()) {
+			// The page was freed entirely and reallocated since this entry was queued
+			continue;
+		}
+		--itr;
+
+		if(itr->second == PagerFile::INVALID_PAGE && itr + 1 == pageVersionMap.end()) {
+			itr = pageVersionMap.end();
+		}
+
+		for(auto i = pageVersionMap.begin(); i != itr; ++i) {
+			if(i->second != PagerFile::INVALID_PAGE) {
+				pendingFreePages.push_back(i->second);
+			}
+		}
+
+		if(itr == pageVersionMap.end()) {
+			debug_printf("%s: Freeing logical %u, freed as of v%lld\n", pageFileName.c_str(), pageID, pageVersionMap.back().first);
+			logPageTableClearToEnd(pageID, 0);
+			pageVersionMap.clear();
+			freeLogicalPageID(pageID);
+		}
+		else if(itr != pageVersionMap.begin()) {
+			debug_printf("%s: Forgetting versions of logical %u before v%lld\n", pageFileName.c_str(), pageID, itr->first);
+			logPageTableClear(pageID, 0, itr->first);
+			pageVersionMap.erase(pageVersionMap.begin(), itr);
+		}
+	}
+}
+
 void IndirectShadowPager::writePage(LogicalPageID pageID, Reference<IPage> contents, Version updateVersion, LogicalPageID referencePageID) {
 	ASSERT(recovery.isReady());
 	ASSERT(committing.isReady());
@@ -485,12 +543,16 @@ void IndirectShadowPager::writePage(LogicalPageID pageID, Reference<IPage> conte
 	}
 	else {
 		ASSERT(pageVersionMap.empty() || pageVersionMap.back().first < updateVersion);
+		if(!pageVersionMap.empty()) {
+			supersededPages.push_back(std::make_pair(updateVersion, pageID));
+		}
 		pageVersionMap.push_back(std::make_pair(updateVersion, physicalPageID));
 	}
 
 	logPageTableUpdate(pageID, updateVersion, physicalPageID);
 
 	checksumWrite(dataFile.getPtr(), contents->mutate(), IndirectShadowPage::PAGE_BYTES, pageID, physicalPageID);
+	pageCache.insert(physicalPageID, contents);
 
 	Future<Void> write = holdWhile(contents, dataFile->write(contents->begin(), IndirectShadowPage::PAGE_BYTES, (int64_t) physicalPageID * IndirectShadowPage::PAGE_BYTES));
 
@@ -509,15 +571,18 @@ void IndirectShadowPager::forgetVersions(Version begin, Version end) {
 	ASSERT(end <= latestVersion);
 
 	// TODO: support forgetting arbitrary ranges
-	if(begin <= oldestVersion) {
-		oldestVersion = std::max(end, oldestVersion);
+	if(begin <= oldestVersion && end > oldestVersion) {
+		oldestVersion = end;
 		logVersion(OLDEST_VERSION_KEY, oldestVersion);
+		forgetSupersededVersions();
 	}
 }
 
 ACTOR Future<Void> commitImpl(IndirectShadowPager *pager, Future<Void> previousCommit) {
 	state Future<Void> outstandingWrites = pager->writeActors.signalAndCollapse();
 	state Version commitVersion = pager->latestVersion;
+	state std::vector<PhysicalPageID> freeablePages;
+	freeablePages.swap(pager->pendingFreePages);
 
 	wait(previousCommit);
 
@@ -534,6 +599,16 @@ ACTOR Future<Void> commitImpl(IndirectShadowPager *pager, Future<Void> previousC
 	
 	pager->committedVersion = std::max(pager->committedVersion, commitVersion);
 
+	// Pages that are still being read can't be reused yet, so leave them for the next commit
+	for(PhysicalPageID pageID : freeablePages) {
+		if(pager->busyPages.count(pageID)) {
+			pager->pendingFreePages.push_back(pageID);
+		}
+		else {
+			pager->freePhysicalPageID(pageID);
+		}
+	}
+
 	return Void();
 }
 
@@ -624,7 +699,9 @@ ACTOR Future<Reference<const IPage>> rawRead(IndirectShadowPager *pager, Logical
 		}
 
 		pager->busyPages.erase(physicalPageID);
-		return Reference<const IPage>(new IndirectShadowPage((uint8_t *)data, pager->dataFile, physicalPageID));
+		Reference<const IPage> page(new IndirectShadowPage((uint8_t *)data, pager->dataFile, physicalPageID));
+		pager->pageCache.insert(physicalPageID, page);
+		return page;
 	}
 	catch(Error &e) {
 		pager->busyPages.erase(physicalPageID);
@@ -636,6 +713,11 @@ ACTOR Future<Reference<const IPage>> rawRead(IndirectShadowPager *pager, Logical
 }
 
 Future<Reference<const IPage>> getPageImpl(IndirectShadowPager *pager, Reference<IndirectShadowPagerSnapshot> snapshot, LogicalPageID logicalPageID, Version version) {
+	// The page versions the snapshot reads may have been forgotten since it was created
+	if(version < pager->oldestVersion) {
+		return transaction_too_old();
+	}
+
 	ASSERT(logicalPageID < pager->pageTable.size());
 	PageVersionMap &pageVersionMap = pager->pageTable[logicalPageID];
 
@@ -650,6 +732,11 @@ Future<Reference<const IPage>> getPageImpl(IndirectShadowPager *pager, Reference
 
 	debug_printf("%s: Reading logical %d v%lld physical %d mapSize %lu\n", pager->pageFileName.c_str(), logicalPageID, version, physicalPageID, pageVersionMap.size());
 
+	Reference<const IPage> cached = pager->pageCache.get(physicalPageID);
+	if(cached) {
+		return cached;
+	}
+
 	IndirectShadowPager::BusyPage &bp = pager->busyPages[physicalPageID];
 	if(!bp.read.isValid()) {
 		Future<Reference<const IPage>> get = rawRead(pager, logicalPageID, physicalPageID);
@@ -36,6 +36,49 @@ typedef std::vector<PageVersionMap> LogicalPageTable;
 
 class IndirectShadowPager;
 
+// A bounded LRU cache of pages by physical page ID.  A physical page's contents do not change until it is freed, so
+// a cached page, along with whatever its reader attached as userData, can be returned for any read which maps to it.
+class PageCache : NonCopyable {
+public:
+	explicit PageCache( int64_t capacity ) : capacity(capacity) {}
+
+	Reference<const IPage> get( PhysicalPageID pageID ) {
+		auto i = index.find( pageID );
+		if(i == index.end())
+			return Reference<const IPage>();
+		lru.splice( lru.end(), lru, i->second );
+		return i->second->second;
+	}
+
+	void insert( PhysicalPageID pageID, Reference<const IPage> page ) {
+		if(capacity <= 0)
+			return;
+		erase( pageID );
+		lru.emplace_back( pageID, page );
+		index[pageID] = std::prev( lru.end() );
+		while((int64_t)index.size() > capacity) {
+			index.erase( lru.front().first );
+			lru.pop_front();
+		}
+	}
+
+	void erase( PhysicalPageID pageID ) {
+		auto i = index.find( pageID );
+		if(i != index.end()) {
+			lru.erase( i->second );
+			index.erase( i );
+		}
+	}
+
+	int64_t size() const { return index.size(); }
+
+private:
+	typedef std::list<std::pair<PhysicalPageID, Reference<const IPage>>> Entries;
+	int64_t capacity;  // in pages
+	Entries lru;
+	std::unordered_map<PhysicalPageID, Entries::iterator> index;
+};
+
 class IndirectShadowPage : public IPage, ReferenceCounted<IndirectShadowPage> {
 public:
 	IndirectShadowPage();
@@ -183,6 +226,15 @@ public:
 	typedef std::map<PhysicalPageID, BusyPage> BusyPageMapT;
 	BusyPageMapT busyPages;
 
+	PageCache pageCache;
+
+	// (version, logical page) for each page version which replaced an earlier one.  Once oldestVersion reaches version
+	// the earlier versions of the page can no longer be read and are freed.  Ordered by version.
+	std::deque<std::pair<Version, LogicalPageID>> supersededPages;
+
+	// Physical pages no longer referenced by the page table, which can be reused once that change is committed
+	std::vector<PhysicalPageID> pendingFreePages;
+
 	SignalableActorCollection operations;
 	SignalableActorCollection writeActors;
 	Future<Void> committing;
@@ -198,6 +250,7 @@ public:
 
 	void freeLogicalPageID(LogicalPageID pageID);
 	void freePhysicalPageID(PhysicalPageID pageID);
+	void forgetSupersededVersions();
 
 	void logVersion(StringRef versionKey, Version version);
 	void logPagesAllocated();
@@ -20,6 +20,9 @@
 
 #include "fdbserver/IKeyValueStore.h"
 #include "fdbserver/IDiskQueue.h"
+#include "fdbserver/CompactKeyValueMap.h"
+#include "fdbserver/CoroFlow.h"
+#include "flow/IThreadPool.h"
 #include "flow/IndexedSet.h"
 #include "flow/ActorCollection.h"
 #include "fdbclient/Notified.h"
@@ -54,9 +57,14 @@ bool operator<(CompatibleWithKey const& l, KeyValueMapPair const& r) { return l
 
 extern bool noUnseed;
 
+// Container is either IndexedSet<KeyValueMapPair, uint64_t>, which holds each pair in its own node and arena, or the
+// prefix compressed CompactKeyValueMap.  Both are written to and recovered from the same disk queue format.
+template <class Container>
 class KeyValueStoreMemory : public IKeyValueStore, NonCopyable {
 public:
-	KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery );
+	static constexpr bool isCompact = std::is_same<Container, CompactKeyValueMap>::value;
+
+	KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery, bool parallelSnapshot );
 
 	// IClosable
 	virtual Future<Void> getError() { return log->getError(); }
@@ -69,7 +77,7 @@ public:
 
 	int64_t getAvailableSize() {
 		int64_t residentSize =
-			data.sumTo(data.end()) +
+			dataSize() +
 			queue.totalSize() +  // doesn't account for overhead in queue
 			transactionSize;
 
@@ -91,6 +99,9 @@ public:
 		    std::max((int64_t)0, availableSize));
 	}
 
+	// As of the end of the last full snapshot
+	virtual int64_t getResidentBytesPerKV() { return residentBytesPerKV; }
+
 	void semiCommit() {
 		transactionSize += queue.totalSize();
 		if(transactionSize > 0.5 * committedDataSize) {
@@ -110,8 +121,7 @@ public:
 			return;
 
 		if(transactionIsLarge) {
-			KeyValueMapPair pair(keyValue.key, keyValue.value);
-			data.insert(pair, pair.arena.getSize() + data.getElementBytes());
+			dataInsert(keyValue.key, keyValue.value);
 		}
 		else {
 			queue.set(keyValue, arena);
@@ -127,7 +137,7 @@ public:
 			return;
 
 		if(transactionIsLarge) {
-			data.erase(data.lower_bound(range.begin), data.lower_bound(range.end));
+			dataErase(range.begin, range.end);
 		}
 		else {
 			queue.clear(range, arena);
@@ -181,7 +191,7 @@ public:
 
 		auto c = log->commit();
 
-		committedDataSize = data.sumTo(data.end());
+		committedDataSize = dataSize();
 		transactionSize = 0;
 		transactionIsLarge = false;
 		firstCommitWithSnapshot = false;
@@ -333,7 +343,7 @@ private:
 
 	UID id;
 
-	IndexedSet< KeyValueMapPair, uint64_t > data;
+	Container data;
 
 	OpQueue queue; // mutations not yet commit()ted
 	IDiskQueue *log;
@@ -356,10 +366,108 @@ private:
 	bool replaceContent;
 	bool firstCommitWithSnapshot;
 	int snapshotCount;
+	int64_t residentBytesPerKV;
 
 	int64_t memoryLimit; //The upper limit on the memory used by the store (excluding, possibly, some clear operations)
 	std::vector<std::pair<KeyValueMapPair, uint64_t>> dataSets;
 
+	// In parallel snapshot mode, chunks of snapshot items are serialized by snapshotThread while the network thread
+	// continues.  A chunk holds the pairs in snapshotChunkRange as they were when it was captured, so a write to that
+	// range before the chunk is logged makes it stale.
+	Reference<IThreadPool> snapshotThread;
+	bool snapshotChunkInFlight;
+	bool snapshotChunkStale;
+	KeyRange snapshotChunkRange;
+
+	struct SnapshotWriter : IThreadPoolReceiver {
+		virtual void init() {}
+
+		struct SerializeAction : TypedAction<SnapshotWriter, SerializeAction>, FastAllocated<SerializeAction> {
+			Standalone<VectorRef<KeyValueRef>> items;
+			ThreadReturnPromise<Standalone<StringRef>> result;
+			explicit SerializeAction( Standalone<VectorRef<KeyValueRef>> const& items ) : items(items) {}
+			virtual double getTimeEstimate() { return 0; }
+		};
+		void action( SerializeAction& a ) {
+			a.result.send( serializeSnapshotItems(a.items) );
+		}
+	};
+
+	static Container newContainer() {
+		if constexpr (isCompact) {
+			return CompactKeyValueMap(SERVER_KNOBS->KVSTORE_MEMORY_COMPACT_BLOCK_BYTES);
+		} else {
+			return Container();
+		}
+	}
+
+	// The memory used by data, as counted against memoryLimit
+	int64_t dataSize() {
+		if constexpr (isCompact) {
+			return data.bytes();
+		} else {
+			return data.sumTo(data.end());
+		}
+	}
+
+	void checkSnapshotChunk(KeyRef key) {
+		if(snapshotChunkInFlight && snapshotChunkRange.contains(key))
+			snapshotChunkStale = true;
+	}
+
+	void checkSnapshotChunk(KeyRangeRef range) {
+		if(snapshotChunkInFlight && snapshotChunkRange.intersects(range))
+			snapshotChunkStale = true;
+	}
+
+	void dataInsert(KeyRef key, ValueRef value) {
+		checkSnapshotChunk(key);
+		if constexpr (isCompact) {
+			data.insert(key, value);
+		} else {
+			KeyValueMapPair pair(key, value);
+			data.insert(pair, pair.arena.getSize() + data.getElementBytes());
+		}
+	}
+
+	// Sets that arrive in key order are batched in dataSets so that an IndexedSet can insert them together
+	void dataInsertSequential(KeyRef key, ValueRef value) {
+		checkSnapshotChunk(key);
+		if constexpr (isCompact) {
+			data.insert(key, value);
+		} else {
+			KeyValueMapPair pair(key, value);
+			dataSets.push_back(std::make_pair(pair, pair.arena.getSize() + data.getElementBytes()));
+		}
+	}
+
+	void flushDataSets() {
+		if constexpr (!isCompact) {
+			data.insert(dataSets);
+			dataSets.clear();
+		}
+	}
+
+	void dataErase(KeyRef begin, KeyRef end) {
+		if(begin < end)
+			checkSnapshotChunk(KeyRangeRef(begin, end));
+		if constexpr (isCompact) {
+			data.erase(begin, end);
+		} else {
+			data.erase(data.lower_bound(begin), data.lower_bound(end));
+		}
+	}
+
+	void dataEraseToEnd(KeyRef begin) {
+		if(snapshotChunkInFlight && begin < snapshotChunkRange.end)
+			snapshotChunkStale = true;
+		if constexpr (isCompact) {
+			data.eraseToEnd(begin);
+		} else {
+			data.erase(data.lower_bound(begin), data.end());
+		}
+	}
+
 	int64_t commit_queue(OpQueue &ops, bool log, bool sequential = false) {
 		int64_t total = 0, count = 0;
 		IDiskQueue::location log_location = 0;
@@ -368,34 +476,30 @@ private:
 			++count;
 			total += o->p1.size() + o->p2.size() + OP_DISK_OVERHEAD;
 			if (o->op == OpSet) {
-				KeyValueMapPair pair(o->p1, o->p2);
 				if(sequential) {
-					dataSets.push_back(std::make_pair(pair, pair.arena.getSize() + data.getElementBytes()));
+					dataInsertSequential(o->p1, o->p2);
 				} else {
-					data.insert( pair, pair.arena.getSize() + data.getElementBytes() );
+					dataInsert(o->p1, o->p2);
 				}
 			}
 			else if (o->op == OpClear) {
 				if(sequential) {
-					data.insert(dataSets);
-					dataSets.clear();
+					flushDataSets();
 				}
-				data.erase( data.lower_bound(o->p1), data.lower_bound(o->p2) );
+				dataErase(o->p1, o->p2);
 			}
 			else if (o->op == OpClearToEnd) {
 				if(sequential) {
-					data.insert(dataSets);
-					dataSets.clear();
+					flushDataSets();
 				}
-				data.erase( data.lower_bound(o->p1), data.end() );
+				dataEraseToEnd(o->p1);
 			}
 			else ASSERT(false);
 			if ( log )
 				log_location = log_op( o->op, o->p1, o->p2 );
 		}
 		if(sequential) {
-			data.insert(dataSets);
-			dataSets.clear();
+			flushDataSets();
 		}
 
 		bool ok = count < 1e6;
@@ -412,6 +516,50 @@ private:
 		return total;
 	}
 
+	// Returns the OpSnapshotItem records for items, laid out exactly as log_op() would push them
+	static Standalone<StringRef> serializeSnapshotItems( VectorRef<KeyValueRef> const& items ) {
+		int size = 0;
+		for(auto& kv : items)
+			size += kv.key.size() + kv.value.size() + OP_DISK_OVERHEAD;
+
+		Standalone<StringRef> result;
+		uint8_t* p = new (result.arena()) uint8_t[size];
+		result.contents() = StringRef(p, size);
+		for(auto& kv : items) {
+			OpHeader h = {(int)OpSnapshotItem, kv.key.size(), kv.value.size()};
+			memcpy(p, &h, sizeof(h));
+			p += sizeof(h);
+			memcpy(p, kv.key.begin(), kv.key.size());
+			p += kv.key.size();
+			memcpy(p, kv.value.begin(), kv.value.size());
+			p += kv.value.size();
+			*p++ = 1;
+		}
+		ASSERT(p == result.end());
+		return result;
+	}
+
+	// Collects the pairs from next onward until about byteLimit bytes of snapshot items, and marks the range they cover
+	// as in flight.  Pairs in an IndexedSet are shared with the chunk through their arenas rather than copied.
+	template <class Iterator>
+	Standalone<VectorRef<KeyValueRef>> captureSnapshotChunk( Iterator next, KeyRef begin, int byteLimit ) {
+		Standalone<VectorRef<KeyValueRef>> chunk;
+		int bytes = 0;
+		for(; next != data.end() && (chunk.empty() || bytes < byteLimit); ++next) {
+			if constexpr (isCompact) {
+				chunk.push_back_deep( chunk.arena(), KeyValueRef(next->key, next->value) );
+			} else {
+				chunk.arena().dependsOn( next->arena );
+				chunk.push_back( chunk.arena(), KeyValueRef(next->key, next->value) );
+			}
+			bytes += next->key.size() + next->value.size() + OP_DISK_OVERHEAD;
+		}
+		snapshotChunkInFlight = true;
+		snapshotChunkStale = false;
+		snapshotChunkRange = KeyRangeRef( begin, keyAfter(chunk.back().key) );
+		return chunk;
+	}
+
 	IDiskQueue::location log_op(OpType op, StringRef v1, StringRef v2) {
 		OpHeader h = {(int)op, v1.size(), v2.size()};
 		log->push( StringRef((const uint8_t*)&h, sizeof(h)) );
@@ -569,7 +717,7 @@ private:
 				// make sure that before any new operations are added to the log that all uncommitted operations are "rolled back"
 				self->log_op( OpRollback, StringRef(), StringRef() );  // rollback previous transaction
 
-				self->committedDataSize = self->data.sumTo(self->data.end());
+				self->committedDataSize = self->dataSize();
 
 				TraceEvent("KVSMemRecovered", self->id)
 					.detail("SnapshotItems", dbgSnapshotItemCount)
@@ -593,7 +741,7 @@ private:
 	}
 
 	//Snapshots an entire data set
-	void fullSnapshot( IndexedSet< KeyValueMapPair, uint64_t> &snapshotData ) {
+	void fullSnapshot( Container &snapshotData ) {
 		previousSnapshotEnd = log_op(OpSnapshotAbort, StringRef(), StringRef());
 		replaceContent = false;
 
@@ -660,6 +808,14 @@ private:
 				//	.detail("CommittedWrites", self->notifiedCommittedWriteBytes.get())
 				//	.detail("SnapshotSize", snapshotBytes);
 
+				TraceEvent("KVSMemSnapshotStats", self->id).suppressFor(60.0)
+					.detail("Items", snapItems)
+					.detail("LogicalBytes", snapshotBytes - snapItems * OP_DISK_OVERHEAD)
+					.detail("ResidentBytes", self->dataSize())
+					.detail("BytesPerKV", snapItems ? double(self->dataSize()) / snapItems : 0.0)
+					.detail("Layout", isCompact ? "Compact" : "Tree");
+				self->residentBytesPerKV = snapItems ? self->dataSize() / snapItems : 0;
+
 				ASSERT(thisSnapshotEnd >= self->currentSnapshotEnd);
 				self->previousSnapshotEnd = self->currentSnapshotEnd;
 				self->currentSnapshotEnd = thisSnapshotEnd;
@@ -674,6 +830,38 @@ private:
 				snapshotBytes = 0;
 
 				snapshotTotalWrittenBytes += OP_DISK_OVERHEAD;
+			} else if(self->snapshotThread) {
+				state Key chunkBegin = nextKeyAfter ? keyAfter(nextKey) : nextKey;
+				state Standalone<VectorRef<KeyValueRef>> chunk = self->captureSnapshotChunk( next, chunkBegin, SERVER_KNOBS->KVSTORE_MEMORY_SNAPSHOT_CHUNK_BYTES );
+				state Standalone<StringRef> items;
+				auto action = new typename SnapshotWriter::SerializeAction( chunk );
+				state Future<Standalone<StringRef>> serialized = action->result.getFuture();
+				self->snapshotThread->post( action );
+				Standalone<StringRef> _items = wait( serialized );
+				items = _items;
+				self->snapshotChunkInFlight = false;
+
+				if(self->resetSnapshot)
+					continue;
+
+				if(self->snapshotChunkStale) {
+					// Capture and log the chunk again without leaving the network thread, so that the snapshot
+					// makes progress even if its range is written continuously
+					TEST(true); // Memory engine snapshot chunk was written to while being serialized
+					auto retry = self->data.lower_bound(chunkBegin);
+					if(retry == self->data.end())
+						continue;
+					chunk = self->captureSnapshotChunk( retry, chunkBegin, SERVER_KNOBS->KVSTORE_MEMORY_SNAPSHOT_CHUNK_BYTES );
+					self->snapshotChunkInFlight = false;
+					items = serializeSnapshotItems( chunk );
+				}
+
+				self->log->push( items );
+				nextKey = chunk.back().key;
+				nextKeyAfter = true;
+				snapItems += chunk.size();
+				snapshotBytes += items.size();
+				snapshotTotalWrittenBytes += items.size();
 			} else {
 				self->log_op( OpSnapshotItem, next->key, next->value );
 				nextKey = next->key;
@@ -710,21 +898,31 @@ private:
 	}
 };
 
-KeyValueStoreMemory::KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery )
-	: log(log), id(id), previousSnapshotEnd(-1), currentSnapshotEnd(-1), resetSnapshot(false), memoryLimit(memoryLimit), committedWriteBytes(0), overheadWriteBytes(0),
-	  committedDataSize(0), transactionSize(0), transactionIsLarge(false), disableSnapshot(disableSnapshot), replaceContent(replaceContent), snapshotCount(0), firstCommitWithSnapshot(true)
+template <class Container>
+KeyValueStoreMemory<Container>::KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery, bool parallelSnapshot )
+	: log(log), id(id), data(newContainer()), previousSnapshotEnd(-1), currentSnapshotEnd(-1), resetSnapshot(false), memoryLimit(memoryLimit), committedWriteBytes(0), overheadWriteBytes(0),
+	  committedDataSize(0), transactionSize(0), transactionIsLarge(false), disableSnapshot(disableSnapshot), replaceContent(replaceContent), snapshotCount(0), residentBytesPerKV(0), firstCommitWithSnapshot(true),
+	  snapshotChunkInFlight(false), snapshotChunkStale(false)
 {
+	if(parallelSnapshot) {
+		snapshotThread = g_network->isSimulated() ? CoroThreadPool::createThreadPool() : createGenericThreadPool();
+		snapshotThread->addThread( new SnapshotWriter );
+	}
 	recovering = recover( this, exactRecovery );
 	snapshotting = snapshot( this );
 	commitActors = actorCollection( addActor.getFuture() );
 }
 
 IKeyValueStore* keyValueStoreMemory( std::string const& basename, UID logID, int64_t memoryLimit, std::string ext ) {
-	TraceEvent("KVSMemOpening", logID).detail("Basename", basename).detail("MemoryLimit", memoryLimit);
+	TraceEvent("KVSMemOpening", logID).detail("Basename", basename).detail("MemoryLimit", memoryLimit).detail("CompactIndex", SERVER_KNOBS->KVSTORE_MEMORY_COMPACT_INDEX)
+		.detail("ParallelSnapshot", SERVER_KNOBS->KVSTORE_MEMORY_PARALLEL_SNAPSHOT);
 	IDiskQueue *log = openDiskQueue( basename, ext, logID, DiskQueueVersion::V1 );
-	return new KeyValueStoreMemory( log, logID, memoryLimit, false, false, false );
+	if(SERVER_KNOBS->KVSTORE_MEMORY_COMPACT_INDEX) {
+		return new KeyValueStoreMemory<CompactKeyValueMap>( log, logID, memoryLimit, false, false, false, SERVER_KNOBS->KVSTORE_MEMORY_PARALLEL_SNAPSHOT );
+	}
+	return new KeyValueStoreMemory<IndexedSet<KeyValueMapPair, uint64_t>>( log, logID, memoryLimit, false, false, false, SERVER_KNOBS->KVSTORE_MEMORY_PARALLEL_SNAPSHOT );
 }
 
 IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot, bool replaceContent, bool exactRecovery ) {
-	return new KeyValueStoreMemory( queue, logID, memoryLimit, disableSnapshot, replaceContent, exactRecovery );
+	return new KeyValueStoreMemory<IndexedSet<KeyValueMapPair, uint64_t>>( queue, logID, memoryLimit, disableSnapshot, replaceContent, exactRecovery, false );
 }
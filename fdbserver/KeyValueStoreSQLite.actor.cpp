@@ -24,7 +24,11 @@
 #include "fdbserver/IKeyValueStore.h"
 #include "fdbserver/CoroFlow.h"
 #include "fdbserver/Knobs.h"
+#include "fdbserver/SQLitePageCompression.h"
+#include "fdbrpc/zlib/zlib.h"
 #include "flow/Hash3.h"
+#include "flow/Stats.h"
+#include "flow/UnitTest.h"
 
 extern "C" {
 #include "fdbserver/sqlite/sqliteInt.h"
@@ -58,20 +62,41 @@ struct SpringCleaningStats {
 	int64_t springCleaningCount;
 	int64_t lazyDeletePages;
 	int64_t vacuumedPages;
+	int64_t releasedPages;
 	double springCleaningTime;
 	double vacuumTime;
 	double lazyDeleteTime;
+	double releaseTime;
 
-	SpringCleaningStats() : springCleaningCount(0), lazyDeletePages(0), vacuumedPages(0), springCleaningTime(0.0), vacuumTime(0.0), lazyDeleteTime(0.0) {}
+	SpringCleaningStats() : springCleaningCount(0), lazyDeletePages(0), vacuumedPages(0), releasedPages(0), springCleaningTime(0.0), vacuumTime(0.0), lazyDeleteTime(0.0), releaseTime(0.0) {}
+};
+
+struct RangeReadStats {
+	int64_t rangeReads;
+	int64_t rangeReadBytes;
+	int64_t readAheadPages;
+	double rangeReadTime;
+
+	RangeReadStats() : rangeReads(0), rangeReadBytes(0), readAheadPages(0), rangeReadTime(0.0) {}
 };
 
 struct PageChecksumCodec {
-	PageChecksumCodec(std::string const &filename) : pageSize(0), reserveSize(0), filename(filename), silent(false) {}
+	PageChecksumCodec(std::string const &filename, int compressionLevel) : pageSize(0), reserveSize(0), filename(filename), silent(false), compressionLevel(compressionLevel), deflaterReady(false), inflaterReady(false) {}
+	~PageChecksumCodec() {
+		if(deflaterReady)
+			deflateEnd(&deflater);
+		if(inflaterReady)
+			inflateEnd(&inflater);
+	}
 
 	int pageSize;
 	int reserveSize;
 	std::string filename;
 	bool silent;
+	int compressionLevel;  // zlib level used for pages written through this codec, or 0 to write them uncompressed
+	std::vector<uint8_t> pageBuffer;  // Holds the compressed image of the page being written, or the decompressed image of the page being read
+	z_stream deflater, inflater;  // Reused for every page, since initializing them allocates
+	bool deflaterReady, inflaterReady;
 
 	struct SumType {
 		bool operator==(const SumType &rhs) const { return part1 == rhs.part1 && part2 == rhs.part2; }
@@ -80,6 +105,9 @@ struct PageChecksumCodec {
 		std::string toString() { return format("0x%08x%08x", part1, part2); }
 	};
 
+	// Whether the pages of this file are in the layout that allows them to be compressed (see CompressedPageHeader)
+	bool compressedLayout() const { return reserveSize == CompressedPageHeader::reserveSize(); }
+
 	// Calculates and then either stores or verifies a checksum.
 	// The checksum is read/stored at the end of the page buffer.
 	// Page size is passed in as pageLen because this->pageSize is not always appropriate.
@@ -156,8 +184,9 @@ struct PageChecksumCodec {
 			}
 		}
 		else {
-			// For Page Numbers other than 1, reserve size must be the size of the checksum.
-			if(self->reserveSize != sizeof(SumType)) {
+			// For Page Numbers other than 1, reserve size must be the size of the checksum, or of the checksum and the
+			// bytes displaced by the header of uncompressed pages in the compressed layout.
+			if(self->reserveSize != sizeof(SumType) && !self->compressedLayout()) {
 				if(!self->silent)
 					TraceEvent(SevWarnAlways, "SQLitePageChecksumFailureBadReserveSize")
 						.detail("CodecPageSize", self->pageSize)
@@ -169,12 +198,135 @@ struct PageChecksumCodec {
 			}
 		}
 
+		// In the compressed layout pages are decoded in place before their checksum is verified, and pages being written
+		// are encoded (into pageBuffer, since SQLite still owns data) after it has been set.  Page 1 is never encoded.
+		bool encoded = pageNumber != 1 && self->compressedLayout();
+		if(!write && encoded && !self->decode(pageNumber, data))
+			return NULL;
+
+		// The codec's part of the reserved bytes is zero in every page SQLite sees
+		if(write && encoded)
+			memset((uint8_t *)data + CompressedPageHeader::displacedOffset(self->pageSize), 0, sizeof(CompressedPageHeader));
+
 		if(!self->checksum(pageNumber, data, self->pageSize, write))
 			return NULL;
 
+		if(write && encoded)
+			return self->encode(data);
+
 		return data;
 	}
 
+	// Returns the image of the page to store in pageBuffer: compressed if compression is enabled and saves at least one
+	// block, and otherwise the page with its beginning moved to the reserved bytes to make room for the header.
+	void * encode(void *data) {
+		if(compressionLevel > 0) {
+			void *compressed = compress(data);
+			if(compressed != NULL)
+				return compressed;
+		}
+
+		pageBuffer.resize(pageSize);
+		memcpy(pageBuffer.data(), data, pageSize);
+		memcpy(pageBuffer.data() + CompressedPageHeader::displacedOffset(pageSize), data, sizeof(CompressedPageHeader));
+		memset(pageBuffer.data(), 0, sizeof(CompressedPageHeader));
+		return pageBuffer.data();
+	}
+
+	// Returns a compressed image of the page in pageBuffer, or NULL if compressing it would not save at least one block
+	void * compress(void *data) {
+		int maxLength = CompressedPageHeader::maxLength(pageSize);
+		if(maxLength <= 0)
+			return NULL;
+
+		if(!deflaterReady) {
+			memset(&deflater, 0, sizeof(deflater));
+			if(deflateInit(&deflater, compressionLevel) != Z_OK)
+				return NULL;
+			deflaterReady = true;
+		} else {
+			deflateReset(&deflater);
+		}
+
+		pageBuffer.resize(pageSize);
+		CompressedPageHeader *header = (CompressedPageHeader *)pageBuffer.data();
+		deflater.next_in = (Bytef *)data;
+		deflater.avail_in = pageSize;
+		deflater.next_out = pageBuffer.data() + sizeof(CompressedPageHeader);
+		deflater.avail_out = maxLength;
+		// Anything but Z_STREAM_END means that the page did not compress well enough to fit
+		if(deflate(&deflater, Z_FINISH) != Z_STREAM_END)
+			return NULL;
+
+		int length = deflater.total_out;
+		header->length = length;
+		header->unused = 0;
+		memset(pageBuffer.data() + sizeof(CompressedPageHeader) + length, 0, maxLength - length + _PAGE_SIZE);
+		return pageBuffer.data();
+	}
+
+	// Replaces the stored image of a page in data with the page.  Returns false if the image is not valid.
+	bool decode(Pgno pageNumber, void *data) {
+		const CompressedPageHeader *header = CompressedPageHeader::get(data, pageSize);
+		if(header != NULL)
+			return decompress(pageNumber, data, header);
+
+		// A page that is not compressed has a header of zeros, and any other header is corrupt.  Its checksum, which
+		// covers the displaced bytes, is verified afterwards.
+		uint8_t *displaced = (uint8_t *)data + CompressedPageHeader::displacedOffset(pageSize);
+		header = (const CompressedPageHeader *)data;
+		if(header->length != 0 || header->unused != 0) {
+			if(!silent)
+				TraceEvent(SevError, "SQLitePageDecompressFailure")
+					.error(checksum_failed())
+					.detail("CodecPageSize", pageSize)
+					.detail("Filename", filename)
+					.detail("PageNumber", pageNumber)
+					.detail("CompressedLength", header->length);
+			return false;
+		}
+		memcpy(data, displaced, sizeof(CompressedPageHeader));
+		memset(displaced, 0, sizeof(CompressedPageHeader));
+		return true;
+	}
+
+	// Replaces a compressed page image in data with the page it was compressed from.  Returns false if the page could
+	// not be decompressed.
+	bool decompress(Pgno pageNumber, void *data, const CompressedPageHeader *header) {
+
+		int r = Z_OK;
+		if(!inflaterReady) {
+			memset(&inflater, 0, sizeof(inflater));
+			r = inflateInit(&inflater);
+			inflaterReady = r == Z_OK;
+		} else {
+			inflateReset(&inflater);
+		}
+
+		pageBuffer.resize(pageSize);
+		if(inflaterReady) {
+			inflater.next_in = (Bytef *)(header + 1);
+			inflater.avail_in = header->length;
+			inflater.next_out = pageBuffer.data();
+			inflater.avail_out = pageSize;
+			r = inflate(&inflater, Z_FINISH);
+		}
+		if(r != Z_STREAM_END || inflater.total_out != pageSize) {
+			if(!silent)
+				TraceEvent(SevError, "SQLitePageDecompressFailure")
+					.error(checksum_failed())
+					.detail("CodecPageSize", pageSize)
+					.detail("Filename", filename)
+					.detail("PageNumber", pageNumber)
+					.detail("CompressedLength", header->length)
+					.detail("ZlibError", r);
+			return false;
+		}
+
+		memcpy(data, pageBuffer.data(), pageSize);
+		return true;
+	}
+
 	static void sizeChange(void *vpSelf, int new_pageSize, int new_reserveSize) {
 		PageChecksumCodec *self = (PageChecksumCodec *)vpSelf;
 		self->pageSize = new_pageSize;
@@ -230,7 +382,7 @@ struct SQLiteDB : NonCopyable {
 				ASSERT(false);
 			}
 			// Always start with a new pager codec with default options.
-			pPagerCodec = new PageChecksumCodec(filename);
+			pPagerCodec = new PageChecksumCodec(filename, SERVER_KNOBS->SQLITE_PAGE_COMPRESSION_LEVEL);
 			sqlite3BtreePagerSetCodec(btree, PageChecksumCodec::codec, PageChecksumCodec::sizeChange, PageChecksumCodec::free, pPagerCodec);
 		}
 	}
@@ -645,15 +797,24 @@ struct IntKeyCursor {
 	}
 };
 
+void vfsAsyncPrefetchPages( sqlite3_file* pFile, int pageSize, uint32_t const* pages, int count );
+
 struct RawCursor {
 	SQLiteDB& db;
 	BtCursor *cursor;
 	KeyInfo keyInfo;
 	bool valid;
 
+	// Range read readahead state (see readAhead())
+	sqlite3_file* dbFile;
+	int pageSize;
+	u32 readAheadLeaf;
+	std::vector<u32> siblingPages, readAheadPages, newPages;
+	int64_t pagesReadAhead;
+
 	operator bool() const { return valid; }
 
-	RawCursor( SQLiteDB& db, int table, bool write) : cursor(0), db(db), valid(false) {
+	RawCursor( SQLiteDB& db, int table, bool write) : cursor(0), db(db), valid(false), dbFile(nullptr), pageSize(0), readAheadLeaf(0), pagesReadAhead(0) {
 		keyInfo.db = db.db;
 		keyInfo.enc = db.db->aDb[0].pSchema->enc;
 		keyInfo.aColl[0] = db.db->pDfltColl;
@@ -697,6 +858,36 @@ struct RawCursor {
 		db.checkError("BtreePrevious", sqlite3BtreePrevious(cursor, &empty));
 		valid = !empty;
 	}
+	// When the cursor reaches a new leaf, starts fetching the leaves which a range read moving forward (or backward) will
+	// visit next, as listed in the parent page, so that a cold scan waits on a batch of concurrent page reads rather than
+	// on one page read per leaf.  Leaves fetched for the previous leaf are not fetched again.
+	void readAhead( bool forward ) {
+		int maxPages = SERVER_KNOBS->SQLITE_READAHEAD_PAGES;
+		if (!valid || maxPages <= 0)
+			return;
+
+		siblingPages.resize(maxPages);
+		u32 leaf;
+		int n = sqlite3BtreeSiblingLeafPages(cursor, forward, &leaf, siblingPages.data(), maxPages);
+		if (leaf == readAheadLeaf)
+			return;
+		readAheadLeaf = leaf;
+
+		newPages.clear();
+		for(int i = 0; i < n; i++)
+			if (std::find(readAheadPages.begin(), readAheadPages.end(), siblingPages[i]) == readAheadPages.end())
+				newPages.push_back(siblingPages[i]);
+		readAheadPages.assign(siblingPages.begin(), siblingPages.begin() + n);
+		if (newPages.empty())
+			return;
+
+		if (!dbFile) {
+			db.checkError("FilePointer", sqlite3_file_control(db.db, nullptr, SQLITE_FCNTL_FILE_POINTER, &dbFile));
+			pageSize = sqlite3BtreeGetPageSize(db.btree);
+		}
+		vfsAsyncPrefetchPages(dbFile, pageSize, newPages.data(), newPages.size());
+		pagesReadAhead += newPages.size();
+	}
 	int size() {
 		int64_t size;
 		db.checkError("BtreeKeySize", sqlite3BtreeKeySize(cursor, (i64*)&size));
@@ -1079,6 +1270,7 @@ struct RawCursor {
 		Standalone<VectorRef<KeyValueRef>> result;
 		int accumulatedBytes = 0;
 		ASSERT( byteLimit > 0 );
+		readAheadLeaf = 0;
 		if(db.fragment_values) {
 			if(rowLimit >= 0) {
 				int r = moveTo(keys.begin);
@@ -1091,6 +1283,7 @@ struct RawCursor {
 					Optional<KeyValueRef> kv = i.getNext();
 					result.push_back(result.arena(), kv.get());
 					accumulatedBytes += sizeof(KeyValueRef) + kv.get().expectedSize();
+					readAhead(true);
 					nextKey = i.peek();
 				}
 			}
@@ -1104,6 +1297,7 @@ struct RawCursor {
 					Optional<KeyValueRef> kv = i.getNext();
 					result.push_back(result.arena(), kv.get());
 					accumulatedBytes += sizeof(KeyValueRef) + kv.get().expectedSize();
+					readAhead(false);
 					nextKey = i.peek();
 				}
 			}
@@ -1117,6 +1311,7 @@ struct RawCursor {
 					accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
 					if (kv.key >= keys.end) break;
 					result.push_back( result.arena(), kv );
+					readAhead(true);
 					moveNext();
 				}
 			} else {
@@ -1127,6 +1322,7 @@ struct RawCursor {
 					accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
 					if (kv.key < keys.begin) break;
 					result.push_back( result.arena(), kv );
+					readAhead(false);
 					movePrevious();
 				}
 			}
@@ -1238,6 +1434,22 @@ int SQLiteDB::checkAllPageChecksums() {
 	haveMutex = true;
 
 	pPagerCodec->silent = true;
+
+	// Leaves of the free list may have been released (see Writer::releaseFreePages()) and read as zeros, which is not corruption
+	std::vector<u32> freeLeaves;
+	int freeListRC = sqlite3BtreeBeginTrans(btree, 0);
+	if(freeListRC == SQLITE_OK) {
+		freeListRC = sqlite3BtreeFreeListLeaves(btree, [](void* leaves, u32 pgno) { ((std::vector<u32>*)leaves)->push_back(pgno); }, &freeLeaves);
+		sqlite3BtreeRollback(btree);
+	}
+	if(freeListRC != SQLITE_OK) {
+		TraceEvent(SevWarnAlways, "SQLitePageChecksumScanFreeListUnreadable")
+			.detail("File", filename)
+			.detail("SQLiteError", sqlite3ErrStr(freeListRC))
+			.detail("SQLiteErrorCode", freeListRC);
+	}
+	std::sort(freeLeaves.begin(), freeLeaves.end());
+
 	Pgno p = 1;
 	int readErrors = 0;
 	int corruptPages = 0;
@@ -1249,6 +1461,11 @@ int SQLiteDB::checkAllPageChecksums() {
 		int rc = tryReadEveryDbPage(db, p, &p, &type, &zero);
 		if(rc == SQLITE_OK)
 			break;
+		if(rc == SQLITE_CORRUPT && zero == 1 && std::binary_search(freeLeaves.begin(), freeLeaves.end(), p)) {
+			TEST(true); // Page checksum scan found a released free page
+			++p;
+			continue;
+		}
 		if(rc == SQLITE_CORRUPT) {
 			TraceEvent(SevWarnAlways, "SQLitePageChecksumScanCorruptPage")
 				.detail("File", filename)
@@ -1286,6 +1503,42 @@ int SQLiteDB::checkAllPageChecksums() {
 	return totalErrors;
 }
 
+// Returns the contents of a new database file like template_fdb_with_page_checksums but with the given page size, in the
+// layout that allows pages to be compressed.  The template's four pages are empty b-tree pages apart from the pointer map
+// on page 2, so only their headers have to change.
+static std::string resizedTemplateDatabase(std::string const& filename, int pageSize) {
+	const int templatePageSize = 4096;
+	const int templatePages = 4;
+	const int templateReserveSize = sizeof(PageChecksumCodec::SumType);
+	const int reserveSize = CompressedPageHeader::reserveSize();
+	ASSERT( sizeof(template_fdb_with_page_checksums) > templatePages * templatePageSize );
+	ASSERT( pageSize > templatePageSize && pageSize <= SQLITE_MAX_PAGE_SIZE && !(pageSize & (pageSize - 1)) );
+
+	std::string db(templatePages * pageSize, '\0');
+	for(int i = 0; i < templatePages; i++)
+		memcpy(&db[i * pageSize], template_fdb_with_page_checksums + i * templatePageSize, templatePageSize - templateReserveSize);
+
+	// The page size in the file header (where 65536 is stored as 1) and the reserve size, and the start of the cell
+	// content area, which is the usable size of an empty page, in the headers of the b-tree pages
+	db[16] = (pageSize >> 8) & 0xff;
+	db[17] = pageSize & 0xff;
+	db[CompressedPageHeader::FILE_HEADER_RESERVE_OFFSET] = reserveSize;
+	for(int btreeHeader : { 100, 2 * pageSize, 3 * pageSize }) {
+		db[btreeHeader + 5] = ((pageSize - reserveSize) >> 8) & 0xff;
+		db[btreeHeader + 6] = (pageSize - reserveSize) & 0xff;
+	}
+
+	PageChecksumCodec codec(filename, 0);
+	PageChecksumCodec::sizeChange(&codec, pageSize, reserveSize);
+	for(int i = 0; i < templatePages; i++) {
+		void* image = PageChecksumCodec::codec(&codec, &db[i * pageSize], i + 1, 6);
+		ASSERT( image != NULL );
+		if(image != &db[i * pageSize])
+			memcpy(&db[i * pageSize], image, pageSize);
+	}
+	return db;
+}
+
 void SQLiteDB::open(bool writable) {
 	ASSERT( !haveMutex );
 	double startT = timer();
@@ -1321,7 +1574,12 @@ void SQLiteDB::open(bool writable) {
 			walFile = waitForAndGet( IAsyncFileSystem::filesystem()->open( walpath, IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0600 ) );
 			waitFor( walFile.get()->sync() );
 			dbFile = waitForAndGet( IAsyncFileSystem::filesystem()->open( apath, IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0600 ) );
-			if(page_checksums)
+			if(page_checksums && SERVER_KNOBS->SQLITE_PAGE_COMPRESSION_LEVEL > 0) {
+				// Compressed pages only take fewer blocks than uncompressed ones if pages are larger than blocks
+				std::string db = resizedTemplateDatabase(apath, SERVER_KNOBS->SQLITE_COMPRESSED_PAGE_SIZE);
+				waitFor( dbFile.get()->write( db.data(), db.size(), 0 ) );
+			}
+			else if(page_checksums)
 				waitFor( dbFile.get()->write( template_fdb_with_page_checksums, sizeof(template_fdb_with_page_checksums), 0 ) );
 			else
 				waitFor( dbFile.get()->write( template_fdb_without_page_checksums, sizeof(template_fdb_without_page_checksums), 0 ) );
@@ -1458,6 +1716,18 @@ public:
 	struct SpringCleaningWorkPerformed {
 		int lazyDeletePages = 0;
 		int vacuumedPages = 0;
+		bool moreWork = false; // Whether reclamation stopped with pages left to lazily delete or vacuum
+	};
+
+	// Bytes of pages made reusable by lazy deletion or returned to the file system by vacuuming, and bytes of free pages
+	// released by punching holes for them.  The writer thread only updates springCleaningStats, so these are brought up
+	// to date from it by logPeriodically() and logged for status as <logID>/SpringCleaningCounters.
+	struct SpringCleaningCounters {
+		CounterCollection cc;
+		Counter reclaimedBytes;
+		Counter releasedBytes;
+
+		explicit SpringCleaningCounters(UID logID) : cc("SpringCleaningCounters", logID.toString()), reclaimedBytes("ReclaimedBytes", cc), releasedBytes("ReleasedBytes", cc) {}
 	};
 
 	Future<SpringCleaningWorkPerformed> doClean();
@@ -1469,25 +1739,29 @@ private:
 	std::string filename;
 	Reference<IThreadPool> readThreads, writeThread;
 	Promise<Void> stopped;
-	Future<Void> cleaning, logging, starting, stopOnErr;
+	Future<Void> cleaning, logging, counterLogging, starting, stopOnErr;
 
 	int64_t readsRequested, writesRequested;
 	ThreadSafeCounter readsComplete;
 	volatile int64_t writesComplete;
 	volatile SpringCleaningStats springCleaningStats;
+	SpringCleaningCounters springCleaningCounters;
+	volatile RangeReadStats rangeReadStats;
 	volatile int64_t diskBytesUsed;
 	volatile int64_t freeListPages;
+	volatile int pageSize;
 
 	vector< Reference<ReadCursor> > readCursors;
 
 	struct Reader : IThreadPoolReceiver {
 		SQLiteDB conn;
 		ThreadSafeCounter& counter;
+		volatile RangeReadStats& rangeReadStats;
 		UID dbgid;
 		Reference<ReadCursor>* ppReadCursor;
 
-		explicit Reader( std::string const& filename, bool is_btree_v2, ThreadSafeCounter& counter, UID dbgid, Reference<ReadCursor>* ppReadCursor )
-			: conn( filename, is_btree_v2, is_btree_v2 ), counter(counter), dbgid(dbgid), ppReadCursor(ppReadCursor)
+		explicit Reader( std::string const& filename, bool is_btree_v2, ThreadSafeCounter& counter, volatile RangeReadStats& rangeReadStats, UID dbgid, Reference<ReadCursor>* ppReadCursor )
+			: conn( filename, is_btree_v2, is_btree_v2 ), counter(counter), rangeReadStats(rangeReadStats), dbgid(dbgid), ppReadCursor(ppReadCursor)
 		{
 		}
 		~Reader() {
@@ -1554,7 +1828,17 @@ private:
 			virtual double getTimeEstimate() { return SERVER_KNOBS->READ_RANGE_TIME_ESTIMATE; }
 		};
 		void action( ReadRangeAction& rr ) {
-			rr.result.send( getCursor()->get().getRange(rr.keys, rr.rowLimit, rr.byteLimit) );
+			double t = timer();
+			Reference<ReadCursor> cursor = getCursor();
+			int64_t pagesReadAhead = cursor->get().pagesReadAhead;
+			Standalone<VectorRef<KeyValueRef>> result = cursor->get().getRange(rr.keys, rr.rowLimit, rr.byteLimit);
+
+			++rangeReadStats.rangeReads;
+			rangeReadStats.rangeReadBytes += result.expectedSize();
+			rangeReadStats.readAheadPages += cursor->get().pagesReadAhead - pagesReadAhead;
+			rangeReadStats.rangeReadTime += timer() - t;
+
+			rr.result.send( result );
 			++counter;
 		}
 	};
@@ -1565,23 +1849,31 @@ private:
 		int commits;
 		int setsThisCommit;
 		bool freeTableEmpty; // true if we are sure the freetable (pages pending lazy deletion) is empty
+		double nextFreePageRelease;
+		u32 nextFreePageToRelease; // releaseFreePages() continues from this page
+		int64_t const& writesRequested;
 		volatile int64_t& writesComplete;
 		volatile SpringCleaningStats& springCleaningStats;
 		volatile int64_t& diskBytesUsed;
 		volatile int64_t& freeListPages;
+		volatile int& pageSize;
 		UID dbgid;
 		vector<Reference<ReadCursor>>& readThreads;
 		bool checkAllChecksumsOnOpen;
 		bool checkIntegrityOnOpen;
 
-		explicit Writer( std::string const& filename, bool isBtreeV2, bool checkAllChecksumsOnOpen, bool checkIntegrityOnOpen, volatile int64_t& writesComplete, volatile SpringCleaningStats& springCleaningStats, volatile int64_t& diskBytesUsed, volatile int64_t& freeListPages, UID dbgid, vector<Reference<ReadCursor>>* pReadThreads )
+		explicit Writer( std::string const& filename, bool isBtreeV2, bool checkAllChecksumsOnOpen, bool checkIntegrityOnOpen, int64_t const& writesRequested, volatile int64_t& writesComplete, volatile SpringCleaningStats& springCleaningStats, volatile int64_t& diskBytesUsed, volatile int64_t& freeListPages, volatile int& pageSize, UID dbgid, vector<Reference<ReadCursor>>* pReadThreads )
 			: conn( filename, isBtreeV2, isBtreeV2 ),
 			  commits(), setsThisCommit(),
 			  freeTableEmpty(false),
+			  nextFreePageRelease(0),
+			  nextFreePageToRelease(0),
+			  writesRequested(writesRequested),
 			  writesComplete(writesComplete),
 			  springCleaningStats(springCleaningStats),
 			  diskBytesUsed(diskBytesUsed),
 			  freeListPages(freeListPages),
+			  pageSize(pageSize),
 			  cursor(NULL),
 			  dbgid(dbgid),
 			  readThreads(*pReadThreads),
@@ -1605,6 +1897,7 @@ private:
 				}
 			}
 			conn.open(true);
+			pageSize = sqlite3BtreeGetPageSize(conn.btree);
 
 			//If a wal file fails during the commit process before finishing a checkpoint, then it is possible that our wal file will be non-empty
 			//when we reload it.  We execute a checkpoint here to remedy that situation.  This call must come before before creating a cursor because
@@ -1687,6 +1980,11 @@ private:
 
 			a.result.send(Void());
 
+			if (SERVER_KNOBS->SPRING_CLEANING_FREE_PAGE_RELEASE_INTERVAL > 0 && now() >= nextFreePageRelease) {
+				releaseFreePages();
+				nextFreePageRelease = now() + SERVER_KNOBS->SPRING_CLEANING_FREE_PAGE_RELEASE_INTERVAL;
+			}
+
 			cursor = new Cursor(conn, true);
 			checkFreePages();
 			++writesComplete;
@@ -1732,6 +2030,46 @@ private:
 			//if (iterations) printf("Lazy free: %d pages on freelist, %d iterations, freeTableEmpty=%d\n", freeListPages, iterationsi, freeTableEmpty);
 		}
 
+		// Releases the space in the file of the pages on the free list, which SQLite never reads, by punching holes for
+		// them.  This must run between write transactions and after a full checkpoint, so that the free list is the one in
+		// the file and no reader can see an older one.  A pass releases at most SPRING_CLEANING_FREE_PAGE_RELEASE_MAX_RUNS
+		// runs of adjacent pages, starting where the previous pass stopped.
+		void releaseFreePages() {
+			ASSERT(cursor == NULL);
+			double begin = now();
+
+			std::vector<u32> pages;
+			{
+				SQLiteTransaction tr(conn, false);
+				conn.checkError("FreeListLeaves", sqlite3BtreeFreeListLeaves(conn.btree, [](void* pages, u32 pgno) { ((std::vector<u32>*)pages)->push_back(pgno); }, &pages));
+			}
+			std::sort(pages.begin(), pages.end());
+
+			auto p = std::lower_bound(pages.begin(), pages.end(), nextFreePageToRelease);
+			if (p == pages.end())
+				p = pages.begin();
+			int runs = 0;
+			int64_t releasedPages = 0;
+			while (p != pages.end() && runs < SERVER_KNOBS->SPRING_CLEANING_FREE_PAGE_RELEASE_MAX_RUNS) {
+				auto e = p + 1;
+				while (e != pages.end() && *e == e[-1] + 1)
+					++e;
+				int64_t offset = (int64_t)(*p - 1) * pageSize;
+				int64_t length = (int64_t)(e - p) * pageSize;
+				// Simulated files don't release space, so the pages are zeroed instead to check that nothing reads them
+				waitFor( g_network->isSimulated() ? conn.dbFile->zeroRange(offset, length) : conn.dbFile->punchHole(offset, length) );
+				releasedPages += e - p;
+				++runs;
+				p = e;
+			}
+			nextFreePageToRelease = p == pages.end() ? 0 : *p;
+
+			TEST(releasedPages > 0); // Free pages released
+			TEST(p != pages.end()); // Free page release continues in the next pass
+			springCleaningStats.releasedPages += releasedPages;
+			springCleaningStats.releaseTime += now() - begin;
+		}
+
 		struct SpringCleaningAction : TypedAction<Writer, SpringCleaningAction>, FastAllocated<SpringCleaningAction> {
 			ThreadReturnPromise<SpringCleaningWorkPerformed> result;
 			virtual double getTimeEstimate() { 
@@ -1753,15 +2091,18 @@ private:
 
 			loop {
 				double begin = now();
+				// Writes queued behind this action end it once the minimum work is done, just as running out of time does
+				bool writesWaiting = writesRequested - writesComplete > 1;
 				bool canDelete = !freeTableEmpty 
-				                 && (now() < lazyDeleteEnd || workPerformed.lazyDeletePages < SERVER_KNOBS->SPRING_CLEANING_MIN_LAZY_DELETE_PAGES) 
+				                 && ((now() < lazyDeleteEnd && !writesWaiting) || workPerformed.lazyDeletePages < SERVER_KNOBS->SPRING_CLEANING_MIN_LAZY_DELETE_PAGES) 
 				                 && workPerformed.lazyDeletePages < SERVER_KNOBS->SPRING_CLEANING_MAX_LAZY_DELETE_PAGES;
 
 				bool canVacuum = !vacuumFinished 
-				                 && (now() < vacuumEnd || workPerformed.vacuumedPages < SERVER_KNOBS->SPRING_CLEANING_MIN_VACUUM_PAGES) 
+				                 && ((now() < vacuumEnd && !writesWaiting) || workPerformed.vacuumedPages < SERVER_KNOBS->SPRING_CLEANING_MIN_VACUUM_PAGES) 
 				                 && workPerformed.vacuumedPages < SERVER_KNOBS->SPRING_CLEANING_MAX_VACUUM_PAGES;
 
 				if(!canDelete && !canVacuum) {
+					TEST(writesWaiting); // SQLite spring cleaning yielded to waiting writes
 					break;
 				}
 
@@ -1793,6 +2134,7 @@ private:
 			}
 
 			freeListPages = conn.freePages();
+			workPerformed.moreWork = !freeTableEmpty || (!vacuumFinished && freeListPages > 0);
 
 			TEST(workPerformed.lazyDeletePages > 0); // Pages lazily deleted
 			TEST(workPerformed.vacuumedPages > 0); // Pages vacuumed
@@ -1817,6 +2159,12 @@ private:
 	ACTOR static Future<Void> logPeriodically( KeyValueStoreSQLite* self ) {
 		state int64_t lastReadsComplete = 0;
 		state int64_t lastWritesComplete = 0;
+		state int64_t lastRangeReads = 0;
+		state int64_t lastRangeReadBytes = 0;
+		state int64_t lastReadAheadPages = 0;
+		state double lastRangeReadTime = 0;
+		state int64_t lastReclaimedPages = 0;
+		state int64_t lastReleasedPages = 0;
 		loop {
 			wait( delay(SERVER_KNOBS->DISK_METRIC_LOGGING_INTERVAL) );
 
@@ -1834,10 +2182,33 @@ private:
 				.detail("VacuumedPages", self->springCleaningStats.vacuumedPages)
 				.detail("SpringCleaningTime", self->springCleaningStats.springCleaningTime)
 				.detail("LazyDeleteTime", self->springCleaningStats.lazyDeleteTime)
-				.detail("VacuumTime", self->springCleaningStats.vacuumTime);
+				.detail("VacuumTime", self->springCleaningStats.vacuumTime)
+				.detail("ReleasedPages", self->springCleaningStats.releasedPages)
+				.detail("ReleaseTime", self->springCleaningStats.releaseTime);
+
+			int64_t reclaimedPages = self->springCleaningStats.lazyDeletePages + self->springCleaningStats.vacuumedPages;
+			int64_t releasedPages = self->springCleaningStats.releasedPages;
+			self->springCleaningCounters.reclaimedBytes += (reclaimedPages - lastReclaimedPages) * self->pageSize;
+			self->springCleaningCounters.releasedBytes += (releasedPages - lastReleasedPages) * self->pageSize;
+			lastReclaimedPages = reclaimedPages;
+			lastReleasedPages = releasedPages;
+
+			// ScanMBPerSec is the throughput of range reads while they are running, which readahead (SQLITE_READAHEAD_PAGES) should raise for cold scans
+			int64_t rangeReads = self->rangeReadStats.rangeReads, rangeReadBytes = self->rangeReadStats.rangeReadBytes, readAheadPages = self->rangeReadStats.readAheadPages;
+			double rangeReadTime = self->rangeReadStats.rangeReadTime;
+			TraceEvent("RangeReadMetrics", self->logID)
+				.detail("RangeReads", rangeReads - lastRangeReads)
+				.detail("RangeReadBytes", rangeReadBytes - lastRangeReadBytes)
+				.detail("RangeReadTime", rangeReadTime - lastRangeReadTime)
+				.detail("ScanMBPerSec", rangeReadTime > lastRangeReadTime ? (rangeReadBytes - lastRangeReadBytes) / 1e6 / (rangeReadTime - lastRangeReadTime) : 0.0)
+				.detail("ReadAheadPages", readAheadPages - lastReadAheadPages);
 
 			lastReadsComplete = self->readsComplete;
 			lastWritesComplete = self->writesComplete;
+			lastRangeReads = rangeReads;
+			lastRangeReadBytes = rangeReadBytes;
+			lastReadAheadPages = readAheadPages;
+			lastRangeReadTime = rangeReadTime;
 		}
 	}
 
@@ -1861,6 +2232,7 @@ private:
 			self->starting.cancel();
 			self->cleaning.cancel();
 			self->logging.cancel();
+			self->counterLogging.cancel();
 			wait( self->readThreads->stop() && self->writeThread->stop() );
 			if (deleteOnClose) {
 				wait( IAsyncFileSystem::filesystem()->incrementalDeleteFile( self->filename, true ) );
@@ -1896,6 +2268,10 @@ ACTOR Future<Void> cleanPeriodically( KeyValueStoreSQLite* self ) {
 		if (workPerformed.vacuumedPages > 0) {
 			duration = std::min(duration, SERVER_KNOBS->SPRING_CLEANING_VACUUM_INTERVAL);
 		}
+		int reclaimedPages = workPerformed.lazyDeletePages + workPerformed.vacuumedPages;
+		if (workPerformed.moreWork && reclaimedPages > 0 && SERVER_KNOBS->SPRING_CLEANING_RECLAIM_PAGES_PER_SECOND > 0) {
+			duration = std::min(duration, reclaimedPages / SERVER_KNOBS->SPRING_CLEANING_RECLAIM_PAGES_PER_SECOND);
+		}
 		if (duration == std::numeric_limits<double>::max()) {
 			duration = SERVER_KNOBS->SPRING_CLEANING_NO_ACTION_INTERVAL;
 		}
@@ -1919,7 +2295,7 @@ KeyValueStoreSQLite::KeyValueStoreSQLite(std::string const& filename, UID id, Ke
 	  logID(id),
 	  readThreads(CoroThreadPool::createThreadPool()),
 	  writeThread(CoroThreadPool::createThreadPool()),
-	  readsRequested(0), writesRequested(0), writesComplete(0), diskBytesUsed(0), freeListPages(0)
+	  readsRequested(0), writesRequested(0), writesComplete(0), springCleaningCounters(id), diskBytesUsed(0), freeListPages(0), pageSize(_PAGE_SIZE)
 {
 	stopOnErr = stopOnError(this);
 
@@ -1939,7 +2315,7 @@ KeyValueStoreSQLite::KeyValueStoreSQLite(std::string const& filename, UID id, Ke
 	sqlite3_soft_heap_limit64( SERVER_KNOBS->SOFT_HEAP_LIMIT );  // SOMEDAY: Is this a performance issue?  Should we drop the cache sizes for individual threads?
 	TaskPriority taskId = g_network->getCurrentTask();
 	g_network->setCurrentTask(TaskPriority::DiskWrite);
-	writeThread->addThread( new Writer(filename, type==KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity, writesComplete, springCleaningStats, diskBytesUsed, freeListPages, id, &readCursors) );
+	writeThread->addThread( new Writer(filename, type==KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity, writesRequested, writesComplete, springCleaningStats, diskBytesUsed, freeListPages, pageSize, id, &readCursors) );
 	g_network->setCurrentTask(taskId);
 	auto p = new Writer::InitAction();
 	auto f = p->result.getFuture();
@@ -1947,6 +2323,7 @@ KeyValueStoreSQLite::KeyValueStoreSQLite(std::string const& filename, UID id, Ke
 	starting = startReadThreadsWhen( this, f, logID );
 	cleaning = cleanPeriodically(this);
 	logging = logPeriodically(this);
+	counterLogging = traceCounters("SpringCleaningCounters", id, SERVER_KNOBS->DISK_METRIC_LOGGING_INTERVAL, &springCleaningCounters.cc, id.toString() + "/SpringCleaningCounters");
 }
 KeyValueStoreSQLite::~KeyValueStoreSQLite() {
 	//printf("dbf=%lld bytes, wal=%lld bytes\n", getFileSize((filename+".fdb").c_str()), getFileSize((filename+".fdb-wal").c_str()));
@@ -1958,7 +2335,7 @@ StorageBytes KeyValueStoreSQLite::getStorageBytes() {
 
 	g_network->getDiskBytes(parentDirectory(filename), free, total);
 
-	return StorageBytes(free, total, diskBytesUsed, free + _PAGE_SIZE * freeListPages);
+	return StorageBytes(free, total, diskBytesUsed, free + (int64_t)pageSize * freeListPages);
 }
 
 void KeyValueStoreSQLite::startReadThreads() {
@@ -1966,7 +2343,7 @@ void KeyValueStoreSQLite::startReadThreads() {
 	TaskPriority taskId = g_network->getCurrentTask();
 	g_network->setCurrentTask(TaskPriority::DiskRead);
 	for(int i=0; i<nReadThreads; i++)
-		readThreads->addThread( new Reader(filename, type==KeyValueStoreType::SSD_BTREE_V2, readsComplete, logID, &readCursors[i]) );
+		readThreads->addThread( new Reader(filename, type==KeyValueStoreType::SSD_BTREE_V2, readsComplete, rangeReadStats, logID, &readCursors[i]) );
 	g_network->setCurrentTask(taskId);
 }
 
@@ -2066,3 +2443,58 @@ ACTOR Future<Void> KVFileCheck(std::string filename, bool integrity) {
 	return Void();
 }
 
+TEST_CASE("/fdbserver/KeyValueStoreSQLite/pageCodec") {
+	// Pages are written through the codec in the compressed layout, stored as VFSAsync stores them, with the unused
+	// blocks of compressed pages left as zeros, and must read back as SQLite wrote them
+	const int pageSize = 16384;
+	PageChecksumCodec codec("pageCodec", deterministicRandom()->randomInt(0, 10));
+	codec.silent = true;
+	PageChecksumCodec::sizeChange(&codec, pageSize, CompressedPageHeader::reserveSize());
+
+	int compressedPages = 0;
+	for(int i = 0; i < 100; i++) {
+		Pgno pageNumber = deterministicRandom()->randomInt(2, 1000);
+
+		// Mostly empty pages compress and full ones do not.  Some pages begin with what looks like a compressed page
+		// header, which is only data to the codec.
+		std::vector<uint8_t> page(pageSize);
+		for(int b = deterministicRandom()->randomInt(0, pageSize); b > 0; b--)
+			page[deterministicRandom()->randomInt(0, pageSize)] = deterministicRandom()->randomInt(0, 256);
+		if(deterministicRandom()->coinflip()) {
+			CompressedPageHeader* lookalike = (CompressedPageHeader*)page.data();
+			lookalike->length = deterministicRandom()->randomInt(1, CompressedPageHeader::maxLength(pageSize) + 1);
+			lookalike->unused = 0;
+		}
+
+		uint8_t* image = (uint8_t*)PageChecksumCodec::codec(&codec, page.data(), pageNumber, 6);
+		ASSERT( image != NULL && image != page.data() );
+		int usedBytes = CompressedPageHeader::usedBytes(image, pageSize);
+		ASSERT( usedBytes % _PAGE_SIZE == 0 && usedBytes <= pageSize );
+		ASSERT( usedBytes == pageSize || codec.compressionLevel > 0 );
+		if(usedBytes < pageSize)
+			++compressedPages;
+
+		std::vector<uint8_t> stored(pageSize);
+		memcpy(stored.data(), image, usedBytes);
+		std::vector<uint8_t> corrupted = stored;
+
+		ASSERT( PageChecksumCodec::codec(&codec, stored.data(), pageNumber, 3) == stored.data() );
+		ASSERT( stored == page );
+
+		// A damaged page image is rejected, unless the damage is to bits that do not matter, such as the padding of the
+		// compressed stream
+		corrupted[deterministicRandom()->randomInt(0, usedBytes)] ^= 1 << deterministicRandom()->randomInt(0, 8);
+		void* decoded = PageChecksumCodec::codec(&codec, corrupted.data(), pageNumber, 3);
+		ASSERT( decoded == NULL || corrupted == page );
+	}
+	ASSERT( compressedPages > 0 || codec.compressionLevel == 0 );
+
+	// Files with only the checksum reserved are never compressed, and their pages are stored as they are
+	PageChecksumCodec plain("pageCodec", 9);
+	PageChecksumCodec::sizeChange(&plain, pageSize, sizeof(PageChecksumCodec::SumType));
+	std::vector<uint8_t> page(pageSize);
+	ASSERT( PageChecksumCodec::codec(&plain, page.data(), 2, 6) == page.data() );
+	ASSERT( PageChecksumCodec::codec(&plain, page.data(), 2, 3) == page.data() );
+
+	return Void();
+}
@@ -0,0 +1,1102 @@
+/*
+ * KeyValueStoreTiered.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/KeyRangeMap.h"
+#include "fdbclient/SystemData.h"
+#include "fdbserver/IKeyValueStore.h"
+#include "fdbserver/Knobs.h"
+#include "fdbrpc/IAsyncFile.h"
+#include "fdbrpc/crc32c.h"
+#include "fdbrpc/zlib/zlib.h"
+#include "flow/ActorCollection.h"
+#include "flow/UnitTest.h"
+#include "flow/actorcompiler.h"  // This must be the last #include.
+
+// A tiered store keeps its data in a wrapped "hot" store, and moves key ranges of the user key space (allKeys) which
+// have not been written for TIERED_COLD_AGE seconds into immutable "cold" files, which are sorted, compressed in
+// blocks and indexed, so that data which is rarely read takes a fraction of the space.
+//
+// Each key in a cold range is read from the hot store if it is there, and otherwise from the cold file unless a clear
+// made since the file was written covers it.  The list of cold files and those clears are kept in the hot store under
+// tieredMetadataKeys, so that moving a range to the cold tier is committed atomically with the rest of the hot store:
+// the cold file is written and synced first, and then the hot copy of the range is cleared and the file is added to
+// the list by the next commit.  A cold range is rewritten, merging in the writes to it, once it is quiet again.
+
+// The user key space of the store ends where its metadata begins
+static const KeyRangeRef tieredMetadataKeys(LiteralStringRef("\xff\xff\xff/tiered/"), LiteralStringRef("\xff\xff\xff/tiered0"));
+static const KeyRef coldFilePrefix = LiteralStringRef("\xff\xff\xff/tiered/file/");
+static const KeyRef coldClearPrefix = LiteralStringRef("\xff\xff\xff/tiered/clear/");
+
+static Key coldFileKey(KeyRef begin) { return begin.withPrefix(coldFilePrefix); }
+static Key coldClearKey(KeyRef begin) { return begin.withPrefix(coldClearPrefix); }
+
+// The value of coldFileKey(begin) for a cold file containing the keys from begin to end
+struct ColdFileInfo {
+	constexpr static FileIdentifier file_identifier = 9461375;
+	Key end;
+	UID id;
+
+	ColdFileInfo() {}
+	ColdFileInfo(KeyRef end, UID id) : end(end), id(id) {}
+
+	template <class Ar>
+	void serialize(Ar& ar) {
+		serializer(ar, end, id);
+	}
+};
+
+// A cold file is a sequence of blocks, followed by the block index and then this footer.  Each block is the crc32c
+// checksum of the rest of the block followed by the zlib compressed encoding of a run of rows, each of which is its key
+// and value lengths (int32_t) followed by its key and value.
+struct ColdFileFooter {
+	static constexpr uint64_t MAGIC = 0xfdbc01df11e5fdbcULL;
+	static constexpr uint32_t FORMAT_VERSION = 1;
+
+	uint64_t magic;
+	uint32_t formatVersion;
+	uint32_t indexChecksum;
+	int64_t indexOffset;
+	int64_t indexLength;
+};
+
+struct ColdFileBlock {
+	KeyRef firstKey;
+	int64_t offset;
+	int length; // Bytes of the block in the file, including the checksum
+	int rawLength; // Bytes of the encoded rows
+};
+
+static Standalone<StringRef> encodeColdFileIndex(std::vector<ColdFileBlock> const& blocks) {
+	BinaryWriter wr(Unversioned());
+	wr << (int32_t)blocks.size();
+	for(auto& b : blocks) {
+		wr << (int32_t)b.firstKey.size();
+		wr.serializeBytes(b.firstKey);
+		wr << b.offset << (int32_t)b.length << (int32_t)b.rawLength;
+	}
+	return wr.toValue();
+}
+
+static void decodeColdFileIndex(StringRef index, Arena& arena, std::vector<ColdFileBlock>& blocks) {
+	BinaryReader rd(index, Unversioned());
+	int32_t count;
+	rd >> count;
+	blocks.resize(count);
+	for(auto& b : blocks) {
+		int32_t keyLength, length, rawLength;
+		rd >> keyLength;
+		b.firstKey = StringRef(arena, StringRef((const uint8_t*)rd.readBytes(keyLength), keyLength));
+		rd >> b.offset >> length >> rawLength;
+		b.length = length;
+		b.rawLength = rawLength;
+	}
+	rd.assertEnd();
+}
+
+// The vendored zlib has only the stream interface, so each block is deflated or inflated in one call to it
+static Standalone<StringRef> compressColdBlock(StringRef raw, int level) {
+	z_stream deflater;
+	memset(&deflater, 0, sizeof(deflater));
+	if(deflateInit(&deflater, level) != Z_OK)
+		throw internal_error();
+	Standalone<StringRef> block = makeString(sizeof(uint32_t) + deflateBound(&deflater, raw.size()));
+	uint8_t* out = mutateString(block);
+	deflater.next_in = (Bytef*)raw.begin();
+	deflater.avail_in = raw.size();
+	deflater.next_out = out + sizeof(uint32_t);
+	deflater.avail_out = block.size() - sizeof(uint32_t);
+	int rc = deflate(&deflater, Z_FINISH);
+	int length = deflater.total_out;
+	deflateEnd(&deflater);
+	if(rc != Z_STREAM_END)
+		throw internal_error();
+	uint32_t checksum = crc32c_append(0, out + sizeof(uint32_t), length);
+	memcpy(out, &checksum, sizeof(checksum));
+	return Standalone<StringRef>(block.substr(0, sizeof(uint32_t) + length), block.arena());
+}
+
+static bool inflateColdBlock(StringRef data, uint8_t* out, int rawLength) {
+	z_stream inflater;
+	memset(&inflater, 0, sizeof(inflater));
+	if(inflateInit(&inflater) != Z_OK)
+		return false;
+	inflater.next_in = (Bytef*)data.begin();
+	inflater.avail_in = data.size();
+	inflater.next_out = out;
+	inflater.avail_out = rawLength;
+	int rc = inflate(&inflater, Z_FINISH);
+	bool complete = rc == Z_STREAM_END && inflater.total_out == rawLength;
+	inflateEnd(&inflater);
+	return complete;
+}
+
+static Standalone<VectorRef<KeyValueRef>> decodeColdBlock(StringRef block, int rawLength, std::string const& filename, int64_t offset) {
+	uint32_t checksum = 0;
+	Standalone<StringRef> raw = makeString(rawLength);
+	if(block.size() >= sizeof(checksum))
+		memcpy(&checksum, block.begin(), sizeof(checksum));
+	StringRef data = block.size() >= sizeof(checksum) ? block.substr(sizeof(checksum)) : StringRef();
+	if(block.size() < sizeof(checksum) || checksum != crc32c_append(0, data.begin(), data.size()) || !inflateColdBlock(data, mutateString(raw), rawLength)) {
+		TraceEvent(SevError, "TieredColdBlockCorrupt").detail("Filename", filename).detail("Offset", offset).detail("Length", block.size());
+		throw checksum_failed();
+	}
+
+	Standalone<VectorRef<KeyValueRef>> rows;
+	rows.arena().dependsOn(raw.arena());
+	const uint8_t* p = raw.begin();
+	while(p != raw.end()) {
+		int32_t lengths[2];
+		ASSERT(raw.end() - p >= sizeof(lengths));
+		memcpy(lengths, p, sizeof(lengths));
+		p += sizeof(lengths);
+		ASSERT(raw.end() - p >= (int64_t)lengths[0] + lengths[1]);
+		rows.push_back(rows.arena(), KeyValueRef(StringRef(p, lengths[0]), StringRef(p + lengths[0], lengths[1])));
+		p += lengths[0] + lengths[1];
+	}
+	return rows;
+}
+
+// An open cold file.  Its index is kept in memory, so a read of a key reads and decompresses one block.
+struct ColdFile : ReferenceCounted<ColdFile> {
+	UID id;
+	std::string filename;
+	Reference<IAsyncFile> file;
+	KeyRange range; // The keys the file holds, which is set from the file's manifest entry
+	int64_t fileBytes;
+	int64_t dataBytes;
+	Arena arena;
+	std::vector<ColdFileBlock> blocks;
+
+	ColdFile(UID id, std::string const& filename) : id(id), filename(filename), fileBytes(0), dataBytes(0) {}
+
+	// Returns the index of the last block beginning before end (or at end, if orEqual), or -1 if there is none
+	int lastBlockBefore(KeyRef end, bool orEqual) const {
+		auto b = orEqual ? std::upper_bound(blocks.begin(), blocks.end(), end, [](KeyRef const& k, ColdFileBlock const& b) { return k < b.firstKey; })
+		                 : std::lower_bound(blocks.begin(), blocks.end(), end, [](ColdFileBlock const& b, KeyRef const& k) { return b.firstKey < k; });
+		return (b - blocks.begin()) - 1;
+	}
+
+	ACTOR static Future<Reference<ColdFile>> open(UID id, std::string filename) {
+		state Reference<ColdFile> self(new ColdFile(id, filename));
+		state ColdFileFooter footer;
+		state int64_t size;
+		Reference<IAsyncFile> file = wait(IAsyncFileSystem::filesystem()->open(filename, IAsyncFile::OPEN_READONLY | IAsyncFile::OPEN_UNCACHED, 0));
+		self->file = file;
+		int64_t s = wait(self->file->size());
+		size = self->fileBytes = s;
+		if(size >= sizeof(footer)) {
+			int read = wait(self->file->read(&footer, sizeof(footer), size - sizeof(footer)));
+		}
+		if(size < sizeof(footer) || footer.magic != ColdFileFooter::MAGIC || footer.formatVersion != ColdFileFooter::FORMAT_VERSION
+		   || footer.indexOffset < 0 || footer.indexLength < 0 || footer.indexOffset + footer.indexLength + sizeof(footer) != size) {
+			TraceEvent(SevError, "TieredColdFileCorrupt").detail("Filename", filename).detail("Size", size);
+			throw file_corrupt();
+		}
+
+		state Standalone<StringRef> index = makeString(footer.indexLength);
+		int read = wait(self->file->read(mutateString(index), index.size(), footer.indexOffset));
+		if(read != index.size() || crc32c_append(0, index.begin(), index.size()) != footer.indexChecksum) {
+			TraceEvent(SevError, "TieredColdFileCorrupt").detail("Filename", filename).detail("Size", size);
+			throw checksum_failed();
+		}
+		decodeColdFileIndex(index, self->arena, self->blocks);
+		for(auto& b : self->blocks)
+			self->dataBytes += b.rawLength;
+		return self;
+	}
+
+	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> readBlock(Reference<ColdFile> self, int i) {
+		state ColdFileBlock block = self->blocks[i];
+		state Standalone<StringRef> data = makeString(block.length);
+		int read = wait(self->file->read(mutateString(data), block.length, block.offset));
+		if(read != block.length) {
+			TraceEvent(SevError, "TieredColdFileShortRead").detail("Filename", self->filename).detail("Offset", block.offset).detail("Length", block.length).detail("Read", read);
+			throw io_error();
+		}
+		return decodeColdBlock(data, block.rawLength, self->filename, block.offset);
+	}
+
+	ACTOR static Future<Optional<Value>> readValue(Reference<ColdFile> self, Key key) {
+		int i = self->lastBlockBefore(key, true);
+		if(i < 0)
+			return Optional<Value>();
+		Standalone<VectorRef<KeyValueRef>> rows = wait(readBlock(self, i));
+		auto r = std::lower_bound(rows.begin(), rows.end(), key, [](KeyValueRef const& kv, KeyRef const& k) { return kv.key < k; });
+		if(r != rows.end() && r->key == key)
+			return Value(r->value, rows.arena());
+		return Optional<Value>();
+	}
+
+	// Reads rows of keys with the same limits as IKeyValueStore::readRange().  The second member of the result is
+	// false if all of the rows of keys were returned.
+	ACTOR static Future<std::pair<Standalone<VectorRef<KeyValueRef>>, bool>> readRange(Reference<ColdFile> self, KeyRange keys, int rowLimit, int byteLimit) {
+		state Standalone<VectorRef<KeyValueRef>> result;
+		state Standalone<VectorRef<KeyValueRef>> rows;
+		state int accumulatedBytes = 0;
+		state bool forward = rowLimit >= 0;
+		state int rowsLeft = std::abs(rowLimit);
+		state int i = forward ? std::max(0, self->lastBlockBefore(keys.begin, true)) : self->lastBlockBefore(keys.end, false);
+
+		while(forward ? i < self->blocks.size() && self->blocks[i].firstKey < keys.end : i >= 0) {
+			Standalone<VectorRef<KeyValueRef>> block = wait(readBlock(self, i));
+			rows = block;
+			result.arena().dependsOn(rows.arena());
+			for(int r = 0; r < rows.size(); r++) {
+				KeyValueRef kv = rows[forward ? r : rows.size() - 1 - r];
+				if(!keys.contains(kv.key))
+					continue;
+				result.push_back(result.arena(), kv);
+				accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
+				if(--rowsLeft == 0 || accumulatedBytes >= byteLimit)
+					return std::make_pair(result, true);
+			}
+			if(!forward && self->blocks[i].firstKey <= keys.begin)
+				break;
+			i += forward ? 1 : -1;
+		}
+		return std::make_pair(result, false);
+	}
+};
+
+// Writes the rows passed to add(), which must be in key order, to a new cold file
+struct ColdFileBuilder : ReferenceCounted<ColdFileBuilder> {
+	Reference<IAsyncFile> file;
+	int blockBytes;
+	int compressionLevel;
+	int64_t offset;
+	int64_t dataBytes;
+	Arena arena;
+	std::vector<ColdFileBlock> blocks;
+	std::string rawBlock;
+	KeyRef blockFirstKey;
+
+	ColdFileBuilder(Reference<IAsyncFile> file, int blockBytes, int compressionLevel)
+	  : file(file), blockBytes(blockBytes), compressionLevel(compressionLevel), offset(0), dataBytes(0) {}
+
+	void add(KeyValueRef kv) {
+		if(rawBlock.empty())
+			blockFirstKey = StringRef(arena, kv.key);
+		int32_t lengths[2] = { kv.key.size(), kv.value.size() };
+		rawBlock.append((const char*)lengths, sizeof(lengths));
+		rawBlock.append((const char*)kv.key.begin(), kv.key.size());
+		rawBlock.append((const char*)kv.value.begin(), kv.value.size());
+		dataBytes += sizeof(lengths) + kv.key.size() + kv.value.size();
+	}
+
+	bool blockFull() const { return rawBlock.size() >= blockBytes; }
+
+	// Writes the rows added since the last call
+	Future<Void> flushBlock() {
+		if(rawBlock.empty())
+			return Void();
+		Standalone<StringRef> data = compressColdBlock(StringRef(rawBlock), compressionLevel);
+		blocks.push_back(ColdFileBlock{ blockFirstKey, offset, data.size(), (int)rawBlock.size() });
+		Future<Void> written = holdWhile(data, file->write(data.begin(), data.size(), offset));
+		offset += data.size();
+		rawBlock.clear();
+		return written;
+	}
+
+	ACTOR static Future<Void> finish(Reference<ColdFileBuilder> self) {
+		wait(self->flushBlock());
+		state Standalone<StringRef> index = encodeColdFileIndex(self->blocks);
+		state ColdFileFooter footer;
+		footer.magic = ColdFileFooter::MAGIC;
+		footer.formatVersion = ColdFileFooter::FORMAT_VERSION;
+		footer.indexChecksum = crc32c_append(0, index.begin(), index.size());
+		footer.indexOffset = self->offset;
+		footer.indexLength = index.size();
+		wait(self->file->write(index.begin(), index.size(), self->offset));
+		wait(self->file->write(&footer, sizeof(footer), self->offset + index.size()));
+		wait(self->file->sync());
+		return Void();
+	}
+};
+
+ACTOR template <class T>
+Future<T> catchTieredStoreError(Promise<Void> error, Future<T> f) {
+	try {
+		T result = wait(f);
+		return result;
+	} catch(Error& e) {
+		if(e.code() != error_code_actor_cancelled && error.canBeSet())
+			error.sendError(e);
+		throw;
+	}
+}
+
+struct KeyValueStoreTiered : IKeyValueStore {
+	// When each range of the user key space was last written.  The migration scan splits the ranges at the boundaries
+	// of the chunks of hot data it considers moving to the cold tier.
+	struct WriteTime {
+		double time;
+		bool chunk; // Whether the range is one chunk of the migration scan, rather than not yet scanned
+
+		WriteTime(double time = 0, bool chunk = false) : time(time), chunk(chunk) {}
+	};
+
+	IKeyValueStore* hot;
+	std::string filePrefix; // Cold files are named filePrefix + "-cold-" + their id
+	UID logID;
+
+	KeyRangeMap<Reference<ColdFile>> coldFiles; // The cold file holding each range of allKeys, or null for the hot tier
+	KeyRangeMap<bool> cleared; // Committed clears of cold data, which hide it from reads
+	std::vector<KeyRange> pendingClears; // Clears of cold data made since the last commit
+	std::map<Key, Key> clearRecords; // The clears of cold data stored in the hot store under coldClearPrefix
+	KeyRangeMap<WriteTime> writeTimes;
+	double committedBefore; // Writes made before this time have been committed to the hot store
+	std::vector<Reference<ColdFile>> obsoleteFiles; // Cold files which are deleted once the next commit completes
+	Key migrationCursor;
+
+	int64_t coldFileCount, coldFileBytes, coldDataBytes;
+	int64_t coldReads, migrations, abandonedMigrations, migratedBytes;
+
+	Future<Void> m_init, migration, logging;
+	ActorCollectionNoErrors fileDeletes;
+	Promise<Void> m_closed;
+	Promise<Void> m_error;
+
+	KeyValueStoreTiered(IKeyValueStore* hot, std::string const& filePrefix, UID logID)
+	  : hot(hot), filePrefix(filePrefix), logID(logID), writeTimes(WriteTime(now())), committedBefore(0),
+	    coldFileCount(0), coldFileBytes(0), coldDataBytes(0), coldReads(0), migrations(0), abandonedMigrations(0), migratedBytes(0) {
+		m_init = catchError(init_impl(this));
+	}
+
+	template <class T>
+	Future<T> catchError(Future<T> f) {
+		return catchTieredStoreError(m_error, f);
+	}
+
+	std::string coldFilename(UID id) const { return filePrefix + "-cold-" + id.toString(); }
+
+	virtual Future<Void> init() { return m_init; }
+
+	virtual KeyValueStoreType getType() { return KeyValueStoreType::SSD_TIERED_V1; }
+
+	virtual Future<Void> getError() { return delayed(m_error.getFuture() || hot->getError()); }
+
+	virtual Future<Void> onClosed() { return m_closed.getFuture(); }
+
+	virtual void dispose() { shutdown(this, true); }
+
+	virtual void close() { shutdown(this, false); }
+
+	virtual StorageBytes getStorageBytes() {
+		StorageBytes sb = hot->getStorageBytes();
+		sb.used += coldFileBytes;
+		return sb;
+	}
+
+	virtual void set(KeyValueRef keyValue, const Arena* arena = NULL) {
+		ASSERT(keyValue.key < tieredMetadataKeys.begin);
+		if(keyValue.key < allKeys.end)
+			writeTimes.rangeContaining(keyValue.key).value().time = now();
+		hot->set(keyValue, arena);
+	}
+
+	virtual void clear(KeyRangeRef range, const Arena* arena = NULL) {
+		range = range & KeyRangeRef(KeyRef(), tieredMetadataKeys.begin);
+		if(range.empty())
+			return;
+		hot->clear(range, arena);
+
+		KeyRangeRef coldRange = range & allKeys;
+		if(coldRange.empty())
+			return;
+		for(auto w : writeTimes.intersectingRanges(coldRange))
+			w.value().time = now();
+		for(auto f : coldFiles.intersectingRanges(coldRange)) {
+			if(f.value())
+				addClear(f.range() & coldRange, f.range());
+		}
+	}
+
+	// Records the clear of keys, which are in the cold file with the given range.  The records of clears which overlap
+	// or touch it in the same file are merged with it, so there is at most one per key of cold data.
+	void addClear(KeyRange keys, KeyRangeRef fileRange) {
+		pendingClears.push_back(keys);
+
+		Key begin = keys.begin, end = keys.end;
+		auto r = clearRecords.upper_bound(begin);
+		if(r != clearRecords.begin() && std::prev(r)->second >= begin && std::prev(r)->first >= fileRange.begin)
+			--r;
+		while(r != clearRecords.end() && r->first <= end && r->first < fileRange.end) {
+			begin = std::min(begin, r->first);
+			end = std::max(end, r->second);
+			hot->clear(singleKeyRange(coldClearKey(r->first)));
+			r = clearRecords.erase(r);
+		}
+		clearRecords[begin] = end;
+		hot->set(KeyValueRef(coldClearKey(begin), end));
+	}
+
+	virtual Future<Void> commit(bool sequential = false) {
+		Future<Void> c = commit_impl(this, hot->commit(sequential), now(), std::move(pendingClears), std::move(obsoleteFiles));
+		pendingClears.clear();
+		obsoleteFiles.clear();
+		return catchError(c);
+	}
+
+	ACTOR static Future<Void> commit_impl(KeyValueStoreTiered* self, Future<Void> commit, double begin, std::vector<KeyRange> clears, std::vector<Reference<ColdFile>> obsolete) {
+		wait(commit);
+		for(auto& r : clears) {
+			self->cleared.insert(r, true);
+			self->cleared.coalesce(KeyRangeRef(r));
+		}
+		self->committedBefore = std::max(self->committedBefore, begin);
+		for(auto& f : obsolete)
+			self->fileDeletes.add(ready(IAsyncFileSystem::filesystem()->deleteFile(f->filename, false)));
+		return Void();
+	}
+
+	// Returns the cold file which holds key, or null if the hot store has the only copy of it
+	Reference<ColdFile> coldFileContaining(KeyRef key) {
+		if(key >= allKeys.end || cleared[key])
+			return Reference<ColdFile>();
+		return coldFiles[key];
+	}
+
+	virtual Future<Optional<Value>> readValue(KeyRef key, Optional<UID> debugID = Optional<UID>()) {
+		Future<Optional<Value>> hotValue = hot->readValue(key, debugID);
+		if(!coldFileContaining(key))
+			return hotValue;
+		return catchError(readValue_impl(this, key, hotValue, -1));
+	}
+
+	virtual Future<Optional<Value>> readValuePrefix(KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>()) {
+		Future<Optional<Value>> hotValue = hot->readValuePrefix(key, maxLength, debugID);
+		if(!coldFileContaining(key))
+			return hotValue;
+		return catchError(readValue_impl(this, key, hotValue, maxLength));
+	}
+
+	ACTOR static Future<Optional<Value>> readValue_impl(KeyValueStoreTiered* self, Key key, Future<Optional<Value>> hotValue, int maxLength) {
+		Optional<Value> v = wait(hotValue);
+		if(v.present())
+			return v;
+		state Optional<Value> cold;
+		loop {
+			// A migration which completes during the read may replace the file and forget its clears, so read again
+			state int64_t migrations = self->migrations;
+			state Reference<ColdFile> file = self->coldFileContaining(key);
+			if(!file)
+				return Optional<Value>();
+			++self->coldReads;
+			Optional<Value> c = wait(ColdFile::readValue(file, key));
+			cold = c;
+			if(self->migrations == migrations)
+				break;
+			TEST(true); // Tiered store point read raced with a migration
+		}
+		if(!cold.present() || self->cleared[key])
+			return Optional<Value>();
+		if(maxLength >= 0 && cold.get().size() > maxLength)
+			return Value(cold.get().substr(0, maxLength), cold.get().arena());
+		return cold;
+	}
+
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRange(KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30) {
+		keys = keys & KeyRangeRef(KeyRef(), tieredMetadataKeys.begin);
+		if(keys.empty())
+			return Standalone<VectorRef<KeyValueRef>>();
+		bool cold = false;
+		for(auto f : coldFiles.intersectingRanges(keys & allKeys)) {
+			if(f.value()) {
+				cold = true;
+				break;
+			}
+		}
+		if(!cold)
+			return hot->readRange(keys, rowLimit, byteLimit);
+		return catchError(readRange_impl(this, keys, rowLimit, byteLimit));
+	}
+
+	// Returns the part of keys at its beginning (or end, if !forward) which is either only in the hot tier, or in one
+	// cold file, which is returned in *file
+	KeyRange nextPiece(KeyRangeRef keys, bool forward, Reference<ColdFile>* file) {
+		if(forward) {
+			if(keys.begin >= allKeys.end) {
+				*file = Reference<ColdFile>();
+				return keys;
+			}
+			auto r = coldFiles.rangeContaining(keys.begin);
+			*file = r.value();
+			return KeyRangeRef(keys.begin, !*file && r.end() == allKeys.end ? keys.end : std::min<KeyRef>(r.end(), keys.end));
+		}
+		if(keys.end > allKeys.end) {
+			*file = Reference<ColdFile>();
+			return KeyRangeRef(std::max(keys.begin, allKeys.end), keys.end);
+		}
+		auto r = coldFiles.rangeContainingKeyBefore(keys.end);
+		*file = r.value();
+		return KeyRangeRef(std::max<KeyRef>(r.begin(), keys.begin), keys.end);
+	}
+
+	// Reads keys piece by piece in the direction of the read.  Pieces in the hot tier are read from the hot store.
+	// Pieces in a cold file are read from both the hot store and the file and merged, and if either read stopped at its
+	// limits before the end of the piece, the rest of the piece is read again from after the last merged key.
+	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> readRange_impl(KeyValueStoreTiered* self, KeyRange keys, int rowLimit, int byteLimit) {
+		state Standalone<VectorRef<KeyValueRef>> result;
+		state int accumulatedBytes = 0;
+		state bool forward = rowLimit >= 0;
+		state int rowsLeft = std::abs(rowLimit);
+		state KeyRange remaining = keys;
+		state Reference<ColdFile> file;
+		state KeyRange piece;
+		state Future<Standalone<VectorRef<KeyValueRef>>> hotRows;
+		state std::pair<Standalone<VectorRef<KeyValueRef>>, bool> coldRows;
+		state int64_t migrations;
+
+		ASSERT(byteLimit > 0);
+		while(rowsLeft > 0 && accumulatedBytes < byteLimit && !remaining.empty()) {
+			migrations = self->migrations;
+			piece = self->nextPiece(remaining, forward, &file);
+			hotRows = self->hot->readRange(piece, forward ? rowsLeft : -rowsLeft, byteLimit - accumulatedBytes);
+			if(file) {
+				++self->coldReads;
+				std::pair<Standalone<VectorRef<KeyValueRef>>, bool> c = wait(ColdFile::readRange(file, piece, forward ? rowsLeft : -rowsLeft, byteLimit - accumulatedBytes));
+				coldRows = c;
+			}
+			Standalone<VectorRef<KeyValueRef>> h = wait(hotRows);
+
+			// A migration which completed during the reads may have moved the piece's rows between the tiers, or replaced
+			// its file and forgotten the clears of it, so the piece is read again
+			if(self->migrations != migrations) {
+				TEST(true); // Tiered store range read raced with a migration
+				continue;
+			}
+
+			if(!file) {
+				// The hot store applied the limits, so either they are reached or the piece is done
+				result.arena().dependsOn(h.arena());
+				for(auto& kv : h) {
+					result.push_back(result.arena(), kv);
+					accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
+				}
+				rowsLeft -= h.size();
+				remaining = forward ? KeyRangeRef(piece.end, remaining.end) : KeyRangeRef(remaining.begin, piece.begin);
+				continue;
+			}
+
+			// Each source has every row of the piece up to its last row, or all of them if it wasn't truncated
+			int hotBytes = 0;
+			for(auto& kv : h)
+				hotBytes += sizeof(KeyValueRef) + kv.expectedSize();
+			bool hotTruncated = h.size() == rowsLeft || hotBytes >= byteLimit - accumulatedBytes;
+			Optional<Key> bound;
+			if(hotTruncated && h.size())
+				bound = h.back().key;
+			if(coldRows.second && coldRows.first.size() && (!bound.present() || (forward ? coldRows.first.back().key < bound.get() : coldRows.first.back().key > bound.get())))
+				bound = coldRows.first.back().key;
+
+			result.arena().dependsOn(h.arena());
+			result.arena().dependsOn(coldRows.first.arena());
+			const KeyValueRef* hi = h.begin();
+			const KeyValueRef* ci = coldRows.first.begin();
+			bool fwd = forward;
+			auto before = [fwd](KeyRef a, KeyRef b) { return fwd ? a < b : a > b; };
+			while(rowsLeft > 0 && accumulatedBytes < byteLimit) {
+				bool hasHot = hi != h.end() && (!bound.present() || !before(bound.get(), hi->key));
+				bool hasCold = ci != coldRows.first.end() && (!bound.present() || !before(bound.get(), ci->key));
+				if(!hasHot && !hasCold)
+					break;
+				KeyValueRef kv;
+				if(hasHot && (!hasCold || !before(ci->key, hi->key))) {
+					if(hasCold && ci->key == hi->key)
+						++ci;
+					kv = *hi++;
+				} else {
+					kv = *ci++;
+					if(self->cleared[kv.key])
+						continue;
+				}
+				result.push_back(result.arena(), kv);
+				accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
+				--rowsLeft;
+			}
+
+			if(bound.present())
+				remaining = forward ? KeyRangeRef(keyAfter(bound.get()), remaining.end) : KeyRangeRef(remaining.begin, bound.get());
+			else
+				remaining = forward ? KeyRangeRef(piece.end, remaining.end) : KeyRangeRef(remaining.begin, piece.begin);
+		}
+		return result;
+	}
+
+	double maxWriteTime(KeyRangeRef keys) {
+		double t = 0;
+		for(auto w : writeTimes.intersectingRanges(keys))
+			t = std::max(t, w.value().time);
+		return t;
+	}
+
+	// Whether keys have not been written for TIERED_COLD_AGE, and the hot store has committed the last write to them
+	bool isQuiet(KeyRangeRef keys) {
+		double t = maxWriteTime(keys);
+		return t < committedBefore && now() - t >= SERVER_KNOBS->TIERED_COLD_AGE;
+	}
+
+	ACTOR static Future<Void> migrateColdData(KeyValueStoreTiered* self) {
+		loop {
+			wait(delay(SERVER_KNOBS->TIERED_MIGRATION_INTERVAL));
+			wait(migrationStep(self));
+		}
+	}
+
+	// Considers the next chunk of hot data or cold file for migration, and moves it to the cold tier if it is quiet.
+	// Hot data is considered in chunks of about TIERED_MIGRATION_BYTES, which are merged into the preceding cold file
+	// while it is smaller than TIERED_COLD_FILE_BYTES.  A cold file is rewritten if it has writes to merge.
+	ACTOR static Future<Void> migrationStep(KeyValueStoreTiered* self) {
+		state Key begin = self->migrationCursor < allKeys.end ? self->migrationCursor : Key();
+		state Reference<ColdFile> file = self->coldFiles[begin];
+		state KeyRange unit;
+		state std::vector<Reference<ColdFile>> replaced;
+
+		if(file) {
+			unit = file->range;
+			self->migrationCursor = unit.end;
+			if(!self->isQuiet(unit))
+				return Void();
+			Standalone<VectorRef<KeyValueRef>> hotRows = wait(self->hot->readRange(unit, 1));
+			// migrate() only notices writes made after it starts, so the file must still be quiet after the read
+			if(!self->isQuiet(unit))
+				return Void();
+			bool clears = false;
+			for(auto c : self->cleared.intersectingRanges(unit))
+				clears = clears || c.value();
+			if(!hotRows.size() && !clears)
+				return Void();
+			replaced.push_back(file);
+		} else {
+			state Key gapEnd = self->coldFiles.rangeContaining(begin).end();
+			auto w = self->writeTimes.rangeContaining(begin);
+			if(w.value().chunk && w.begin() == begin && !self->isQuiet(w.range())) {
+				self->migrationCursor = std::min(w.end(), gapEnd);
+				return Void();
+			}
+
+			Standalone<VectorRef<KeyValueRef>> rows = wait(self->hot->readRange(KeyRangeRef(begin, gapEnd), 1<<30, SERVER_KNOBS->TIERED_MIGRATION_BYTES));
+			int bytes = 0;
+			for(auto& kv : rows)
+				bytes += sizeof(KeyValueRef) + kv.expectedSize();
+			unit = KeyRangeRef(begin, bytes >= SERVER_KNOBS->TIERED_MIGRATION_BYTES ? keyAfter(rows.back().key) : gapEnd);
+			self->migrationCursor = unit.end;
+			self->writeTimes.insert(unit, WriteTime(self->maxWriteTime(unit), true));
+			if(!rows.size() || !self->isQuiet(unit))
+				return Void();
+
+			if(begin > allKeys.begin) {
+				auto p = self->coldFiles.rangeContainingKeyBefore(begin);
+				if(p.value() && p.value()->dataBytes < SERVER_KNOBS->TIERED_COLD_FILE_BYTES && self->isQuiet(p.range())) {
+					replaced.push_back(p.value());
+					unit = KeyRangeRef(p.begin(), unit.end);
+				}
+			}
+		}
+
+		wait(migrate(self, unit, replaced));
+		return Void();
+	}
+
+	// Writes the rows of unit, which is quiet, to new cold files which replace the hot copy and the given cold files
+	// (which are all within unit).  Abandons the new files if unit is written before they are complete.
+	ACTOR static Future<Void> migrate(KeyValueStoreTiered* self, KeyRange unit, std::vector<Reference<ColdFile>> replaced) {
+		state double writeTime = self->maxWriteTime(unit);
+		state std::vector<Reference<ColdFileBuilder>> builders;
+		state std::vector<UID> ids;
+		state std::vector<Key> begins;
+		state Key hotBegin = unit.begin;
+		state Standalone<VectorRef<KeyValueRef>> hotRows;
+		state int hotIndex = 0;
+		state bool hotDone = false;
+		state int replacedIndex = 0;
+		state int block = 0;
+		state Standalone<VectorRef<KeyValueRef>> coldRows;
+		state int coldIndex = 0;
+		state KeyValueRef kv;
+		state std::vector<Future<Reference<ColdFile>>> opens;
+		state int64_t bytes = 0;
+
+		TraceEvent("TieredMigrationStart", self->logID).detail("Begin", unit.begin).detail("End", unit.end).detail("ReplacedFiles", replaced.size());
+		try {
+			loop {
+				if(!hotDone && hotIndex == hotRows.size()) {
+					Standalone<VectorRef<KeyValueRef>> rows = wait(self->hot->readRange(KeyRangeRef(hotBegin, unit.end), 1<<30, SERVER_KNOBS->TIERED_MIGRATION_BYTES));
+					hotRows = rows;
+					hotIndex = 0;
+					hotDone = rows.empty();
+					if(!hotDone)
+						hotBegin = keyAfter(rows.back().key);
+					continue;
+				}
+				if(replacedIndex < replaced.size() && coldIndex == coldRows.size()) {
+					if(block == replaced[replacedIndex]->blocks.size()) {
+						++replacedIndex;
+						block = 0;
+					} else {
+						Standalone<VectorRef<KeyValueRef>> rows = wait(ColdFile::readBlock(replaced[replacedIndex], block++));
+						coldRows = rows;
+						coldIndex = 0;
+					}
+					continue;
+				}
+
+				bool hasHot = hotIndex < hotRows.size(), hasCold = coldIndex < coldRows.size();
+				if(!hasHot && !hasCold)
+					break;
+				if(hasHot && (!hasCold || hotRows[hotIndex].key <= coldRows[coldIndex].key)) {
+					if(hasCold && coldRows[coldIndex].key == hotRows[hotIndex].key)
+						++coldIndex;
+					kv = hotRows[hotIndex++];
+				} else {
+					kv = coldRows[coldIndex++];
+					if(self->cleared[kv.key])
+						continue;
+				}
+
+				if(!builders.size() || builders.back()->dataBytes >= SERVER_KNOBS->TIERED_COLD_FILE_BYTES) {
+					if(builders.size())
+						wait(ColdFileBuilder::finish(builders.back()));
+					ids.push_back(deterministicRandom()->randomUniqueID());
+					begins.push_back(builders.size() ? Key(kv.key) : unit.begin);
+					Reference<IAsyncFile> f = wait(IAsyncFileSystem::filesystem()->open(self->coldFilename(ids.back()),
+						IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_UNCACHED, 0600));
+					builders.push_back(Reference<ColdFileBuilder>(new ColdFileBuilder(f, SERVER_KNOBS->TIERED_COLD_BLOCK_BYTES, SERVER_KNOBS->TIERED_COLD_COMPRESSION_LEVEL)));
+				}
+				builders.back()->add(kv);
+				if(builders.back()->blockFull())
+					wait(builders.back()->flushBlock());
+			}
+
+			if(builders.size())
+				wait(ColdFileBuilder::finish(builders.back()));
+			for(int i = 0; i < builders.size(); i++) {
+				bytes += builders[i]->dataBytes;
+				builders[i]->file = Reference<IAsyncFile>();
+				opens.push_back(ColdFile::open(ids[i], self->coldFilename(ids[i])));
+			}
+			wait(waitForAll(opens));
+		} catch(Error& e) {
+			if(e.code() != error_code_actor_cancelled) {
+				for(auto& id : ids)
+					self->fileDeletes.add(ready(IAsyncFileSystem::filesystem()->deleteFile(self->coldFilename(id), false)));
+			}
+			throw;
+		}
+
+		if(self->maxWriteTime(unit) > writeTime) {
+			TEST(true); // Tiered store migration abandoned after a write
+			++self->abandonedMigrations;
+			for(auto& id : ids)
+				self->fileDeletes.add(ready(IAsyncFileSystem::filesystem()->deleteFile(self->coldFilename(id), false)));
+			return Void();
+		}
+
+		// The hot copy and the replaced files are dropped by the next commit, which makes the new files part of the store
+		self->hot->clear(unit);
+		self->hot->clear(KeyRangeRef(coldClearKey(unit.begin), coldClearKey(unit.end)));
+		self->clearRecords.erase(self->clearRecords.lower_bound(unit.begin), self->clearRecords.lower_bound(unit.end));
+		self->cleared.insert(unit, false);
+		self->cleared.coalesce(KeyRangeRef(unit));
+		for(auto& f : replaced) {
+			self->hot->clear(singleKeyRange(coldFileKey(f->range.begin)));
+			--self->coldFileCount;
+			self->coldFileBytes -= f->fileBytes;
+			self->coldDataBytes -= f->dataBytes;
+		}
+		self->coldFiles.insert(unit, Reference<ColdFile>());
+		for(int i = 0; i < opens.size(); i++) {
+			Reference<ColdFile> f = opens[i].get();
+			f->range = KeyRangeRef(begins[i], i + 1 < begins.size() ? begins[i + 1] : unit.end);
+			self->hot->set(KeyValueRef(coldFileKey(f->range.begin), BinaryWriter::toValue(ColdFileInfo(f->range.end, f->id), IncludeVersion())));
+			self->coldFiles.insert(f->range, f);
+			++self->coldFileCount;
+			self->coldFileBytes += f->fileBytes;
+			self->coldDataBytes += f->dataBytes;
+		}
+		self->coldFiles.coalesce(KeyRangeRef(unit));
+		self->obsoleteFiles.insert(self->obsoleteFiles.end(), replaced.begin(), replaced.end());
+		++self->migrations;
+		self->migratedBytes += bytes;
+
+		TEST(replaced.size()); // Tiered store rewrote a cold file
+		TEST(opens.empty()); // Tiered store dropped a cold file with no remaining data
+		TEST(opens.size() > 1); // Tiered store migration split into several cold files
+		TraceEvent("TieredMigrationComplete", self->logID).detail("Begin", unit.begin).detail("End", unit.end).detail("Files", opens.size()).detail("Bytes", bytes);
+		return Void();
+	}
+
+	// Deletes the cold files (and partially written cold files) which are not in keep
+	ACTOR static Future<Void> deleteColdFiles(KeyValueStoreTiered* self, std::set<UID> keep) {
+		state std::vector<Future<Void>> deletes;
+		std::string directory = parentDirectory(self->filePrefix);
+		std::string prefix = basename(self->filePrefix) + "-cold-";
+		for(auto& name : platform::listFiles(directory)) {
+			if(name.size() < prefix.size() + 32 || name.compare(0, prefix.size(), prefix) != 0)
+				continue;
+			if(keep.count(UID::fromString(name.substr(prefix.size(), 32))) && name.size() == prefix.size() + 32)
+				continue;
+			TraceEvent("TieredDeleteColdFile", self->logID).detail("Filename", name);
+			deletes.push_back(IAsyncFileSystem::filesystem()->deleteFile(joinPath(directory, name), false));
+		}
+		wait(waitForAll(deletes));
+		return Void();
+	}
+
+	ACTOR static Future<Void> init_impl(KeyValueStoreTiered* self) {
+		state Standalone<VectorRef<KeyValueRef>> files;
+		state std::vector<Future<Reference<ColdFile>>> opens;
+		state std::vector<KeyRange> ranges;
+		state std::set<UID> ids;
+
+		TraceEvent("TieredInit", self->logID).detail("FilePrefix", self->filePrefix);
+		wait(self->hot->init());
+
+		Standalone<VectorRef<KeyValueRef>> f = wait(self->hot->readRange(prefixRange(coldFilePrefix)));
+		files = f;
+		for(auto& kv : files) {
+			ColdFileInfo info = BinaryReader::fromStringRef<ColdFileInfo>(kv.value, IncludeVersion());
+			ranges.push_back(KeyRangeRef(kv.key.removePrefix(coldFilePrefix), info.end));
+			ids.insert(info.id);
+			opens.push_back(ColdFile::open(info.id, self->coldFilename(info.id)));
+		}
+		wait(waitForAll(opens));
+		for(int i = 0; i < opens.size(); i++) {
+			Reference<ColdFile> file = opens[i].get();
+			file->range = ranges[i];
+			self->coldFiles.insert(file->range, file);
+			++self->coldFileCount;
+			self->coldFileBytes += file->fileBytes;
+			self->coldDataBytes += file->dataBytes;
+		}
+
+		Standalone<VectorRef<KeyValueRef>> clears = wait(self->hot->readRange(prefixRange(coldClearPrefix)));
+		for(auto& kv : clears) {
+			Key begin = kv.key.removePrefix(coldClearPrefix);
+			self->clearRecords[begin] = kv.value;
+			self->cleared.insert(KeyRangeRef(begin, kv.value), true);
+		}
+		self->cleared.coalesce(allKeys);
+
+		wait(deleteColdFiles(self, ids));
+
+		self->committedBefore = now();
+		self->migration = self->catchError(migrateColdData(self));
+		self->logging = logPeriodically(self);
+		TraceEvent("TieredInitComplete", self->logID).detail("ColdFiles", self->coldFileCount).detail("ColdFileBytes", self->coldFileBytes).detail("ColdDataBytes", self->coldDataBytes);
+		return Void();
+	}
+
+	ACTOR static Future<Void> logPeriodically(KeyValueStoreTiered* self) {
+		loop {
+			wait(delay(SERVER_KNOBS->DISK_METRIC_LOGGING_INTERVAL));
+			TraceEvent("TieredStorageMetrics", self->logID)
+				.detail("ColdFiles", self->coldFileCount)
+				.detail("ColdFileBytes", self->coldFileBytes)
+				.detail("ColdDataBytes", self->coldDataBytes)
+				.detail("ColdReads", self->coldReads)
+				.detail("Migrations", self->migrations)
+				.detail("AbandonedMigrations", self->abandonedMigrations)
+				.detail("MigratedBytes", self->migratedBytes);
+		}
+	}
+
+	ACTOR static void shutdown(KeyValueStoreTiered* self, bool dispose) {
+		TraceEvent("TieredShutdown", self->logID).detail("FilePrefix", self->filePrefix).detail("Dispose", dispose);
+		if(self->m_error.canBeSet()) {
+			self->m_error.sendError(actor_cancelled());  // Ideally this should be shutdown_in_progress
+		}
+		self->m_init.cancel();
+		self->migration.cancel();
+		self->logging.cancel();
+		self->fileDeletes.clear();
+		self->coldFiles.insert(allKeys, Reference<ColdFile>());
+		self->obsoleteFiles.clear();
+
+		state Future<Void> closed = self->hot->onClosed();
+		if(dispose)
+			self->hot->dispose();
+		else
+			self->hot->close();
+		wait(closed);
+		if(dispose)
+			wait(deleteColdFiles(self, std::set<UID>()));
+
+		self->m_closed.send(Void());
+		TraceEvent("TieredShutdownComplete", self->logID).detail("FilePrefix", self->filePrefix).detail("Dispose", dispose);
+		delete self;
+	}
+};
+
+IKeyValueStore* keyValueStoreTiered(IKeyValueStore* hot, std::string const& filePrefix, UID logID) {
+	return new KeyValueStoreTiered(hot, filePrefix, logID);
+}
+
+TEST_CASE("/fdbserver/KeyValueStoreTiered/ColdFile") {
+	state std::string filename = "unittest_coldfile";
+	state std::map<std::string, std::string> rows;
+	state int blockBytes = deterministicRandom()->randomInt(1, 2000);
+	state int i;
+
+	for(i = 0; i < 1000; i++)
+		rows[format("key%06d", deterministicRandom()->randomInt(0, 100000))] = std::string(deterministicRandom()->randomInt(0, 100), 'v');
+
+	state Reference<IAsyncFile> f = wait(IAsyncFileSystem::filesystem()->open(filename,
+		IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_UNCACHED, 0600));
+	state Reference<ColdFileBuilder> builder(new ColdFileBuilder(f, blockBytes, deterministicRandom()->randomInt(0, 10)));
+	state std::map<std::string, std::string>::iterator r;
+	for(r = rows.begin(); r != rows.end(); ++r) {
+		builder->add(KeyValueRef(StringRef(r->first), StringRef(r->second)));
+		if(builder->blockFull())
+			wait(builder->flushBlock());
+	}
+	wait(ColdFileBuilder::finish(builder));
+	builder = Reference<ColdFileBuilder>();
+	f = Reference<IAsyncFile>();
+
+	state Reference<ColdFile> file = wait(ColdFile::open(UID(), filename));
+	for(i = 0; i < 100; i++) {
+		state Key key = StringRef(format("key%06d", deterministicRandom()->randomInt(0, 100000)));
+		Optional<Value> v = wait(ColdFile::readValue(file, key));
+		auto expected = rows.find(key.toString());
+		ASSERT(v.present() == (expected != rows.end()));
+		ASSERT(!v.present() || v.get() == StringRef(expected->second));
+	}
+
+	for(i = 0; i < 100; i++) {
+		state Key begin = StringRef(format("key%06d", deterministicRandom()->randomInt(0, 100000)));
+		state Key end = StringRef(format("key%06d", deterministicRandom()->randomInt(0, 100000)));
+		state int rowLimit = deterministicRandom()->randomInt(1, 100) * (deterministicRandom()->coinflip() ? 1 : -1);
+		if(end < begin)
+			std::swap(begin, end);
+		std::pair<Standalone<VectorRef<KeyValueRef>>, bool> result = wait(ColdFile::readRange(file, KeyRangeRef(begin, end), rowLimit, 1<<30));
+		std::vector<std::pair<std::string, std::string>> expected(rows.lower_bound(begin.toString()), rows.lower_bound(end.toString()));
+		if(rowLimit < 0)
+			std::reverse(expected.begin(), expected.end());
+		ASSERT(result.first.size() == std::min<int>(expected.size(), std::abs(rowLimit)));
+		ASSERT(result.second || result.first.size() == expected.size());
+		for(int j = 0; j < result.first.size(); j++)
+			ASSERT(result.first[j].key == StringRef(expected[j].first) && result.first[j].value == StringRef(expected[j].second));
+	}
+
+	file = Reference<ColdFile>();
+	wait(IAsyncFileSystem::filesystem()->deleteFile(filename, true));
+	return Void();
+}
+
+// Applies random sets and clears to a tiered store whose knobs move data to the cold tier as soon as it is committed, and
+// checks its reads against a model of its contents after each commit and after it is reopened.
+TEST_CASE("/fdbserver/KeyValueStoreTiered/model") {
+	state std::string filename = "unittest_tiered";
+	state ServerKnobs* knobs = const_cast<ServerKnobs*>(SERVER_KNOBS);
+	state double coldAge = knobs->TIERED_COLD_AGE;
+	state double migrationInterval = knobs->TIERED_MIGRATION_INTERVAL;
+	state int migrationBytes = knobs->TIERED_MIGRATION_BYTES;
+	state int64_t coldFileBytes = knobs->TIERED_COLD_FILE_BYTES;
+	state int coldBlockBytes = knobs->TIERED_COLD_BLOCK_BYTES;
+	knobs->TIERED_COLD_AGE = 0;
+	knobs->TIERED_MIGRATION_INTERVAL = 0.001;
+	knobs->TIERED_MIGRATION_BYTES = deterministicRandom()->randomInt(100, 2000);
+	knobs->TIERED_COLD_FILE_BYTES = deterministicRandom()->randomInt(1000, 10000);
+	knobs->TIERED_COLD_BLOCK_BYTES = deterministicRandom()->randomInt(1, 1000);
+
+	deleteFile(filename);
+	deleteFile(filename + "-wal");
+	state IKeyValueStore* store = openKVStore(KeyValueStoreType::SSD_TIERED_V1, filename, UID(), 0);
+	wait(store->init());
+
+	state std::map<std::string, std::string> rows;
+	state int64_t maxColdFiles = 0;
+	state int commits;
+	state int i;
+
+	for(commits = 0; commits < 100; commits++) {
+		for(i = deterministicRandom()->randomInt(1, 50); i; i--) {
+			int k = deterministicRandom()->randomInt(0, 1000);
+			std::string key = format("key%05d", k);
+			if(deterministicRandom()->random01() < 0.1) {
+				std::string end = format("key%05d", k + deterministicRandom()->randomInt(1, 100));
+				store->clear(KeyRangeRef(key, end));
+				rows.erase(rows.lower_bound(key), rows.lower_bound(end));
+			} else {
+				std::string value(deterministicRandom()->randomInt(0, 100), 'a' + deterministicRandom()->randomInt(0, 26));
+				store->set(KeyValueRef(key, value));
+				rows[key] = value;
+			}
+		}
+		wait(store->commit());
+
+		// Give the migration time to move some of the committed data to cold files
+		wait(delay(deterministicRandom()->random01() * 0.05));
+		maxColdFiles = std::max(maxColdFiles, ((KeyValueStoreTiered*)store)->coldFileCount);
+
+		// Recovery restores the cold files and the clears of their data from the hot store
+		if(deterministicRandom()->random01() < 0.1) {
+			state Future<Void> closed = store->onClosed();
+			store->close();
+			wait(closed);
+			store = openKVStore(KeyValueStoreType::SSD_TIERED_V1, filename, UID(), 0);
+			wait(store->init());
+		}
+
+		Standalone<VectorRef<KeyValueRef>> all = wait(store->readRange(allKeys));
+		ASSERT(all.size() == rows.size());
+		auto row = rows.begin();
+		for(auto& kv : all) {
+			ASSERT(kv.key == StringRef(row->first) && kv.value == StringRef(row->second));
+			++row;
+		}
+
+		for(i = 0; i < 10; i++) {
+			state Key key = StringRef(format("key%05d", deterministicRandom()->randomInt(0, 1100)));
+			state int maxLength = deterministicRandom()->randomInt(0, 100);
+			state Optional<Value> v = wait(store->readValue(key));
+			Optional<Value> prefix = wait(store->readValuePrefix(key, maxLength));
+			auto expected = rows.find(key.toString());
+			ASSERT(v.present() == (expected != rows.end()) && prefix.present() == v.present());
+			// A prefix read may return more than maxLength bytes (SQLite returns whole fragmented values), but never fewer
+			ASSERT(!v.present() || (v.get() == StringRef(expected->second) && v.get().startsWith(prefix.get()) && prefix.get().size() >= std::min(maxLength, v.get().size())));
+
+			state Key begin = StringRef(format("key%05d", deterministicRandom()->randomInt(0, 1100)));
+			state Key end = StringRef(format("key%05d", deterministicRandom()->randomInt(0, 1100)));
+			state int rowLimit = deterministicRandom()->randomInt(1, 100) * (deterministicRandom()->coinflip() ? 1 : -1);
+			if(end < begin)
+				std::swap(begin, end);
+			Standalone<VectorRef<KeyValueRef>> result = wait(store->readRange(KeyRangeRef(begin, end), rowLimit));
+			std::vector<std::pair<std::string, std::string>> expectedRange(rows.lower_bound(begin.toString()), rows.lower_bound(end.toString()));
+			if(rowLimit < 0)
+				std::reverse(expectedRange.begin(), expectedRange.end());
+			ASSERT(result.size() == std::min<int>(expectedRange.size(), std::abs(rowLimit)));
+			for(int j = 0; j < result.size(); j++)
+				ASSERT(result[j].key == StringRef(expectedRange[j].first) && result[j].value == StringRef(expectedRange[j].second));
+		}
+	}
+	ASSERT(maxColdFiles > 0);
+
+	state Future<Void> disposed = store->onClosed();
+	store->dispose();
+	wait(disposed);
+	knobs->TIERED_COLD_AGE = coldAge;
+	knobs->TIERED_MIGRATION_INTERVAL = migrationInterval;
+	knobs->TIERED_MIGRATION_BYTES = migrationBytes;
+	knobs->TIERED_COLD_FILE_BYTES = coldFileBytes;
+	knobs->TIERED_COLD_BLOCK_BYTES = coldBlockBytes;
+	return Void();
+}
@@ -65,6 +65,8 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( TLOG_MESSAGE_BLOCK_OVERHEAD_FACTOR,      double(TLOG_MESSAGE_BLOCK_BYTES) / (TLOG_MESSAGE_BLOCK_BYTES - MAX_MESSAGE_SIZE) ); //1.0121466709838096006362758832473
 	init( PEEK_TRACKER_EXPIRATION_TIME,                          600 ); if( randomize && BUGGIFY ) PEEK_TRACKER_EXPIRATION_TIME = deterministicRandom()->coinflip() ? 0.1 : 60;
 	init( PARALLEL_GET_MORE_REQUESTS,                             32 ); if( randomize && BUGGIFY ) PARALLEL_GET_MORE_REQUESTS = 2;
+	init( PEEK_USING_STREAMING,                                false ); if( randomize && BUGGIFY ) PEEK_USING_STREAMING = true;
+	init( TLOG_PEEK_STREAM_WINDOW,                                 8 ); if( randomize && BUGGIFY ) TLOG_PEEK_STREAM_WINDOW = 1;
 	init( MULTI_CURSOR_PRE_FETCH_LIMIT,                           10 );
 	init( MAX_QUEUE_COMMIT_BYTES,                               15e6 ); if( randomize && BUGGIFY ) MAX_QUEUE_COMMIT_BYTES = 5000;
 	init( VERSIONS_PER_BATCH,                 VERSIONS_PER_SECOND/20 ); if( randomize && BUGGIFY ) VERSIONS_PER_BATCH = std::max<int64_t>(1,VERSIONS_PER_SECOND/1000);
@@ -75,9 +77,17 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( TLOG_SPILL_REFERENCE_MAX_PEEK_MEMORY_BYTES,            2e9 ); if ( randomize && BUGGIFY ) TLOG_SPILL_REFERENCE_MAX_PEEK_MEMORY_BYTES = 2e6;
 	init( TLOG_SPILL_REFERENCE_MAX_BATCHES_PER_PEEK,           100 ); if ( randomize && BUGGIFY ) TLOG_SPILL_REFERENCE_MAX_BATCHES_PER_PEEK = 1;
 	init( TLOG_SPILL_REFERENCE_MAX_BYTES_PER_BATCH,           16<<10 ); if ( randomize && BUGGIFY ) TLOG_SPILL_REFERENCE_MAX_BYTES_PER_BATCH = 500;
+	init( TLOG_COMPRESS_COMMITS,                               false ); if ( randomize && BUGGIFY ) TLOG_COMPRESS_COMMITS = true;
+	init( TLOG_COMPRESS_LOG_ROUTER_PEEKS,                      false ); if ( randomize && BUGGIFY ) TLOG_COMPRESS_LOG_ROUTER_PEEKS = true;
+	init( TLOG_COMPRESSION_MIN_BYTES,                           4096 ); if ( randomize && BUGGIFY ) TLOG_COMPRESSION_MIN_BYTES = 1;
+	init( TLOG_COMPRESSION_LEVEL,                                  1 ); if ( randomize && BUGGIFY ) TLOG_COMPRESSION_LEVEL = deterministicRandom()->randomInt(1, 10);
+	init( TLOG_SPILL_TAG_INDEX,                                 true ); if ( randomize && BUGGIFY ) TLOG_SPILL_TAG_INDEX = false;
 	init( DISK_QUEUE_FILE_EXTENSION_BYTES,                    10<<20 ); // BUGGIFYd per file within the DiskQueue
 	init( DISK_QUEUE_FILE_SHRINK_BYTES,                      100<<20 ); // BUGGIFYd per file within the DiskQueue
 	init( DISK_QUEUE_MAX_TRUNCATE_BYTES,                       2<<30 ); if ( randomize && BUGGIFY ) DISK_QUEUE_MAX_TRUNCATE_BYTES = 0;
+	init( DISK_QUEUE_RECOVERY_READ_BYTES,                      1<<20 ); // BUGGIFYd per read within the DiskQueue
+	init( DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES,               16<<20 ); if ( randomize && BUGGIFY ) DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES = deterministicRandom()->coinflip() ? 0 : 16384;
+	init( DISK_QUEUE_RECOVERY_CHECKSUM_THREADS,                    2 ); if ( randomize && BUGGIFY ) DISK_QUEUE_RECOVERY_CHECKSUM_THREADS = deterministicRandom()->randomInt(0, 3);
 	init( TLOG_DEGRADED_DELAY_COUNT,                               5 );
 	init( TLOG_DEGRADED_DURATION,                                5.0 );
 	init( TLOG_IGNORE_POP_AUTO_ENABLE_DELAY,                   300.0 );
@@ -199,6 +209,8 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	// Redwood Storage Engine
 	init( PREFIX_TREE_IMMEDIATE_KEY_SIZE_LIMIT,                   30 );
 	init( PREFIX_TREE_IMMEDIATE_KEY_SIZE_MIN,                     0 );
+	init( REDWOOD_RANGE_PREFETCH_PAGES,                           16 ); if( randomize && BUGGIFY ) REDWOOD_RANGE_PREFETCH_PAGES = deterministicRandom()->coinflip() ? 0 : 1;
+	init( REDWOOD_ROW_PREFETCH_BYTES_ESTIMATE,                   100 );
 
 	// KeyValueStore SQLITE
 	init( CLEAR_BUFFER_SIZE,                                   20000 );
@@ -215,6 +227,9 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SQLITE_BTREE_PAGE_USABLE,                          4096 - 8);  // pageSize - reserveSize for page checksum
 	init( SQLITE_CHUNK_SIZE_PAGES,                             25600 );  // 100MB
 	init( SQLITE_CHUNK_SIZE_PAGES_SIM,                          1024 );  // 4MB
+	init( SQLITE_PAGE_COMPRESSION_LEVEL,                           0 ); if( randomize && BUGGIFY ) SQLITE_PAGE_COMPRESSION_LEVEL = deterministicRandom()->randomInt(1, 10);
+	init( SQLITE_COMPRESSED_PAGE_SIZE,                         16384 );  // Must be a power of two larger than _PAGE_SIZE
+	init( SQLITE_READAHEAD_PAGES,                                 16 ); if( randomize && BUGGIFY ) SQLITE_READAHEAD_PAGES = deterministicRandom()->randomInt(0, 3);
 
 	// Maximum and minimum cell payload bytes allowed on primary page as calculated in SQLite.
 	// These formulas are copied from SQLite, using its hardcoded constants, so if you are
@@ -250,9 +265,24 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SPRING_CLEANING_LAZY_DELETE_BATCH_SIZE,                100 ); if( randomize && BUGGIFY ) SPRING_CLEANING_LAZY_DELETE_BATCH_SIZE = deterministicRandom()->randomInt(1, 1000);
 	init( SPRING_CLEANING_MIN_VACUUM_PAGES,                        1 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MIN_VACUUM_PAGES = deterministicRandom()->randomInt(0, 100);
 	init( SPRING_CLEANING_MAX_VACUUM_PAGES,                      1e9 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MAX_VACUUM_PAGES = deterministicRandom()->coinflip() ? 0 : deterministicRandom()->randomInt(1, 1e4);
+	init( SPRING_CLEANING_RECLAIM_PAGES_PER_SECOND,             2500 ); if( randomize && BUGGIFY ) SPRING_CLEANING_RECLAIM_PAGES_PER_SECOND = deterministicRandom()->coinflip() ? 0 : deterministicRandom()->random01() * 1e5;
+	init( SPRING_CLEANING_FREE_PAGE_RELEASE_INTERVAL,           10.0 ); if( randomize && BUGGIFY ) SPRING_CLEANING_FREE_PAGE_RELEASE_INTERVAL = deterministicRandom()->coinflip() ? 0 : deterministicRandom()->random01();
+	init( SPRING_CLEANING_FREE_PAGE_RELEASE_MAX_RUNS,           1000 ); if( randomize && BUGGIFY ) SPRING_CLEANING_FREE_PAGE_RELEASE_MAX_RUNS = deterministicRandom()->randomInt(1, 10);
 
 	// KeyValueStoreMemory
 	init( REPLACE_CONTENTS_BYTES,                                1e5 );
+	init( KVSTORE_MEMORY_COMPACT_INDEX,                        false ); if( randomize && BUGGIFY ) KVSTORE_MEMORY_COMPACT_INDEX = true;
+	init( KVSTORE_MEMORY_COMPACT_BLOCK_BYTES,                   1024 ); if( randomize && BUGGIFY ) KVSTORE_MEMORY_COMPACT_BLOCK_BYTES = deterministicRandom()->randomInt(16, 256);
+	init( KVSTORE_MEMORY_PARALLEL_SNAPSHOT,                    false ); if( randomize && BUGGIFY ) KVSTORE_MEMORY_PARALLEL_SNAPSHOT = true;
+	init( KVSTORE_MEMORY_SNAPSHOT_CHUNK_BYTES,                   1e6 ); if( randomize && BUGGIFY ) KVSTORE_MEMORY_SNAPSHOT_CHUNK_BYTES = deterministicRandom()->randomInt(1, 1000);
+
+	// KeyValueStoreTiered
+	init( TIERED_COLD_AGE,                                    3600.0 ); if( randomize && BUGGIFY ) TIERED_COLD_AGE = deterministicRandom()->random01() * 10;
+	init( TIERED_MIGRATION_INTERVAL,                            10.0 ); if( randomize && BUGGIFY ) TIERED_MIGRATION_INTERVAL = deterministicRandom()->random01();
+	init( TIERED_MIGRATION_BYTES,                                1e7 ); if( randomize && BUGGIFY ) TIERED_MIGRATION_BYTES = deterministicRandom()->randomInt(100, 10000);
+	init( TIERED_COLD_FILE_BYTES,                          256 << 20 ); if( randomize && BUGGIFY ) TIERED_COLD_FILE_BYTES = deterministicRandom()->randomInt(1000, 100000);
+	init( TIERED_COLD_BLOCK_BYTES,                           64 << 10 ); if( randomize && BUGGIFY ) TIERED_COLD_BLOCK_BYTES = deterministicRandom()->randomInt(1, 1000);
+	init( TIERED_COLD_COMPRESSION_LEVEL,                           6 ); if( randomize && BUGGIFY ) TIERED_COLD_COMPRESSION_LEVEL = deterministicRandom()->randomInt(0, 10);
 
 	// Leader election
 	bool longLeaderElection = randomize && BUGGIFY;
@@ -283,6 +313,7 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( COMMIT_BATCHES_MEM_BYTES_HARD_LIMIT,              8LL << 30 ); if (randomize && BUGGIFY) COMMIT_BATCHES_MEM_BYTES_HARD_LIMIT = deterministicRandom()->randomInt64(100LL << 20,  8LL << 30);
 	init( COMMIT_BATCHES_MEM_FRACTION_OF_TOTAL,                   0.5 );
 	init( COMMIT_BATCHES_MEM_TO_TOTAL_MEM_SCALE_FACTOR,          10.0 );
+	init( MAX_COMMIT_BATCHES_IN_PIPELINE,                          64 ); if( randomize && BUGGIFY ) MAX_COMMIT_BATCHES_IN_PIPELINE = deterministicRandom()->randomInt(1, 4);
 
 	// these settings disable batch bytes scaling.  Try COMMIT_TRANSACTION_BATCH_BYTES_MAX=1e6, COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE=50000, COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER=0.5?
 	init( COMMIT_TRANSACTION_BATCH_BYTES_MIN,                  100000 );
@@ -290,6 +321,14 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE,           100000 );
 	init( COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER,             0.0 );
 
+	init( ADAPTIVE_COMMIT_BATCHING,                             false ); if( randomize && BUGGIFY ) ADAPTIVE_COMMIT_BATCHING = true;
+	init( ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY,              0.050 ); if( randomize && BUGGIFY ) ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY = deterministicRandom()->random01() * 0.5;
+	init( ADAPTIVE_COMMIT_BATCHING_WINDOW,                        1.0 );
+	init( ADAPTIVE_COMMIT_BATCHING_QUEUING_FRACTION,              0.1 );
+	init( ADAPTIVE_COMMIT_BATCHING_STEP,                         0.05 ); if( randomize && BUGGIFY ) ADAPTIVE_COMMIT_BATCHING_STEP = 0.5;
+	init( ADAPTIVE_COMMIT_BATCHING_MIN_BYTES,                   10000 );
+	init( ADAPTIVE_COMMIT_BATCHING_MAX_BYTES,                 1000000 ); if( randomize && BUGGIFY ) ADAPTIVE_COMMIT_BATCHING_MAX_BYTES = ADAPTIVE_COMMIT_BATCHING_MIN_BYTES;
+
 	init( TRANSACTION_BUDGET_TIME,							   0.050 ); if( randomize && BUGGIFY ) TRANSACTION_BUDGET_TIME = 0.0;
 	init( RESOLVER_COALESCE_TIME,                                1.0 );
 	init( BUGGIFIED_ROW_LIMIT,                  APPLY_MUTATION_BYTES ); if( randomize && BUGGIFY ) BUGGIFIED_ROW_LIMIT = deterministicRandom()->randomInt(3, 30);
@@ -324,6 +363,9 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SAMPLE_EXPIRATION_TIME,                                1.0 );
 	init( SAMPLE_POLL_TIME,                                      0.1 );
 	init( RESOLVER_STATE_MEMORY_LIMIT,                           1e6 );
+	init( CONFLICT_SET_THREADS,                                    0 ); // 0 or 1 runs conflict detection serially on the resolver's network thread; ignored in simulation
+	init( CONFLICT_SET_PARALLEL_MIN_RANGES,                     1000 ); // Batches with fewer conflict ranges than this are resolved serially even when CONFLICT_SET_THREADS > 1
+	init( CONFLICT_SET_TYPE,                              "skiplist" ); if( randomize && BUGGIFY ) CONFLICT_SET_TYPE = "btree"; // "skiplist" or "btree"
 	init( LAST_LIMITED_RATIO,                                    0.6 );
 
 	//Cluster Controller
@@ -441,6 +483,13 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( FETCH_BLOCK_BYTES,                                     2e6 );
 	init( FETCH_KEYS_PARALLELISM_BYTES,                          4e6 ); if( randomize && BUGGIFY ) FETCH_KEYS_PARALLELISM_BYTES = 3e6;
 	init( FETCH_KEYS_LOWER_PRIORITY,                               0 );
+	init( BULK_INGEST_RETRY_DELAY,                              10.0 ); if( randomize && BUGGIFY ) BULK_INGEST_RETRY_DELAY = 1.0;
+	init( RANGE_STREAM_CHUNK_BYTES,                            80000 ); if( randomize && BUGGIFY ) RANGE_STREAM_CHUNK_BYTES = 1000;
+	init( RANGE_STREAM_WINDOW_BYTES,                             1e6 ); if( randomize && BUGGIFY ) RANGE_STREAM_WINDOW_BYTES = 1;
+	init( RANGE_FILTER_SCAN_BYTES,                               1e6 ); if( randomize && BUGGIFY ) RANGE_FILTER_SCAN_BYTES = 1000;
+	init( RANGE_AGGREGATE_SCAN_BYTES,                            1e7 ); if( randomize && BUGGIFY ) RANGE_AGGREGATE_SCAN_BYTES = 1000;
+	init( STORAGE_HOT_KEY_CACHE_BYTES,                           1e7 ); if( randomize && BUGGIFY ) STORAGE_HOT_KEY_CACHE_BYTES = deterministicRandom()->coinflip() ? 0 : 2000;
+	init( VERSIONED_STORAGE_LAG_VERSIONS,      1 * VERSIONS_PER_SECOND ); if( randomize && BUGGIFY ) VERSIONED_STORAGE_LAG_VERSIONS = deterministicRandom()->coinflip() ? 1 : 0.1 * VERSIONS_PER_SECOND;
 	init( BUGGIFY_BLOCK_BYTES,                                 10000 );
 	init( STORAGE_COMMIT_BYTES,                             10000000 ); if( randomize && BUGGIFY ) STORAGE_COMMIT_BYTES = 2000000;
 	init( STORAGE_DURABILITY_LAG_REJECT_THRESHOLD,              0.25 );
@@ -491,6 +540,7 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( FREE_PAGE_VACUUM_THRESHOLD,                              1 );
 	init( VACUUM_QUEUE_SIZE,                                  100000 );
 	init( VACUUM_BYTES_PER_SECOND,                               1e6 );
+	init( PAGER_CACHE_BYTES,                                     1e9 ); if( randomize && BUGGIFY ) PAGER_CACHE_BYTES = deterministicRandom()->coinflip() ? 0 : 1e5;
 
 	// Timekeeper
 	init( TIME_KEEPER_DELAY,                                      10 );
@@ -68,6 +68,8 @@ public:
 	int LOG_SYSTEM_PUSHED_DATA_BLOCK_SIZE;
 	double PEEK_TRACKER_EXPIRATION_TIME;
 	int PARALLEL_GET_MORE_REQUESTS;
+	bool PEEK_USING_STREAMING; // Storage servers subscribe to the current TLogs for their tag instead of polling them with peek requests
+	int TLOG_PEEK_STREAM_WINDOW; // Replies a TLog pushes to a peek stream ahead of those the cursor has acknowledged
 	int MULTI_CURSOR_PRE_FETCH_LIMIT;
 	int64_t MAX_QUEUE_COMMIT_BYTES;
 	int64_t VERSIONS_PER_BATCH;
@@ -78,9 +80,17 @@ public:
 	int64_t TLOG_SPILL_REFERENCE_MAX_PEEK_MEMORY_BYTES;
 	int64_t TLOG_SPILL_REFERENCE_MAX_BATCHES_PER_PEEK;
 	int64_t TLOG_SPILL_REFERENCE_MAX_BYTES_PER_BATCH;
+	bool TLOG_COMPRESS_COMMITS; // Proxies compress each TLog's share of a commit batch, which the TLog keeps compressed in its disk queue
+	bool TLOG_COMPRESS_LOG_ROUTER_PEEKS; // TLogs compress their replies to log routers, which usually read from another region
+	int TLOG_COMPRESSION_MIN_BYTES; // Batches of messages smaller than this are not compressed
+	int TLOG_COMPRESSION_LEVEL; // zlib compression level, from 1 (fastest) to 9 (smallest)
+	bool TLOG_SPILL_TAG_INDEX; // Store an index of each commit's messages by tag in the disk queue, for peeks of spilled data
 	int64_t DISK_QUEUE_FILE_EXTENSION_BYTES; // When we grow the disk queue, by how many bytes should it grow?
 	int64_t DISK_QUEUE_FILE_SHRINK_BYTES; // When we shrink the disk queue, by how many bytes should it shrink?
 	int DISK_QUEUE_MAX_TRUNCATE_BYTES;  // A truncate larger than this will cause the file to be replaced instead.
+	int DISK_QUEUE_RECOVERY_READ_BYTES; // Size of each read of the queue during recovery
+	int64_t DISK_QUEUE_RECOVERY_READ_AHEAD_BYTES; // Bytes of the queue that recovery reads ahead of the page being decoded
+	int DISK_QUEUE_RECOVERY_CHECKSUM_THREADS; // Threads checking page checksums during recovery, or 0 to check them when decoding
 	int TLOG_DEGRADED_DELAY_COUNT;
 	double TLOG_DEGRADED_DURATION;
 	double TXS_POPPED_MAX_DELAY;
@@ -161,6 +171,8 @@ public:
 	// Redwood Storage Engine
 	int PREFIX_TREE_IMMEDIATE_KEY_SIZE_LIMIT;
 	int PREFIX_TREE_IMMEDIATE_KEY_SIZE_MIN;
+	int REDWOOD_RANGE_PREFETCH_PAGES; // Range reads read ahead up to this many leaf pages
+	int REDWOOD_ROW_PREFETCH_BYTES_ESTIMATE; // Bytes of leaf page assumed per row when limiting read ahead by a row limit
 
 	// KeyValueStore SQLITE
 	int CLEAR_BUFFER_SIZE;
@@ -182,6 +194,9 @@ public:
 	double SQLITE_FRAGMENT_MIN_SAVINGS;
 	int SQLITE_CHUNK_SIZE_PAGES;
 	int SQLITE_CHUNK_SIZE_PAGES_SIM;
+	int SQLITE_PAGE_COMPRESSION_LEVEL; // zlib level for compressing ssd engine pages, or 0 to store them uncompressed
+	int SQLITE_COMPRESSED_PAGE_SIZE; // SQLite page size of files created while SQLITE_PAGE_COMPRESSION_LEVEL is set
+	int SQLITE_READAHEAD_PAGES; // Max number of upcoming leaf pages a range read fetches ahead of its cursor, or 0 to disable
 
 	// KeyValueStoreSqlite spring cleaning
 	double SPRING_CLEANING_NO_ACTION_INTERVAL;
@@ -195,9 +210,24 @@ public:
 	int SPRING_CLEANING_LAZY_DELETE_BATCH_SIZE;
 	int SPRING_CLEANING_MIN_VACUUM_PAGES;
 	int SPRING_CLEANING_MAX_VACUUM_PAGES;
+	double SPRING_CLEANING_RECLAIM_PAGES_PER_SECOND; // While reclamation is behind, it runs again as soon as this rate allows rather than after the intervals above, or 0 to always wait for them
+	double SPRING_CLEANING_FREE_PAGE_RELEASE_INTERVAL; // Min seconds between passes which punch holes for free pages, or 0 to never release them
+	int SPRING_CLEANING_FREE_PAGE_RELEASE_MAX_RUNS; // Max number of runs of adjacent free pages released by one pass
 
 	// KeyValueStoreMemory
 	int64_t REPLACE_CONTENTS_BYTES;
+	bool KVSTORE_MEMORY_COMPACT_INDEX; // Store the data of a memory storage engine in prefix compressed blocks instead of one tree node per pair
+	int KVSTORE_MEMORY_COMPACT_BLOCK_BYTES; // Target encoded size of a block of the compact layout
+	bool KVSTORE_MEMORY_PARALLEL_SNAPSHOT; // Serialize snapshot items on a separate thread and log them in chunks
+	int KVSTORE_MEMORY_SNAPSHOT_CHUNK_BYTES; // Approximate size of each chunk of a parallel snapshot
+
+	// KeyValueStoreTiered
+	double TIERED_COLD_AGE; // Seconds without writes after which a key range is moved to the cold tier
+	double TIERED_MIGRATION_INTERVAL; // Delay between steps of the cold tier migration scan
+	int TIERED_MIGRATION_BYTES; // Max bytes of the hot tier read by one step of the migration scan
+	int64_t TIERED_COLD_FILE_BYTES; // Target size of the data in a cold file, before compression
+	int TIERED_COLD_BLOCK_BYTES; // Target size of a block of a cold file, before compression
+	int TIERED_COLD_COMPRESSION_LEVEL; // zlib level used to compress cold file blocks
 
 	// Leader election
 	int MAX_NOTIFICATIONS;
@@ -228,9 +258,17 @@ public:
 	int    COMMIT_TRANSACTION_BATCH_BYTES_MAX;
 	double COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE;
 	double COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER;
+	bool   ADAPTIVE_COMMIT_BATCHING; // Choose the commit batch interval and size from ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY instead of the COMMIT_TRANSACTION_BATCH_* knobs above
+	double ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY; // The p99 commit latency, in seconds, that adaptive commit batching aims for
+	double ADAPTIVE_COMMIT_BATCHING_WINDOW; // The period over which the observed p99 latencies are measured
+	double ADAPTIVE_COMMIT_BATCHING_QUEUING_FRACTION; // The commit pipeline is considered saturated when batches spend this fraction of their latency waiting to enter it
+	double ADAPTIVE_COMMIT_BATCHING_STEP; // Relative change of the batch interval and size after each batch
+	int    ADAPTIVE_COMMIT_BATCHING_MIN_BYTES;
+	int    ADAPTIVE_COMMIT_BATCHING_MAX_BYTES;
 	int64_t COMMIT_BATCHES_MEM_BYTES_HARD_LIMIT;
 	double COMMIT_BATCHES_MEM_FRACTION_OF_TOTAL;
 	double COMMIT_BATCHES_MEM_TO_TOTAL_MEM_SCALE_FACTOR;
+	int MAX_COMMIT_BATCHES_IN_PIPELINE; // The most commit batches a proxy works on at once; later batches wait to start until an earlier one has sent its replies
 
 	double TRANSACTION_BUDGET_TIME;
 	double RESOLVER_COALESCE_TIME;
@@ -261,6 +299,9 @@ public:
 	double SAMPLE_EXPIRATION_TIME;
 	double SAMPLE_POLL_TIME;
 	int64_t RESOLVER_STATE_MEMORY_LIMIT;
+	int CONFLICT_SET_THREADS;
+	int CONFLICT_SET_PARALLEL_MIN_RANGES;
+	std::string CONFLICT_SET_TYPE;
 
 	//Cluster Controller
 	double CLUSTER_CONTROLLER_LOGGING_DELAY;
@@ -376,6 +417,13 @@ public:
 	int FETCH_BLOCK_BYTES;
 	int FETCH_KEYS_PARALLELISM_BYTES;
 	int FETCH_KEYS_LOWER_PRIORITY;
+	double BULK_INGEST_RETRY_DELAY; // Delay before a storage server tries again to load a bulk ingest file it could not read
+	int RANGE_STREAM_CHUNK_BYTES;
+	int64_t RANGE_STREAM_WINDOW_BYTES; // A range stream pauses while this many bytes are unacknowledged
+	int RANGE_FILTER_SCAN_BYTES; // A filtered range read examines at most about this many bytes of rows
+	int RANGE_AGGREGATE_SCAN_BYTES; // A range aggregate request examines at most about this many bytes of rows
+	int64_t STORAGE_HOT_KEY_CACHE_BYTES; // Size of the cache of values read from a storage engine other than memory, 0 to disable
+	int64_t VERSIONED_STORAGE_LAG_VERSIONS; // With a versioned storage engine, mutations older than this are moved out of memory into the engine
 	int BUGGIFY_BLOCK_BYTES;
 	int64_t STORAGE_HARD_LIMIT_BYTES;
 	int64_t STORAGE_DURABILITY_LAG_HARD_MAX;
@@ -429,6 +477,7 @@ public:
 	int FREE_PAGE_VACUUM_THRESHOLD;
 	int VACUUM_QUEUE_SIZE;
 	int VACUUM_BYTES_PER_SECOND;
+	int64_t PAGER_CACHE_BYTES;
 
 	// Timekeeper
 	int64_t TIME_KEEPER_DELAY;
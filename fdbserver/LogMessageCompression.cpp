@@ -0,0 +1,101 @@
+/*
+ * LogMessageCompression.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbserver/LogMessageCompression.h"
+#include "fdbserver/Knobs.h"
+#include "fdbrpc/zlib/zlib.h"
+#include "flow/UnitTest.h"
+
+Standalone<StringRef> compressLogMessages( StringRef messages ) {
+	if( messages.size() < SERVER_KNOBS->TLOG_COMPRESSION_MIN_BYTES ) {
+		return Standalone<StringRef>();
+	}
+
+	z_stream deflater;
+	memset(&deflater, 0, sizeof(deflater));
+	if(deflateInit(&deflater, SERVER_KNOBS->TLOG_COMPRESSION_LEVEL) != Z_OK)
+		throw internal_error();
+	// A batch that does not shrink is sent as is, so there is no point in deflating more than its size
+	Standalone<StringRef> compressed = makeString(messages.size());
+	deflater.next_in = (Bytef*)messages.begin();
+	deflater.avail_in = messages.size();
+	deflater.next_out = mutateString(compressed);
+	deflater.avail_out = compressed.size();
+	int rc = deflate(&deflater, Z_FINISH);
+	int length = deflater.total_out;
+	deflateEnd(&deflater);
+	if(rc != Z_STREAM_END) {
+		if(rc != Z_OK && rc != Z_BUF_ERROR)
+			throw internal_error();
+		return Standalone<StringRef>();
+	}
+	return Standalone<StringRef>(compressed.substr(0, length), compressed.arena());
+}
+
+StringRef decompressLogMessages( Arena& arena, StringRef compressed, uint32_t uncompressedBytes ) {
+	uint8_t* out = new (arena) uint8_t[uncompressedBytes];
+	z_stream inflater;
+	memset(&inflater, 0, sizeof(inflater));
+	bool complete = false;
+	if(inflateInit(&inflater) == Z_OK) {
+		inflater.next_in = (Bytef*)compressed.begin();
+		inflater.avail_in = compressed.size();
+		inflater.next_out = out;
+		inflater.avail_out = uncompressedBytes;
+		int rc = inflate(&inflater, Z_FINISH);
+		complete = rc == Z_STREAM_END && inflater.total_out == uncompressedBytes;
+		inflateEnd(&inflater);
+	}
+	if(!complete) {
+		TraceEvent(SevError, "LogMessagesCorrupt").detail("Length", compressed.size()).detail("UncompressedBytes", uncompressedBytes);
+		throw checksum_failed();
+	}
+	return StringRef(out, uncompressedBytes);
+}
+
+TEST_CASE("/fdbserver/LogMessageCompression/roundTrip") {
+	// Messages with repetitive keys, like those of a typical commit batch, and a few random bytes
+	std::string messages;
+	int count = deterministicRandom()->randomInt(0, 1000);
+	for(int i = 0; i < count; i++) {
+		messages += format("\x01\x15\x02users\xff\x02%08d\xff", deterministicRandom()->randomInt(0, 100000));
+		messages += std::string(deterministicRandom()->randomInt(0, 100), (char)deterministicRandom()->randomInt(0, 256));
+		if(deterministicRandom()->random01() < 0.1) {
+			messages += deterministicRandom()->randomUniqueID().toString();
+		}
+	}
+
+	Standalone<StringRef> compressed = compressLogMessages( StringRef(messages) );
+	if(compressed.size()) {
+		ASSERT( compressed.size() < messages.size() );
+		Arena arena;
+		ASSERT( decompressLogMessages(arena, compressed, messages.size()) == StringRef(messages) );
+	} else {
+		ASSERT( messages.size() < std::max(SERVER_KNOBS->TLOG_COMPRESSION_MIN_BYTES, 10000) );
+	}
+
+	// Random bytes do not compress, and are left as they are
+	std::string random;
+	for(int i = 0; i < 10000; i++) {
+		random += (char)deterministicRandom()->randomInt(0, 256);
+	}
+	ASSERT( compressLogMessages( StringRef(random) ).size() == 0 );
+	return Void();
+}
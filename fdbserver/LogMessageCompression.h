@@ -0,0 +1,39 @@
+/*
+ * LogMessageCompression.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_LOGMESSAGECOMPRESSION_H
+#define FDBSERVER_LOGMESSAGECOMPRESSION_H
+#pragma once
+
+#include "flow/flow.h"
+
+// Block compression of a batch of log messages, such as one TLog's share of a commit (see LogPushData) or the messages
+// of a peek reply.  A compressed batch travels with its uncompressed size, which is zero for a batch that is not
+// compressed.
+
+// Returns the zlib compressed form of messages, or an empty string if messages is smaller than
+// TLOG_COMPRESSION_MIN_BYTES or compressing it would not save anything, in which case it should be sent as is.
+Standalone<StringRef> compressLogMessages( StringRef messages );
+
+// Returns the uncompressedBytes long batch that compressLogMessages() turned into compressed, allocated in arena.
+// Throws checksum_failed() if compressed does not inflate to exactly that many bytes.
+StringRef decompressLogMessages( Arena& arena, StringRef compressed, uint32_t uncompressedBytes );
+
+#endif
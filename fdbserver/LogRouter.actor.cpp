@@ -419,6 +419,9 @@ ACTOR Future<Void> logRouterCore(
 		when( TLogPeekRequest req = waitNext( interf.peekMessages.getFuture() ) ) {
 			addActor.send( logRouterPeekMessages( &logRouterData, req ) );
 		}
+		when( TLogPeekStreamRequest req = waitNext( interf.peekStreamMessages.getFuture() ) ) {
+			req.reply.sendError( unsupported_operation() );
+		}
 		when( TLogPopRequest req = waitNext( interf.popMessages.getFuture() ) ) {
 			addActor.send( logRouterPop( &logRouterData, req ) );
 		}
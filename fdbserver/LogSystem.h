@@ -395,8 +395,22 @@ struct ILogSystem {
 		Deque<Future<TLogPeekReply>> futureResults;
 		Future<Void> interfaceChanged;
 
-		ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore );
+		// When usePeekStream is set, getMore() subscribes to replies pushed by the TLog (see TLogPeekStreamRequest)
+		// rather than sending peek requests.  It uses peek requests instead while it reads data the TLog has spilled,
+		// until a peek reply shows it has caught up.  While a stream is open, sequence counts the pushed replies
+		// the cursor has consumed.
+		bool usePeekStream;
+		bool peekStreamDeclined;
+		Future<Void> peekStream;
+		RequestStream<TLogPeekReply> peekStreamReplies;
+		Version peekStreamBegin;
+		int peekStreamAcknowledged;
+
+		ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore, bool usePeekStream = false );
 		ServerPeekCursor( TLogPeekReply const& results, LogMessageVersion const& messageVersion, LogMessageVersion const& end, int32_t messageLength, int32_t rawLength, bool hasMsg, Version poppedVersion, Tag tag );
+		~ServerPeekCursor();
+
+		void closePeekStream();
 
 		virtual Reference<IPeekCursor> cloneNoMore();
 		virtual void setProtocolVersion( ProtocolVersion version );
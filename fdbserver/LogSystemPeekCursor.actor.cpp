@@ -19,20 +19,23 @@
  */
 
 #include "fdbserver/LogSystem.h"
+#include "fdbserver/LogMessageCompression.h"
 #include "fdbrpc/FailureMonitor.h"
 #include "fdbserver/Knobs.h"
 #include "fdbrpc/ReplicationUtils.h"
 #include "flow/actorcompiler.h" // has to be last include
 
-ILogSystem::ServerPeekCursor::ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore )
-			: interf(interf), tag(tag), messageVersion(begin), end(end), hasMsg(false), rd(results.arena, results.messages, Unversioned()), randomID(deterministicRandom()->randomUniqueID()), poppedVersion(0), returnIfBlocked(returnIfBlocked), sequence(0), onlySpilled(false), parallelGetMore(parallelGetMore) {
+ILogSystem::ServerPeekCursor::ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore, bool usePeekStream )
+			: interf(interf), tag(tag), messageVersion(begin), end(end), hasMsg(false), rd(results.arena, results.messages, Unversioned()), randomID(deterministicRandom()->randomUniqueID()), poppedVersion(0), returnIfBlocked(returnIfBlocked), sequence(0), onlySpilled(false), parallelGetMore(parallelGetMore),
+			  usePeekStream(usePeekStream && !returnIfBlocked), peekStreamDeclined(false), peekStreamBegin(0), peekStreamAcknowledged(0) {
 	this->results.maxKnownVersion = 0;
 	this->results.minKnownCommittedVersion = 0;
 	//TraceEvent("SPC_Starting", randomID).detail("Tag", tag.toString()).detail("Begin", begin).detail("End", end).backtrace();
 }
 
 ILogSystem::ServerPeekCursor::ServerPeekCursor( TLogPeekReply const& results, LogMessageVersion const& messageVersion, LogMessageVersion const& end, int32_t messageLength, int32_t rawLength, bool hasMsg, Version poppedVersion, Tag tag )
-			: results(results), tag(tag), rd(results.arena, results.messages, Unversioned()), messageVersion(messageVersion), end(end), messageLength(messageLength), rawLength(rawLength), hasMsg(hasMsg), randomID(deterministicRandom()->randomUniqueID()), poppedVersion(poppedVersion), returnIfBlocked(false), sequence(0), onlySpilled(false), parallelGetMore(false)
+			: results(results), tag(tag), rd(results.arena, results.messages, Unversioned()), messageVersion(messageVersion), end(end), messageLength(messageLength), rawLength(rawLength), hasMsg(hasMsg), randomID(deterministicRandom()->randomUniqueID()), poppedVersion(poppedVersion), returnIfBlocked(false), sequence(0), onlySpilled(false), parallelGetMore(false),
+			  usePeekStream(false), peekStreamDeclined(false), peekStreamBegin(0), peekStreamAcknowledged(0)
 {
 	//TraceEvent("SPC_Clone", randomID);
 	this->results.maxKnownVersion = 0;
@@ -43,6 +46,27 @@ ILogSystem::ServerPeekCursor::ServerPeekCursor( TLogPeekReply const& results, Lo
 	advanceTo(messageVersion);
 }
 
+ILogSystem::ServerPeekCursor::~ServerPeekCursor() {
+	closePeekStream();
+}
+
+// Tells the TLog to stop pushing to the open peek stream, if there is one
+void ILogSystem::ServerPeekCursor::closePeekStream() {
+	if( peekStream.isValid() && !peekStream.isReady() && interf && interf->get().present() ) {
+		interf->get().interf().peekStreamMessages.send( TLogPeekStreamRequest( peekStreamBegin, tag, std::make_pair(randomID, -1) ) );
+	}
+	peekStream = Future<Void>();
+}
+
+// Replies to log routers may be compressed.  They are only inflated when the cursor moves on to them, so the replies
+// queued by parallel peeks stay compressed until then.
+static void decompressPeekReply( TLogPeekReply& reply ) {
+	if(reply.uncompressedBytes) {
+		reply.messages = decompressLogMessages(reply.arena, reply.messages, reply.uncompressedBytes);
+		reply.uncompressedBytes = 0;
+	}
+}
+
 Reference<ILogSystem::IPeekCursor> ILogSystem::ServerPeekCursor::cloneNoMore() {
 	return Reference<ILogSystem::ServerPeekCursor>( new ILogSystem::ServerPeekCursor( results, messageVersion, end, messageLength, rawLength, hasMsg, poppedVersion, tag ) );
 }
@@ -162,6 +186,7 @@ ACTOR Future<Void> serverPeekParallelGetMore( ILogSystem::ServerPeekCursor* self
 					expectedBegin = res.end;
 					self->futureResults.pop_front();
 					self->results = res;
+					decompressPeekReply(self->results);
 					self->onlySpilled = res.onlySpilled;
 					if(res.popped.present())
 						self->poppedVersion = std::min( std::max(self->poppedVersion, res.popped.get()), self->end.version );
@@ -209,7 +234,12 @@ ACTOR Future<Void> serverPeekGetMore( ILogSystem::ServerPeekCursor* self, TaskPr
 				when( TLogPeekReply res = wait( self->interf->get().present() ?
 					brokenPromiseToNever( self->interf->get().interf().peekMessages.getReply(TLogPeekRequest(self->messageVersion.version,self->tag,self->returnIfBlocked, self->onlySpilled), taskID) ) : Never() ) ) {
 					self->results = res;
+					decompressPeekReply(self->results);
 					self->onlySpilled = res.onlySpilled;
+					if(self->peekStreamDeclined && !res.onlySpilled && res.end > res.maxKnownVersion) {
+						// The cursor has caught up with the TLog, so it can subscribe to the versions that follow
+						self->peekStreamDeclined = false;
+					}
 					if(res.popped.present())
 						self->poppedVersion = std::min( std::max(self->poppedVersion, res.popped.get()), self->end.version );
 					self->rd = ArenaReader( self->results.arena, self->results.messages, Unversioned() );
@@ -234,12 +264,103 @@ ACTOR Future<Void> serverPeekGetMore( ILogSystem::ServerPeekCursor* self, TaskPr
 	}
 }
 
+ACTOR Future<Void> serverPeekStreamGetMore( ILogSystem::ServerPeekCursor* self, TaskPriority taskID ) {
+	if( !self->interf || self->messageVersion >= self->end ) {
+		wait( Future<Void>(Never()));
+		throw internal_error();
+	}
+
+	if(!self->interfaceChanged.isValid()) {
+		self->interfaceChanged = self->interf->onChange();
+	}
+
+	loop {
+		try {
+			if(!self->interf->get().present()) {
+				self->peekStream = Future<Void>();
+				wait( self->interfaceChanged );
+				self->interfaceChanged = self->interf->onChange();
+				continue;
+			}
+
+			if(!self->peekStream.isValid()) {
+				self->randomID = deterministicRandom()->randomUniqueID();
+				self->sequence = 0;
+				self->peekStreamAcknowledged = 0;
+				self->peekStreamBegin = self->messageVersion.version;
+				self->peekStreamReplies = RequestStream<TLogPeekReply>();
+				self->peekStreamReplies.getEndpoint(taskID);
+				self->peekStream = self->interf->get().interf().peekStreamMessages.getReply(TLogPeekStreamRequest(self->peekStreamBegin, self->tag, std::make_pair(self->randomID, 0), self->peekStreamReplies), taskID);
+			} else if(self->sequence - self->peekStreamAcknowledged >= std::max(1, SERVER_KNOBS->TLOG_PEEK_STREAM_WINDOW / 2)) {
+				self->interf->get().interf().peekStreamMessages.send(TLogPeekStreamRequest(self->peekStreamBegin, self->tag, std::make_pair(self->randomID, self->sequence)));
+				self->peekStreamAcknowledged = self->sequence;
+			}
+
+			choose {
+				when( TLogPeekReply res = waitNext( self->peekStreamReplies.getFuture() ) ) {
+					if(!res.begin.present() || res.begin.get() != self->peekStreamBegin) {
+						// A pushed reply was lost or reordered, so the stream is reopened at the cursor's version
+						throw timed_out();
+					}
+					self->peekStreamBegin = res.end;
+					self->sequence++;
+					self->results = res;
+					decompressPeekReply(self->results);
+					if(res.popped.present())
+						self->poppedVersion = std::min( std::max(self->poppedVersion, res.popped.get()), self->end.version );
+					self->rd = ArenaReader( self->results.arena, self->results.messages, Unversioned() );
+					LogMessageVersion skipSeq = self->messageVersion;
+					self->hasMsg = true;
+					self->nextMessage();
+					self->advanceTo(skipSeq);
+					return Void();
+				}
+				when( wait( self->peekStream ) ) {
+					TEST(true); // TLog ended a peek stream to serve spilled or popped data
+					self->peekStream = Future<Void>();
+					self->peekStreamDeclined = true;
+					wait( serverPeekGetMore(self, taskID) );
+					return Void();
+				}
+				when( wait( self->interfaceChanged ) ) {
+					self->interfaceChanged = self->interf->onChange();
+					self->peekStream = Future<Void>();
+				}
+				when( wait( IFailureMonitor::failureMonitor().onDisconnectOrFailure( self->interf->get().interf().peekStreamMessages.getEndpoint() ) ) ) {
+					// Pushed replies and acknowledgements may have been lost, so peek until the TLog is reachable again
+					self->peekStream = Future<Void>();
+					self->peekStreamDeclined = true;
+					wait( serverPeekGetMore(self, taskID) );
+					return Void();
+				}
+			}
+		} catch( Error &e ) {
+			if(e.code() == error_code_timed_out) {
+				TraceEvent("PeekStreamReopened", self->randomID).detail("Tag", self->tag.toString()).detail("Begin", self->messageVersion.version);
+				self->closePeekStream();
+			} else if(e.code() == error_code_broken_promise || e.code() == error_code_unsupported_operation) {
+				self->peekStream = Future<Void>();
+				self->peekStreamDeclined = true;
+				if(e.code() == error_code_unsupported_operation) {
+					self->usePeekStream = false;
+				}
+				wait( serverPeekGetMore(self, taskID) );
+				return Void();
+			} else {
+				throw e;
+			}
+		}
+	}
+}
+
 Future<Void> ILogSystem::ServerPeekCursor::getMore(TaskPriority taskID) {
 	//TraceEvent("SPC_GetMore", randomID).detail("HasMessage", hasMessage()).detail("More", !more.isValid() || more.isReady()).detail("MessageVersion", messageVersion.toString()).detail("End", end.toString());
 	if( hasMessage() )
 		return Void();
 	if( !more.isValid() || more.isReady() ) {
-		if (parallelGetMore || onlySpilled || futureResults.size()) {
+		if (usePeekStream && !peekStreamDeclined && !onlySpilled && !futureResults.size()) {
+			more = serverPeekStreamGetMore(this, taskID);
+		} else if (parallelGetMore || onlySpilled || futureResults.size()) {
 			more = serverPeekParallelGetMore(this, taskID);
 		} else {
 			more = serverPeekGetMore(this, taskID);
@@ -27,6 +27,7 @@
 #include "fdbclient/NativeAPI.actor.h"
 #include "fdbclient/Notified.h"
 #include "fdbclient/SystemData.h"
+#include "fdbrpc/ContinuousSample.h"
 #include "fdbrpc/sim_validation.h"
 #include "fdbserver/ApplyMetadataMutation.h"
 #include "fdbserver/ConflictSet.h"
@@ -46,6 +47,7 @@
 #include "flow/Knobs.h"
 #include "flow/Stats.h"
 #include "flow/TDMetric.actor.h"
+#include "flow/UnitTest.h"
 #include "flow/actorcompiler.h"  // This must be the last #include.
 
 struct ProxyStats {
@@ -66,6 +68,14 @@ struct ProxyStats {
 	LatencyBands commitLatencyBands;
 	LatencyBands grvLatencyBands;
 
+	// Histograms of the time a commit batch spends in each stage of the commit pipeline (see commitBatch())
+	LatencyBands commitBatchQueuingLatencyBands;
+	LatencyBands getCommitVersionLatencyBands;
+	LatencyBands resolutionLatencyBands;
+	LatencyBands postResolutionLatencyBands;
+	LatencyBands tlogLoggingLatencyBands;
+	LatencyBands replyCommitLatencyBands;
+
 	Future<Void> logger;
 
 	explicit ProxyStats(UID id, Version* pVersion, NotifiedVersion* pCommittedVersion, int64_t *commitBatchesMemBytesCountPtr)
@@ -73,8 +83,20 @@ struct ProxyStats {
 		txnStartIn("TxnStartIn", cc), txnStartOut("TxnStartOut", cc), txnStartBatch("TxnStartBatch", cc), txnSystemPriorityStartIn("TxnSystemPriorityStartIn", cc), txnSystemPriorityStartOut("TxnSystemPriorityStartOut", cc), txnBatchPriorityStartIn("TxnBatchPriorityStartIn", cc), txnBatchPriorityStartOut("TxnBatchPriorityStartOut", cc),
 		txnDefaultPriorityStartIn("TxnDefaultPriorityStartIn", cc), txnDefaultPriorityStartOut("TxnDefaultPriorityStartOut", cc), txnCommitIn("TxnCommitIn", cc),	txnCommitVersionAssigned("TxnCommitVersionAssigned", cc), txnCommitResolving("TxnCommitResolving", cc), txnCommitResolved("TxnCommitResolved", cc), txnCommitOut("TxnCommitOut", cc),
 		txnCommitOutSuccess("TxnCommitOutSuccess", cc), txnConflicts("TxnConflicts", cc), commitBatchIn("CommitBatchIn", cc), commitBatchOut("CommitBatchOut", cc), mutationBytes("MutationBytes", cc), mutations("Mutations", cc), conflictRanges("ConflictRanges", cc), keyServerLocationRequests("KeyServerLocationRequests", cc), 
-		lastCommitVersionAssigned(0), commitLatencyBands("CommitLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY), grvLatencyBands("GRVLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY)
+		lastCommitVersionAssigned(0), commitLatencyBands("CommitLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY), grvLatencyBands("GRVLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY),
+		commitBatchQueuingLatencyBands("CommitBatchQueuingLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY), getCommitVersionLatencyBands("GetCommitVersionLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY),
+		resolutionLatencyBands("ResolutionLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY), postResolutionLatencyBands("PostResolutionLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY),
+		tlogLoggingLatencyBands("TLogLoggingLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY), replyCommitLatencyBands("ReplyCommitLatencyMetrics", id, SERVER_KNOBS->STORAGE_LOGGING_DELAY)
 	{
+		// Unlike the client latency bands, which are configured through the database, the stage histograms always use these buckets
+		for(double band : { 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1.0 }) {
+			commitBatchQueuingLatencyBands.addThreshold(band);
+			getCommitVersionLatencyBands.addThreshold(band);
+			resolutionLatencyBands.addThreshold(band);
+			postResolutionLatencyBands.addThreshold(band);
+			tlogLoggingLatencyBands.addThreshold(band);
+			replyCommitLatencyBands.addThreshold(band);
+		}
 		specialCounter(cc, "LastAssignedCommitVersion", [this](){return this->lastCommitVersionAssigned;});
 		specialCounter(cc, "Version", [pVersion](){return *pVersion; });
 		specialCounter(cc, "CommittedVersion", [pCommittedVersion](){ return pCommittedVersion->get(); });
@@ -191,6 +213,81 @@ DESCR struct SingleKeyMutation {
 	int64_t tag3;
 };
 
+// With ADAPTIVE_COMMIT_BATCHING, chooses the interval at which commitBatcher() starts commit batches and the number of bytes
+// at which it closes one, aiming for a p99 commit latency of ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY.  A transaction waits
+// up to one interval in commitBatcher() and then as long as its batch takes to go through the pipeline of commitBatch(), so
+// the interval may use whatever the pipeline leaves of the target.  Within that, the interval is as short as possible while
+// the pipeline keeps up (for latency at low load) and grows along with the batch size when batches queue to enter the
+// pipeline (for throughput at peak).
+struct CommitBatchController {
+	double interval;
+	int desiredBytes;
+
+	// Smoothed times a commit batch spends in some stages of commitBatch()
+	double queuingTime;
+	double resolutionTime;
+	double loggingTime;
+	double batchLatency; // From the start of commitBatch() to the replies
+
+	// p99s of the latencies observed in the last complete ADAPTIVE_COMMIT_BATCHING_WINDOW
+	double commitLatencyP99; // Of transactions, from the request to the reply
+	double batchLatencyP99;
+
+	double windowStart;
+	ContinuousSample<double> commitLatencies;
+	ContinuousSample<double> batchLatencies;
+
+	CommitBatchController()
+	  : interval(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN),
+		desiredBytes(std::max(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MIN_BYTES, std::min(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MAX_BYTES, SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_MIN))),
+		queuingTime(0), resolutionTime(0), loggingTime(0), batchLatency(0), commitLatencyP99(0), batchLatencyP99(0), windowStart(0),
+		commitLatencies(1000), batchLatencies(1000)
+	{}
+
+	void addCommitLatency(double latency) {
+		commitLatencies.addSample(latency);
+	}
+
+	// Called once a batch has sent its replies, with the time it spent in the stages of commitBatch()
+	void addBatch(double now, double queuing, double resolution, double logging, double latency) {
+		double alpha = SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA;
+		queuingTime = alpha * queuing + (1 - alpha) * queuingTime;
+		resolutionTime = alpha * resolution + (1 - alpha) * resolutionTime;
+		loggingTime = alpha * logging + (1 - alpha) * loggingTime;
+		batchLatency = alpha * latency + (1 - alpha) * batchLatency;
+		batchLatencies.addSample(latency);
+
+		if(now - windowStart >= SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_WINDOW) {
+			commitLatencyP99 = commitLatencies.percentile(0.99);
+			batchLatencyP99 = batchLatencies.percentile(0.99);
+			commitLatencies.clear();
+			batchLatencies.clear();
+			windowStart = now;
+		}
+
+		double target = SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY;
+		double step = 1 + SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_STEP;
+		bool saturated = queuingTime > SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_QUEUING_FRACTION * batchLatency;
+		if(saturated) {
+			// Fewer, larger batches spend less of the proxy's time on the per batch work of the ordered stages
+			interval *= step;
+			desiredBytes = int(desiredBytes * step) + 1;
+		} else {
+			interval /= step;
+			if(commitLatencyP99 > target) {
+				// Large batches take longer to resolve and log
+				desiredBytes = int(desiredBytes / step);
+			}
+		}
+
+		// The resolver and TLog service times stand in for the pipeline's p99 until a window has been measured
+		double budget = target - std::max(batchLatencyP99, resolutionTime + loggingTime);
+		double maxInterval = std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, budget));
+		interval = std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, std::min(maxInterval, interval));
+		desiredBytes = std::max(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MIN_BYTES, std::min(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MAX_BYTES, desiredBytes));
+	}
+};
+
 struct ProxyCommitData {
 	UID dbgid;
 	int64_t commitBatchesMemBytesCount;
@@ -216,10 +313,12 @@ struct ProxyCommitData {
 	bool locked;
 	Optional<Value> metadataVersion;
 	double commitBatchInterval;
+	CommitBatchController commitBatchController;
 
 	int64_t localCommitBatchesStarted;
 	NotifiedVersion latestLocalCommitBatchResolving;
 	NotifiedVersion latestLocalCommitBatchLogging;
+	FlowLock commitBatchPipeline; // Bounds the number of commit batches in flight to MAX_COMMIT_BATCHES_IN_PIPELINE
 
 	PromiseStream<Void> commitBatchStartNotifications;
 	PromiseStream<Future<GetCommitVersionReply>> commitBatchVersions;  // 1:1 with commitBatchStartNotifications
@@ -268,8 +367,21 @@ struct ProxyCommitData {
 			getConsistentReadVersion(getConsistentReadVersion), commit(commit), lastCoalesceTime(0),
 			localCommitBatchesStarted(0), locked(false), commitBatchInterval(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN),
 			firstProxy(firstProxy), cx(openDBOnServer(db, TaskPriority::DefaultEndpoint, true, true)), db(db),
-			singleKeyMutationEvent(LiteralStringRef("SingleKeyMutation")), commitBatchesMemBytesCount(0), lastTxsPop(0), lastStartCommit(0), lastCommitLatency(SERVER_KNOBS->REQUIRED_MIN_RECOVERY_DURATION), lastCommitTime(0)
-	{}
+			singleKeyMutationEvent(LiteralStringRef("SingleKeyMutation")), commitBatchesMemBytesCount(0), lastTxsPop(0), lastStartCommit(0), lastCommitLatency(SERVER_KNOBS->REQUIRED_MIN_RECOVERY_DURATION), lastCommitTime(0),
+			commitBatchPipeline(SERVER_KNOBS->MAX_COMMIT_BATCHES_IN_PIPELINE)
+	{
+		specialCounter(stats.cc, "CommitBatchesInPipeline", [this](){ return this->commitBatchPipeline.activePermits(); });
+		specialCounter(stats.cc, "CommitBatchesWaitingForPipeline", [this](){ return this->commitBatchPipeline.waiters(); });
+		specialCounter(stats.cc, "CommitBatchIntervalMicros", [this](){ return int64_t(this->commitBatchInterval * 1e6); });
+		if(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING) {
+			specialCounter(stats.cc, "CommitBatchDesiredBytes", [this](){ return this->commitBatchController.desiredBytes; });
+			specialCounter(stats.cc, "CommitLatencyP99Micros", [this](){ return int64_t(this->commitBatchController.commitLatencyP99 * 1e6); });
+			specialCounter(stats.cc, "CommitBatchLatencyP99Micros", [this](){ return int64_t(this->commitBatchController.batchLatencyP99 * 1e6); });
+			specialCounter(stats.cc, "CommitBatchQueuingMicros", [this](){ return int64_t(this->commitBatchController.queuingTime * 1e6); });
+			specialCounter(stats.cc, "ResolutionServiceMicros", [this](){ return int64_t(this->commitBatchController.resolutionTime * 1e6); });
+			specialCounter(stats.cc, "TLogServiceMicros", [this](){ return int64_t(this->commitBatchController.loggingTime * 1e6); });
+		}
+	}
 };
 
 struct ResolutionRequestBuilder {
@@ -362,6 +474,7 @@ ACTOR Future<Void> commitBatcher(ProxyCommitData *commitData, PromiseStream<std:
 		state Future<Void> timeout;
 		state std::vector<CommitTransactionRequest> batch;
 		state int batchBytes = 0;
+		state int batchDesiredBytes = SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING ? commitData->commitBatchController.desiredBytes : desiredBytes;
 
 		if(SERVER_KNOBS->MAX_COMMIT_BATCH_INTERVAL <= 0) {
 			timeout = Never();
@@ -370,7 +483,7 @@ ACTOR Future<Void> commitBatcher(ProxyCommitData *commitData, PromiseStream<std:
 			timeout = delayJittered(SERVER_KNOBS->MAX_COMMIT_BATCH_INTERVAL, TaskPriority::ProxyCommitBatcher);
 		}
 
-		while(!timeout.isReady() && !(batch.size() == SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_COUNT_MAX || batchBytes >= desiredBytes)) {
+		while(!timeout.isReady() && !(batch.size() == SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_COUNT_MAX || batchBytes >= batchDesiredBytes)) {
 			choose{
 				when(CommitTransactionRequest req = waitNext(in)) {
 					int bytes = getBytes(req);
@@ -464,6 +577,15 @@ ACTOR Future<Void> commitBatch(
 	state Optional<UID> debugID;
 	state bool forceRecovery = false;
 
+	// The batches of a proxy move through the pipeline below in the order of localBatchNumber.  Each stage is ordered
+	// with respect to the same stage of the previous batch (by latestLocalCommitBatchResolving and latestLocalCommitBatchLogging),
+	// but not with later stages of earlier batches, so that e.g. a batch is resolved while its predecessor is being logged.
+	// The number of batches in the pipeline is bounded by commitBatchPipeline; since the lock is fair and is requested
+	// before the first wait, the batches holding it are always the oldest ones, which can make progress.
+	TEST(self->commitBatchPipeline.available() <= 0); // Commit batch waiting for a place in the pipeline
+	state Future<Void> pipelineSlot = self->commitBatchPipeline.take(TaskPriority::ProxyCommit);
+	state FlowLock::Releaser pipelineReleaser;
+
 	ASSERT(SERVER_KNOBS->MAX_READ_TRANSACTION_LIFE_VERSIONS <= SERVER_KNOBS->MAX_VERSIONS_IN_FLIGHT);  // since we are using just the former to limit the number of versions actually in flight!
 
 	// Active load balancing runs at a very high priority (to obtain accurate estimate of memory used by commit batches) so we need to downgrade here
@@ -494,11 +616,19 @@ ACTOR Future<Void> commitBatch(
 		self->commitBatchStartNotifications.send(Void());
 	}
 
-	/////// Phase 1: Pre-resolution processing (CPU bound except waiting for a version # which is separately pipelined and *should* be available by now (unless empty commit); ordered; currently atomic but could yield)
+	/////// Stage 1: Queuing for a place in the pipeline and for the pre-resolution processing of the previous batch
+	wait(pipelineSlot);
+	pipelineReleaser = FlowLock::Releaser(self->commitBatchPipeline);
+
 	TEST(self->latestLocalCommitBatchResolving.get() < localBatchNumber-1); // Queuing pre-resolution commit processing 
 	wait(self->latestLocalCommitBatchResolving.whenAtLeast(localBatchNumber-1));
 	wait(yield());
 
+	state double getCommitVersionStart = now();
+	self->stats.commitBatchQueuingLatencyBands.addMeasurement(getCommitVersionStart - t1);
+
+	/////// Stage 2: Version fetch and pre-resolution processing (CPU bound except waiting for a version # which is separately pipelined and *should* be available by now (unless empty commit); ordered; currently atomic but could yield)
+
 	if (debugID.present())
 		g_traceBatch.addEvent("CommitDebug", debugID.get().first(), "MasterProxyServer.commitBatch.GettingCommitVersion");
 
@@ -511,6 +641,7 @@ ACTOR Future<Void> commitBatch(
 
 	state Version commitVersion = versionReply.version;
 	state Version prevVersion = versionReply.prevVersion;
+	self->stats.getCommitVersionLatencyBands.addMeasurement(now() - getCommitVersionStart);
 
 	for(auto it : versionReply.resolverChanges) {
 		auto rs = self->keyResolvers.modify(it.range);
@@ -539,8 +670,9 @@ ACTOR Future<Void> commitBatch(
 	for (int r = 1; r<self->resolvers.size(); r++)
 		ASSERT(requests.requests[r].txnStateTransactions.size() == requests.requests[0].txnStateTransactions.size());
 
-	// Sending these requests is the fuzzy border between phase 1 and phase 2; it could conceivably overlap with resolution processing but is still using CPU
+	// Sending these requests is the fuzzy border between stage 2 and stage 3; it could conceivably overlap with resolution processing but is still using CPU
 	self->stats.txnCommitResolving += trs.size();
+	state double resolutionStart = now();
 	vector< Future<ResolveTransactionBatchReply> > replies;
 	for (int r = 0; r<self->resolvers.size(); r++) {
 		requests.requests[r].debugID = debugID;
@@ -552,13 +684,15 @@ ACTOR Future<Void> commitBatch(
 	ASSERT(self->latestLocalCommitBatchResolving.get() == localBatchNumber-1);
 	self->latestLocalCommitBatchResolving.set(localBatchNumber);
 
-	/////// Phase 2: Resolution (waiting on the network; pipelined)
+	/////// Stage 3: Resolution (waiting on the network; pipelined)
 	state vector<ResolveTransactionBatchReply> resolution = wait( getAll(replies) );
+	state double postResolutionStart = now();
+	self->stats.resolutionLatencyBands.addMeasurement(postResolutionStart - resolutionStart);
 
 	if (debugID.present())
 		g_traceBatch.addEvent("CommitDebug", debugID.get().first(), "MasterProxyServer.commitBatch.AfterResolution");
 
-	////// Phase 3: Post-resolution processing (CPU bound except for very rare situations; ordered; currently atomic but doesn't need to be)
+	////// Stage 4: Post-resolution processing, i.e. applying metadata mutations and assigning mutations to tags (CPU bound except for very rare situations; ordered; currently atomic but doesn't need to be)
 	TEST(self->latestLocalCommitBatchLogging.get() < localBatchNumber-1); // Queuing post-resolution commit processing 
 	wait(self->latestLocalCommitBatchLogging.whenAtLeast(localBatchNumber-1));
 	wait(yield());
@@ -923,6 +1057,7 @@ ACTOR Future<Void> commitBatch(
 
 	state double commitStartTime = now();
 	self->lastStartCommit = commitStartTime;
+	self->stats.postResolutionLatencyBands.addMeasurement(commitStartTime - postResolutionStart);
 	Future<Version> loggingComplete = self->logSystem->push( prevVersion, commitVersion, self->committedVersion.get(), self->minKnownCommittedVersion, toCommit, debugID );
 
 	if (!forceRecovery) {
@@ -930,7 +1065,7 @@ ACTOR Future<Void> commitBatch(
 		self->latestLocalCommitBatchLogging.set(localBatchNumber);
 	}
 
-	/////// Phase 4: Logging (network bound; pipelined up to MAX_READ_TRANSACTION_LIFE_VERSIONS (limited by loop above))
+	/////// Stage 5: Logging (network bound; pipelined up to MAX_READ_TRANSACTION_LIFE_VERSIONS (limited by loop above))
 
 	try {
 		choose {
@@ -945,8 +1080,10 @@ ACTOR Future<Void> commitBatch(
 		}
 		throw;
 	}
-	self->lastCommitLatency = now()-commitStartTime;
+	state double replyStart = now();
+	self->lastCommitLatency = replyStart-commitStartTime;
 	self->lastCommitTime = std::max(self->lastCommitTime.get(), commitStartTime);
+	self->stats.tlogLoggingLatencyBands.addMeasurement(self->lastCommitLatency);
 	wait(yield());
 
 	if( self->popRemoteTxs && msg.popTo > ( self->txsPopVersions.size() ? self->txsPopVersions.back().second : self->lastTxsPop ) ) {
@@ -959,7 +1096,7 @@ ACTOR Future<Void> commitBatch(
 	}
 	self->logSystem->popTxs(msg.popTo);
 
-	/////// Phase 5: Replies (CPU bound; no particular order required, though ordered execution would be best for latency)
+	/////// Stage 6: Replies (CPU bound; no particular order required, though ordered execution would be best for latency)
 	if ( prevVersion && commitVersion - prevVersion < SERVER_KNOBS->MAX_VERSIONS_IN_FLIGHT/2 )
 		debug_advanceMinCommittedVersion(UID(), commitVersion);
 
@@ -999,6 +1136,10 @@ ACTOR Future<Void> commitBatch(
 			trs[t].reply.sendError(not_committed());
 		}
 
+		if(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING) {
+			self->commitBatchController.addCommitLatency(endTime - trs[t].requestTime());
+		}
+
 		// TODO: filter if pipelined with large commit
 		if(self->latencyBandConfig.present()) {
 			bool filter = maxTransactionBytes > self->latencyBandConfig.get().commitConfig.maxCommitBytes.orDefault(std::numeric_limits<int>::max());
@@ -1006,6 +1147,7 @@ ACTOR Future<Void> commitBatch(
 		}
 	}
 
+	self->stats.replyCommitLatencyBands.addMeasurement(now() - replyStart);
 	++self->stats.commitBatchOut;
 	self->stats.txnCommitOut += trs.size();
 	self->stats.txnConflicts += trs.size() - commitCount;
@@ -1028,11 +1170,16 @@ ACTOR Future<Void> commitBatch(
 	}
 
 	// Dynamic batching for commits
-	double target_latency = (now() - t1) * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_LATENCY_FRACTION;
-	self->commitBatchInterval = 
-		std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, 
-			std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, 
-				target_latency * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA + self->commitBatchInterval * (1-SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA)));
+	if(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING) {
+		self->commitBatchController.addBatch(now(), getCommitVersionStart - t1, postResolutionStart - resolutionStart, replyStart - commitStartTime, now() - t1);
+		self->commitBatchInterval = self->commitBatchController.interval;
+	} else {
+		double target_latency = (now() - t1) * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_LATENCY_FRACTION;
+		self->commitBatchInterval = 
+			std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, 
+				std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, 
+					target_latency * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA + self->commitBatchInterval * (1-SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA)));
+	}
 
 
 	self->commitBatchesMemBytesCount -= currentBatchMemBytesCount;
@@ -1774,3 +1921,50 @@ ACTOR Future<Void> masterProxyServer(
 	}
 	return Void();
 }
+
+static double expectedCommitBatchInterval(double batchLatency) {
+	return std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY - batchLatency));
+}
+
+TEST_CASE("/fdbserver/MasterProxyServer/CommitBatchController") {
+	state CommitBatchController controller;
+	state double time = 0;
+	state int i;
+
+	// A pipeline that keeps up needs no more than the shortest interval
+	for(i = 0; i < 2000; i++) {
+		time += 0.005;
+		controller.addCommitLatency(0.008);
+		controller.addBatch(time, 0, 0.002, 0.003, 0.006);
+	}
+	ASSERT( controller.interval == SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN );
+	ASSERT( controller.batchLatencyP99 == 0.006 && controller.commitLatencyP99 == 0.008 );
+
+	// When batches queue, they grow as far as the latency target allows
+	for(i = 0; i < 2000; i++) {
+		time += 0.005;
+		controller.addCommitLatency(0.015);
+		controller.addBatch(time, 0.005, 0.002, 0.003, 0.010);
+	}
+	ASSERT( controller.interval == expectedCommitBatchInterval(0.010) );
+	ASSERT( controller.desiredBytes == SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MAX_BYTES );
+
+	// A slower pipeline leaves less of the target to batching
+	for(i = 0; i < 2000; i++) {
+		time += 0.005;
+		controller.addCommitLatency(0.080);
+		controller.addBatch(time, 0.005, 0.010, 0.030, 0.045);
+	}
+	ASSERT( controller.interval == expectedCommitBatchInterval(0.045) );
+
+	// Once the pipeline keeps up again, batches shrink back while the latency is over the target
+	for(i = 0; i < 2000; i++) {
+		time += 0.005;
+		controller.addCommitLatency(SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_TARGET_LATENCY * 2);
+		controller.addBatch(time, 0, 0.010, 0.030, 0.045);
+	}
+	ASSERT( controller.interval == SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN );
+	ASSERT( controller.desiredBytes == SERVER_KNOBS->ADAPTIVE_COMMIT_BATCHING_MIN_BYTES );
+
+	return Void();
+}
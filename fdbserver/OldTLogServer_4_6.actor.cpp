@@ -1173,6 +1173,9 @@ namespace oldTLog_4_6 {
 			when( TLogPeekRequest req = waitNext( tli.peekMessages.getFuture() ) ) {
 				logData->addActor.send( tLogPeekMessages( self, req, logData ) );
 			}
+			when( TLogPeekStreamRequest req = waitNext( tli.peekStreamMessages.getFuture() ) ) {
+				req.reply.sendError( unsupported_operation() );
+			}
 			when( TLogPopRequest req = waitNext( tli.popMessages.getFuture() ) ) {
 				logData->addActor.send( tLogPop( self, req, logData ) );
 			}
@@ -1307,6 +1310,7 @@ namespace oldTLog_4_6 {
 			recruited.initEndpoints();
 
 			DUMPTOKEN( recruited.peekMessages );
+			DUMPTOKEN( recruited.peekStreamMessages );
 			DUMPTOKEN( recruited.popMessages );
 			DUMPTOKEN( recruited.commit );
 			DUMPTOKEN( recruited.lock );
@@ -1655,6 +1655,9 @@ ACTOR Future<Void> serveTLogInterface( TLogData* self, TLogInterface tli, Refere
 		when( TLogPeekRequest req = waitNext( tli.peekMessages.getFuture() ) ) {
 			logData->addActor.send( tLogPeekMessages( self, req, logData ) );
 		}
+		when( TLogPeekStreamRequest req = waitNext( tli.peekStreamMessages.getFuture() ) ) {
+			req.reply.sendError( unsupported_operation() );
+		}
 		when( TLogPopRequest req = waitNext( tli.popMessages.getFuture() ) ) {
 			logData->addActor.send(tLogPop(self, req, logData));
 		}
@@ -2010,6 +2013,7 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 		recruited.initEndpoints();
 
 		DUMPTOKEN( recruited.peekMessages );
+		DUMPTOKEN( recruited.peekStreamMessages );
 		DUMPTOKEN( recruited.popMessages );
 		DUMPTOKEN( recruited.commit );
 		DUMPTOKEN( recruited.lock );
@@ -2177,6 +2181,7 @@ ACTOR Future<Void> tLogStart( TLogData* self, InitializeTLogRequest req, Localit
 	recruited.initEndpoints();
 
 	DUMPTOKEN( recruited.peekMessages );
+	DUMPTOKEN( recruited.peekStreamMessages );
 	DUMPTOKEN( recruited.popMessages );
 	DUMPTOKEN( recruited.commit );
 	DUMPTOKEN( recruited.lock );
@@ -22,35 +22,11 @@
 
 #include "flow/flow.h"
 #include "flow/Arena.h"
+#include "flow/KeyCompare.h"
 #include "fdbclient/FDBTypes.h"
 #include "fdbserver/Knobs.h"
 #include <string.h>
 
-typedef uint64_t Word;
-static inline int commonPrefixLength(uint8_t const* ap, uint8_t const* bp, int cl) {
-	int i = 0;
-	const int wordEnd = cl - sizeof(Word) + 1;
-
-	for(; i < wordEnd; i += sizeof(Word)) {
-		Word a = *(Word *)ap;
-		Word b = *(Word *)bp;
-		if(a != b) {
-			return i + ctzll(a ^ b) / 8;
-		}
-		ap += sizeof(Word);
-		bp += sizeof(Word);
-	}
-
-	for (; i < cl; i++) {
-		if (*ap != *bp) {
-			return i;
-		}
-		++ap;
-		++bp;
-	}
-	return cl;
-}
-
 static int commonPrefixLength(StringRef a, StringRef b) {
 	return commonPrefixLength(a.begin(), b.begin(), std::min(a.size(), b.size()));
 }
@@ -0,0 +1,78 @@
+/*
+ * SQLitePageCompression.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_SQLITEPAGECOMPRESSION_H
+#define FDBSERVER_SQLITEPAGECOMPRESSION_H
+#pragma once
+
+#include <stdint.h>
+#include "fdbserver/Knobs.h"
+
+// On disk layout of the pages of a SQLite file which the pager codec in KeyValueStoreSQLite may compress.  Such files
+// are created with reserveSize() bytes reserved at the end of each page rather than only room for the page checksum,
+// and the reserve size is recorded in the file header, so whether a page is in this layout never depends on its data.
+//
+// Every page but page 1 of such a file begins with a header owned by the codec.  A compressed page is the header
+// followed by `length` bytes of zlib compressed page image (which includes the page checksum), and the rest of the page
+// slot is unused.  Pages are only stored compressed if this saves at least one _PAGE_SIZE block, so VFSAsync can skip
+// reading and writing the unused blocks at the end of the slot, which are left sparse in the file.  An uncompressed
+// page has a length of 0, and the bytes of the page that the header displaces are kept in its reserved bytes.
+struct CompressedPageHeader {
+	uint32_t length;	// Of the compressed page image, or 0 if the page is stored uncompressed
+	uint32_t unused;	// Zero
+
+	enum { CHECKSUM_SIZE = 8 };  // The size of the page checksum at the very end of each page
+	enum { FILE_HEADER_RESERVE_OFFSET = 20 };  // Where the SQLite file header records the reserve size
+
+	// The reserve size of files in this layout, which holds the displaced bytes of uncompressed pages and the checksum
+	static int reserveSize() {
+		return CHECKSUM_SIZE + (int)sizeof(CompressedPageHeader);
+	}
+
+	// Where the bytes displaced by the header of an uncompressed page are kept
+	static int displacedOffset(int pageSize) {
+		return pageSize - reserveSize();
+	}
+
+	// The largest compressed image that saves a block when stored in a page slot of pageSize bytes
+	static int maxLength(int pageSize) {
+		return pageSize - _PAGE_SIZE - (int)sizeof(CompressedPageHeader);
+	}
+
+	// Returns the header of page if it is compressed, and otherwise NULL.  page must be in this layout, and not page 1.
+	static const CompressedPageHeader* get(const void* page, int pageSize) {
+		auto header = (const CompressedPageHeader*)page;
+		if (header->length == 0 || (int64_t)header->length > maxLength(pageSize) || header->unused != 0)
+			return NULL;
+		return header;
+	}
+
+	// Returns the number of bytes at the beginning of page which must be read or written, which is always a multiple of
+	// _PAGE_SIZE when pageSize is.
+	static int usedBytes(const void* page, int pageSize) {
+		auto header = get(page, pageSize);
+		if (!header)
+			return pageSize;
+		int bytes = sizeof(CompressedPageHeader) + header->length;
+		return (bytes + _PAGE_SIZE - 1) / _PAGE_SIZE * _PAGE_SIZE;
+	}
+};
+
+#endif
@@ -26,21 +26,17 @@
 #include <string>
 #include <vector>
 
-/*
-#ifdef __GNUG__
-#include <smmintrin.h>
-#endif
-*/
 
 #include "flow/Platform.h"
+#include "flow/KeyCompare.h"
 #include "fdbrpc/fdbrpc.h"
 #include "fdbrpc/PerfMetric.h"
 #include "fdbclient/FDBTypes.h"
 #include "fdbclient/KeyRangeMap.h"
 #include "fdbclient/SystemData.h"
 #include "fdbserver/Knobs.h"
-
-#define PARALLEL_THREAD_COUNT 0	// FIXME: When >1, program execution (e.g. random numbers) is/was nondeterministic.  Why?
+#include "fdbserver/ConflictBTree.h"
+#include "flow/UnitTest.h"
 
 using std::min;
 using std::max;
@@ -111,12 +107,7 @@ PerfDoubleCounter
 	;
 
 static force_inline int compare( const StringRef& a, const StringRef& b ) {
-	int c = memcmp( a.begin(), b.begin(), min(a.size(), b.size()) );
-	if (c<0) return -1;
-	if (c>0) return +1;
-	if (a.size() < b.size()) return -1;
-	if (a.size() == b.size()) return 0;
-	return +1;
+	return compareKeys( a.begin(), a.size(), b.begin(), b.size() );
 }
 
 struct ReadConflictRange {
@@ -178,8 +169,8 @@ force_inline bool getCharacter(const KeyInfo& ki, int character, int &outputChar
 
 bool operator < ( const KeyInfo& lhs, const KeyInfo& rhs ) {
 	int i = min(lhs.key.size(), rhs.key.size());
-	int c = memcmp( lhs.key.begin(), rhs.key.begin(), i );
-	if (c!=0) return c<0;
+	int p = commonPrefixLength( lhs.key.begin(), rhs.key.begin(), i );
+	if (p<i) return lhs.key[p] < rhs.key[p];
 
 	// SOMEDAY: This is probably not very fast.  Slows D.Sort by ~20% relative to previous (incorrect) version.
 
@@ -222,61 +213,90 @@ struct SortTask {
 	int size;
 	int character;
 	SortTask(int begin, int size, int character) : begin(begin), size(size), character(character) {}
+	bool operator<(const SortTask& rhs) const { return size < rhs.size; }
 };
 
-void sortPoints(std::vector<KeyInfo>& points){
-	std::vector<SortTask> tasks;
-	std::vector<KeyInfo> newPoints;
-	std::vector<int> counts;
-
-	tasks.emplace_back(0, points.size(), 0);
-
-	while (tasks.size()){
-		SortTask st = tasks.back();
-		tasks.pop_back();
-
-		if (st.size < 10){
-			//smallSort(points, st.begin, st.size);
-			std::sort(points.begin() + st.begin, points.begin() + st.begin + st.size );
-			continue;
+// MSD radix sort of points by the characters returned by getCharacter().  Each task is a range of points that
+// agree on their first task.character characters.  Sorters working on disjoint tasks of the same points can
+// run on different threads.
+class PointSorter : NonCopyable {
+public:
+	explicit PointSorter( std::vector<KeyInfo>& points ) : points(points) {}
+
+	// Completely sorts the points of st
+	void sort( SortTask st ) {
+		tasks.push_back(st);
+		while (tasks.size()) {
+			st = tasks.back();
+			tasks.pop_back();
+			split(st, tasks);
 		}
+	}
 
-		newPoints.resize(st.size);
-		counts.assign(256+5, 0);
+	// Sorts the points of st by their next character, appending the resulting buckets that still need to be
+	// sorted to out
+	void split( SortTask st, std::vector<SortTask>& out ) {
+		if (st.size < 16) {
+			std::sort(points.begin() + st.begin, points.begin() + st.begin + st.size);
+			return;
+		}
 
-		// get counts
+		characters.resize(st.size);
+		memset(counts, 0, sizeof(counts));
 		int c;
 		bool allDone = true;
-		for (int i=st.begin; i<st.begin+st.size; i++){
-			allDone &= getCharacter(points[i], st.character, c);
+		for (int i=0; i<st.size; i++) {
+			allDone &= getCharacter(points[st.begin+i], st.character, c);
+			characters[i] = c;
 			counts[c]++;
 		}
 		if (allDone)
-			continue;
+			return;
+
+		if (counts[characters[0]] == st.size) {
+			// Every point has the same next character, as is usual for keys sharing a long prefix.  Skip the whole
+			// prefix they share without moving anything.
+			out.emplace_back(st.begin, st.size, std::max(st.character+1, sharedPrefix(st)));
+			return;
+		}
 
-		// calculate offsets from counts and build next level of tasks
-		int total=0;
-		for(int i=0;i<counts.size();i++){
+		int total = 0;
+		for (int i=0; i<CharacterCount; i++) {
 			int temp = counts[i];
 			if (temp > 1)
-				tasks.emplace_back(st.begin+total, temp, st.character+1);
+				out.emplace_back(st.begin+total, temp, st.character+1);
 			counts[i] = total;
 			total += temp;
 		}
 
-		// put in their places
-		for (int i=st.begin; i<st.begin+st.size; i++){
-			getCharacter(points[i], st.character, c);
-			newPoints[counts[c]++] = points[i];
-		}
-
-		//copy back into original points array
-		for (int i=0;i<st.size;i++)
-			points[st.begin+i] = newPoints[i];
+		newPoints.resize(st.size);
+		for (int i=0; i<st.size; i++)
+			newPoints[counts[characters[i]]++] = points[st.begin+i];
+		std::copy(newPoints.begin(), newPoints.begin() + st.size, points.begin() + st.begin);
 	}
 
-	//cout << endl << "Radix sort done" << endl;
-}
+private:
+	enum { CharacterCount = 256+5 };
+
+	std::vector<KeyInfo>& points;
+	std::vector<KeyInfo> newPoints;
+	std::vector<uint16_t> characters;
+	std::vector<SortTask> tasks;
+	int counts[CharacterCount];
+
+	// Returns the length of the key prefix shared by all of the points of st, given that they share the first
+	// st.character characters.  Only characters that are bytes of every key are counted.
+	int sharedPrefix( const SortTask& st ) const {
+		StringRef first = points[st.begin].key;
+		int shared = first.size();
+		for (int i=1; i<st.size && shared > st.character; i++) {
+			StringRef key = points[st.begin+i].key;
+			int len = std::min(shared, key.size()) - st.character;
+			shared = len > 0 ? st.character + commonPrefixLength(first.begin() + st.character, key.begin() + st.character, len) : st.character;
+		}
+		return shared;
+	}
+};
 
 class SkipList : NonCopyable
 {
@@ -369,25 +389,16 @@ private:
 				INSTRUMENT_RELEASE("SkipListNodeLarge");
 			}
 		}
-	private:
+
 		int getNodeSize() { return sizeof(Node) + valueLength + nPointers*(sizeof(Node*)+sizeof(Version)); }
+	private:
 		uint8_t* end() { return (uint8_t*)(this+1); }
 		int nPointers,
 			valueLength;
 	};
 
 	static force_inline bool less( const uint8_t* a, int aLen, const uint8_t* b, int bLen ) {
-		int len = min(aLen, bLen);
-		for(int i=0; i<len; i++)
-			if (a[i] < b[i])
-				return true;
-			else if (a[i] > b[i])
-				return false;
-
-		/*int c = memcmp(a,b,min(aLen,bLen));
-		if (c<0) return true;
-		if (c>0) return false;*/
-		return aLen < bLen;
+		return compareKeys( a, aLen, b, bLen ) < 0;
 	}
 
 	Node *header;
@@ -484,6 +495,13 @@ public:
 		return count;
 	}
 
+	int64_t bytes() {
+		int64_t bytes = 0;
+		for(Node* x = header; x; x = x->getNext(0))
+			bytes += x->getNodeSize();
+		return bytes;
+	}
+
 	explicit SkipList( Version version = 0 ) {
 		header = Node::create(StringRef(), MaxLevels-1);
 		for(int l=0; l<MaxLevels; l++) {
@@ -880,12 +898,20 @@ PAction action( F && f ) {
 	return new FAction( std::move(f) );
 };
 
+template <class F>
+void startThreadF( F && func ) {
+	struct Thing {
+		F f;
+		Thing( F && f ) : f(std::move(f)) {}
+		THREAD_FUNC start(void* p) { Thing* self = (Thing*)p; self->f(); delete self; THREAD_RETURN; }
+	};
+	Thing* t = new Thing(std::move(func));
+	startThread(Thing::start, t);
+}
+
 void workerThread( PAction* nextAction, Event* nextActionReady, int index, Event* whenFinished ) {
-	ASSERT(false);
-	/*
-	inThread<Void>( [nextAction,nextActionReady,index,whenFinished]()->Void {
-		g_seed = index*123; fastrand();
-		setAffinity( index );
+	startThreadF( [nextAction,nextActionReady,index,whenFinished]() {
+		g_seed = index*123; skfastrand();
 		while (true) {
 			try {
 				nextActionReady->block();   // auto-reset
@@ -900,10 +926,9 @@ void workerThread( PAction* nextAction, Event* nextActionReady, int index, Event
 				fprintf(stderr, "Error in worker thread: %s\n", unknown_error().what());
 			}
 		}
-		//cout << "Worker thread finished" << endl;
+		releaseAllThreadMagazines();
 		whenFinished->set();
-		return Void();
-	});*/
+	});
 }
 
 StringRef setK( Arena& arena, int i ) {
@@ -924,16 +949,35 @@ StringRef setK( Arena& arena, int i ) {
 #include "fdbserver/ConflictSet.h"
 
 struct ConflictSet {
-	ConflictSet() : oldestVersion(0) {
-		static_assert(PARALLEL_THREAD_COUNT == 0, "workerThread() not implemented");
-		static_assert(PARALLEL_THREAD_COUNT == 0 || FASTALLOC_THREAD_SAFE, "Thread safe fast allocator required for multithreaded conflict set");
-		for (int i = 0; i < PARALLEL_THREAD_COUNT; i++) {
+	// Conflict detection is spread over threadCount() threads: the calling (resolver) thread plus
+	// SERVER_KNOBS->CONFLICT_SET_THREADS-1 dedicated workers.  Worker threads only ever run
+	// detached from the flow event loop, so the simulator always uses the serial path to keep
+	// runs deterministic.
+	enum Type { SkipListType, BTreeType };
+
+	static Type defaultType() {
+		if (SERVER_KNOBS->CONFLICT_SET_TYPE == "skiplist")
+			return SkipListType;
+		if (SERVER_KNOBS->CONFLICT_SET_TYPE == "btree")
+			return BTreeType;
+		TraceEvent(SevError, "InvalidConflictSetType").detail("Type", SERVER_KNOBS->CONFLICT_SET_TYPE);
+		throw invalid_option_value();
+	}
+
+	static int defaultThreads() {
+		return (g_network && g_network->isSimulated()) ? 1 : SERVER_KNOBS->CONFLICT_SET_THREADS;
+	}
+
+	explicit ConflictSet( Type type = defaultType(), int threads = defaultThreads() ) : useBTree(type == BTreeType), oldestVersion(0) {
+		static_assert(FASTALLOC_THREAD_SAFE, "Thread safe fast allocator required for multithreaded conflict set");
+		for (int i = 1; i < threads; i++) {
 			worker_nextAction.push_back( NULL );
 			worker_ready.push_back( new Event );
 			worker_finished.push_back( new Event );
+			worker_done.push_back( new Event );
 		}
 		for(int t=0; t<worker_nextAction.size(); t++)
-			workerThread( &worker_nextAction[t], worker_ready[t], (t)*2, worker_finished[t] );
+			workerThread( &worker_nextAction[t], worker_ready[t], (t+1)*2, worker_finished[t] );
 	}
 	~ConflictSet() {
 		for(int i=0; i<worker_nextAction.size(); i++) {
@@ -943,19 +987,78 @@ struct ConflictSet {
 		// Wait for workers to terminate; otherwise can get crashes at shutdown time
 		for(int i=0; i<worker_finished.size(); i++)
 			worker_finished[i]->block();
+		for(int i=0; i<worker_nextAction.size(); i++) {
+			delete worker_ready[i];
+			delete worker_finished[i];
+			delete worker_done[i];
+		}
+	}
+
+	int threadCount() const { return worker_nextAction.size() + 1; }
+
+	// Runs f(t) for every t in [0, count) and returns once all of them have finished.  f(0) runs on the
+	// calling thread, the rest on worker threads; f must not touch flow state.  If any f(t) throws, the
+	// first such error (by t) is rethrown on the calling thread after all of them have finished.
+	template <class F>
+	void parallelFor( int count, F const& f ) {
+		ASSERT( count <= threadCount() );
+		std::vector<std::exception_ptr> errors( count );
+		for(int t=1; t<count; t++) {
+			Event* done = worker_done[t-1];
+			std::exception_ptr* error = &errors[t];
+			worker_nextAction[t-1] = action( [&f,t,done,error] {
+				try {
+					f(t);
+				} catch (...) {
+					*error = std::current_exception();
+				}
+				done->set();
+			});
+			worker_ready[t-1]->set();
+		}
+		try {
+			f(0);
+		} catch (...) {
+			errors[0] = std::current_exception();
+		}
+		for(int t=1; t<count; t++)
+			worker_done[t-1]->block();
+		for(auto& error : errors)
+			if (error)
+				std::rethrow_exception( error );
+	}
+
+	// Reads the version history for a slice of the batch's read conflict ranges
+	void detectConflicts( ReadConflictRange* ranges, int count, bool* transactionConflictStatus ) {
+		if (useBTree) {
+			for(int r=0; r<count; r++)
+				if (!transactionConflictStatus[ranges[r].transaction] && btreeHistory.hasConflict(ranges[r].begin, ranges[r].end, ranges[r].version))
+					transactionConflictStatus[ranges[r].transaction] = true;
+		} else {
+			versionHistory.detectConflicts( ranges, count, transactionConflictStatus );
+		}
 	}
 
+	int entryCount() { return useBTree ? btreeHistory.count() : versionHistory.count(); }
+	int64_t bytes() { return useBTree ? btreeHistory.bytes() : versionHistory.bytes(); }
+
+	bool useBTree;
 	SkipList versionHistory;
+	ConflictBTree btreeHistory;
 	Key removalKey;
 	Version oldestVersion;
 	std::vector<PAction> worker_nextAction;
 	std::vector<Event*> worker_ready;
 	std::vector<Event*> worker_finished;
+	std::vector<Event*> worker_done;
 };
 
 ConflictSet* newConflictSet() { return new ConflictSet; }
 void clearConflictSet( ConflictSet* cs, Version v ) {
-	SkipList(v).swap( cs->versionHistory );
+	if (cs->useBTree)
+		ConflictBTree(v).swap( cs->btreeHistory );
+	else
+		SkipList(v).swap( cs->versionHistory );
 }
 void destroyConflictSet(ConflictSet* cs) {
 	delete cs;
@@ -1162,7 +1265,7 @@ void ConflictBatch::GetTooOldTransactions(std::vector<int>& tooOldTransactions)
 
 void ConflictBatch::detectConflicts(Version now, Version newOldestVersion, std::vector<int>& nonConflicting, std::vector<int>* tooOldTransactions) {
 	double t = timer();
-	sortPoints( points );
+	sortPoints();
 	//std::sort( combinedReadConflictRanges.begin(), combinedReadConflictRanges.end() );
 	g_sort += timer()-t;
 
@@ -1198,37 +1301,87 @@ void ConflictBatch::detectConflicts(Version now, Version newOldestVersion, std::
 	t = timer();
 	if (newOldestVersion > cs->oldestVersion) {
 		cs->oldestVersion = newOldestVersion;
-		SkipList::Finger finger; 
-		int temp;
-		cs->versionHistory.find( &cs->removalKey, &finger, &temp, 1 );
-		cs->versionHistory.removeBefore( cs->oldestVersion, finger, combinedWriteConflictRanges.size()*3 + 10 );
-		cs->removalKey = finger.getValue();
+		if (cs->useBTree) {
+			cs->btreeHistory.removeBefore( cs->oldestVersion, cs->removalKey, combinedWriteConflictRanges.size()*3 + 10 );
+		} else {
+			SkipList::Finger finger; 
+			int temp;
+			cs->versionHistory.find( &cs->removalKey, &finger, &temp, 1 );
+			cs->versionHistory.removeBefore( cs->oldestVersion, finger, combinedWriteConflictRanges.size()*3 + 10 );
+			cs->removalKey = finger.getValue();
+		}
 	}
 	g_removeBefore += timer()-t;
 }
 
+void ConflictBatch::sortPoints() {
+	PointSorter sorter( points );
+	SortTask all( 0, points.size(), 0 );
+	int parts = parallelism( points.size()/2 );
+	if (parts <= 1) {
+		sorter.sort( all );
+		return;
+	}
+
+	// Split the largest tasks on this thread until none is big enough to unbalance the workers, then give each
+	// of the remaining tasks, largest first, to the least loaded worker
+	int maxTaskSize = std::max<int>( 1, points.size() / (parts*4) );
+	std::vector<SortTask> pending( 1, all ), ready;
+	while (pending.size()) {
+		std::pop_heap( pending.begin(), pending.end() );
+		SortTask st = pending.back();
+		pending.pop_back();
+		if (st.size <= maxTaskSize) {
+			ready.push_back( st );
+			ready.insert( ready.end(), pending.begin(), pending.end() );
+			break;
+		}
+		int oldSize = pending.size();
+		sorter.split( st, pending );
+		for(int i = oldSize; i < pending.size(); i++)
+			std::push_heap( pending.begin(), pending.begin()+i+1 );
+	}
+
+	std::sort( ready.begin(), ready.end(), [](const SortTask& a, const SortTask& b) { return b < a; } );
+	std::vector<std::vector<SortTask>> assigned( parts );
+	std::vector<int64_t> load( parts );
+	for(auto& st : ready) {
+		int t = std::min_element( load.begin(), load.end() ) - load.begin();
+		assigned[t].push_back( st );
+		load[t] += st.size;
+	}
+
+	cs->parallelFor( parts, [&](int t) {
+		PointSorter s( points );
+		for(auto& st : assigned[t])
+			s.sort( st );
+	});
+}
+
 void ConflictBatch::checkReadConflictRanges() {
 	if (!combinedReadConflictRanges.size()) 
 		return;
 
-	if (PARALLEL_THREAD_COUNT) {
-		Event done[PARALLEL_THREAD_COUNT?PARALLEL_THREAD_COUNT:1];
-		for(int t=0; t<PARALLEL_THREAD_COUNT; t++) {
-			cs->worker_nextAction[t] = action( [&,t] {
-#pragma GCC diagnostic push
-DISABLE_ZERO_DIVISION_FLAG
-				auto begin = &combinedReadConflictRanges[0] + t*combinedReadConflictRanges.size()/PARALLEL_THREAD_COUNT;
-				auto end = &combinedReadConflictRanges[0] + (t+1)*combinedReadConflictRanges.size()/PARALLEL_THREAD_COUNT;
-#pragma GCC diagnostic pop
-				cs->versionHistory.detectConflicts( begin, end-begin, transactionConflictStatus );
-				done[t].set();
-			});
-			cs->worker_ready[t]->set();
-		}
-		for(int i=0; i<PARALLEL_THREAD_COUNT; i++)
-			done[i].block();
+	int parts = parallelism( combinedReadConflictRanges.size() );
+	if (parts > 1) {
+		// The version history is only read here, so every thread walks the shared skiplist with its own
+		// slice of the read ranges.  Each slice records conflicts privately so that two threads never
+		// write the same transaction's status; the results are OR-ed together afterwards.
+		std::vector<std::unique_ptr<bool[]>> status( parts );
+		for(int t=1; t<parts; t++)
+			status[t].reset( new bool[ transactionCount ]() );
+
+		cs->parallelFor( parts, [&](int t) {
+			auto begin = &combinedReadConflictRanges[0] + t*combinedReadConflictRanges.size()/parts;
+			auto end = &combinedReadConflictRanges[0] + (t+1)*combinedReadConflictRanges.size()/parts;
+			cs->detectConflicts( begin, end-begin, t ? status[t].get() : transactionConflictStatus );
+		});
+
+		for(int t=1; t<parts; t++)
+			for(int i=0; i<transactionCount; i++)
+				transactionConflictStatus[i] |= status[t][i];
 	} else {
-		cs->versionHistory.detectConflicts( &combinedReadConflictRanges[0], combinedReadConflictRanges.size(), transactionConflictStatus );
+		cs->detectConflicts( &combinedReadConflictRanges[0], combinedReadConflictRanges.size(), transactionConflictStatus );
 	}
 }
 
@@ -1261,40 +1414,52 @@ void ConflictBatch::mergeWriteConflictRanges(Version now) {
 	if (!combinedWriteConflictRanges.size()) 
 		return;
 
-	if (PARALLEL_THREAD_COUNT) {
+	if (cs->useBTree) {
+		for(auto w = combinedWriteConflictRanges.begin(); w != combinedWriteConflictRanges.end(); ++w)
+			cs->btreeHistory.addConflictRange( w->first, w->second, now );
+		return;
+	}
+
+	// Choose split points among the begin keys of the combined write ranges.  A split key must not also be
+	// the end of the preceding range: the partition to its left would then insert an entry at the split key
+	// (see SkipList::partition()) which concatenate() would duplicate.
+	int parallel = parallelism( combinedWriteConflictRanges.size() );
+	std::vector<int> splitIndices;
+	for(int s=1; s<parallel; s++) {
+		int i = std::max<int>( s*combinedWriteConflictRanges.size()/parallel, splitIndices.size() ? splitIndices.back()+1 : 1 );
+		while (i < combinedWriteConflictRanges.size() && combinedWriteConflictRanges[i-1].second == combinedWriteConflictRanges[i].first)
+			i++;
+		if (i >= combinedWriteConflictRanges.size())
+			break;
+		splitIndices.push_back(i);
+	}
+
+	if (splitIndices.size()) {
 		std::vector<SkipList> parts;
-		for (int i = 0; i < PARALLEL_THREAD_COUNT; i++)
+		for (int i = 0; i <= splitIndices.size(); i++)
 			parts.emplace_back();
 
-		std::vector<StringRef> splits( parts.size()-1 );
+		std::vector<StringRef> splits( splitIndices.size() );
 		for(int s=0; s<splits.size(); s++)
-			splits[s] = combinedWriteConflictRanges[ (s+1)*combinedWriteConflictRanges.size()/parts.size() ].first;
+			splits[s] = combinedWriteConflictRanges[ splitIndices[s] ].first;
 
-		cs->versionHistory.partition( splits.size() ? &splits[0] : NULL, splits.size(), &parts[0] );
-		std::vector<double> tstart(PARALLEL_THREAD_COUNT), tend(PARALLEL_THREAD_COUNT);
-		Event done[PARALLEL_THREAD_COUNT ? PARALLEL_THREAD_COUNT : 1];
 		double before = timer();
-		for(int t=0; t<parts.size(); t++) {
-			cs->worker_nextAction[t] = action( [&,t] {
-				tstart[t] = timer();
-				auto begin = combinedWriteConflictRanges.begin() + (t*combinedWriteConflictRanges.size()/parts.size());
-				auto end = combinedWriteConflictRanges.begin() + ((t+1)*combinedWriteConflictRanges.size()/parts.size());
+		cs->versionHistory.partition( &splits[0], splits.size(), &parts[0] );
+		std::vector<double> tstart(parts.size()), tend(parts.size());
+		double launch = timer();
+		cs->parallelFor( parts.size(), [&](int t) {
+			tstart[t] = timer();
+			auto begin = combinedWriteConflictRanges.begin() + (t ? splitIndices[t-1] : 0);
+			auto end = t < splitIndices.size() ? combinedWriteConflictRanges.begin() + splitIndices[t] : combinedWriteConflictRanges.end();
 
-				addConflictRanges(now, begin, end, &parts[t]);
+			addConflictRanges(now, begin, end, &parts[t]);
 
-				tend[t] = timer();
-				done[t].set();
-			});
-			cs->worker_ready[t]->set();
-		}
-		double launch = timer();
-		for(int i=0; i<PARALLEL_THREAD_COUNT; i++)
-			done[i].block();
+			tend[t] = timer();
+		});
 		double after = timer();
 
 		g_merge_launch += launch-before;
-		//g_merge_start_var += *std::max_element(tstart.begin(), tstart.end()) - before;
-		g_merge_fork += *std::min_element(tstart.begin(), tstart.end()) - before;
+		g_merge_fork += *std::min_element(tstart.begin(), tstart.end()) - launch;
 		g_merge_start_var += *std::max_element(tstart.begin(), tstart.end()) - *std::min_element(tstart.begin(), tstart.end());
 		g_merge_end_var += *std::max_element(tend.begin(), tend.end()) - *std::min_element(tend.begin(), tend.end());
 		g_merge_join += after - *std::max_element(tend.begin(), tend.end());
@@ -1317,6 +1482,12 @@ void ConflictBatch::mergeWriteConflictRanges(Version now) {
 	//	versionHistory.addConflictRange( w->first.begin(), w->first.size(), w->second.begin(), w->second.size(), now );
 }
 
+int ConflictBatch::parallelism( int rangeCount ) const {
+	if (rangeCount < SERVER_KNOBS->CONFLICT_SET_PARALLEL_MIN_RANGES)
+		return 1;
+	return std::max( 1, std::min( cs->threadCount(), rangeCount / std::max(1, SERVER_KNOBS->CONFLICT_SET_PARALLEL_MIN_RANGES / 2) ) );
+}
+
 void ConflictBatch::combineWriteConflictRanges()
 {
 	int activeWriteCount = 0;
@@ -1338,59 +1509,6 @@ void ConflictBatch::combineWriteConflictRanges()
 
 //void showNumaStatus();
 
-/*
-bool sse4Less( const uint8_t* a, int aLen, const uint8_t* b, int bLen ) {
-	while (true) {
-		int res = _mm_cmpestri(*(__m128i*)a, aLen, *(__m128i*)b, bLen, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT );
-		printf("%d ", res);
-		if (res == 16) {
-			if (bLen < 16) return false;
-			a += 16; b += 16; aLen -= 16; bLen -= 16;
-		}
-		if (res == bLen) return false;
-		if (res == aLen) return true;
-
-		return a[res] < b[res];
-	}
-}
-
-void tless( const char* a, const char* b ) {
-	bool x = sse4Less( (const uint8_t*)a, strlen(a), (const uint8_t*)b, strlen(b) );
-	if (x)
-		printf("%s < %s\n", a, b);
-	else
-		printf("%s >= %s\n", a, b);
-}
-
-void sse4Test(){
-
-	tless("hello", "world");
-	tless("a", "a");
-	tless("world", "hello");
-	tless("world", "worry");
-	tless("worry", "world");
-	tless("hello", "hello1");
-	tless("hello1", "hello");
-
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworld");
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworld", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello");
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworld", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworry");
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworry", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaworld");
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello1");
-	tless("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello1", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahello");
-
-	char *a = "hello1worldthisisalonglonglongstring";
-	char *b = "hello";
-	__m128i aa = *(__m128i*)a;
-	__m128i bb = *(__m128i*)a;
-
-	int res = _mm_cmpestri(aa, 2, bb, 2, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT );
-
-	cout << res << endl;
-
-}
-*/
-
 void miniConflictSetTest() {
 	for(int i=0; i<2000000; i++) {
 		int size = 64*5;		// Also run 64*64*5 to test multiple words of andValues and orValues
@@ -1409,51 +1527,20 @@ void miniConflictSetTest() {
 	printf("miniConflictSetTest complete\n");
 }
 
-void skipListTest() {
-	printf("Skip list test\n");
-
-	//sse4Test();
-
-	//A test case that breaks the old operator<
-	//KeyInfo a( LiteralStringRef("hello"), true, false, true, -1 );
-	//KeyInfo b( LiteralStringRef("hello\0"), false, false, false, 0 );
-
-	miniConflictSetTest();
-
-
-	setAffinity(0);
-	//showNumaStatus();
-
-	double start;
+static std::vector<std::vector<int>> conflictSetBenchmark( ConflictSet::Type type, const char* name, VectorRef< VectorRef<KeyRangeRef> > testData ) {
+	for(int c=0; c<skc.size(); c++)
+		skc[c]->clear();
 
-	ConflictSet* cs = newConflictSet();
-
-	Arena testDataArena;
-	VectorRef< VectorRef<KeyRangeRef> > testData;
-	testData.resize(testDataArena, 500);
-	std::vector<std::vector<uint8_t>> success( testData.size() );
-	std::vector<std::vector<uint8_t>> success2( testData.size() );
-	for(int i=0; i<testData.size(); i++) {
-		testData[i].resize(testDataArena, 5000);
-		success[i].assign( testData[i].size(), false );
-		success2[i].assign( testData[i].size(), false );
-		for(int j=0; j<testData[i].size(); j++) {
-			int key = deterministicRandom()->randomInt(0, 20000000);
-			int key2 = key + 1 + deterministicRandom()->randomInt(0, 10);
-			testData[i][j] = KeyRangeRef(
-				setK( testDataArena, key ),
-				setK( testDataArena, key2 ) );
-		}
-	}
-	printf("Test data generated (%d)\n", deterministicRandom()->randomInt(0,100000));
-	printf("  %d threads, %d batches, %d/batch\n", PARALLEL_THREAD_COUNT, testData.size(), testData[0].size());
+	ConflictSet* cs = new ConflictSet( type );
+	printf("%s conflict set\n", name);
+	printf("  %d threads, %d batches, %d/batch\n", cs->threadCount(), testData.size(), testData[0].size());
 
 	printf("Running\n");
 
 	int readCount = 1, writeCount = 1;
-	int cranges = 0, tcount = 0;
+	int cranges = 0, tcount = 0, reads = 0;
 
-	start = timer();
+	double start = timer();
 	std::vector<std::vector<int>> nonConflict( testData.size() );
 	for(int i=0; i<testData.size(); i++) {
 		Arena buf;
@@ -1470,6 +1557,7 @@ void skipListTest() {
 				tr.write_conflict_ranges.push_back( buf, r );
 			}
 			cranges += tr.read_conflict_ranges.size() + tr.write_conflict_ranges.size();
+			reads += tr.read_conflict_ranges.size();
 			tr.read_snapshot = i;
 			trs.push_back(tr);
 		}
@@ -1497,10 +1585,13 @@ void skipListTest() {
 	printf("                  %0.3f Mkeys/sec\n", cranges*2/elapsed/1e6);
 
 	elapsed = g_checkRead.getValue() + g_merge.getValue();
-	printf("Skiplist only:    %0.3f sec\n", elapsed);
+	printf("%-8s only:    %0.3f sec\n", name, elapsed);
 	printf("                  %0.3f Mtransactions/sec\n", tcount/elapsed/1e6);
 	printf("                  %0.3f Mkeys/sec\n", cranges*2/elapsed/1e6);
 
+	elapsed = g_checkRead.getValue();
+	printf("Read checks:      %0.3f Mlookups/sec\n", reads/elapsed/1e6);
+
 	printf("Performance counters:\n");
 	for(int c=0; c<skc.size(); c++) {
 		printf("%20s: %s\n", skc[c]->getMetric().name().c_str(), skc[c]->getMetric().formatted().c_str());
@@ -1508,7 +1599,82 @@ void skipListTest() {
 
 	//showNumaStatus();
 
-	printf("%d entries in version history\n", cs->versionHistory.count());
+	int entries = cs->entryCount();
+	printf("%d entries in version history, %0.1f bytes/entry\n", entries, double(cs->bytes())/entries);
+
+	destroyConflictSet(cs);
+	return nonConflict;
+}
+
+// Sorts the conflict points of each batch of testData, in the order ConflictBatch::addTransaction produces them,
+// with std::sort and with PointSorter
+static void sortPointsBenchmark( VectorRef< VectorRef<KeyRangeRef> > testData ) {
+	std::vector<std::vector<KeyInfo>> batches( testData.size() );
+	int index = 0;
+	for(int i=0; i<testData.size(); i++) {
+		for(int j=0; j<testData[i].size(); j++) {
+			bool write = j&1;
+			batches[i].emplace_back( testData[i][j].begin, false, true, write, j/2, &index );
+			batches[i].emplace_back( testData[i][j].end, false, false, write, j/2, &index );
+		}
+	}
+
+	double comparisonTime = 0, radixTime = 0;
+	bool correct = true;
+	for(auto& batch : batches) {
+		std::vector<KeyInfo> expected = batch;
+		double t = timer();
+		std::sort( expected.begin(), expected.end() );
+		comparisonTime += timer()-t;
+
+		t = timer();
+		PointSorter( batch ).sort( SortTask( 0, batch.size(), 0 ) );
+		radixTime += timer()-t;
+
+		for(int i=0; i<batch.size(); i++)
+			correct = correct && !(batch[i] < expected[i]) && !(expected[i] < batch[i]);
+	}
+	printf("Sorting conflict points of %d batches of %d:\n", (int)batches.size(), (int)batches[0].size());
+	printf("  std::sort:        %0.3f sec\n", comparisonTime);
+	printf("  Radix sort:       %0.3f sec\n", radixTime);
+	if (!correct)
+		printf("ERROR: radix sort order differs from std::sort!\n");
+}
+
+void skipListTest() {
+	printf("Skip list test\n");
+
+	//A test case that breaks the old operator<
+	//KeyInfo a( LiteralStringRef("hello"), true, false, true, -1 );
+	//KeyInfo b( LiteralStringRef("hello\0"), false, false, false, 0 );
+
+	miniConflictSetTest();
+
+
+	setAffinity(0);
+	//showNumaStatus();
+
+	Arena testDataArena;
+	VectorRef< VectorRef<KeyRangeRef> > testData;
+	testData.resize(testDataArena, 500);
+	for(int i=0; i<testData.size(); i++) {
+		testData[i].resize(testDataArena, 5000);
+		for(int j=0; j<testData[i].size(); j++) {
+			int key = deterministicRandom()->randomInt(0, 20000000);
+			int key2 = key + 1 + deterministicRandom()->randomInt(0, 10);
+			testData[i][j] = KeyRangeRef(
+				setK( testDataArena, key ),
+				setK( testDataArena, key2 ) );
+		}
+	}
+	printf("Test data generated (%d)\n", deterministicRandom()->randomInt(0,100000));
+
+	sortPointsBenchmark( testData );
+
+	auto nonConflict = conflictSetBenchmark( ConflictSet::SkipListType, "Skiplist", testData );
+	auto nonConflictBTree = conflictSetBenchmark( ConflictSet::BTreeType, "BTree", testData );
+	if (nonConflict != nonConflictBTree)
+		printf("ERROR: skiplist and btree conflict sets disagree!\n");
 
 	/*start = timer();
 	vector<vector<int>> nonConflict2( testData.size() );
@@ -1549,3 +1715,57 @@ void skipListTest() {
 	//for(int i=0; i<testData.size(); i++)
 	//	printf("%d %d %d %d\n", i, nonConflict[i].size(), nonConflict2[i].size()-nonConflict[i].size(), nonConflict[i] != nonConflict2[i]);
 }
+
+// Resolves the same random batches with a serial and a parallel conflict set of each type
+TEST_CASE("/fdbserver/ConflictSet/parallel") {
+	for(auto type : { ConflictSet::SkipListType, ConflictSet::BTreeType }) {
+		std::unique_ptr<ConflictSet> serial( new ConflictSet( type, 1 ) );
+		std::unique_ptr<ConflictSet> parallel( new ConflictSet( type, 4 ) );
+		ASSERT( parallel->threadCount() == 4 );
+
+		for(int i=0; i<20; i++) {
+			Arena arena;
+			std::vector<CommitTransactionRef> trs( deterministicRandom()->randomInt(1, 1500) );
+			for(auto& tr : trs) {
+				for(int r = deterministicRandom()->randomInt(0, 4); r; r--) {
+					int key = deterministicRandom()->randomInt(0, 20000);
+					KeyRangeRef range( setK( arena, key ), setK( arena, key + 1 + deterministicRandom()->randomInt(0, 10) ) );
+					if (deterministicRandom()->coinflip())
+						tr.read_conflict_ranges.push_back( arena, range );
+					else
+						tr.write_conflict_ranges.push_back( arena, range );
+				}
+				tr.read_snapshot = std::max( 0, i - deterministicRandom()->randomInt(0, 8) );
+			}
+
+			std::vector<int> serialCommitted, serialTooOld, parallelCommitted, parallelTooOld;
+			ConflictBatch serialBatch( serial.get() ), parallelBatch( parallel.get() );
+			for(auto& tr : trs) {
+				serialBatch.addTransaction( tr );
+				parallelBatch.addTransaction( tr );
+			}
+			serialBatch.detectConflicts( i+1, std::max( 0, i-5 ), serialCommitted, &serialTooOld );
+			parallelBatch.detectConflicts( i+1, std::max( 0, i-5 ), parallelCommitted, &parallelTooOld );
+			ASSERT( serialCommitted == parallelCommitted );
+			ASSERT( serialTooOld == parallelTooOld );
+		}
+		ASSERT( serial->entryCount() == parallel->entryCount() );
+
+		// An error in any thread reaches the caller once all of them are done
+		for(int thrower = 0; thrower < 4; thrower++) {
+			std::vector<int> ran( 4 );
+			try {
+				parallel->parallelFor( 4, [&](int t) {
+					ran[t] = 1;
+					if (t == thrower)
+						throw io_error();
+				});
+				ASSERT( false );
+			} catch (Error& e) {
+				ASSERT( e.code() == error_code_io_error );
+			}
+			ASSERT( std::accumulate( ran.begin(), ran.end(), 0 ) == 4 );
+		}
+	}
+	return Void();
+}
@@ -442,6 +442,9 @@ struct RolesInfo {
 			obj.setKeyRawNumber("kvstore_free_bytes", storageMetrics.getValue("KvstoreBytesFree"));
 			obj.setKeyRawNumber("kvstore_available_bytes", storageMetrics.getValue("KvstoreBytesAvailable"));
 			obj.setKeyRawNumber("kvstore_total_bytes", storageMetrics.getValue("KvstoreBytesTotal"));
+			// Only the memory storage engine reports the memory it uses per key-value pair
+			if(storageMetrics.getInt64("KvstoreBytesPerKV") > 0)
+				obj.setKeyRawNumber("kvstore_bytes_per_kv", storageMetrics.getValue("KvstoreBytesPerKV"));
 			obj["input_bytes"] = StatusCounter(storageMetrics.getValue("BytesInput")).getStatus();
 			obj["durable_bytes"] = StatusCounter(storageMetrics.getValue("BytesDurable")).getStatus();
 			obj.setKeyRawNumber("query_queue_max", storageMetrics.getValue("QueryQueueMax"));
@@ -474,6 +477,13 @@ struct RolesInfo {
 				obj["read_latency_bands"] = addLatencyBandInfo(readLatencyMetrics);
 			}
 
+			// Only the ssd engine logs spring cleaning counters
+			TraceEventFields const& springCleaningCounters = metrics.at("SpringCleaningCounters");
+			if(springCleaningCounters.size()) {
+				obj["kvstore_reclaimed_bytes"] = StatusCounter(springCleaningCounters.getValue("ReclaimedBytes")).getStatus();
+				obj["kvstore_released_bytes"] = StatusCounter(springCleaningCounters.getValue("ReleasedBytes")).getStatus();
+			}
+
 			JsonBuilderObject dataLag;
 			dataLag["versions"] = versionLag;
 			dataLagSeconds = versionLag / (double)SERVER_KNOBS->VERSIONS_PER_SECOND;
@@ -1438,7 +1448,7 @@ static Future<vector<std::pair<iface, EventMap>>> getServerMetrics(vector<iface>
 ACTOR static Future<vector<std::pair<StorageServerInterface, EventMap>>> getStorageServersAndMetrics(Database cx, std::unordered_map<NetworkAddress, WorkerInterface> address_workers) {
 	vector<StorageServerInterface> servers = wait(timeoutError(getStorageServers(cx, true), 5.0));
 	vector<std::pair<StorageServerInterface, EventMap>> results = wait(
-	    getServerMetrics(servers, address_workers, std::vector<std::string>{ "StorageMetrics", "ReadLatencyMetrics" }));
+	    getServerMetrics(servers, address_workers, std::vector<std::string>{ "StorageMetrics", "ReadLatencyMetrics", "SpringCleaningCounters" }));
 
 	return results;
 }
@@ -48,6 +48,7 @@ struct TLogInterface {
 	RequestStream< struct TLogDisablePopRequest> disablePopRequest;
 	RequestStream< struct TLogEnablePopRequest> enablePopRequest;
 	RequestStream< struct TLogSnapRequest> snapRequest;
+	RequestStream< struct TLogPeekStreamRequest > peekStreamMessages;
 
 	
 	TLogInterface() {}
@@ -63,6 +64,7 @@ struct TLogInterface {
 		getQueuingMetrics.getEndpoint( TaskPriority::TLogQueuingMetrics );
 		popMessages.getEndpoint( TaskPriority::TLogPop );
 		peekMessages.getEndpoint( TaskPriority::TLogPeek );
+		peekStreamMessages.getEndpoint( TaskPriority::TLogPeek );
 		confirmRunning.getEndpoint( TaskPriority::TLogConfirmRunning );
 		commit.getEndpoint( TaskPriority::TLogCommit );
 	}
@@ -74,7 +76,7 @@ struct TLogInterface {
 		}
 		serializer(ar, uniqueID, sharedTLogID, locality, peekMessages, popMessages
 		  , commit, lock, getQueuingMetrics, confirmRunning, waitFailure, recoveryFinished
-		  , disablePopRequest, enablePopRequest, snapRequest);
+		  , disablePopRequest, enablePopRequest, snapRequest, peekStreamMessages);
 	}
 };
 
@@ -156,10 +158,11 @@ struct TLogPeekReply {
 	Version minKnownCommittedVersion;
 	Optional<Version> begin;
 	bool onlySpilled;
+	uint32_t uncompressedBytes = 0; // If nonzero, messages is compressed (see LogMessageCompression.h)
 
 	template <class Ar>
 	void serialize(Ar& ar) {
-		serializer(ar, arena, messages, end, popped, maxKnownVersion, minKnownCommittedVersion, begin, onlySpilled);
+		serializer(ar, arena, messages, end, popped, maxKnownVersion, minKnownCommittedVersion, begin, onlySpilled, uncompressedBytes);
 	}
 };
 
@@ -182,6 +185,30 @@ struct TLogPeekRequest {
 	}
 };
 
+// Subscribes to the messages for a tag, which the TLog pushes to replies as versions are committed, instead of waiting
+// for a peek request for each batch.  Each pushed reply has begin set to the end of the one before it.  The request
+// which opens a stream has sequence (id, 0).  Later requests with the same id and no replies acknowledge that the
+// cursor has consumed sequence.second replies, which lets the TLog push up to TLOG_PEEK_STREAM_WINDOW more, or close
+// the stream if sequence.second is negative.  reply is sent when the TLog ends the stream because the cursor needs
+// data that is spilled or popped, which it then reads with TLogPeekRequests.
+struct TLogPeekStreamRequest {
+	constexpr static FileIdentifier file_identifier = 10072821;
+	Arena arena;
+	Version begin;
+	Tag tag;
+	std::pair<UID, int> sequence;
+	Optional<RequestStream<TLogPeekReply>> replies;
+	ReplyPromise<Void> reply;
+
+	TLogPeekStreamRequest( Version begin, Tag tag, std::pair<UID, int> sequence, Optional<RequestStream<TLogPeekReply>> replies = Optional<RequestStream<TLogPeekReply>>() ) : begin(begin), tag(tag), sequence(sequence), replies(replies) {}
+	TLogPeekStreamRequest() {}
+
+	template <class Ar>
+	void serialize(Ar& ar) {
+		serializer(ar, arena, begin, tag, sequence, replies, reply);
+	}
+};
+
 struct TLogPopRequest {
 	constexpr static FileIdentifier file_identifier = 5556423;
 	Arena arena;
@@ -222,16 +249,17 @@ struct TLogCommitRequest {
 	Version prevVersion, version, knownCommittedVersion, minKnownCommittedVersion;
 
 	StringRef messages;// Each message prefixed by a 4-byte length
+	uint32_t uncompressedBytes; // If nonzero, messages is compressed (see LogMessageCompression.h)
 
 	ReplyPromise<Version> reply;
 	Optional<UID> debugID;
 
-	TLogCommitRequest() {}
-	TLogCommitRequest( const Arena& a, Version prevVersion, Version version, Version knownCommittedVersion, Version minKnownCommittedVersion, StringRef messages, Optional<UID> debugID )
-		: arena(a), prevVersion(prevVersion), version(version), knownCommittedVersion(knownCommittedVersion), minKnownCommittedVersion(minKnownCommittedVersion), messages(messages), debugID(debugID) {}
+	TLogCommitRequest() : uncompressedBytes(0) {}
+	TLogCommitRequest( const Arena& a, Version prevVersion, Version version, Version knownCommittedVersion, Version minKnownCommittedVersion, StringRef messages, Optional<UID> debugID, uint32_t uncompressedBytes = 0 )
+		: arena(a), prevVersion(prevVersion), version(version), knownCommittedVersion(knownCommittedVersion), minKnownCommittedVersion(minKnownCommittedVersion), messages(messages), uncompressedBytes(uncompressedBytes), debugID(debugID) {}
 	template <class Ar>
 	void serialize( Ar& ar ) {
-		serializer(ar, prevVersion, version, knownCommittedVersion, minKnownCommittedVersion, messages, reply, arena, debugID);
+		serializer(ar, prevVersion, version, knownCommittedVersion, minKnownCommittedVersion, messages, reply, arena, debugID, uncompressedBytes);
 	}
 };
 
@@ -37,6 +37,7 @@
 #include "fdbrpc/simulator.h"
 #include "fdbserver/ServerDBInfo.h"
 #include "fdbserver/LogSystem.h"
+#include "fdbserver/LogMessageCompression.h"
 #include "fdbserver/WaitFailure.h"
 #include "fdbserver/RecoveryState.h"
 #include "fdbserver/FDBExecHelper.actor.h"
@@ -47,23 +48,90 @@ using std::make_pair;
 using std::min;
 using std::max;
 
+// The offsets of the messages for one tag within the (uncompressed) messages of a commit
+struct TagMessageOffsetsRef {
+	Tag tag;
+	VectorRef<uint32_t> offsets;
+
+	TagMessageOffsetsRef() {}
+	explicit TagMessageOffsetsRef(Tag tag) : tag(tag) {}
+	TagMessageOffsetsRef(Arena &a, TagMessageOffsetsRef const &from) : tag(from.tag), offsets(a, from.offsets) {}
+
+	template <class Ar>
+	void serialize(Ar& ar) {
+		serializer(ar, tag, offsets);
+	}
+	size_t expectedSize() const {
+		return offsets.expectedSize();
+	}
+};
+
+// Indexes the consecutive messages of a commit by tag, so that peeks of spilled data can find the messages for their tag
+// without parsing the tags of every message.  The txs tags are spilled by value, so their messages are never read back
+// from the queue and are left out.
+static VectorRef<TagMessageOffsetsRef> indexMessagesByTag( Arena& arena, std::vector<TagsAndMessage> const& taggedMessages ) {
+	std::vector<std::pair<Tag, uint32_t>> tagOffsets;
+	tagOffsets.reserve( taggedMessages.size() * 3 );
+	uint32_t offset = 0;
+	for(auto& msg : taggedMessages) {
+		for(auto tag : msg.tags) {
+			if(tag.locality != tagLocalityTxs && tag != txsTag) {
+				tagOffsets.push_back( std::make_pair(tag, offset) );
+			}
+		}
+		offset += msg.message.size();
+	}
+	std::sort( tagOffsets.begin(), tagOffsets.end() );
+
+	VectorRef<TagMessageOffsetsRef> index;
+	for(int i = 0; i < tagOffsets.size(); ) {
+		int j = i;
+		while(j < tagOffsets.size() && tagOffsets[j].first == tagOffsets[i].first) {
+			j++;
+		}
+		index.push_back( arena, TagMessageOffsetsRef(tagOffsets[i].first) );
+		index.back().offsets.reserve( arena, j - i );
+		for(; i < j; i++) {
+			index.back().offsets.push_back( arena, tagOffsets[i].second );
+		}
+	}
+	return index;
+}
+
 struct TLogQueueEntryRef {
 	UID id;
 	Version version;
 	Version knownCommittedVersion;
 	StringRef messages;
+	uint32_t uncompressedBytes; // If nonzero, messages is kept as the proxy compressed it
+	Optional<VectorRef<TagMessageOffsetsRef>> tagIndex; // Not present in entries written without TLOG_SPILL_TAG_INDEX
 
-	TLogQueueEntryRef() : version(0), knownCommittedVersion(0) {}
+	TLogQueueEntryRef() : version(0), knownCommittedVersion(0), uncompressedBytes(0) {}
 	TLogQueueEntryRef(Arena &a, TLogQueueEntryRef const &from)
-	  : version(from.version), knownCommittedVersion(from.knownCommittedVersion), id(from.id), messages(a, from.messages) {
+	  : version(from.version), knownCommittedVersion(from.knownCommittedVersion), id(from.id), messages(a, from.messages), uncompressedBytes(from.uncompressedBytes),
+	    tagIndex(a, from.tagIndex) {
 	}
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		serializer(ar, version, messages, knownCommittedVersion, id);
+		if (ar.protocolVersion().hasCompressedTLogMessages()) {
+			serializer(ar, uncompressedBytes);
+		}
+		if (ar.protocolVersion().hasTLogQueueTagIndex()) {
+			serializer(ar, tagIndex);
+		}
+	}
+
+	// Replaces compressed messages with the uncompressed messages, allocated in arena
+	void decompress(Arena& arena) {
+		if(uncompressedBytes) {
+			messages = decompressLogMessages(arena, messages, uncompressedBytes);
+			uncompressedBytes = 0;
+		}
 	}
 	size_t expectedSize() const {
-		return messages.expectedSize();
+		return messages.expectedSize() + (tagIndex.present() ? tagIndex.get().expectedSize() : 0);
 	}
 };
 
@@ -84,6 +152,18 @@ struct AlternativeTLogQueueEntryRef {
 			ar.serializeBytes( msg.message );
 		}
 		serializer(ar, knownCommittedVersion, id);
+		if (ar.protocolVersion().hasCompressedTLogMessages()) {
+			uint32_t uncompressedBytes = 0;
+			serializer(ar, uncompressedBytes);
+		}
+		if (ar.protocolVersion().hasTLogQueueTagIndex()) {
+			Arena indexArena;
+			Optional<VectorRef<TagMessageOffsetsRef>> tagIndex;
+			if(SERVER_KNOBS->TLOG_SPILL_TAG_INDEX) {
+				tagIndex = indexMessagesByTag(indexArena, *alternativeMessages);
+			}
+			serializer(ar, tagIndex);
+		}
 	}
 
 	uint32_t expectedSize() const {
@@ -175,6 +255,7 @@ private:
 				Arena a = e.arena();
 				ArenaReader ar( a, e.substr(0, payloadSize), IncludeVersion() );
 				ar >> result;
+				result.decompress(result.arena());
 				const IDiskQueue::location endloc = self->queue->getNextReadLocation();
 				self->updateVersionSizes(result, tLog, startloc, endloc);
 				return result;
@@ -473,6 +554,7 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 	CounterCollection cc;
 	Counter bytesInput;
 	Counter bytesDurable;
+	Counter peekStreamReplies;
 
 	UID logId;
 	ProtocolVersion protocolVersion;
@@ -490,6 +572,22 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 
 	std::map<UID, PeekTrackerData> peekTracker;
 
+	struct PeekStreamData : ReferenceCounted<PeekStreamData> {
+		NotifiedVersion consumed; // The number of pushed replies the cursor has acknowledged
+		Promise<Void> closed;
+	};
+
+	std::map<UID, Reference<PeekStreamData>> peekStreams;
+
+	// A stopped log receives no more versions, so its streams end and their cursors go back to peek requests
+	void closePeekStreams() {
+		for(auto& it : peekStreams) {
+			if(it.second->closed.canBeSet()) {
+				it.second->closed.send(Void());
+			}
+		}
+	}
+
 	Reference<AsyncVar<Reference<ILogSystem>>> logSystem;
 	Tag remoteTag;
 	bool isPrimary;
@@ -504,7 +602,7 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 	int txsTags;
 
 	explicit LogData(TLogData* tLogData, TLogInterface interf, Tag remoteTag, bool isPrimary, int logRouterTags, int txsTags, UID recruitmentID, ProtocolVersion protocolVersion, std::vector<Tag> tags) : tLogData(tLogData), knownCommittedVersion(0), logId(interf.id()),
-			cc("TLog", interf.id().toString()), bytesInput("BytesInput", cc), bytesDurable("BytesDurable", cc), remoteTag(remoteTag), isPrimary(isPrimary), logRouterTags(logRouterTags), txsTags(txsTags), recruitmentID(recruitmentID), protocolVersion(protocolVersion),
+			cc("TLog", interf.id().toString()), bytesInput("BytesInput", cc), bytesDurable("BytesDurable", cc), peekStreamReplies("PeekStreamReplies", cc), remoteTag(remoteTag), isPrimary(isPrimary), logRouterTags(logRouterTags), txsTags(txsTags), recruitmentID(recruitmentID), protocolVersion(protocolVersion),
 			logSystem(new AsyncVar<Reference<ILogSystem>>()), logRouterPoppedVersion(0), durableKnownCommittedVersion(0), minKnownCommittedVersion(0), queuePoppedVersion(0), allTags(tags.begin(), tags.end()), terminated(tLogData->terminated.getFuture()),
 			// These are initialized differently on init() or recovery
 			recoveryCount(), stopped(false), initialized(false), queueCommittingVersion(0), newPersistentDataVersion(invalidVersion), unrecoveredBefore(1), recoveredAt(1), unpoppedRecoveredTags(0),
@@ -631,6 +729,7 @@ ACTOR Future<Void> tLogLock( TLogData* self, ReplyPromise< TLogLockResult > repl
 	unregisterTLog(logData->logId);
 
 	logData->stopped = true;
+	logData->closePeekStreams();
 	if(!logData->recoveryComplete.isSet()) {
 		logData->recoveryComplete.sendError(end_of_stream());
 	}
@@ -1142,7 +1241,7 @@ void commitMessages( TLogData* self, Reference<LogData> logData, Version version
 	//TraceEvent("TLogPushed", self->dbgid).detail("Bytes", addedBytes).detail("MessageBytes", messages.size()).detail("Tags", tags.size()).detail("ExpectedBytes", expectedBytes).detail("MCount", mCount).detail("TCount", tCount);
 }
 
-void commitMessages( TLogData *self, Reference<LogData> logData, Version version, Arena arena, StringRef messages ) {
+std::vector<TagsAndMessage> parseTagsAndMessages( Arena arena, StringRef messages ) {
 	ArenaReader rd( arena, messages, Unversioned() );
 	int32_t messageLength, rawLength;
 	uint16_t tagCount;
@@ -1161,7 +1260,11 @@ void commitMessages( TLogData *self, Reference<LogData> logData, Version version
 		tagsAndMsg.message = StringRef((uint8_t const*)rd.readBytes(rawLength), rawLength);
 		msgs.push_back(std::move(tagsAndMsg));
 	}
-	commitMessages(self, logData, version, msgs);
+	return msgs;
+}
+
+void commitMessages( TLogData *self, Reference<LogData> logData, Version version, Arena arena, StringRef messages ) {
+	commitMessages(self, logData, version, parseTagsAndMessages(arena, messages));
 }
 
 Version poppedVersion( Reference<LogData> self, Tag tag) {
@@ -1285,6 +1388,30 @@ void peekMessagesFromMemory( Reference<LogData> self, TLogPeekRequest const& req
 	}
 }
 
+// Returns the same messages as parseMessagesForTag, but only looks at the messages which the tag index of entry lists
+std::vector<StringRef> indexedMessagesForTag( TLogQueueEntryRef const& entry, Tag tag, int logRouters ) {
+	std::vector<uint32_t> offsets;
+	for (auto& tagOffsets : entry.tagIndex.get()) {
+		if (tagOffsets.tag == tag || (tag.locality == tagLocalityLogRouter && tagOffsets.tag.locality == tagLocalityLogRouter &&
+		                              tagOffsets.tag.id % logRouters == tag.id)) {
+			offsets.insert(offsets.end(), tagOffsets.offsets.begin(), tagOffsets.offsets.end());
+		}
+	}
+	// Several log router tags can be modded down to the same one
+	uniquify(offsets);
+
+	std::vector<StringRef> relevantMessages;
+	relevantMessages.reserve(offsets.size());
+	for (uint32_t offset : offsets) {
+		uint32_t messageLength = 0;
+		ASSERT(offset + sizeof(messageLength) <= entry.messages.size());
+		memcpy(&messageLength, entry.messages.begin() + offset, sizeof(messageLength));
+		ASSERT(offset + sizeof(messageLength) + messageLength <= entry.messages.size());
+		relevantMessages.push_back(entry.messages.substr(offset + sizeof(messageLength), messageLength));
+	}
+	return relevantMessages;
+}
+
 ACTOR Future<std::vector<StringRef>> parseMessagesForTag( StringRef commitBlob, Tag tag, int logRouters ) {
 	// See the comment in LogSystem.cpp for the binary format of commitBlob.
 	state std::vector<StringRef> relevantMessages;
@@ -1529,12 +1656,19 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 				rd >> entry >> valid;
 				ASSERT( valid == 0x01 );
 				ASSERT( length + sizeof(valid) == queueEntryData.size() );
+				entry.decompress(entry.arena());
 
 				messages << int32_t(-1) << entry.version;
 
-				std::vector<StringRef> parsedMessages = wait(parseMessagesForTag(entry.messages, req.tag, logData->logRouterTags));
-				for (StringRef msg : parsedMessages) {
-					messages << msg;
+				if (entry.tagIndex.present()) {
+					for (StringRef msg : indexedMessagesForTag(entry, req.tag, logData->logRouterTags)) {
+						messages << msg;
+					}
+				} else {
+					std::vector<StringRef> parsedMessages = wait(parseMessagesForTag(entry.messages, req.tag, logData->logRouterTags));
+					for (StringRef msg : parsedMessages) {
+						messages << msg;
+					}
 				}
 
 				lastRefMessageVersion = entry.version;
@@ -1568,6 +1702,16 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 	reply.end = endVersion;
 	reply.onlySpilled = onlySpilled;
 
+	// Log routers usually read from another region, where bandwidth is more precious than our CPU
+	if(SERVER_KNOBS->TLOG_COMPRESS_LOG_ROUTER_PEEKS && req.tag.locality == tagLocalityLogRouter) {
+		Standalone<StringRef> compressed = compressLogMessages(reply.messages);
+		if(compressed.size()) {
+			reply.uncompressedBytes = reply.messages.size();
+			reply.arena = compressed.arena();
+			reply.messages = compressed;
+		}
+	}
+
 	//TraceEvent("TlogPeek", self->dbgid).detail("LogId", logData->logId).detail("EndVer", reply.end).detail("MsgBytes", reply.messages.expectedSize()).detail("ForAddress", req.reply.getEndpoint().getPrimaryAddress());
 
 	if(req.sequence.present()) {
@@ -1596,6 +1740,100 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 	return Void();
 }
 
+ACTOR Future<Void> tLogPeekStream( TLogData* self, TLogPeekStreamRequest req, Reference<LogData> logData ) {
+	state UID streamId = req.sequence.first;
+	state Reference<LogData::PeekStreamData> stream( new LogData::PeekStreamData );
+	state Version begin = req.begin;
+	state int pushed = 0;
+	state Future<Void> cursorFailed = IFailureMonitor::failureMonitor().onDisconnectOrFailure( req.replies.get().getEndpoint() );
+
+	// Streams are for storage servers, whose data is in memory unless they are far behind
+	if( req.tag.locality == tagLocalityLogRouter || req.tag.locality == tagLocalityTxs || req.tag == txsTag ) {
+		req.reply.send(Void());
+		return Void();
+	}
+
+	auto previous = logData->peekStreams.find(streamId);
+	if( previous != logData->peekStreams.end() && previous->second->closed.canBeSet() ) {
+		previous->second->closed.send(Void());
+	}
+	logData->peekStreams[streamId] = stream;
+	if( logData->stopped ) {
+		stream->closed.send(Void());
+	}
+
+	try {
+		loop {
+			if( pushed - stream->consumed.get() >= SERVER_KNOBS->TLOG_PEEK_STREAM_WINDOW ) {
+				choose {
+					when( wait( stream->consumed.whenAtLeast( pushed - SERVER_KNOBS->TLOG_PEEK_STREAM_WINDOW + 1 ) ) ) {}
+					when( wait( delay(SERVER_KNOBS->PEEK_TRACKER_EXPIRATION_TIME) ) ) { break; }
+					when( wait( stream->closed.getFuture() || cursorFailed ) ) { break; }
+				}
+				continue;
+			}
+
+			if( logData->version.get() < begin ) {
+				choose {
+					when( wait( logData->version.whenAtLeast( begin ) ) ) {}
+					when( wait( stream->closed.getFuture() || cursorFailed ) ) { break; }
+				}
+				wait( delay(SERVER_KNOBS->TLOG_PEEK_DELAY, g_network->getCurrentTask()) );
+			}
+
+			if( stream->closed.isSet() || logData->stopped || begin <= logData->persistentDataDurableVersion || poppedVersion(logData, req.tag) > begin ) {
+				break;
+			}
+
+			BinaryWriter messages(Unversioned());
+			Version endVersion = logData->version.get() + 1;
+			peekMessagesFromMemory( logData, TLogPeekRequest(begin, req.tag, false, false), messages, endVersion );
+
+			TLogPeekReply reply;
+			reply.maxKnownVersion = logData->version.get();
+			reply.minKnownCommittedVersion = logData->minKnownCommittedVersion;
+			Standalone<StringRef> replyMessages = messages.toValue();
+			reply.messages = replyMessages;
+			reply.arena.dependsOn(replyMessages.arena());
+			reply.end = endVersion;
+			reply.onlySpilled = false;
+			reply.begin = begin;
+			req.replies.get().send( reply );
+
+			++logData->peekStreamReplies;
+			begin = endVersion;
+			pushed++;
+		}
+	} catch( Error &e ) {
+		auto it = logData->peekStreams.find(streamId);
+		if( it != logData->peekStreams.end() && it->second == stream ) {
+			logData->peekStreams.erase(it);
+		}
+		throw;
+	}
+
+	auto it = logData->peekStreams.find(streamId);
+	if( it != logData->peekStreams.end() && it->second == stream ) {
+		logData->peekStreams.erase(it);
+	}
+	req.reply.send(Void());
+	return Void();
+}
+
+void tLogPeekStreamAcknowledge( Reference<LogData> logData, TLogPeekStreamRequest const& req ) {
+	auto it = logData->peekStreams.find(req.sequence.first);
+	if( it != logData->peekStreams.end() ) {
+		if( req.sequence.second < 0 ) {
+			if( it->second->closed.canBeSet() ) {
+				it->second->closed.send(Void());
+			}
+		} else if( req.sequence.second > it->second->consumed.get() ) {
+			it->second->consumed.set( req.sequence.second );
+		}
+	}
+	req.reply.send(Void());
+}
+
 ACTOR Future<Void> watchDegraded(TLogData* self) {
 	if(g_network->isSimulated() && g_simulator.speedUpSimulation) {
 		return Void();
@@ -1752,7 +1990,10 @@ ACTOR Future<Void> tLogCommit(
 			g_traceBatch.addEvent("CommitDebug", tlogDebugID.get().first(), "TLog.tLogCommit.Before");
 
 		//TraceEvent("TLogCommit", logData->logId).detail("Version", req.version);
-		commitMessages(self, logData, req.version, req.arena, req.messages);
+		Arena uncompressedArena;
+		StringRef messages = req.uncompressedBytes ? decompressLogMessages(uncompressedArena, req.messages, req.uncompressedBytes) : req.messages;
+		std::vector<TagsAndMessage> taggedMessages = parseTagsAndMessages(req.uncompressedBytes ? uncompressedArena : req.arena, messages);
+		commitMessages(self, logData, req.version, taggedMessages);
 
 		logData->knownCommittedVersion = std::max(logData->knownCommittedVersion, req.knownCommittedVersion);
 
@@ -1761,6 +2002,10 @@ ACTOR Future<Void> tLogCommit(
 		qe.version = req.version;
 		qe.knownCommittedVersion = logData->knownCommittedVersion;
 		qe.messages = req.messages;
+		qe.uncompressedBytes = req.uncompressedBytes;
+		if(SERVER_KNOBS->TLOG_SPILL_TAG_INDEX) {
+			qe.tagIndex = indexMessagesByTag(uncompressedArena, taggedMessages);
+		}
 		qe.id = logData->logId;
 		self->persistentQueue->push( qe, logData );
 
@@ -2041,6 +2286,13 @@ ACTOR Future<Void> serveTLogInterface( TLogData* self, TLogInterface tli, Refere
 		when( TLogPeekRequest req = waitNext( tli.peekMessages.getFuture() ) ) {
 			logData->addActor.send( tLogPeekMessages( self, req, logData ) );
 		}
+		when( TLogPeekStreamRequest req = waitNext( tli.peekStreamMessages.getFuture() ) ) {
+			if( req.replies.present() ) {
+				logData->addActor.send( tLogPeekStream( self, req, logData ) );
+			} else {
+				tLogPeekStreamAcknowledge( logData, req );
+			}
+		}
 		when( TLogPopRequest req = waitNext( tli.popMessages.getFuture() ) ) {
 			logData->addActor.send(tLogPop(self, req, logData));
 		}
@@ -2100,6 +2352,7 @@ ACTOR Future<Void> serveTLogInterface( TLogData* self, TLogInterface tli, Refere
 void removeLog( TLogData* self, Reference<LogData> logData ) {
 	TraceEvent("TLogRemoved", self->dbgid).detail("LogId", logData->logId).detail("Input", logData->bytesInput.getValue()).detail("Durable", logData->bytesDurable.getValue());
 	logData->stopped = true;
+	logData->closePeekStreams();
 	unregisterTLog(logData->logId);
 	if(!logData->recoveryComplete.isSet()) {
 		logData->recoveryComplete.sendError(end_of_stream());
@@ -2407,6 +2660,7 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 		recruited.initEndpoints();
 
 		DUMPTOKEN( recruited.peekMessages );
+		DUMPTOKEN( recruited.peekStreamMessages );
 		DUMPTOKEN( recruited.popMessages );
 		DUMPTOKEN( recruited.commit );
 		DUMPTOKEN( recruited.lock );
@@ -2595,6 +2849,7 @@ ACTOR Future<Void> tLogStart( TLogData* self, InitializeTLogRequest req, Localit
 	recruited.initEndpoints();
 
 	DUMPTOKEN( recruited.peekMessages );
+	DUMPTOKEN( recruited.peekStreamMessages );
 	DUMPTOKEN( recruited.popMessages );
 	DUMPTOKEN( recruited.commit );
 	DUMPTOKEN( recruited.lock );
@@ -2612,6 +2867,7 @@ ACTOR Future<Void> tLogStart( TLogData* self, InitializeTLogRequest req, Localit
 			}
 		}
 		it.second->stopped = true;
+		it.second->closePeekStreams();
 		if(!it.second->recoveryComplete.isSet()) {
 			it.second->recoveryComplete.sendError(end_of_stream());
 		}
@@ -2855,3 +3111,118 @@ TEST_CASE("/fdbserver/tlogserver/VersionMessagesOverheadFactor" ) {
 
 	return Void();
 }
+
+// The messages of a commit for one TLog, written as LogPushData does.  Each message is tagged for up to three of
+// storageTags storage servers, and, if there are log routers, often for one of twice as many log router tags as there are
+// log routers, as if the commit were made before the number of log routers went down.
+static Standalone<StringRef> randomTLogCommitMessages( int messageCount, int storageTags, int logRouters ) {
+	BinaryWriter wr( AssumeVersion(currentProtocolVersion) );
+	for(int i = 0; i < messageCount; i++) {
+		std::vector<Tag> tags;
+		int tagCount = deterministicRandom()->randomInt(1, 4);
+		for(int t = 0; t < tagCount; t++) {
+			tags.push_back( Tag(0, deterministicRandom()->randomInt(0, storageTags)) );
+		}
+		if(logRouters && deterministicRandom()->coinflip()) {
+			tags.push_back( Tag(tagLocalityLogRouter, deterministicRandom()->randomInt(0, 2 * logRouters)) );
+		}
+		if(deterministicRandom()->random01() < 0.01) {
+			tags.push_back( txsTag );
+		}
+		uniquify(tags);
+
+		int offset = wr.getLength();
+		wr << uint32_t(0) << uint32_t(i + 1) << uint16_t(tags.size());
+		for(auto& tag : tags)
+			wr << tag;
+		wr.serializeBytes( std::string(deterministicRandom()->randomInt(0, 100), 'm') );
+		*(uint32_t*)((uint8_t*)wr.getData() + offset) = wr.getLength() - offset - sizeof(uint32_t);
+	}
+	return wr.toValue();
+}
+
+// The payload of a queue packet holding the given commit, as TLogQueue::push writes it
+static Standalone<StringRef> queueEntryPayload( StringRef messages, bool indexed ) {
+	Arena arena;
+	TLogQueueEntryRef qe;
+	qe.version = 1;
+	qe.messages = messages;
+	if(indexed) {
+		qe.tagIndex = indexMessagesByTag( arena, parseTagsAndMessages(arena, messages) );
+	}
+	BinaryWriter wr( Unversioned() );
+	IncludeVersion().write(wr);
+	wr << qe;
+	return wr.toValue();
+}
+
+TEST_CASE("/fdbserver/tlogserver/SpilledTagIndex" ) {
+	state int logRouters = deterministicRandom()->randomInt(0, 4);
+	state int storageTags = deterministicRandom()->randomInt(1, 20);
+	state Standalone<StringRef> messages = randomTLogCommitMessages( deterministicRandom()->randomInt(0, 1000), storageTags, logRouters );
+	state Standalone<StringRef> payload = queueEntryPayload( messages, true );
+	state TLogQueueEntry entry;
+	BinaryReader rd( payload, IncludeVersion() );
+	rd >> entry;
+	ASSERT( entry.tagIndex.present() && entry.messages == messages );
+
+	state std::vector<Tag> tags;
+	for(int i = 0; i < storageTags; i++)
+		tags.push_back( Tag(0, i) );
+	for(int i = 0; i < logRouters; i++)
+		tags.push_back( Tag(tagLocalityLogRouter, i) );
+
+	state int i;
+	for(i = 0; i < tags.size(); i++) {
+		std::vector<StringRef> parsed = wait( parseMessagesForTag(entry.messages, tags[i], logRouters) );
+		ASSERT( indexedMessagesForTag(entry, tags[i], logRouters) == parsed );
+	}
+	return Void();
+}
+
+TEST_CASE("!/fdbserver/tlogserver/SpilledPeekPerformance" ) {
+	// A TLog holding 100 storage servers' worth of tags, whose spilled commits are all peeked by 20 of them
+	state int storageTags = 100;
+	state int logRouters = 4;
+	state int peekedTags = 20;
+	state std::vector<Standalone<StringRef>> commits;
+	for(int c = 0; c < 20; c++) {
+		commits.push_back( randomTLogCommitMessages(10000, storageTags, logRouters) );
+	}
+
+	state int indexed;
+	for(indexed = 0; indexed < 2; indexed++) {
+		state std::vector<Standalone<StringRef>> payloads;
+		state int64_t payloadBytes = 0;
+		for(auto& commit : commits) {
+			payloads.push_back( queueEntryPayload(commit, indexed) );
+			payloadBytes += payloads.back().size();
+		}
+
+		state double start = timer();
+		state int64_t peekedBytes = 0;
+		state int t;
+		state int p;
+		for(t = 0; t < peekedTags; t++) {
+			for(p = 0; p < payloads.size(); p++) {
+				state TLogQueueEntry entry;
+				BinaryReader rd( payloads[p], IncludeVersion() );
+				rd >> entry;
+				state std::vector<StringRef> relevantMessages;
+				if(indexed) {
+					relevantMessages = indexedMessagesForTag( entry, Tag(0, t), logRouters );
+				} else {
+					std::vector<StringRef> parsed = wait( parseMessagesForTag(entry.messages, Tag(0, t), logRouters) );
+					relevantMessages = parsed;
+				}
+				for(auto& msg : relevantMessages)
+					peekedBytes += msg.size();
+			}
+		}
+		double elapsed = timer() - start;
+		printf("%s: %d peeks of %d spilled commits (%.1f MB queued) in %.3f seconds, %.1f MB/s of commits, %.1f MB/s of messages returned\n",
+		       indexed ? "Tag index" : "Parsing every message", peekedTags, (int)payloads.size(), payloadBytes / 1e6, elapsed,
+		       payloadBytes * peekedTags / elapsed / 1e6, peekedBytes / elapsed / 1e6);
+	}
+	return Void();
+}
@@ -27,6 +27,7 @@
 #include "fdbserver/CoroFlow.h"
 #include "fdbrpc/simulator.h"
 #include "fdbrpc/AsyncFileReadAhead.actor.h"
+#include "fdbserver/SQLitePageCompression.h"
 
 #include <assert.h>
 #include <string.h>
@@ -79,8 +80,11 @@ struct VFSAsyncFile {
 	int debug_zcrefs, debug_zcreads, debug_reads;
 
 	int chunkSize;
+	bool compressedLayout;  // Whether the pages of this database file are in the layout described by CompressedPageHeader
 
-	VFSAsyncFile(std::string const& filename, int flags) : filename(filename), flags(flags), pLockCount(&filename_lockCount_openCount[filename].first), debug_zcrefs(0), debug_zcreads(0), debug_reads(0), chunkSize(0) {
+	std::vector<Future<Void>> prefetches;  // Reads started by vfsAsyncPrefetchPages() which may not have finished
+
+	VFSAsyncFile(std::string const& filename, int flags) : filename(filename), flags(flags), pLockCount(&filename_lockCount_openCount[filename].first), debug_zcrefs(0), debug_zcreads(0), debug_reads(0), chunkSize(0), compressedLayout(false) {
 		filename_lockCount_openCount[filename].second++;
 	}
 	~VFSAsyncFile();
@@ -102,11 +106,31 @@ static int asyncClose(sqlite3_file *pFile){
 	return SQLITE_OK;
 }
 
+// Whether an access of iAmt bytes at iOfst is of a whole database page which could be compressed (see CompressedPageHeader)
+static bool isCompressiblePage(VFSAsyncFile *p, int iAmt, sqlite_int64 iOfst) {
+	return p->compressedLayout && iAmt > _PAGE_SIZE && iAmt % _PAGE_SIZE == 0 && iOfst % iAmt == 0 && iOfst > 0;
+}
+
 static int asyncRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite_int64 iOfst) {
 	VFSAsyncFile *p = (VFSAsyncFile*)pFile;
 	try {
 		++p->debug_reads;
-		int readBytes = waitForAndGet( p->file->read( zBuf, iAmt, iOfst ) );
+		int readBytes = 0;
+		if (isCompressiblePage(p, iAmt, iOfst)) {
+			// Read the first block to find out how much of the page is in use, and then only the rest of that
+			readBytes = waitForAndGet( p->file->read( zBuf, _PAGE_SIZE, iOfst ) );
+			if (readBytes == _PAGE_SIZE) {
+				int usedBytes = CompressedPageHeader::usedBytes( zBuf, iAmt );
+				if (usedBytes > readBytes)
+					readBytes += waitForAndGet( p->file->read( (uint8_t*)zBuf + readBytes, usedBytes - readBytes, iOfst + readBytes ) );
+				if (readBytes == usedBytes && usedBytes < iAmt) {
+					memset((uint8_t*)zBuf + usedBytes, 0, iAmt - usedBytes);
+					return SQLITE_OK;
+				}
+			}
+		} else {
+			readBytes = waitForAndGet( p->file->read( zBuf, iAmt, iOfst ) );
+		}
 		if (readBytes < iAmt) {
 			memset((uint8_t*)zBuf + readBytes, 0, iAmt-readBytes);  // When reading past the EOF, sqlite expects the extra portion of the buffer to be zeroed
 			return SQLITE_IOERR_SHORT_READ;
@@ -117,6 +141,22 @@ static int asyncRead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite_int64 iOf
 	}
 }
 
+/*
+** Start reading the given pages of a database file, without waiting for them, so that they are in the
+** page cache of the underlying IAsyncFile by the time SQLite reads them.  The data read is discarded,
+** and so are errors, which the later read of the page will report.  Whole page slots are read even if
+** a page is compressed, because the unused blocks of a compressed page are sparse in the file.
+*/
+void vfsAsyncPrefetchPages( sqlite3_file* pFile, int pageSize, uint32_t const* pages, int count ) {
+	VFSAsyncFile *p = (VFSAsyncFile*)pFile;
+	p->prefetches.erase( std::remove_if( p->prefetches.begin(), p->prefetches.end(), [](Future<Void> const& f) { return f.isReady(); } ), p->prefetches.end() );
+	for(int i = 0; i < count; i++) {
+		Arena arena;
+		uint8_t* buf = new (arena) uint8_t[pageSize];
+		p->prefetches.push_back( ready( holdWhile( arena, p->file->read( buf, pageSize, (int64_t)(pages[i] - 1) * pageSize ) ) ) );
+	}
+}
+
 #if 1
 static int asyncReleaseZeroCopy(sqlite3_file* pFile, void* data, int iAmt, sqlite_int64 iOfst) {
 	VFSAsyncFile *p = (VFSAsyncFile*)pFile;
@@ -134,8 +174,7 @@ static int asyncReadZeroCopy(sqlite3_file *pFile, void **data, int iAmt, sqlite_
 	try {
 		int readBytes = iAmt;
 		Future<Void> readFuture = p->file->readZeroCopy( data, &readBytes, iOfst );
-		if(pDataWasCached)
-			*pDataWasCached = readFuture.isReady() ? 1 : 0;
+		bool wasCached = readFuture.isReady();
 		waitFor(readFuture);
 		++p->debug_zcrefs;
 		if (readBytes < iAmt) {
@@ -143,6 +182,9 @@ static int asyncReadZeroCopy(sqlite3_file *pFile, void **data, int iAmt, sqlite_
 			asyncReleaseZeroCopy(pFile, *data, readBytes, iOfst);
 			return SQLITE_IOERR_SHORT_READ;
 		}
+		// Only set on success, since sqlite skips the pager codec for cached pages even if it falls back to the slow path
+		if(pDataWasCached)
+			*pDataWasCached = wasCached ? 1 : 0;
 		++p->debug_zcreads;
 		return SQLITE_OK;
 	} catch (Error& ) {
@@ -176,6 +218,15 @@ static int asyncReleaseZeroCopy(sqlite3_file* pFile, void* data, int iAmt, sqlit
 static int asyncWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite_int64 iOfst) {
 	VFSAsyncFile *p = (VFSAsyncFile*)pFile;
 	try {
+		// Unused blocks at the end of a compressed page are not written, and the file system can release their space
+		if (isCompressiblePage(p, iAmt, iOfst)) {
+			int usedBytes = CompressedPageHeader::usedBytes( zBuf, iAmt );
+			if (usedBytes < iAmt) {
+				waitFor( p->file->write( zBuf, usedBytes, iOfst ) );
+				waitFor( p->file->punchHole( iOfst + usedBytes, iAmt - usedBytes ) );
+				return SQLITE_OK;
+			}
+		}
 		waitFor( p->file->write( zBuf, iAmt, iOfst ) );
 		return SQLITE_OK;
 	} catch(Error& ) {
@@ -537,6 +588,13 @@ static int asyncOpen(
 		// Note that SQLiteDB::open also opens the db file, so its flags and modes are important, too
 		p->file = waitForAndGet( IAsyncFileSystem::filesystem()->open( p->filename, oflags, 0600 ) );
 
+		// KeyValueStoreSQLite creates database files with their header, which records the layout of their pages
+		if (flags & SQLITE_OPEN_MAIN_DB) {
+			uint8_t reserveSize = 0;
+			int readBytes = waitForAndGet( p->file->read( &reserveSize, 1, CompressedPageHeader::FILE_HEADER_RESERVE_OFFSET ) );
+			p->compressedLayout = readBytes == 1 && reserveSize == CompressedPageHeader::reserveSize();
+		}
+
 		/*TraceEvent("VFSOpened")
 			.detail("Filename", p->filename)
 			.detail("Fd", DEBUG_DETERMINISM ? 0 : p->file->debugFD())
@@ -543,7 +543,7 @@ struct RedwoodRecordRef {
 	// Value is not considered, as it is does not make sense for a container
 	// to have two records which differ only in value.
 	int compare(const RedwoodRecordRef &rhs) const {
-		int cmp = key.compare(rhs.key);
+		int cmp = compareKeys(key.begin(), key.size(), rhs.key.begin(), rhs.key.size());
 		if(cmp == 0) {
 			cmp = version - rhs.version;
 			if(cmp == 0) {
@@ -1152,7 +1152,9 @@ public:
 	virtual void mutate(int op, StringRef param1, StringRef param2) NOT_IMPLEMENTED
 
 	// Versions [begin, end) no longer readable
-	virtual void forgetVersions(Version begin, Version end) NOT_IMPLEMENTED
+	virtual void forgetVersions(Version begin, Version end) {
+		m_pager->forgetVersions(begin, std::min(end, m_lastCommittedVersion));
+	}
 
 	virtual Future<Version> getLatestVersion() {
 		if(m_writeVersion != invalidVersion)
@@ -1173,6 +1175,7 @@ public:
 		m_writeVersion(invalidVersion),
 		m_usablePageSizeOverride(pager->getUsablePageSize()),
 		m_lastCommittedVersion(invalidVersion),
+		m_commitVersion(invalidVersion),
 		m_pBuffer(nullptr),
 		m_name(name),
 		singleVersion(singleVersion)
@@ -1214,22 +1217,22 @@ public:
 	//   than or equal to the given version.
 	// If readAtVersion() is called on the *current* write version, the given read cursor MAY reflect subsequent writes at the same
 	//   write version, OR it may represent a snapshot as of the call to readAtVersion().
+	// In single version mode every write version is committed as its own pager version, so any committed version which has
+	// not been forgotten can be read.  Throws transaction_too_old for forgotten versions.
 	virtual Reference<IStoreCursor> readAtVersion(Version v) {
 		// TODO: Use the buffer to return uncommitted data
 		// For now, only committed versions can be read.
 		Version recordVersion = singleVersion ? 0 : v;
 		ASSERT(v <= m_lastCommittedVersion);
-		if(singleVersion) {
-			ASSERT(v == m_lastCommittedVersion);
-		}
 		return Reference<IStoreCursor>(new Cursor(m_pager->getReadSnapshot(v), m_root, recordVersion, m_usablePageSizeOverride));
 	}
 
 	// Must be nondecreasing
 	virtual void setWriteVersion(Version v) {
 		ASSERT(v > m_lastCommittedVersion);
-		// If there was no current mutation buffer, create one in the buffer map and update m_pBuffer
-		if(m_pBuffer == nullptr) {
+		// If there was no current mutation buffer, create one in the buffer map and update m_pBuffer.
+		// In single version mode each version gets its own buffer so that it can be read once committed.
+		if(m_pBuffer == nullptr || (singleVersion && v > m_writeVersion)) {
 			// When starting a new mutation buffer its start version must be greater than the last write version
 			ASSERT(v > m_writeVersion);
 			m_pBuffer = &m_mutationBuffers[v];
@@ -1512,6 +1515,7 @@ private:
 
 	Version m_writeVersion;
 	Version m_lastCommittedVersion;
+	Version m_commitVersion;  // The version that the mutation buffer being committed is written at
 	Future<Void> m_latestCommit;
 	int m_usablePageSizeOverride;
 	Future<Void> m_init;
@@ -1580,8 +1584,18 @@ private:
 
 			debug_printf("Writing a new root level at version %" PRId64 " with %lu children across %lu pages\n", version, childEntries.size(), pages.size());
 
-			logicalPageIDs = writePages(pages, version, m_root, pPage, &dbEnd, nullptr);
+			logicalPageIDs = writePages(pages, version, m_root, nullptr, &dbEnd, nullptr);
+		}
+	}
+
+	// Frees the page id, and its extension pages, as of version.  Versions before it can still read them.
+	void freePage(LogicalPageID id, const BTreePage *page, Version version) {
+		for(int i = 0; i < page->extensionPageCount; ++i) {
+			debug_printf("freePage(): Freeing extension op=del id=%u @%" PRId64 "\n", bigEndian32(page->extensionPages()[i]), version);
+			m_pager->freeLogicalPage(bigEndian32(page->extensionPages()[i]), version);
 		}
+		debug_printf("freePage(): Freeing op=del id=%u @%" PRId64 "\n", id, version);
+		m_pager->freeLogicalPage(id, version);
 	}
 
 	std::vector<LogicalPageID> writePages(std::vector<BoundaryAndPage> pages, Version version, LogicalPageID originalID, const BTreePage *originalPage, const RedwoodRecordRef *upperBound, void *actor_debug) {
@@ -1633,9 +1647,9 @@ private:
 		}
 
 		// Free the old extension pages now that all replacement pages have been written
-		for(int i = 0; i < originalPage->extensionPageCount; ++i) {
-			//debug_printf("%p: writePages(): Freeing old extension op=del id=%u @latest\n", actor_debug, bigEndian32(originalPage->extensionPages()[i]));
-			//m_pager->freeLogicalPage(bigEndian32(originalPage->extensionPages()[i]), version);
+		for(int i = 0; originalPage != nullptr && i < originalPage->extensionPageCount; ++i) {
+			debug_printf("%p: writePages(): Freeing old extension op=del id=%u @%" PRId64 "\n", actor_debug, bigEndian32(originalPage->extensionPages()[i]), version);
+			m_pager->freeLogicalPage(bigEndian32(originalPage->extensionPages()[i]), version);
 		}
 
 		return primaryLogicalPageIDs;
@@ -1945,6 +1959,7 @@ private:
 			// Note that if a single range clear covered the entire page then we should not get this far
 			if(merged.empty() && root != 0) {
 				// TODO:  For multi version mode only delete this page as of the new version
+				self->freePage(root, page, self->m_commitVersion);
 				VersionedChildrenT c({});
 				debug_printf("%s id=%u All leaf page contents were cleared, returning %s\n", context.c_str(), root, toString(c).c_str());
 				return c;
@@ -1970,7 +1985,7 @@ private:
 			}
 
 			// Write page(s), get new page IDs
-			Version writeVersion = self->singleVersion ? self->getLastCommittedVersion() + 1 : minVersion;
+			Version writeVersion = self->singleVersion ? self->m_commitVersion : minVersion;
 			std::vector<LogicalPageID> newPageIDs = self->writePages(pages, writeVersion, root, page, upperBound, THIS);
 
 			// If this commitSubtree() is operating on the root, write new levels if needed until until we're returning a single page
@@ -2105,12 +2120,13 @@ private:
 						Reference<IPage> page = self->m_pager->newPageBuffer();
 						makeEmptyPage(page, BTreePage::IS_LEAF, self->m_usablePageSizeOverride);
 						RedwoodRecordRef rootEntry = dbBegin.withPageID(0);
-						self->writePage(0, page, self->getLastCommittedVersion() + 1, &dbBegin, &dbEnd);
+						self->writePage(0, page, self->m_commitVersion, &dbBegin, &dbEnd);
 						VersionedChildrenT c({ {0, {dbBegin}, dbEnd } });
 						debug_printf("%s id=%u All root page children were deleted, rewrote root as leaf, returning %s\n", context.c_str(), root, toString(c).c_str());
 						return c;
 					}
 					else {
+						self->freePage(root, page, self->m_commitVersion);
 						VersionedChildrenT c({});
 						debug_printf("%s id=%u All internal page children were deleted #1 so deleting this page too, returning %s\n", context.c_str(), root, toString(c).c_str());
 						return c;
@@ -2130,7 +2146,7 @@ private:
 
 					std::vector<BoundaryAndPage> pages = buildPages(false, *lowerBound, *upperBound, entries, 0, [=](){ return self->m_pager->newPageBuffer(); }, self->m_usablePageSizeOverride);
 
-					Version writeVersion = self->getLastCommittedVersion() + 1;
+					Version writeVersion = self->m_commitVersion;
 					std::vector<LogicalPageID> newPageIDs = self->writePages(pages, writeVersion, root, page, upperBound, THIS);
 
 					// If this commitSubtree() is operating on the root, write new levels if needed until until we're returning a single page
@@ -2161,16 +2177,11 @@ private:
 	}
 
 	ACTOR static Future<Void> commit_impl(VersionedBTree *self) {
-		state MutationBufferT *mutations = self->m_pBuffer;
-
-		// No more mutations are allowed to be written to this mutation buffer we will commit
+		// No more mutations are allowed to be written to the mutation buffers we will commit, the last of which is
 		// at m_writeVersion, which we must save locally because it could change during commit.
 		self->m_pBuffer = nullptr;
 		state Version writeVersion = self->m_writeVersion;
 
-		// The latest mutation buffer start version is the one we will now (or eventually) commit.
-		state Version mutationBufferStartVersion = self->m_mutationBuffers.rbegin()->first;
-
 		// Replace the lastCommit future with a new one and then wait on the old one
 		state Promise<Void> committed;
 		Future<Void> previousCommit = self->m_latestCommit;
@@ -2180,29 +2191,37 @@ private:
 		wait(previousCommit);
 		debug_printf("%s: Beginning commit of version %" PRId64 "\n", self->m_name.c_str(), writeVersion);
 
-		// Get the latest version from the pager, which is what we will read at
-		Version latestVersion = wait(self->m_pager->getLatestVersion());
-		debug_printf("%s: pager latestVersion %" PRId64 "\n", self->m_name.c_str(), latestVersion);
+		// Apply each mutation buffer up to writeVersion, oldest first, as a new pager version which reads the one before it.
+		// Buffers after writeVersion were started after this commit and belong to the next one.
+		state std::map<Version, MutationBufferT>::iterator iBuffer = self->m_mutationBuffers.begin();
+		while(iBuffer != self->m_mutationBuffers.end() && iBuffer->first <= writeVersion) {
+			// Get the latest version from the pager, which is what we will read at
+			state Version latestVersion = wait(self->m_pager->getLatestVersion());
+			debug_printf("%s: pager latestVersion %" PRId64 "\n", self->m_name.c_str(), latestVersion);
 
-		if(REDWOOD_DEBUG) {
-			self->printMutationBuffer(mutations);
-		}
+			state MutationBufferT *mutations = &iBuffer->second;
+			if(REDWOOD_DEBUG) {
+				self->printMutationBuffer(mutations);
+			}
+
+			// In multi version mode a buffer holds the writes of every version up to writeVersion
+			self->m_commitVersion = self->singleVersion ? iBuffer->first : writeVersion;
+			VersionedChildrenT newRoot = wait(commitSubtree(self, mutations, self->m_pager->getReadSnapshot(latestVersion), self->m_root, &dbBegin, &dbEnd, &dbBegin, &dbEnd));
 
-		VersionedChildrenT newRoot = wait(commitSubtree(self, mutations, self->m_pager->getReadSnapshot(latestVersion), self->m_root, &dbBegin, &dbEnd, &dbBegin, &dbEnd));
+			self->m_pager->setLatestVersion(self->m_commitVersion);
+			++iBuffer;
+		}
 
-		self->m_pager->setLatestVersion(writeVersion);
 		debug_printf("%s: Committing pager %" PRId64 "\n", self->m_name.c_str(), writeVersion);
 		wait(self->m_pager->commit());
 		debug_printf("%s: Committed version %" PRId64 "\n", self->m_name.c_str(), writeVersion);
 
-		// Now that everything is committed we must delete the mutation buffer.
-		// Our buffer's start version should be the oldest mutation buffer version in the map.
-		ASSERT(mutationBufferStartVersion == self->m_mutationBuffers.begin()->first);
-		self->m_mutationBuffers.erase(self->m_mutationBuffers.begin());
+		// Now that everything is committed we must delete the mutation buffers.  iBuffer can't be used as the end of
+		// the range because it may have been end(), which now includes buffers started during the commit.
+		self->m_mutationBuffers.erase(self->m_mutationBuffers.begin(), self->m_mutationBuffers.upper_bound(writeVersion));
 
 		self->m_lastCommittedVersion = writeVersion;
 		++self->counts.commits;
-printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 		committed.send(Void());
 
 		return Void();
@@ -2265,13 +2284,41 @@ printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 		int usablePageSizeOverride;
 		Reference<IPagerSnapshot> pager;
 		Reference<PageCursor> pageCursor;
+		int prefetchPages;  // Leaf pages to read ahead of the cursor, negative to read behind it
+
+		// Starts reading the leaf pages which follow (or precede) the current one under the same parent page, so that
+		// a range read which moves on to them finds them already cached by the pager.
+		void prefetchSiblings() {
+			if(prefetchPages == 0 || !pageCursor->isLeaf() || !pageCursor->parent) {
+				return;
+			}
+
+			BTreePage::BinaryTree::Cursor c = pageCursor->parent->cursor;
+			int n = std::abs(prefetchPages);
+			while(n > 0 && (prefetchPages > 0 ? c.moveNext() : c.movePrev())) {
+				// Skip over internal page entries that do not link to child pages
+				if(c.get().value.present()) {
+					debug_printf("prefetchSiblings() op=read id=%u @%" PRId64 "\n", c.get().getPageID(), pager->getVersion());
+					pager->getPhysicalPage(c.get().getPageID());
+					--n;
+				}
+			}
+		}
 
 	public:
-		InternalCursor() {
+		InternalCursor() : prefetchPages(0) {
 		}
 
 		InternalCursor(Reference<IPagerSnapshot> pager, LogicalPageID root, int usablePageSizeOverride)
-			: pager(pager), rootPageID(root), usablePageSizeOverride(usablePageSizeOverride) {
+			: pager(pager), rootPageID(root), usablePageSizeOverride(usablePageSizeOverride), prefetchPages(0) {
+		}
+
+		// Sets how many bytes of leaf pages past the cursor position, or before it if bytes is negative, to read ahead
+		// of the cursor as it descends to new leaf pages.
+		void setPrefetchBytes(int bytes) {
+			int pages = (std::abs(bytes) + usablePageSizeOverride - 1) / usablePageSizeOverride;
+			pages = std::min(pages, SERVER_KNOBS->REDWOOD_RANGE_PREFETCH_PAGES);
+			prefetchPages = bytes < 0 ? -pages : pages;
 		}
 
 		std::string toString() const {
@@ -2370,6 +2417,7 @@ printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 
 					Reference<PageCursor> child = wait(self->pageCursor->getChild(self->pager, self->usablePageSizeOverride));
 					self->pageCursor = child;
+					self->prefetchSiblings();
 				}
 				else {
 					// No records <= query on this page, so move to immediate previous record at leaf level
@@ -2424,6 +2472,7 @@ printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 				Reference<PageCursor> child = wait(self->pageCursor->getChild(self->pager, self->usablePageSizeOverride));
 				forward ? child->cursor.moveFirst() : child->cursor.moveLast();
 				self->pageCursor = child;
+				self->prefetchSiblings();
 			}
 
 			return true;
@@ -2471,6 +2520,7 @@ printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 
 					Reference<PageCursor> child = wait(self->pageCursor->getChild(self->pager, self->usablePageSizeOverride));
 					self->pageCursor = child;
+					self->prefetchSiblings();
 				}
 				else {
 					return false;
@@ -2517,9 +2567,18 @@ printf("\nCommitted: %s\n", self->counts.toString(true).c_str());
 		Optional<KeyValueRef> m_kv;
 
 	public:
-		virtual Future<Void> findEqual(KeyRef key) { return find_impl(this, key, true, 0); }
-		virtual Future<Void> findFirstEqualOrGreater(KeyRef key, bool needValue, int prefetchNextBytes) { return find_impl(this, key, needValue, 1); }
-		virtual Future<Void> findLastLessOrEqual(KeyRef key, bool needValue, int prefetchPriorBytes) { return find_impl(this, key, needValue, -1); }
+		virtual Future<Void> findEqual(KeyRef key) {
+			m_cur1.setPrefetchBytes(0);
+			return find_impl(this, key, true, 0);
+		}
+		virtual Future<Void> findFirstEqualOrGreater(KeyRef key, bool needValue, int prefetchNextBytes) {
+			m_cur1.setPrefetchBytes(prefetchNextBytes);
+			return find_impl(this, key, needValue, 1);
+		}
+		virtual Future<Void> findLastLessOrEqual(KeyRef key, bool needValue, int prefetchPriorBytes) {
+			m_cur1.setPrefetchBytes(-prefetchPriorBytes);
+			return find_impl(this, key, needValue, -1);
+		}
 
 		virtual Future<Void> next(bool needValue) { return move(this, true, needValue); }
 		virtual Future<Void> prev(bool needValue) { return move(this, false, needValue); }
@@ -2745,7 +2804,8 @@ Future<T> catchError(Promise<Void> error, Future<T> f) {
 		T result = wait(f);
 		return result;
 	} catch(Error &e) {
-		if(e.code() != error_code_actor_cancelled && error.canBeSet())
+		// A read of a version that has been forgotten fails without affecting the store
+		if(e.code() != error_code_actor_cancelled && e.code() != error_code_transaction_too_old && error.canBeSet())
 			error.sendError(e);
 		throw;
 	}
@@ -2830,21 +2890,43 @@ public:
 		m_tree->set(keyValue);
 	}
 
+	virtual bool isVersioned() {
+		return true;
+	}
+
+	virtual void setWriteVersion(Version v) {
+		if(v > m_tree->getWriteVersion()) {
+			m_tree->setWriteVersion(v);
+		}
+	}
+
+	virtual void forgetVersionsBefore(Version v) {
+		m_tree->forgetVersions(0, v);
+	}
+
 	virtual Future< Standalone< VectorRef< KeyValueRef > > > readRange(KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30) {
 		debug_printf("READRANGE %s\n", printable(keys).c_str());
-		return catchError(readRange_impl(this, keys, rowLimit, byteLimit));
+		return catchError(readRange_impl(this, keys, m_tree->getLastCommittedVersion(), rowLimit, byteLimit));
 	}
 
-	ACTOR static Future< Standalone< VectorRef< KeyValueRef > > > readRange_impl(KeyValueStoreRedwoodUnversioned *self, KeyRange keys, int rowLimit, int byteLimit) {
+	virtual Future< Standalone< VectorRef< KeyValueRef > > > readRangeAtVersion(KeyRangeRef keys, Version v, int rowLimit = 1<<30, int byteLimit = 1<<30) {
+		debug_printf("READRANGE %s @%" PRId64 "\n", printable(keys).c_str(), v);
+		return catchError(readRange_impl(this, keys, std::min(v, m_tree->getLastCommittedVersion()), rowLimit, byteLimit));
+	}
+
+	ACTOR static Future< Standalone< VectorRef< KeyValueRef > > > readRange_impl(KeyValueStoreRedwoodUnversioned *self, KeyRange keys, Version v, int rowLimit, int byteLimit) {
 		self->m_tree->counts.getRanges++;
 		state Standalone<VectorRef<KeyValueRef>> result;
 		state int accumulatedBytes = 0;
 		ASSERT( byteLimit > 0 );
 
-		state Reference<IStoreCursor> cur = self->m_tree->readAtVersion(self->m_tree->getLastCommittedVersion());
+		state Reference<IStoreCursor> cur = self->m_tree->readAtVersion(v);
+
+		// Leaf pages past the first are only prefetched when the limits allow reading that far
+		state int prefetchBytes = std::min<int64_t>(byteLimit, (int64_t)std::abs(rowLimit) * SERVER_KNOBS->REDWOOD_ROW_PREFETCH_BYTES_ESTIMATE);
 
 		if(rowLimit >= 0) {
-			wait(cur->findFirstEqualOrGreater(keys.begin, true, 0));
+			wait(cur->findFirstEqualOrGreater(keys.begin, true, prefetchBytes));
 			while(cur->isValid() && cur->getKey() < keys.end) {
 				KeyValueRef kv(KeyRef(result.arena(), cur->getKey()), ValueRef(result.arena(), cur->getValue()));
 				accumulatedBytes += kv.expectedSize();
@@ -2855,7 +2937,7 @@ public:
 				wait(cur->next(true));
 			}
 		} else {
-			wait(cur->findLastLessOrEqual(keys.end, true, 0));
+			wait(cur->findLastLessOrEqual(keys.end, true, prefetchBytes));
 			if(cur->isValid() && cur->getKey() == keys.end)
 				wait(cur->prev(true));
 
@@ -2863,7 +2945,7 @@ public:
 				KeyValueRef kv(KeyRef(result.arena(), cur->getKey()), ValueRef(result.arena(), cur->getValue()));
 				accumulatedBytes += kv.expectedSize();
 				result.push_back(result.arena(), kv);
-				if(--rowLimit == 0 || accumulatedBytes >= byteLimit) {
+				if(++rowLimit == 0 || accumulatedBytes >= byteLimit) {
 					break;
 				}
 				wait(cur->prev(true));
@@ -2872,9 +2954,9 @@ public:
 		return result;
 	}
 
-	ACTOR static Future< Optional<Value> > readValue_impl(KeyValueStoreRedwoodUnversioned *self, Key key, Optional< UID > debugID) {
+	ACTOR static Future< Optional<Value> > readValue_impl(KeyValueStoreRedwoodUnversioned *self, Key key, Version v, Optional< UID > debugID) {
 		self->m_tree->counts.gets++;
-		state Reference<IStoreCursor> cur = self->m_tree->readAtVersion(self->m_tree->getLastCommittedVersion());
+		state Reference<IStoreCursor> cur = self->m_tree->readAtVersion(v);
 
 		wait(cur->findEqual(key));
 		if(cur->isValid()) {
@@ -2884,7 +2966,11 @@ public:
 	}
 
 	virtual Future< Optional< Value > > readValue(KeyRef key, Optional< UID > debugID = Optional<UID>()) {
-		return catchError(readValue_impl(this, key, debugID));
+		return catchError(readValue_impl(this, key, m_tree->getLastCommittedVersion(), debugID));
+	}
+
+	virtual Future< Optional< Value > > readValueAtVersion(KeyRef key, Version v, Optional< UID > debugID = Optional<UID>()) {
+		return catchError(readValue_impl(this, key, std::min(v, m_tree->getLastCommittedVersion()), debugID));
 	}
 
 	ACTOR static Future< Optional<Value> > readValuePrefix_impl(KeyValueStoreRedwoodUnversioned *self, Key key, int maxLength, Optional< UID > debugID) {
@@ -3941,6 +4027,110 @@ TEST_CASE("!/redwood/correctness/btree") {
 	return Void();
 }
 
+// Reads committed versions older than the latest, across commits, forgetVersions() and reopening the pager, checking each
+// against the history of sets and clears and that reads of forgotten versions throw transaction_too_old.
+TEST_CASE("!/redwood/correctness/versionedReads") {
+	state std::string pagerFile = "unittest_pageFile";
+	deleteFile(pagerFile);
+	deleteFile(pagerFile + "0.pagerlog");
+	deleteFile(pagerFile + "1.pagerlog");
+
+	state int pageSize = deterministicRandom()->randomInt(200, 400);
+	state VersionedBTree *btree = new VersionedBTree(new IndirectShadowPager(pagerFile), pagerFile, true, pageSize);
+	wait(btree->init());
+
+	state std::map<std::pair<std::string, Version>, Optional<std::string>> written;
+	state Version firstVersion = wait(btree->getLatestVersion());
+	state Version version = firstVersion;
+	state Version oldestVersion = firstVersion;
+	state int errorCount = 0;
+	state int commits = 0;
+	state int reads;
+	state Reference<IStoreCursor> cur;
+
+	printf("Using page size %d, starting from version %" PRId64 "\n", pageSize, firstVersion);
+
+	for(; commits < 200; ++commits) {
+		// Write several versions, with gaps between them, in each commit
+		for(int versions = deterministicRandom()->randomInt(1, 4); versions; --versions) {
+			version += deterministicRandom()->randomInt(1, 3);
+			btree->setWriteVersion(version);
+			for(int m = deterministicRandom()->randomInt(1, 10); m; --m) {
+				int k = deterministicRandom()->randomInt(0, 500);
+				std::string key = format("%05d", k);
+				if(deterministicRandom()->random01() < 0.1) {
+					// Clears must not be empty
+					std::string end = format("%05d", k + deterministicRandom()->randomInt(1, 50));
+					// Every key present in the range before the clear is absent at this version
+					auto i = written.lower_bound(std::make_pair(key, (Version)0));
+					auto iEnd = written.lower_bound(std::make_pair(end, (Version)0));
+					while(i != iEnd) {
+						auto next = std::next(i);
+						if((next == iEnd || next->first.first != i->first.first) && i->second.present())
+							written[std::make_pair(i->first.first, version)].reset();
+						i = next;
+					}
+					btree->clear(KeyRangeRef(key, end));
+				}
+				else {
+					std::string value(deterministicRandom()->randomInt(0, 50), 'a' + deterministicRandom()->randomInt(0, 26));
+					btree->set(KeyValueRef(key, value));
+					written[std::make_pair(key, version)] = value;
+				}
+			}
+		}
+		wait(btree->commit());
+
+		// Sometimes reopen the tree, which must recover the latest version and the versions forgotten before the commit
+		if(deterministicRandom()->random01() < 0.05) {
+			printf("Reopening btree at version %" PRId64 ", oldest version %" PRId64 "\n", version, oldestVersion);
+			Future<Void> closedFuture = btree->onClosed();
+			btree->close();
+			wait(closedFuture);
+
+			btree = new VersionedBTree(new IndirectShadowPager(pagerFile), pagerFile, true, pageSize);
+			wait(btree->init());
+			Version v = wait(btree->getLatestVersion());
+			ASSERT(v == version);
+		}
+
+		// Read random ranges at random versions which have not been forgotten
+		for(reads = 0; reads < 5; ++reads) {
+			Version v = deterministicRandom()->randomInt64(oldestVersion, version + 1);
+			Key begin(format("%05d", deterministicRandom()->randomInt(0, 500)));
+			Key end(format("%05d", deterministicRandom()->randomInt(0, 500)));
+			wait(success(verifyRange(btree, std::min(begin, end), std::max(begin, end), v, &written, &errorCount)));
+		}
+
+		// Sometimes forget old versions
+		if(deterministicRandom()->random01() < 0.3) {
+			oldestVersion = deterministicRandom()->randomInt64(oldestVersion, version + 1);
+			btree->forgetVersions(0, oldestVersion);
+		}
+
+		// Forgotten versions can no longer be read
+		if(oldestVersion > firstVersion) {
+			try {
+				cur = btree->readAtVersion(deterministicRandom()->randomInt64(firstVersion, oldestVersion));
+				wait(cur->findFirstEqualOrGreater(LiteralStringRef(""), true, 0));
+				ASSERT(false);
+			} catch(Error &e) {
+				if(e.code() != error_code_transaction_too_old)
+					throw;
+			}
+		}
+
+		if(errorCount != 0)
+			throw internal_error();
+	}
+
+	Future<Void> closedFuture = btree->onClosed();
+	btree->close();
+	wait(closedFuture);
+
+	return Void();
+}
+
 ACTOR Future<Void> randomSeeks(VersionedBTree *btree, int count) {
 	state Version readVer = wait(btree->getLatestVersion());
 	state int c = 0;
@@ -2941,9 +2941,10 @@ static int incrVacuumStep(BtShared *pBt, Pgno nFin, Pgno iLastPg){
 
         put4byte(&pBt->pPage1->aData[36], nFreeList-1);
 
-        // Mark the last page as writable since we are about to truncate it
+        // Mark the last page as writable since we are about to truncate it.  Its content is never
+        // needed, and may have been released from the file by FDB, so it is not read.
         MemPage *pFreeLeaf;
-        rc = btreeGetPage(pBt, iLastPg, &pFreeLeaf, 0);
+        rc = btreeGetPage(pBt, iLastPg, &pFreeLeaf, !btreeGetHasContent(pBt, iLastPg));
         if( rc != SQLITE_OK ){
             return rc;
         }
@@ -5076,7 +5077,9 @@ static int allocateBtreePage(
               }
             }
 
-            rc = btreeGetPage(pBt, iNewTrunk, &pNewTrunk, 0);
+            /* The content of a free-list leaf is never read, since FoundationDB may have punched a hole
+            ** for it in the file, and everything the new trunk needs is written below. */
+            rc = btreeGetPage(pBt, iNewTrunk, &pNewTrunk, !btreeGetHasContent(pBt, iNewTrunk));
             if( rc!=SQLITE_OK ){
               goto end_allocate_page;
             }
@@ -7205,6 +7208,75 @@ void swapChildren( u8* c1, u8* c2 ) {
   put4byte( c2, subtree );
 }
 
+/*
+** Call xLeaf for each leaf page of the free-list (but not for the trunk pages
+** which hold the list) that is within the database file.  A transaction must be
+** open on p.  The content of free-list leaves is never read, so the caller may
+** release the space they occupy in the file.
+*/
+SQLITE_PRIVATE int sqlite3BtreeFreeListLeaves(Btree *p, void (*xLeaf)(void*, u32), void *pArg) {
+  BtShared *pBt = p->pBt;
+  MemPage *pTrunk;
+  Pgno iTrunk, mxPage, leaf;
+  u32 nFree, nTrunk = 0, k, i;
+  int rc;
+
+  assert( p->inTrans>TRANS_NONE && pBt->pPage1 );
+  mxPage = btreePagecount(pBt);
+  nFree = get4byte(&pBt->pPage1->aData[36]);
+  iTrunk = get4byte(&pBt->pPage1->aData[32]);
+  while (iTrunk) {
+    if (iTrunk>mxPage || ++nTrunk>nFree)
+      return SQLITE_CORRUPT_BKPT;
+    rc = btreeGetPage(pBt, iTrunk, &pTrunk, 0);
+    if (rc)
+      return rc;
+    k = get4byte(&pTrunk->aData[4]);
+    if (k>pBt->usableSize/4 - 2) {
+      releasePage(pTrunk);
+      return SQLITE_CORRUPT_BKPT;
+    }
+    for (i=0; i<k; i++) {
+      // Leaves beyond the end of the file were truncated by incremental vacuum
+      leaf = get4byte(&pTrunk->aData[8+i*4]);
+      if (leaf<=mxPage)
+        xLeaf(pArg, leaf);
+    }
+    iTrunk = get4byte(&pTrunk->aData[0]);
+    releasePage(pTrunk);
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Find the leaf pages which the cursor will visit after (if bForward) or before
+** its current leaf page, using the child pointers of the parent page, which is
+** already in memory.  *pLeaf is set to the current leaf page number, or 0 if the
+** cursor is not on a leaf below the root.  Up to nMax page numbers are written to
+** aPgno, nearest first, and the number written is returned.  No page is read, so
+** the caller can start fetching the siblings before the cursor reaches them.
+*/
+SQLITE_PRIVATE int sqlite3BtreeSiblingLeafPages(BtCursor *pCur, int bForward, Pgno *pLeaf, Pgno *aPgno, int nMax) {
+  MemPage *pParent;
+  int i, n = 0;
+
+  *pLeaf = 0;
+  if (pCur->eState!=CURSOR_VALID || pCur->iPage<1 || !pCur->apPage[pCur->iPage]->leaf)
+    return 0;
+  *pLeaf = pCur->apPage[pCur->iPage]->pgno;
+
+  // Child i of an interior page is the left child of cell i, or the right child pointer at offset 8 of the header if i==nCell
+  pParent = pCur->apPage[pCur->iPage-1];
+  i = pCur->aiIdx[pCur->iPage-1];
+  while (n < nMax) {
+    i += bForward ? 1 : -1;
+    if (i < 0 || i > pParent->nCell)
+      break;
+    aPgno[n++] = get4byte( i==pParent->nCell ? &pParent->aData[pParent->hdrOffset+8] : findCell(pParent, i) );
+  }
+  return n;
+}
+
 SQLITE_PRIVATE int sqlite3BtreeDeleteRange(BtCursor *begin, BtCursor *end, int* stackBegin, int* stackEnd) {
   int level, cellBegin, cellEnd, rc;
   MemPage *page;
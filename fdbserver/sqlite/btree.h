@@ -160,6 +160,8 @@ int sqlite3BtreeCursorHasMoved(BtCursor*, int*);
 int sqlite3BtreeDelete(BtCursor*);
 int sqlite3BtreeDeleteRange(BtCursor*, BtCursor*, int* stackBegin, int* stackEnd);
 int sqlite3BtreeLazyDelete(BtCursor*, int* stackBegin, int* stackEnd, int desiredPages, int* pagesDeleted);
+int sqlite3BtreeFreeListLeaves(Btree*, void (*xLeaf)(void*, u32), void *pArg);
+int sqlite3BtreeSiblingLeafPages(BtCursor*, int bForward, u32 *pLeaf, u32 *aPgno, int nMax);
 int sqlite3BtreeInsert(BtCursor*, const void *pKey, i64 nKey,
                                   const void *pData, int nData,
                                   int nZero, int bias, int seekResult);
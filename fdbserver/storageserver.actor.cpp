@@ -23,10 +23,14 @@
 #include "fdbrpc/LoadBalance.h"
 #include "flow/IndexedSet.h"
 #include "flow/Hash3.h"
+#include "flow/KeyCompare.h"
 #include "flow/ActorCollection.h"
 #include "flow/SystemMonitor.h"
 #include "flow/Util.h"
+#include "flow/UnitTest.h"
 #include "fdbclient/Atomic.h"
+#include "fdbclient/BackupAgent.actor.h"
+#include "fdbclient/BackupContainer.h"
 #include "fdbclient/DatabaseContext.h"
 #include "fdbclient/KeyRangeMap.h"
 #include "fdbclient/MasterProxyInterface.h"
@@ -105,14 +109,19 @@ struct AddingShard : NonCopyable {
 	struct StorageServer* server;
 	Version transferredVersion;
 
+	// If present, the shard's contents are loaded from this file instead of being fetched from other servers.  The file
+	// holds the contents as of bulkVersion, so updates are kept from then on.
+	Optional<BulkIngestFile> bulkFile;
+	Version bulkVersion;
+
 	enum Phase { WaitPrevious, Fetching, Waiting };
 	Phase phase;
 
-	AddingShard( StorageServer* server, KeyRangeRef const& keys );
+	AddingShard( StorageServer* server, KeyRangeRef const& keys, Optional<BulkIngestFile> const& bulkFile, Version bulkVersion );
 
 	// When fetchKeys "partially completes" (splits an adding shard in two), this is used to construct the left half
 	AddingShard( AddingShard* prev, KeyRange const& keys )
-		: keys(keys), fetchClient(prev->fetchClient), server(prev->server), transferredVersion(prev->transferredVersion), phase(prev->phase)
+		: keys(keys), fetchClient(prev->fetchClient), server(prev->server), transferredVersion(prev->transferredVersion), bulkFile(prev->bulkFile), bulkVersion(prev->bulkVersion), phase(prev->phase)
 	{
 	}
 	~AddingShard() {
@@ -124,6 +133,12 @@ struct AddingShard : NonCopyable {
 
 	void addMutation( Version version, MutationRef const& mutation );
 
+	// Appends mutation to updates
+	void keepUpdate( Version version, MutationRef const& mutation );
+
+	// Adds the parts of other's updates within keys, when this shard restarts the loading of part of other's bulkFile
+	void addUpdates( AddingShard const& other );
+
 	bool isTransferred() const { return phase == Waiting; }
 };
 
@@ -144,7 +159,7 @@ struct ShardInfo : ReferenceCounted<ShardInfo>, NonCopyable {
 
 	static ShardInfo* newNotAssigned(KeyRange keys) { return new ShardInfo(keys, NULL, NULL); }
 	static ShardInfo* newReadWrite(KeyRange keys, StorageServer* data) { return new ShardInfo(keys, NULL, data); }
-	static ShardInfo* newAdding(StorageServer* data, KeyRange keys) { return new ShardInfo(keys, new AddingShard(data, keys), NULL); }
+	static ShardInfo* newAdding(StorageServer* data, KeyRange keys, Optional<BulkIngestFile> const& bulkFile = Optional<BulkIngestFile>(), Version bulkVersion = invalidVersion) { return new ShardInfo(keys, new AddingShard(data, keys, bulkFile, bulkVersion), NULL); }
 	static ShardInfo* addingSplitLeft( KeyRange keys, AddingShard* oldShard) { return new ShardInfo(keys, new AddingShard(oldShard, keys), NULL); }
 
 	bool isReadable() const { return readWrite!=NULL; }
@@ -162,8 +177,70 @@ struct ShardInfo : ReferenceCounted<ShardInfo>, NonCopyable {
 	}
 };
 
+// A bounded LRU cache of point reads from the storage engine.  An entry with an absent value records that the key is
+// not present.  The owner keeps it consistent with the storage engine by invalidating the keys it writes.
+class HotKeyCache : NonCopyable {
+public:
+	explicit HotKeyCache( int64_t capacity ) : capacity(capacity), bytes(0) {}
+
+	bool enabled() const { return capacity > 0; }
+	int64_t size() const { return bytes; }
+
+	// Returns the cached value of key, if key is cached
+	Optional<Optional<Value>> get( KeyRef key ) {
+		auto i = index.find( key );
+		if (i == index.end())
+			return Optional<Optional<Value>>();
+		lru.splice( lru.end(), lru, i->second );
+		return i->second->second;
+	}
+
+	void insert( KeyRef key, Optional<Value> const& value ) {
+		int64_t entryBytes = entrySize( key, value );
+		if (entryBytes > capacity)
+			return;
+		erase( key );
+		lru.emplace_back( Key(key), value );
+		index[ lru.back().first ] = std::prev( lru.end() );
+		bytes += entryBytes;
+		while (bytes > capacity)
+			erase( lru.begin() );
+	}
+
+	void erase( KeyRef key ) {
+		auto i = index.find( key );
+		if (i != index.end())
+			erase( i->second );
+	}
+
+	void erase( KeyRangeRef keys ) {
+		for(auto i = index.lower_bound( keys.begin ); i != index.end() && i->first < keys.end; )
+			erase( (i++)->second );
+	}
+
+private:
+	typedef std::list<std::pair<Key, Optional<Value>>> Entries;
+
+	int64_t capacity;
+	int64_t bytes;
+	Entries lru;	// Least recently used first
+	std::map<KeyRef, Entries::iterator> index;	// Keys refer to the Key in the entry
+
+	static int64_t entrySize( KeyRef key, Optional<Value> const& value ) {
+		return key.size() + (value.present() ? value.get().size() : 0) + 64;
+	}
+
+	void erase( Entries::iterator e ) {
+		bytes -= entrySize( e->first, e->second );
+		index.erase( e->first );
+		lru.erase( e );
+	}
+};
+
 struct StorageServerDisk {
-	explicit StorageServerDisk( struct StorageServer* data, IKeyValueStore* storage ) : data(data), storage(storage) {}
+	explicit StorageServerDisk( struct StorageServer* data, IKeyValueStore* storage )
+	  : data(data), storage(storage), hotKeys( storage->getType() == KeyValueStoreType::MEMORY ? 0 : SERVER_KNOBS->STORAGE_HOT_KEY_CACHE_BYTES ),
+	    cacheGeneration(0), writesSinceCommit(0) {}
 
 	void makeNewStorageServerDurable();
 	bool makeVersionMutationsDurable( Version& prevStorageVersion, Version newStorageVersion, int64_t& bytesLeft );
@@ -178,23 +255,56 @@ struct StorageServerDisk {
 
 	Future<Void> getError() { return storage->getError(); }
 	Future<Void> init() { return storage->init(); }
-	Future<Void> commit() { return storage->commit(); }
+	Future<Void> commit() { return commit(this); }
 
 	// SOMEDAY: Put readNextKeyInclusive in IKeyValueStore
 	Future<Key> readNextKeyInclusive( KeyRef key ) { return readFirstKey(storage, KeyRangeRef(key, allKeys.end)); }
-	Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID = Optional<UID>() ) { return storage->readValue(key, debugID); }
-	Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() ) { return storage->readValuePrefix(key, maxLength, debugID); }
+	Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID = Optional<UID>() );
+	Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() );
 	Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) { return storage->readRange(keys, rowLimit, byteLimit); }
 
+	// A versioned engine can serve reads of versions which are no longer in versionedData
+	bool isVersioned() { return storage->isVersioned(); }
+	void forgetVersionsBefore( Version version ) { storage->forgetVersionsBefore(version); }
+	Future<Optional<Value>> readValueAtVersion( KeyRef key, Version version, Optional<UID> debugID = Optional<UID>() ) { return storage->readValueAtVersion(key, version, debugID); }
+	Future<Standalone<VectorRef<KeyValueRef>>> readRangeAtVersion( KeyRangeRef keys, Version version, int rowLimit = 1<<30, int byteLimit = 1<<30 ) { return storage->readRangeAtVersion(keys, version, rowLimit, byteLimit); }
+
 	KeyValueStoreType getKeyValueStoreType() { return storage->getType(); }
 	StorageBytes getStorageBytes() { return storage->getStorageBytes(); }
+	int64_t getResidentBytesPerKV() { return storage->getResidentBytesPerKV(); }
+	int64_t getHotKeyCacheBytes() const { return hotKeys.size(); }
 
 private:
 	struct StorageServer* data;
 	IKeyValueStore* storage;
 
+	// hotKeys holds only values that match the committed state of storage.  A write removes the keys it touches, and no
+	// value is added while there are uncommitted writes, because the storage engine may not return them yet.  Values
+	// from reads that were in progress across a write or a commit are discarded, which cacheGeneration detects.
+	HotKeyCache hotKeys;
+	uint64_t cacheGeneration;
+	int64_t writesSinceCommit;
+
+	void set( KeyValueRef kv );
+	void clear( KeyRangeRef keys );
 	void writeMutations( MutationListRef mutations, Version debugVersion, const char* debugContext );
 
+	ACTOR static Future<Void> commit( StorageServerDisk* self ) {
+		state int64_t writes = self->writesSinceCommit;
+		wait( self->storage->commit() );
+		self->writesSinceCommit -= writes;
+		++self->cacheGeneration;
+		return Void();
+	}
+
+	ACTOR static Future<Optional<Value>> readValueAndCache( StorageServerDisk* self, Key key, Optional<UID> debugID ) {
+		state uint64_t generation = self->cacheGeneration;
+		Optional<Value> value = wait( self->storage->readValue( key, debugID ) );
+		if (generation == self->cacheGeneration)
+			self->hotKeys.insert( key, value );
+		return value;
+	}
+
 	ACTOR static Future<Key> readFirstKey( IKeyValueStore* storage, KeyRangeRef range ) {
 		Standalone<VectorRef<KeyValueRef>> r = wait( storage->readRange( range, 1 ) );
 		if (r.size()) return r[0].key;
@@ -404,6 +514,9 @@ public:
 	NotifiedVersion desiredOldestVersion;    // We can increase oldestVersion (and then durableVersion) to this version when the disk permits
 	NotifiedVersion oldestVersion;           // See also storageVersion()
 	NotifiedVersion durableVersion; 	     // At least this version will be readable from storage after a power failure
+	Version desiredEngineOldestVersion;      // With a versioned storage engine, versions at least this old need not be kept readable
+	Version engineOldestVersion;             // With a versioned storage engine, versions before this are no longer readable from storage
+	Version shardsReadableVersion;           // No shard became readable after this version, so older versions in storage are complete
 	Version rebootAfterDurableVersion;
 	int8_t primaryLocality;
 
@@ -465,7 +578,7 @@ public:
 
 	struct Counters {
 		CounterCollection cc;
-		Counter allQueries, getKeyQueries, getValueQueries, getRangeQueries, finishedQueries, rowsQueried, bytesQueried, watchQueries;
+		Counter allQueries, getKeyQueries, getValueQueries, getValuesQueries, getRangeQueries, getRangeStreamQueries, getRangeAggregateQueries, finishedQueries, rowsQueried, bytesQueried, watchQueries;
 		Counter bytesInput, bytesDurable, bytesFetched,
 			mutationBytes;  // Like bytesInput but without MVCC accounting
 		Counter mutations, setMutations, clearRangeMutations, atomicMutations;
@@ -473,6 +586,7 @@ public:
 		Counter loops;
 		Counter fetchWaitingMS, fetchWaitingCount, fetchExecutingMS, fetchExecutingCount;
 		Counter readsRejected;
+		Counter hotKeyCacheHits, hotKeyCacheMisses;
 
 		LatencyBands readLatencyBands;
 
@@ -480,7 +594,10 @@ public:
 			: cc("StorageServer", self->thisServerID.toString()),
 			getKeyQueries("GetKeyQueries", cc),
 			getValueQueries("GetValueQueries",cc),
+			getValuesQueries("GetValuesQueries", cc),
 			getRangeQueries("GetRangeQueries", cc),
+			getRangeStreamQueries("GetRangeStreamQueries", cc),
+			getRangeAggregateQueries("GetRangeAggregateQueries", cc),
 			allQueries("QueryQueue", cc),
 			finishedQueries("FinishedQueries", cc),
 			rowsQueried("RowsQueried", cc),
@@ -502,6 +619,8 @@ public:
 			fetchExecutingMS("FetchExecutingMS", cc),
 			fetchExecutingCount("FetchExecutingCount", cc),
 			readsRejected("ReadsRejected", cc),
+			hotKeyCacheHits("HotKeyCacheHits", cc),
+			hotKeyCacheMisses("HotKeyCacheMisses", cc),
 			readLatencyBands("ReadLatencyMetrics", self->thisServerID, SERVER_KNOBS->STORAGE_LOGGING_DELAY)
 		{
 			specialCounter(cc, "LastTLogVersion", [self](){ return self->lastTLogVersion; });
@@ -525,6 +644,8 @@ public:
 			specialCounter(cc, "KvstoreBytesFree", [self](){ return self->storage.getStorageBytes().free; });
 			specialCounter(cc, "KvstoreBytesAvailable", [self](){ return self->storage.getStorageBytes().available; });
 			specialCounter(cc, "KvstoreBytesTotal", [self](){ return self->storage.getStorageBytes().total; });
+			specialCounter(cc, "KvstoreBytesPerKV", [self](){ return self->storage.getResidentBytesPerKV(); });
+			specialCounter(cc, "HotKeyCacheBytes", [self](){ return self->storage.getHotKeyCacheBytes(); });
 		}
 	} counters;
 
@@ -532,6 +653,7 @@ public:
 		:	instanceID(deterministicRandom()->randomUniqueID().first()),
 			storage(this, storage), db(db),
 			lastTLogVersion(0), lastVersionWithData(0), restoredVersion(0),
+			desiredEngineOldestVersion(0), engineOldestVersion(0), shardsReadableVersion(0),
 			rebootAfterDurableVersion(std::numeric_limits<Version>::max()),
 			durableInProgress(Void()),
 			versionLag(0), primaryLocality(tagLocalityInvalid),
@@ -575,6 +697,9 @@ public:
 		desiredOldestVersion = ver;
 		oldestVersion = ver;
 		durableVersion = ver;
+		desiredEngineOldestVersion = ver;
+		engineOldestVersion = ver;
+		shardsReadableVersion = ver;
 		lastVersionWithData = ver;
 		restoredVersion = ver;
 
@@ -585,6 +710,14 @@ public:
 	// This is the maximum version that might be read from storage (the minimum version is durableVersion)
 	Version storageVersion() const { return oldestVersion.get(); }
 
+	// Reads at versions from here to storageVersion() are served by a versioned storage engine.  The engine's older
+	// versions are only complete for the shards which were already readable.
+	Version oldestReadableVersion() {
+		if (!storage.isVersioned())
+			return oldestVersion.get();
+		return std::min( oldestVersion.get(), std::max( engineOldestVersion, shardsReadableVersion ) );
+	}
+
 	bool isReadable( KeyRangeRef const& keys ) {
 		auto sh = shards.intersectingRanges(keys);
 		for(auto i = sh.begin(); i != sh.end(); ++i)
@@ -772,7 +905,7 @@ ACTOR Future<Version> waitForVersion( StorageServer* data, Version version ) {
 	// This could become an Actor transparently, but for now it just does the lookup
 	if (version == latestVersion)
 		version = std::max(Version(1), data->version.get());
-	if (version < data->oldestVersion.get() || version <= 0) throw transaction_too_old();
+	if (version < data->oldestReadableVersion() || version <= 0) throw transaction_too_old();
 	else if (version <= data->version.get())
 		return version;
 
@@ -786,7 +919,7 @@ ACTOR Future<Version> waitForVersion( StorageServer* data, Version version ) {
 		when ( wait( data->version.whenAtLeast(version) ) ) {
 			//FIXME: A bunch of these can block with or without the following delay 0.
 			//wait( delay(0) );  // don't do a whole bunch of these at once
-			if (version < data->oldestVersion.get()) throw transaction_too_old();  // just in case
+			if (version < data->oldestReadableVersion()) throw transaction_too_old();  // just in case
 			return version;
 		}
 		when ( wait( delay( SERVER_KNOBS->FUTURE_VERSION_DELAY ) ) ) {
@@ -850,24 +983,32 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 		}
 
 		state int path = 0;
-		auto i = data->data().at(version).lastLessOrEqual(req.key);
-		if (i && i->isValue() && i.key() == req.key) {
-			v = (Value)i->getValue();
-			path = 1;
-		} else if (!i || !i->isClearTo() || i->getEndKey() <= req.key) {
-			path = 2;
-			Optional<Value> vv = wait( data->storage.readValue( req.key, req.debugID ) );
-			// Validate that while we were reading the data we didn't lose the version or shard
-			if (version < data->storageVersion()) {
-				TEST(true); // transaction_too_old after readValue
-				throw transaction_too_old();
-			}
+		if (version < data->storageVersion()) {
+			// The version is no longer in versionedData, but a versioned storage engine still has it
+			path = 3;
+			Optional<Value> vv = wait( data->storage.readValueAtVersion( req.key, version, req.debugID ) );
 			data->checkChangeCounter(changeCounter, req.key);
 			v = vv;
+		} else {
+			auto i = data->data().at(version).lastLessOrEqual(req.key);
+			if (i && i->isValue() && i.key() == req.key) {
+				v = (Value)i->getValue();
+				path = 1;
+			} else if (!i || !i->isClearTo() || i->getEndKey() <= req.key) {
+				path = 2;
+				Optional<Value> vv = wait( data->storage.readValue( req.key, req.debugID ) );
+				// Validate that while we were reading the data we didn't lose the version or shard
+				if (version < data->storageVersion()) {
+					TEST(true); // transaction_too_old after readValue
+					throw transaction_too_old();
+				}
+				data->checkChangeCounter(changeCounter, req.key);
+				v = vv;
+			}
 		}
 
 		debugMutation("ShardGetValue", version, MutationRef(MutationRef::DebugKey, req.key, v.present()?v.get():LiteralStringRef("<null>")));
-		debugMutation("ShardGetPath", version, MutationRef(MutationRef::DebugKey, req.key, path==0?LiteralStringRef("0"):path==1?LiteralStringRef("1"):LiteralStringRef("2")));
+		debugMutation("ShardGetPath", version, MutationRef(MutationRef::DebugKey, req.key, path==0?LiteralStringRef("0"):path==1?LiteralStringRef("1"):path==2?LiteralStringRef("2"):LiteralStringRef("3")));
 
 		/*
 		StorageMetrics m;
@@ -904,6 +1045,106 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 	return Void();
 };
 
+// Like getValueQ for each of req.keys, except that the reads from storage are all issued before waiting for any
+// of them.  Every key counts as a GetValueQuery.
+ACTOR Future<Void> getValuesQ( StorageServer* data, GetValuesRequest req ) {
+	state int64_t resultSize = 0;
+
+	try {
+		++data->counters.getValuesQueries;
+		data->counters.getValueQueries += req.keys.size();
+		++data->counters.allQueries;
+		++data->readQueueSizeMetric;
+		data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+		// Active load balancing runs at a very high priority (to obtain accurate queue lengths)
+		// so we need to downgrade here
+		wait( delay(0, TaskPriority::DefaultEndpoint) );
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValuesQ.DoRead"); //.detail("TaskID", g_network->getCurrentTask());
+
+		state Version version = wait( waitForVersion( data, req.version ) );
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValuesQ.AfterVersion"); //.detail("TaskID", g_network->getCurrentTask());
+
+		state uint64_t changeCounter = data->shardChangeCounter;
+		state GetValuesReply reply;
+		state std::vector<Optional<ValueRef>> values( req.keys.size() );
+		state std::vector<int> storageReadIndices;
+		state std::vector<Future<Optional<Value>>> storageReads;
+		state bool readAtVersion = version < data->storageVersion();
+
+		for(int k = 0; k < req.keys.size(); k++) {
+			KeyRef key = req.keys[k];
+			if (!data->shards[key]->isReadable())
+				throw wrong_shard_server();
+
+			if (readAtVersion) {
+				// See getValueQ
+				storageReadIndices.push_back(k);
+				storageReads.push_back( data->storage.readValueAtVersion( key, version, req.debugID ) );
+				continue;
+			}
+
+			auto i = data->data().at(version).lastLessOrEqual(key);
+			if (i && i->isValue() && i.key() == key) {
+				values[k] = ValueRef( reply.arena, i->getValue() );
+			} else if (!i || !i->isClearTo() || i->getEndKey() <= key) {
+				storageReadIndices.push_back(k);
+				storageReads.push_back( data->storage.readValue( key, req.debugID ) );
+			}
+		}
+
+		if (storageReads.size()) {
+			wait( waitForAll( storageReads ) );
+			// Validate that while we were reading the data we didn't lose the version or shard
+			if (!readAtVersion && version < data->storageVersion()) {
+				TEST(true); // transaction_too_old after readValue in getValuesQ
+				throw transaction_too_old();
+			}
+			for(int r = 0; r < storageReads.size(); r++) {
+				int k = storageReadIndices[r];
+				data->checkChangeCounter(changeCounter, req.keys[k]);
+				const Optional<Value>& v = storageReads[r].get();
+				if (v.present()) {
+					reply.arena.dependsOn( v.get().arena() );
+					values[k] = v.get();
+				}
+			}
+		}
+
+		for(int k = 0; k < req.keys.size(); k++) {
+			debugMutation("ShardGetValue", version, MutationRef(MutationRef::DebugKey, req.keys[k], values[k].present()?values[k].get():LiteralStringRef("<null>")));
+			if (values[k].present()) {
+				reply.data.push_back( reply.arena, KeyValueRef( KeyRef( reply.arena, req.keys[k] ), values[k].get() ) );
+				++data->counters.rowsQueried;
+				resultSize += values[k].get().size();
+			}
+		}
+		data->counters.bytesQueried += resultSize;
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValuesQ.AfterRead"); //.detail("TaskID", g_network->getCurrentTask());
+
+		reply.penalty = data->getPenalty();
+		req.reply.send(reply);
+	} catch (Error& e) {
+		if(!canReplyWith(e))
+			throw;
+		data->sendErrorWithPenalty(req.reply, e, data->getPenalty());
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+	if(data->latencyBandConfig.present()) {
+		int maxReadBytes = data->latencyBandConfig.get().readConfig.maxReadBytes.orDefault(std::numeric_limits<int>::max());
+		data->counters.readLatencyBands.addMeasurement(timer() - req.requestTime(), resultSize > maxReadBytes);
+	}
+
+	return Void();
+}
+
 ACTOR Future<Void> watchValue_impl( StorageServer* data, WatchValueRequest req ) {
 	try {
 		++data->counters.watchQueries;
@@ -1046,11 +1287,13 @@ void merge( Arena& arena, VectorRef<KeyValueRef, VecSerStrategy::String>& output
 	KeyValueRef const* baseStart = base.begin();
 	KeyValueRef const* baseEnd = base.end();
 	while (baseStart!=baseEnd && start!=end && --limit>=0 && accumulatedBytes < limitBytes) {
-		if (forward ? baseStart->key < start.key() : baseStart->key > start.key())
+		KeyRef startKey = start.key();
+		int cmp = compareKeys( baseStart->key.begin(), baseStart->key.size(), startKey.begin(), startKey.size() );
+		if (forward ? cmp < 0 : cmp > 0)
 			output.push_back_deep( arena, *baseStart++ );
 		else {
-			output.push_back_deep( arena, KeyValueRef(start.key(), start->getValue()) );
-			if (baseStart->key == start.key()) ++baseStart;
+			output.push_back_deep( arena, KeyValueRef(startKey, start->getValue()) );
+			if (cmp == 0) ++baseStart;
 			if (forward) ++start; else --start;
 		}
 		accumulatedBytes += sizeof(KeyValueRef) + output.end()[-1].expectedSize();
@@ -1069,10 +1312,26 @@ void merge( Arena& arena, VectorRef<KeyValueRef, VecSerStrategy::String>& output
 	ASSERT( output.size() <= originalLimit );
 }
 
-// readRange reads up to |limit| rows from the given range and version, combining data->storage and data->versionedData.
-// If limit>=0, it returns the first rows in the range (sorted ascending), otherwise the last rows (sorted descending).
-// readRange has O(|result|) + O(log |data|) cost
-ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes ) {
+// Like readRange, for a version which is no longer in data->versionedData but is still kept by a versioned storage engine
+ACTOR Future<GetKeyValuesReply> readRangeAtStorageVersion( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes ) {
+	state GetKeyValuesReply result;
+	result.version = version;
+	if (limit == 0 || *pLimitBytes <= 0) {
+		result.more = true;
+		return result;
+	}
+
+	Standalone<VectorRef<KeyValueRef>> atVersion = wait( data->storage.readRangeAtVersion( range, version, limit, *pLimitBytes ) );
+	result.arena.dependsOn( atVersion.arena() );
+	result.data = atVersion;
+	for (auto& kv : atVersion)
+		*pLimitBytes -= sizeof(KeyValueRef) + kv.expectedSize();
+	result.more = atVersion.size() == std::abs(limit) || *pLimitBytes <= 0;
+	return result;
+}
+
+// Like readRange, for a version which is still in data->versionedData
+ACTOR Future<GetKeyValuesReply> readRangeAtMemoryVersion( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes ) {
 	state GetKeyValuesReply result;
 	state StorageServer::VersionedData::ViewAtVersion view = data->data().at(version);
 	state StorageServer::VersionedData::iterator vStart = view.end();
@@ -1255,6 +1514,64 @@ ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version,
 	return result;
 }
 
+// readRange reads up to |limit| rows from the given range and version, combining data->storage and data->versionedData.
+// If limit>=0, it returns the first rows in the range (sorted ascending), otherwise the last rows (sorted descending).
+// readRange has O(|result|) + O(log |data|) cost
+Future<GetKeyValuesReply> readRange( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes ) {
+	if (version < data->storageVersion())
+		return readRangeAtStorageVersion( data, version, range, limit, pLimitBytes );
+	return readRangeAtMemoryVersion( data, version, range, limit, pLimitBytes );
+}
+
+// Like readRange, but returns only the rows that pass filter, projected by it.  limit and *pLimitBytes apply to the rows
+// returned.  The scan examines at most about RANGE_FILTER_SCAN_BYTES of rows; if it stops early the result has more set and
+// scannedThrough set to the last key it examined.
+ACTOR Future<GetKeyValuesReply> readRangeFiltered( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes, RangeFilterRef filter ) {
+	state GetKeyValuesReply result;
+	state int scanBytes = SERVER_KNOBS->RANGE_FILTER_SCAN_BYTES;
+	state bool reverse = limit < 0;
+	state int remaining = std::abs(limit);
+
+	loop {
+		state int chunkBytes = std::min( scanBytes, CLIENT_KNOBS->REPLY_BYTE_LIMIT );
+		state int chunkStartBytes = chunkBytes;
+		GetKeyValuesReply r = wait( readRange( data, version, range, reverse ? -CLIENT_KNOBS->REPLY_BYTE_LIMIT : CLIENT_KNOBS->REPLY_BYTE_LIMIT, &chunkBytes ) );
+		scanBytes -= chunkStartBytes - chunkBytes;
+
+		int i = 0;
+		for(; i < r.data.size() && remaining > 0 && *pLimitBytes > 0; i++) {
+			if (filter.matches(r.data[i])) {
+				result.data.push_back_deep( result.arena, filter.project(r.data[i]) );
+				*pLimitBytes -= sizeof(KeyValueRef) + result.data.end()[-1].expectedSize();
+				--remaining;
+			}
+		}
+
+		if (i < r.data.size() || (r.more && (remaining == 0 || *pLimitBytes <= 0))) {
+			// The limits were reached
+			result.more = true;
+			break;
+		}
+		if (!r.more) {
+			result.more = false;
+			break;
+		}
+
+		KeyRef last = r.data.end()[-1].key;
+		if (scanBytes <= 0) {
+			TEST(true); // Filtered range read stopped at its scan limit
+			result.more = true;
+			result.scannedThrough = KeyRef( result.arena, last );
+			break;
+		}
+		Arena arena;
+		KeyRangeRef next( arena, reverse ? KeyRangeRef( range.begin, last ) : KeyRangeRef( keyAfter(last), range.end ) );
+		range = KeyRange( next, arena );
+	}
+	result.version = version;
+	return result;
+}
+
 bool selectorInRange( KeySelectorRef const& sel, KeyRangeRef const& range ) {
 	// Returns true if the given range suffices to at least begin to resolve the given KeySelectorRef
 	return sel.getKey() >= range.begin && (sel.isBackward() ? sel.getKey() <= range.end : sel.getKey() < range.end);
@@ -1270,7 +1587,7 @@ ACTOR Future<Key> findKey( StorageServer* data, KeySelectorRef sel, Version vers
 // The range passed in to this function should specify a shard.  If range.begin is repeatedly not the beginning of a shard, then it is possible to get stuck looping here
 {
 	ASSERT( version != latestVersion );
-	ASSERT( selectorInRange(sel, range) && version >= data->oldestVersion.get() );
+	ASSERT( selectorInRange(sel, range) && version >= data->oldestReadableVersion() );
 
 	// Count forward or backward distance items, skipping the first one if it == key and skipEqualKey
 	state bool forward = sel.offset > 0;                  // If forward, result >= sel.getKey(); else result <= sel.getKey()
@@ -1413,7 +1730,10 @@ ACTOR Future<Void> getKeyValues( StorageServer* data, GetKeyValuesRequest req )
 		} else {
 			state int remainingLimitBytes = req.limitBytes;
 
-			GetKeyValuesReply _r = wait( readRange(data, version, KeyRangeRef(begin, end), req.limit, &remainingLimitBytes) );
+			state Future<GetKeyValuesReply> fReply = req.filter.present() ?
+				readRangeFiltered(data, version, KeyRangeRef(begin, end), req.limit, &remainingLimitBytes, req.filter.get()) :
+				readRange(data, version, KeyRangeRef(begin, end), req.limit, &remainingLimitBytes);
+			GetKeyValuesReply _r = wait( fReply );
 			GetKeyValuesReply r = _r;
 
 			if( req.debugID.present() )
@@ -1460,6 +1780,214 @@ ACTOR Future<Void> getKeyValues( StorageServer* data, GetKeyValuesRequest req )
 	return Void();
 }
 
+ACTOR Future<Void> getKeyValuesStreamQ( StorageServer* data, GetKeyValuesStreamRequest req )
+// Like getKeyValues, but sends the result in chunks of up to RANGE_STREAM_CHUNK_BYTES until the request's limits are reached,
+// pausing whenever more than RANGE_STREAM_WINDOW_BYTES have been sent and not acknowledged
+{
+	state RequestStream<GetKeyValuesStreamAck> acknowledge;
+	state Endpoint chunksEndpoint = req.chunks.getEndpoint();
+	state Future<Void> disconnected = chunksEndpoint.isLocal() ? Never() : IFailureMonitor::failureMonitor().onDisconnectOrFailure(chunksEndpoint);
+	state int64_t bytesSent = 0;
+	state int64_t bytesAcknowledged = 0;
+	state int64_t sequence = 0;
+	state int64_t resultSize = 0;
+
+	++data->counters.getRangeStreamQueries;
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	TaskPriority taskType = TaskPriority::DefaultEndpoint;
+	if (SERVER_KNOBS->FETCH_KEYS_LOWER_PRIORITY && req.isFetchKeys) {
+		taskType = TaskPriority::FetchKeys;
+	}
+	wait( delay(0, taskType) );
+
+	try {
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getKeyValuesStream.Before");
+		state Version version = wait( waitForVersion( data, req.version ) );
+
+		state uint64_t changeCounter = data->shardChangeCounter;
+		state KeyRange shard = getShardKeyRange( data, req.begin );
+
+		if ( !selectorInRange(req.end, shard) && !(req.end.isFirstGreaterOrEqual() && req.end.getKey() == shard.end) ) {
+			throw wrong_shard_server();
+		}
+
+		state int offset1;
+		state int offset2;
+		state Future<Key> fBegin = req.begin.isFirstGreaterOrEqual() ? Future<Key>(req.begin.getKey()) : findKey( data, req.begin, version, shard, &offset1 );
+		state Future<Key> fEnd = req.end.isFirstGreaterOrEqual() ? Future<Key>(req.end.getKey()) : findKey( data, req.end, version, shard, &offset2 );
+		state Key begin = wait(fBegin);
+		state Key end = wait(fEnd);
+
+		// See getKeyValues
+		if ((offset1 && offset1!=1) || (offset2 && offset2!=1)) {
+			TEST(true);  // wrong_shard_server due to offset in a range stream
+			throw wrong_shard_server();
+		}
+		data->checkChangeCounter( changeCounter, KeyRangeRef( std::min<KeyRef>(req.begin.getKey(), req.end.getKey()), std::max<KeyRef>(req.begin.getKey(), req.end.getKey()) ) );
+
+		state bool reverse = req.limit < 0;
+		state int remainingLimit = std::abs(req.limit);
+		state int remainingLimitBytes = req.limitBytes;
+		loop {
+			while( bytesSent - bytesAcknowledged > SERVER_KNOBS->RANGE_STREAM_WINDOW_BYTES ) {
+				choose {
+					when( GetKeyValuesStreamAck ack = waitNext(acknowledge.getFuture()) ) {
+						bytesAcknowledged = std::max( bytesAcknowledged, ack.bytes );
+					}
+					when( wait( disconnected ) ) {
+						// The client is gone, so there is nobody to reply to
+						throw request_maybe_delivered();
+					}
+					when( wait( data->storage.isVersioned() ? Future<Void>(Never()) : data->oldestVersion.whenAtLeast( version+1 ) ) ) {
+						TEST(true); // Range stream outlived its version
+						throw transaction_too_old();
+					}
+				}
+			}
+
+			state GetKeyValuesStreamChunk chunk;
+			state bool last = true;
+			chunk.sequence = sequence;
+			if( sequence == 0 )
+				chunk.acknowledge = acknowledge;
+			chunk.version = version;
+
+			if( begin < end ) {
+				if( version < data->oldestReadableVersion() ) throw transaction_too_old();
+
+				state int chunkLimitBytes = std::min( remainingLimitBytes, SERVER_KNOBS->RANGE_STREAM_CHUNK_BYTES );
+				state int chunkStartBytes = chunkLimitBytes;
+				GetKeyValuesReply r = wait( readRange(data, version, KeyRangeRef(begin, end), reverse ? -remainingLimit : remainingLimit, &chunkLimitBytes) );
+				data->checkChangeCounter( changeCounter, KeyRangeRef(begin, end) );
+
+				chunk.arena = r.arena;
+				chunk.data = r.data;
+				remainingLimit -= r.data.size();
+				remainingLimitBytes -= chunkStartBytes - chunkLimitBytes;
+				resultSize += chunkStartBytes - chunkLimitBytes;
+				data->counters.rowsQueried += r.data.size();
+
+				// The stream ends when the range is exhausted or the request's limits are reached
+				chunk.more = r.more;
+				last = !r.more || remainingLimit <= 0 || remainingLimitBytes <= 0;
+				if( !last ) {
+					ASSERT( r.data.size() );
+					if( reverse )
+						end = r.data.end()[-1].key;
+					else
+						begin = keyAfter( r.data.end()[-1].key );
+				}
+			}
+
+			bytesSent += chunk.data.expectedSize();
+			req.chunks.send( chunk );
+			++sequence;
+			if( last )
+				break;
+		}
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getKeyValuesStream.Send");
+
+		GetKeyValuesStreamReply reply;
+		reply.chunks = sequence;
+		reply.penalty = data->getPenalty();
+		req.reply.send( reply );
+	} catch (Error& e) {
+		if(e.code() != error_code_request_maybe_delivered) {
+			if(!canReplyWith(e))
+				throw;
+			data->sendErrorWithPenalty(req.reply, e, data->getPenalty());
+		}
+	}
+
+	data->counters.bytesQueried += resultSize;
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+ACTOR Future<Void> getRangeAggregateQ( StorageServer* data, GetRangeAggregateRequest req )
+// Throws a wrong_shard_server if req.keys is not within a single readable shard of this server
+{
+	state int64_t resultSize = 0;
+
+	++data->counters.getRangeAggregateQueries;
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	// Active load balancing runs at a very high priority (to obtain accurate queue lengths)
+	// so we need to downgrade here
+	wait( delay(0, TaskPriority::DefaultEndpoint) );
+
+	try {
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getRangeAggregate.Before");
+		state Version version = wait( waitForVersion( data, req.version ) );
+
+		state uint64_t changeCounter = data->shardChangeCounter;
+		state KeyRange shard = getShardKeyRange( data, firstGreaterOrEqual(req.keys.begin) );
+		if (req.keys.end > shard.end)
+			throw wrong_shard_server();
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getRangeAggregate.AfterVersion");
+
+		state GetRangeAggregateReply reply;
+		state KeyRange range = req.keys;
+		state int scanBytes = SERVER_KNOBS->RANGE_AGGREGATE_SCAN_BYTES;
+		while (!range.empty()) {
+			state int chunkBytes = std::min( scanBytes, CLIENT_KNOBS->REPLY_BYTE_LIMIT );
+			state int chunkStartBytes = chunkBytes;
+			GetKeyValuesReply r = wait( readRange( data, version, range, CLIENT_KNOBS->REPLY_BYTE_LIMIT, &chunkBytes ) );
+			scanBytes -= chunkStartBytes - chunkBytes;
+			resultSize += chunkStartBytes - chunkBytes;
+
+			for(auto& kv : r.data) {
+				if (!req.filter.present())
+					reply.aggregate.add(kv);
+				else if (req.filter.get().matches(kv))
+					reply.aggregate.add(req.filter.get().project(kv));
+			}
+
+			if (!r.more)
+				break;
+			KeyRef last = r.data.end()[-1].key;
+			if (scanBytes <= 0) {
+				TEST(true); // Range aggregate stopped at its scan limit
+				reply.scannedThrough = KeyRef( reply.arena, last );
+				break;
+			}
+			Arena arena;
+			KeyRangeRef next( arena, KeyRangeRef( keyAfter(last), range.end ) );
+			range = KeyRange( next, arena );
+		}
+		data->checkChangeCounter( changeCounter, req.keys );
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getRangeAggregate.AfterReadRange");
+
+		reply.penalty = data->getPenalty();
+		req.reply.send( reply );
+	} catch (Error& e) {
+		if(!canReplyWith(e))
+			throw;
+		data->sendErrorWithPenalty(req.reply, e, data->getPenalty());
+	}
+
+	data->counters.bytesQueried += resultSize;
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
 ACTOR Future<Void> getKey( StorageServer* data, GetKeyRequest req ) {
 	state int64_t resultSize = 0;
 
@@ -1809,6 +2337,8 @@ void removeDataRange( StorageServer *ss, Standalone<VersionUpdateRef> &mLV, KeyR
 
 void setAvailableStatus( StorageServer* self, KeyRangeRef keys, bool available );
 void setAssignedStatus( StorageServer* self, KeyRangeRef keys, bool nowAssigned );
+void setBulkIngestStatus( StorageServer* self, KeyRangeRef keys, Optional<BulkIngestFile> const& file, Version version = invalidVersion );
+void persistBulkIngestUpdate( StorageServer* self, Version version, MutationRef const& mutation );
 
 void coalesceShards(StorageServer *data, KeyRangeRef keys) {
 	auto shardRanges = data->shards.intersectingRanges(keys);
@@ -1936,6 +2466,43 @@ void splitMutation(StorageServer* data, KeyRangeMap<T>& map, MutationRef const&
 		ASSERT(false);  // Unknown mutation type in splitMutations
 }
 
+// Loads the part of a bulk ingest file within keys into storage, in place of fetching it from other storage servers.  As with
+// fetched data, the keys are not available until the shard's availability is durable, and are cleared when the server
+// restores its state before then.
+ACTOR Future<Void> fetchBulkIngestFile( StorageServer* data, BulkIngestFile file, KeyRange keys, UID fetchKeysID ) {
+	state Reference<IBackupContainer> bc = IBackupContainer::openContainer( file.container );
+	state Reference<IAsyncFile> inFile = wait( bc->readFile( file.fileName ) );
+	state int64_t offset = 0;
+
+	for(; offset < file.fileSize; offset += file.blockSize) {
+		state Standalone<VectorRef<KeyValueRef>> block = wait( fileBackup::decodeRangeFileBlock( inFile, offset, std::min<int64_t>( file.blockSize, file.fileSize - offset ) ) );
+
+		// The first and last keys of a block are the bounds of its range rather than data
+		if (block.back().key <= keys.begin)
+			continue;
+		if (block.front().key >= keys.end)
+			break;
+
+		state int expectedSize = 0;
+		state KeyValueRef* kvItr = block.begin() + 1;
+		for(; kvItr != block.end() - 1; ++kvItr) {
+			if (keys.contains( kvItr->key )) {
+				data->storage.writeKeyValue( *kvItr );
+				data->byteSampleApplySet( *kvItr, invalidVersion );
+				expectedSize += kvItr->expectedSize() + 8;
+			}
+			wait(yield());
+		}
+
+		TraceEvent(SevDebug, "FetchKeysBulkBlock", data->thisServerID).detail("FKID", fetchKeysID)
+			.detail("Offset", offset).detail("BlockBytes", expectedSize)
+			.detail("KeyBegin", keys.begin).detail("KeyEnd", keys.end);
+		data->counters.bytesFetched += expectedSize;
+	}
+
+	return Void();
+}
+
 ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 	state TraceInterval interval("FetchKeys");
 	state KeyRange keys = shard->keys;
@@ -2002,7 +2569,25 @@ ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 		//FIXME: The client cache does not notice when servers are added to a team. To read from a local storage server we must refresh the cache manually.
 		data->cx->invalidateCache(keys);
 
-		loop {
+		// A bulk ingested shard is loaded in one pass, without splitting off the remainder, because its updates have to be kept
+		// from before fetchVersion
+		while (shard->bulkFile.present()) {
+			try {
+				TEST(true); // Loading keys for bulk ingested shard
+				wait( fetchBulkIngestFile( data, shard->bulkFile.get(), keys, interval.pairID ) );
+				break;
+			} catch (Error& e) {
+				if (e.code() == error_code_actor_cancelled)
+					throw;
+				TraceEvent(SevWarnAlways, "FetchKeysBulkIngestFailed", data->thisServerID).error(e).suppressFor(60.0)
+					.detail("FKID", interval.pairID).detail("File", shard->bulkFile.get().toString());
+				data->storage.clearRange( keys );
+				data->byteSampleApplyClear( keys, invalidVersion );
+				wait( delayJittered( SERVER_KNOBS->BULK_INGEST_RETRY_DELAY ) );
+			}
+		}
+
+		while (!shard->bulkFile.present()) {
 			try {
 				TEST(true);		// Fetching keys for transferred shard
 
@@ -2165,15 +2750,19 @@ ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 				debugMutation("fetchKeysFinalCommitInject", batch->changes[0].version, m);
 		}
 
+		// The updates come back through AddingShard::addMutation, which keeps them again for a bulk ingested shard
 		shard->updates.clear();
 
 		setAvailableStatus(data, keys, true); // keys will be available when getLatestVersion()==transferredVersion is durable
+		if (shard->bulkFile.present())
+			setBulkIngestStatus(data, keys, Optional<BulkIngestFile>());
 
 		// Wait for the transferredVersion (and therefore the shard data) to be committed and durable.
 		wait( data->durableVersion.whenAtLeast( shard->transferredVersion ) );
 
 		ASSERT( data->shards[shard->keys.begin]->assigned() && data->shards[shard->keys.begin]->keys == shard->keys );  // We aren't changing whether the shard is assigned
 		data->newestAvailableVersion.insert(shard->keys, latestVersion);
+		data->shardsReadableVersion = std::max( data->shardsReadableVersion, data->storageVersion() );
 		shard->readWrite.send(Void());
 		data->addShard( ShardInfo::newReadWrite(shard->keys, data) );   // invalidates shard!
 		coalesceShards(data, keys);
@@ -2213,8 +2802,8 @@ ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 	return Void();
 };
 
-AddingShard::AddingShard( StorageServer* server, KeyRangeRef const& keys )
-	: server(server), keys(keys), transferredVersion(invalidVersion), phase(WaitPrevious)
+AddingShard::AddingShard( StorageServer* server, KeyRangeRef const& keys, Optional<BulkIngestFile> const& bulkFile, Version bulkVersion )
+	: server(server), keys(keys), transferredVersion(invalidVersion), bulkFile(bulkFile), bulkVersion(bulkVersion), phase(WaitPrevious)
 {
 	fetchClient = fetchKeys(server, this);
 }
@@ -2227,21 +2816,47 @@ void AddingShard::addMutation( Version version, MutationRef const& mutation ){
 		ASSERT( keys.contains(mutation.param1) );
 	}
 
-	if (phase == WaitPrevious) {
+	if (phase == WaitPrevious && !bulkFile.present()) {
 		// Updates can be discarded
-	} else if (phase == Fetching) {
-		if (!updates.size() || version > updates.end()[-1].version) {
-			VerUpdateRef v;
-			v.version = version;
-			v.isPrivateData = false;
-			updates.push_back(v);
-		} else {
-			ASSERT( version == updates.end()[-1].version );
-		}
-		updates.back().mutations.push_back_deep( updates.back().arena(), mutation );
-	} else if (phase == Waiting) {
+		return;
+	}
+
+	if (phase == Waiting) {
 		server->addMutation(version, mutation, keys, server->updateEagerReads);
-	} else ASSERT(false);
+	}
+
+	// A bulk ingested shard keeps all of its updates until it is readable, in case it has to start over (see addUpdates).
+	// Until it has the file's contents they are also made durable, because after a reboot they cannot be fetched again.
+	if (phase != Waiting || bulkFile.present())
+		keepUpdate( version, mutation );
+	if (phase != Waiting && bulkFile.present())
+		persistBulkIngestUpdate( server, version, mutation );
+}
+
+void AddingShard::keepUpdate( Version version, MutationRef const& mutation ) {
+	if (!updates.size() || version > updates.end()[-1].version) {
+		VerUpdateRef v;
+		v.version = version;
+		v.isPrivateData = false;
+		updates.push_back(v);
+	} else {
+		ASSERT( version == updates.end()[-1].version );
+	}
+	updates.back().mutations.push_back_deep( updates.back().arena(), mutation );
+}
+
+void AddingShard::addUpdates( AddingShard const& other ) {
+	for(auto& u : other.updates) {
+		for(auto& m : u.mutations) {
+			if (m.type == MutationRef::ClearRange) {
+				KeyRangeRef clearKeys = keys & KeyRangeRef(m.param1, m.param2);
+				if (!clearKeys.empty())
+					keepUpdate( u.version, MutationRef(MutationRef::ClearRange, clearKeys.begin, clearKeys.end) );
+			} else if (keys.contains(m.param1)) {
+				keepUpdate( u.version, m );
+			}
+		}
+	}
 }
 
 void ShardInfo::addMutation(Version version, MutationRef const& mutation) {
@@ -2260,6 +2875,24 @@ void ShardInfo::addMutation(Version version, MutationRef const& mutation) {
 enum ChangeServerKeysContext { CSK_UPDATE, CSK_RESTORE };
 const char* changeServerKeysContextName[] = { "Update", "Restore" };
 
+// Replaces the part of shard within range with a new ShardInfo in the same state, for use before inserting a shard which
+// overlaps it.  If shard is an adding shard, the new one starts over.
+void reinitializeShard( StorageServer* data, KeyRange const& range, Reference<ShardInfo> const& shard ) {
+	if (shard->notAssigned())
+		data->addShard( ShardInfo::newNotAssigned(range) );
+	else if (shard->isReadable())
+		data->addShard( ShardInfo::newReadWrite(range, data) );
+	else {
+		ASSERT( shard->adding );
+		data->addShard( ShardInfo::newAdding( data, range, shard->adding->bulkFile, shard->adding->bulkVersion ) );
+		if (shard->adding->bulkFile.present()) {
+			TEST( true ); // Restarting part of a bulk ingested shard
+			data->shards[range.begin]->adding->addUpdates( *shard->adding );
+		}
+		TEST( true );	// ChangeServerKeys reFetchKeys
+	}
+}
+
 void changeServerKeys( StorageServer* data, const KeyRangeRef& keys, bool nowAssigned, Version version, ChangeServerKeysContext context ) {
 	ASSERT( !keys.empty() );
 
@@ -2303,15 +2936,8 @@ void changeServerKeys( StorageServer* data, const KeyRangeRef& keys, bool nowAss
 	for(int i=0; i<ranges.size(); i++) {
 		if (!ranges[i].value) {
 			ASSERT( (KeyRangeRef&)ranges[i] == keys ); // there shouldn't be any nulls except for the range being inserted
-		} else if (ranges[i].value->notAssigned())
-			data->addShard( ShardInfo::newNotAssigned(ranges[i]) );
-		else if (ranges[i].value->isReadable())
-			data->addShard( ShardInfo::newReadWrite(ranges[i], data) );
-		else {
-			ASSERT( ranges[i].value->adding );
-			data->addShard( ShardInfo::newAdding( data, ranges[i] ) );
-			TEST( true );	// ChangeServerKeys reFetchKeys
-		}
+		} else
+			reinitializeShard( data, ranges[i], ranges[i].value );
 	}
 
 	// Shard state depends on nowAssigned and whether the data is available (actually assigned in memory or on the disk) up to the given
@@ -2374,6 +3000,66 @@ void changeServerKeys( StorageServer* data, const KeyRangeRef& keys, bool nowAss
 	validate(data);
 }
 
+// Makes the assigned shards in keys load their contents from a bulk ingest file.  The client checked that keys were empty at
+// version, so like shards moving to this server, they become adding shards with that as their starting point.
+void bulkIngestShards( StorageServer* data, const KeyRangeRef& keys, BulkIngestFile const& file, Version version, ChangeServerKeysContext context ) {
+	ASSERT( !keys.empty() );
+	validate(data);
+
+	debugKeyRange( "BulkIngest", version, keys );
+
+	// As in changeServerKeys, hold the old ShardInfo references to defer fetchKeys cancellation until shards is again valid
+	vector< Reference<ShardInfo> > oldShards;
+	auto os = data->shards.intersectingRanges(keys);
+	bool anyAssigned = false;
+	for(auto r = os.begin(); r != os.end(); ++r) {
+		oldShards.push_back( r->value() );
+		anyAssigned = anyAssigned || r->value()->assigned();
+	}
+	if (!anyAssigned)
+		return;
+
+	auto ranges = data->shards.getAffectedRangesAfterInsertion( keys, Reference<ShardInfo>() );
+	for(int i=0; i<ranges.size(); i++) {
+		if (ranges[i].value)
+			reinitializeShard( data, ranges[i], ranges[i].value );
+	}
+
+	std::vector<KeyRange> ingestRanges;
+	std::vector<KeyRange> removeRanges;
+	for(auto& shard : oldShards) {
+		KeyRange range = keys & shard->keys;
+		if (shard->notAssigned()) {
+			data->addShard( ShardInfo::newNotAssigned(range) );
+			continue;
+		}
+		if (shard->isReadable()) {
+			// The (empty) contents are removed as if the shard had been moved away at version
+			ASSERT( data->mutableData().getLatestVersion() > version );
+			data->newestAvailableVersion.insert( range, version );
+			removeRanges.push_back( range );
+		}
+		data->addShard( ShardInfo::newAdding( data, range, file, version ) );
+		data->metrics.notifyNotReadable( range );
+		data->watches.triggerRange( range.begin, range.end );
+		ingestRanges.push_back( range );
+	}
+
+	coalesceShards( data, KeyRangeRef(ranges[0].begin, ranges[ranges.size()-1].end) );
+
+	oldShards.clear();
+	ranges.clear();
+	for(auto r=removeRanges.begin(); r!=removeRanges.end(); ++r) {
+		removeDataRange( data, data->addVersionToMutationLog(data->data().getLatestVersion()), data->shards, *r );
+		setAvailableStatus(data, *r, false);
+	}
+	if (context == CSK_UPDATE) {
+		for(auto r=ingestRanges.begin(); r!=ingestRanges.end(); ++r)
+			setBulkIngestStatus(data, *r, file, version);
+	}
+	validate(data);
+}
+
 void rollback( StorageServer* data, Version rollbackVersion, Version nextVersion ) {
 	TEST(true); // call to shard rollback
 	debugKeyRange("Rollback", rollbackVersion, allKeys);
@@ -2431,6 +3117,8 @@ static const KeyRef persistID = LiteralStringRef( PERSIST_PREFIX "ID" );
 static const KeyRef persistVersion = LiteralStringRef( PERSIST_PREFIX "Version" );
 static const KeyRangeRef persistShardAssignedKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "ShardAssigned/" ), LiteralStringRef( PERSIST_PREFIX "ShardAssigned0" ) );
 static const KeyRangeRef persistShardAvailableKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "ShardAvailable/" ), LiteralStringRef( PERSIST_PREFIX "ShardAvailable0" ) );
+static const KeyRangeRef persistBulkIngestKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "BulkIngest/" ), LiteralStringRef( PERSIST_PREFIX "BulkIngest0" ) );
+static const KeyRangeRef persistBulkIngestUpdateKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "BulkIngestUpdate/" ), LiteralStringRef( PERSIST_PREFIX "BulkIngestUpdate0" ) );
 static const KeyRangeRef persistByteSampleKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "BS/" ), LiteralStringRef( PERSIST_PREFIX "BS0" ) );
 static const KeyRangeRef persistByteSampleSampleKeys = KeyRangeRef( LiteralStringRef( PERSIST_PREFIX "BS/" PERSIST_PREFIX "BS/" ), LiteralStringRef( PERSIST_PREFIX "BS/" PERSIST_PREFIX "BS0" ) );
 static const KeyRef persistLogProtocol = LiteralStringRef(PERSIST_PREFIX "LogProtocol");
@@ -2486,6 +3174,8 @@ private:
 
 			// add changes in shard assignment to the mutation log
 			setAssignedStatus( data, keys, nowAssigned );
+			if (!nowAssigned)
+				setBulkIngestStatus( data, keys, Optional<BulkIngestFile>() );
 
 			// The changes for version have already been received (and are being processed now).  We need
 			// to fetch the data for change.version-1 (changes from versions < change.version)
@@ -2497,6 +3187,13 @@ private:
 			startKey = m.param1;
 			nowAssigned = m.param2 != serverKeysFalse;
 			processedStartKey = true;
+		} else if (m.type == MutationRef::SetValue && m.param1.substr(1).startsWith( bulkIngestPrefix )) {
+			BulkIngestFile file = decodeBulkIngestValue( m.param2 );
+			TraceEvent("BulkIngestShards", data->thisServerID).detail("File", file.toString()).detail("Version", currentVersion);
+
+			// The changes for version have already been received (and are being processed now), so like the data fetched for
+			// a change in shard assignment, the file holds the keys as of change.version-1
+			bulkIngestShards( data, file.keys, file, currentVersion-1, CSK_UPDATE );
 		} else if (m.type == MutationRef::SetValue && m.param1 == lastEpochEndPrivateKey) {
 			// lastEpochEnd transactions are guaranteed by the master to be alone in their own batch (version)
 			// That means we don't have to worry about the impact on changeServerKeys
@@ -2780,6 +3477,12 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 			if(data->primaryLocality == tagLocalitySpecial || data->tag.locality == data->primaryLocality) {
 				proposedOldestVersion = std::max(proposedOldestVersion, data->lastTLogVersion - maxVersionsInMemory);
 			}
+			if(data->storage.isVersioned()) {
+				// A versioned storage engine serves reads of the versions it has been given, so only the versions which
+				// might still be rolled back or which are very recent need to stay in memory
+				data->desiredEngineOldestVersion = std::max(data->desiredEngineOldestVersion, proposedOldestVersion);
+				proposedOldestVersion = std::max(proposedOldestVersion, std::min(data->version.get() - SERVER_KNOBS->VERSIONED_STORAGE_LAG_VERSIONS, cursor->getMinKnownCommittedVersion()));
+			}
 			proposedOldestVersion = std::min(proposedOldestVersion, data->version.get()-1);
 			proposedOldestVersion = std::max(proposedOldestVersion, data->oldestVersion.get());
 			proposedOldestVersion = std::max(proposedOldestVersion, data->desiredOldestVersion.get());
@@ -2840,11 +3543,14 @@ ACTOR Future<Void> updateStorage(StorageServer* data) {
 		// Write mutations to storage until we reach the desiredVersion or have written too much (bytesleft)
 		loop {
 			state bool done = data->storage.makeVersionMutationsDurable(newOldestVersion, desiredVersion, bytesLeft);
-			// We want to forget things from these data structures atomically with changing oldestVersion (and "before", since oldestVersion.set() may trigger waiting actors)
-			// forgetVersionsBeforeAsync visibly forgets immediately (without waiting) but asynchronously frees memory.
-			Future<Void> finishedForgetting = data->mutableData().forgetVersionsBeforeAsync( newOldestVersion, TaskPriority::UpdateStorage );
-			data->oldestVersion.set( newOldestVersion );
-			wait( finishedForgetting );
+			// A versioned storage engine can only serve reads of versions it has committed, so they are forgotten below
+			if (!data->storage.isVersioned()) {
+				// We want to forget things from these data structures atomically with changing oldestVersion (and "before", since oldestVersion.set() may trigger waiting actors)
+				// forgetVersionsBeforeAsync visibly forgets immediately (without waiting) but asynchronously frees memory.
+				Future<Void> finishedForgetting = data->mutableData().forgetVersionsBeforeAsync( newOldestVersion, TaskPriority::UpdateStorage );
+				data->oldestVersion.set( newOldestVersion );
+				wait( finishedForgetting );
+			}
 			wait( yield(TaskPriority::UpdateStorage) );
 			if (done) break;
 		}
@@ -2863,6 +3569,18 @@ ACTOR Future<Void> updateStorage(StorageServer* data) {
 
 		wait( durable );
 
+		if (data->storage.isVersioned()) {
+			Future<Void> finishedForgetting = data->mutableData().forgetVersionsBeforeAsync( newOldestVersion, TaskPriority::UpdateStorage );
+			data->oldestVersion.set( newOldestVersion );
+
+			Version engineOldestVersion = std::min( newOldestVersion, data->desiredEngineOldestVersion );
+			if (engineOldestVersion > data->engineOldestVersion) {
+				data->storage.forgetVersionsBefore( engineOldestVersion );
+				data->engineOldestVersion = engineOldestVersion;
+			}
+			wait( finishedForgetting );
+		}
+
 		debug_advanceMinCommittedVersion( data->thisServerID, newOldestVersion );
 
 		if(newOldestVersion > data->rebootAfterDurableVersion) {
@@ -2908,11 +3626,12 @@ ACTOR Future<Void> updateStorage(StorageServer* data) {
 #pragma region StorageServerDisk
 
 void StorageServerDisk::makeNewStorageServerDurable() {
-	storage->set( persistFormat );
-	storage->set( KeyValueRef(persistID, BinaryWriter::toValue(data->thisServerID, Unversioned())) );
-	storage->set( KeyValueRef(persistVersion, BinaryWriter::toValue(data->version.get(), Unversioned())) );
-	storage->set( KeyValueRef(persistShardAssignedKeys.begin.toString(), LiteralStringRef("0")) );
-	storage->set( KeyValueRef(persistShardAvailableKeys.begin.toString(), LiteralStringRef("0")) );
+	storage->setWriteVersion(data->version.get());
+	set( persistFormat );
+	set( KeyValueRef(persistID, BinaryWriter::toValue(data->thisServerID, Unversioned())) );
+	set( KeyValueRef(persistVersion, BinaryWriter::toValue(data->version.get(), Unversioned())) );
+	set( KeyValueRef(persistShardAssignedKeys.begin.toString(), LiteralStringRef("0")) );
+	set( KeyValueRef(persistShardAvailableKeys.begin.toString(), LiteralStringRef("0")) );
 }
 
 void setAvailableStatus( StorageServer* self, KeyRangeRef keys, bool available ) {
@@ -2949,20 +3668,142 @@ void setAssignedStatus( StorageServer* self, KeyRangeRef keys, bool nowAssigned
 	}
 }
 
+static Value persistBulkIngestValue( BulkIngestFile const& file, Version version ) {
+	BinaryWriter wr(IncludeVersion());
+	wr << file << version;
+	return wr.toValue();
+}
+
+static std::pair<BulkIngestFile, Version> decodePersistBulkIngestValue( ValueRef const& value ) {
+	BulkIngestFile file;
+	Version version;
+	BinaryReader rd( value, IncludeVersion() );
+	rd >> file >> version;
+	return std::make_pair( file, version );
+}
+
+// Records the bulk ingest file (if any) which the adding shards in keys are loading, and the version of its contents, so that
+// they can load it again after a reboot
+void setBulkIngestStatus( StorageServer* self, KeyRangeRef keys, Optional<BulkIngestFile> const& file, Version version ) {
+	ASSERT( !keys.empty() );
+	auto& mLV = self->addVersionToMutationLog( self->data().getLatestVersion() );
+	KeyRange ingestKeys = KeyRangeRef(
+		persistBulkIngestKeys.begin.toString() + keys.begin.toString(),
+		persistBulkIngestKeys.begin.toString() + keys.end.toString() );
+	self->addMutationToMutationLog( mLV, MutationRef( MutationRef::ClearRange, ingestKeys.begin, ingestKeys.end ) );
+	self->addMutationToMutationLog( mLV, MutationRef( MutationRef::SetValue, ingestKeys.begin,
+			file.present() ? persistBulkIngestValue(file.get(), version) : Value() ) );
+	if (keys.end != allKeys.end) {
+		AddingShard* endShard = self->shards.rangeContaining( keys.end )->value()->adding;
+		bool endIngesting = endShard && endShard->bulkFile.present();
+		self->addMutationToMutationLog( mLV, MutationRef( MutationRef::SetValue, ingestKeys.end,
+				endIngesting ? persistBulkIngestValue(endShard->bulkFile.get(), endShard->bulkVersion) : Value() ) );
+	}
+
+	// The updates recorded by persistBulkIngestUpdate are needed until no shard outside keys is loading a file
+	if (!file.present()) {
+		for(auto shard : self->shards.ranges()) {
+			if (shard.value()->adding && shard.value()->adding->bulkFile.present() && !keys.contains( shard.range() ))
+				return;
+		}
+		self->addMutationToMutationLog( mLV, MutationRef( MutationRef::ClearRange, persistBulkIngestUpdateKeys.begin, persistBulkIngestUpdateKeys.end ) );
+	}
+}
+
+static Key persistBulkIngestUpdateKey( Version version, int index ) {
+	BinaryWriter wr( Unversioned() );
+	wr.serializeBytes( persistBulkIngestUpdateKeys.begin );
+	wr << bigEndian64( version );
+	wr << bigEndian32( index );
+	return wr.toValue();
+}
+
+static Version decodePersistBulkIngestUpdateKey( KeyRef const& key ) {
+	return bigEndian64( BinaryReader::fromStringRef<Version>( key.removePrefix( persistBulkIngestUpdateKeys.begin ).substr( 0, sizeof(Version) ), Unversioned() ) );
+}
+
+// Makes an update to a shard loading a bulk ingest file durable along with version, so that it can be applied on top of the
+// file when the shard loads it again after a reboot (see restoreBulkIngestUpdate)
+void persistBulkIngestUpdate( StorageServer* self, Version version, MutationRef const& mutation ) {
+	// The bytes already logged at version order the updates within it
+	auto& mLV = self->addVersionToMutationLog( version );
+	self->addMutationToMutationLog( mLV, MutationRef( MutationRef::SetValue, persistBulkIngestUpdateKey( version, mLV.mutations.totalSize() ),
+			BinaryWriter::toValue( mutation, IncludeVersion() ) ) );
+}
+
+// Gives an update recorded by persistBulkIngestUpdate to the parts of the restored shards that are loading a file with
+// contents older than it
+void restoreBulkIngestUpdate( StorageServer* self, Version version, MutationRef const& mutation ) {
+	KeyRange keys = mutation.type == MutationRef::ClearRange ? KeyRangeRef( mutation.param1, mutation.param2 ) : singleKeyRange( mutation.param1 );
+	for(auto shard : self->shards.intersectingRanges( keys )) {
+		AddingShard* adding = shard.value()->adding;
+		if (!adding || !adding->bulkFile.present() || version <= adding->bulkVersion)
+			continue;
+		if (mutation.type == MutationRef::ClearRange) {
+			KeyRange clearKeys = keys & shard.range();
+			adding->keepUpdate( version, MutationRef( MutationRef::ClearRange, clearKeys.begin, clearKeys.end ) );
+		} else {
+			adding->keepUpdate( version, mutation );
+		}
+	}
+}
+
+void StorageServerDisk::set( KeyValueRef kv ) {
+	hotKeys.erase( kv.key );
+	++writesSinceCommit;
+	++cacheGeneration;
+	storage->set( kv );
+}
+
+void StorageServerDisk::clear( KeyRangeRef keys ) {
+	hotKeys.erase( keys );
+	++writesSinceCommit;
+	++cacheGeneration;
+	storage->clear( keys );
+}
+
+Future<Optional<Value>> StorageServerDisk::readValue( KeyRef key, Optional<UID> debugID ) {
+	if (!hotKeys.enabled())
+		return storage->readValue( key, debugID );
+
+	Optional<Optional<Value>> cached = hotKeys.get( key );
+	if (cached.present()) {
+		++data->counters.hotKeyCacheHits;
+		return cached.get();
+	}
+	++data->counters.hotKeyCacheMisses;
+	if (writesSinceCommit)
+		return storage->readValue( key, debugID );
+	return readValueAndCache( this, key, debugID );
+}
+
+Future<Optional<Value>> StorageServerDisk::readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID ) {
+	// Only complete values are cached, so misses are not added
+	Optional<Optional<Value>> cached = hotKeys.enabled() ? hotKeys.get( key ) : Optional<Optional<Value>>();
+	if (cached.present()) {
+		++data->counters.hotKeyCacheHits;
+		Optional<Value> const& v = cached.get();
+		if (v.present() && v.get().size() > maxLength)
+			return Optional<Value>( Value( v.get().substr(0, maxLength), v.get().arena() ) );
+		return v;
+	}
+	return storage->readValuePrefix( key, maxLength, debugID );
+}
+
 void StorageServerDisk::clearRange( KeyRangeRef keys ) {
-	storage->clear(keys);
+	clear(keys);
 }
 
 void StorageServerDisk::writeKeyValue( KeyValueRef kv ) {
-	storage->set( kv );
+	set( kv );
 }
 
 void StorageServerDisk::writeMutation( MutationRef mutation ) {
 	// FIXME: debugMutation(debugContext, debugVersion, *m);
 	if (mutation.type == MutationRef::SetValue) {
-		storage->set( KeyValueRef(mutation.param1, mutation.param2) );
+		set( KeyValueRef(mutation.param1, mutation.param2) );
 	} else if (mutation.type == MutationRef::ClearRange) {
-		storage->clear( KeyRangeRef(mutation.param1, mutation.param2) );
+		clear( KeyRangeRef(mutation.param1, mutation.param2) );
 	} else
 		ASSERT(false);
 }
@@ -2971,9 +3812,9 @@ void StorageServerDisk::writeMutations( MutationListRef mutations, Version debug
 	for(auto m = mutations.begin(); m; ++m) {
 		debugMutation(debugContext, debugVersion, *m);
 		if (m->type == MutationRef::SetValue) {
-			storage->set( KeyValueRef(m->param1, m->param2) );
+			set( KeyValueRef(m->param1, m->param2) );
 		} else if (m->type == MutationRef::ClearRange) {
-			storage->clear( KeyRangeRef(m->param1, m->param2) );
+			clear( KeyRangeRef(m->param1, m->param2) );
 		}
 	}
 }
@@ -2987,6 +3828,7 @@ bool StorageServerDisk::makeVersionMutationsDurable( Version& prevStorageVersion
 		VersionUpdateRef const& v = u->second;
 		ASSERT( v.version > prevStorageVersion && v.version <= newStorageVersion );
 		debugKeyRange("makeVersionMutationsDurable", v.version, allKeys);
+		storage->setWriteVersion(v.version);
 		writeMutations(v.mutations, v.version, "makeVersionDurable");
 		for(auto m=v.mutations.begin(); m; ++m)
 			bytesLeft -= mvccStorageBytes(*m);
@@ -3000,7 +3842,9 @@ bool StorageServerDisk::makeVersionMutationsDurable( Version& prevStorageVersion
 
 // Update data->storage to persist the changes from (data->storageVersion(),version]
 void StorageServerDisk::makeVersionDurable( Version version ) {
-	storage->set( KeyValueRef(persistVersion, BinaryWriter::toValue(version, Unversioned())) );
+	// A versioned engine would otherwise commit at a version of its own choosing, which later versions could fall behind
+	storage->setWriteVersion(version);
+	set( KeyValueRef(persistVersion, BinaryWriter::toValue(version, Unversioned())) );
 
 	//TraceEvent("MakeDurable", data->thisServerID).detail("FromVersion", prevStorageVersion).detail("ToVersion", version);
 }
@@ -3098,6 +3942,8 @@ ACTOR Future<bool> restoreDurableState( StorageServer* data, IKeyValueStore* sto
 	state Future<Optional<Value>> fPrimaryLocality = storage->readValue(persistPrimaryLocality);
 	state Future<Standalone<VectorRef<KeyValueRef>>> fShardAssigned = storage->readRange(persistShardAssignedKeys);
 	state Future<Standalone<VectorRef<KeyValueRef>>> fShardAvailable = storage->readRange(persistShardAvailableKeys);
+	state Future<Standalone<VectorRef<KeyValueRef>>> fBulkIngest = storage->readRange(persistBulkIngestKeys);
+	state Future<Standalone<VectorRef<KeyValueRef>>> fBulkIngestUpdates = storage->readRange(persistBulkIngestUpdateKeys);
 
 	state Promise<Void> byteSampleSampleRecovered;
 	state Promise<Void> startByteSampleRestore;
@@ -3105,7 +3951,7 @@ ACTOR Future<bool> restoreDurableState( StorageServer* data, IKeyValueStore* sto
 
 	TraceEvent("ReadingDurableState", data->thisServerID);
 	wait( waitForAll( std::vector{ fFormat, fID, fVersion, fLogProtocol, fPrimaryLocality } ) );
-	wait( waitForAll( std::vector{ fShardAssigned, fShardAvailable } ) );
+	wait( waitForAll( std::vector{ fShardAssigned, fShardAvailable, fBulkIngest, fBulkIngestUpdates } ) );
 	wait( byteSampleSampleRecovered.getFuture() );
 	TraceEvent("RestoringDurableState", data->thisServerID);
 
@@ -3164,6 +4010,43 @@ ACTOR Future<bool> restoreDurableState( StorageServer* data, IKeyValueStore* sto
 		wait(yield());
 	}
 
+	// Shards which were loading a bulk ingest file start loading it again, instead of fetching from other servers
+	state Standalone<VectorRef<KeyValueRef>> bulkIngest = fBulkIngest.get();
+	state int bulkIngestLoc;
+	for(bulkIngestLoc=0; bulkIngestLoc<bulkIngest.size(); bulkIngestLoc++) {
+		if (!bulkIngest[bulkIngestLoc].value.size())
+			continue;
+		KeyRangeRef keys(
+			bulkIngest[bulkIngestLoc].key.removePrefix(persistBulkIngestKeys.begin),
+			bulkIngestLoc+1==bulkIngest.size() ? allKeys.end : bulkIngest[bulkIngestLoc+1].key.removePrefix(persistBulkIngestKeys.begin));
+		std::pair<BulkIngestFile, Version> file = decodePersistBulkIngestValue( bulkIngest[bulkIngestLoc].value );
+		TraceEvent("RestoringBulkIngest", data->thisServerID).detail("File", file.first.toString()).detail("FileVersion", file.second)
+			.detail("KeyBegin", keys.begin).detail("KeyEnd", keys.end);
+
+		std::vector<KeyRange> adding;
+		auto shards = data->shards.intersectingRanges(keys);
+		for(auto s = shards.begin(); s != shards.end(); ++s) {
+			if (s->value()->adding)
+				adding.push_back( keys & s->range() );
+		}
+		for(auto& r : adding)
+			bulkIngestShards( data, r, file.first, file.second, CSK_RESTORE );
+		wait(yield());
+	}
+
+	// ...and apply the updates they had received on top of it
+	state Standalone<VectorRef<KeyValueRef>> bulkIngestUpdates = fBulkIngestUpdates.get();
+	state int bulkIngestUpdateLoc;
+	for(bulkIngestUpdateLoc=0; bulkIngestUpdateLoc<bulkIngestUpdates.size(); bulkIngestUpdateLoc++) {
+		MutationRef m;
+		BinaryReader rd( bulkIngestUpdates[bulkIngestUpdateLoc].value, IncludeVersion() );
+		rd >> m;
+		restoreBulkIngestUpdate( data, decodePersistBulkIngestUpdateKey( bulkIngestUpdates[bulkIngestUpdateLoc].key ), m );
+		if (bulkIngestUpdateLoc % 1000 == 999)
+			wait(yield());
+	}
+	TEST( bulkIngestUpdates.size() ); // Restored updates to bulk ingested shards
+
 	wait( delay( 0.0001 ) );
 
 	{
@@ -3508,6 +4391,12 @@ ACTOR Future<Void> storageServerCore( StorageServer* self, StorageServerInterfac
 				else
 					actors.add(self->readGuard(req , getValueQ));
 			}
+			when( GetValuesRequest req = waitNext(ssi.getValues.getFuture()) ) {
+				// Warning: This code is executed at extremely high priority (TaskPriority::LoadBalancedEndpoint), so downgrade before doing real work
+				if( req.debugID.present() )
+					g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "storageServer.recieved"); //.detail("TaskID", g_network->getCurrentTask());
+				actors.add(self->readGuard(req , getValuesQ));
+			}
 			when( WatchValueRequest req = waitNext(ssi.watchValue.getFuture()) ) {
 				// TODO: fast load balancing?
 				// SOMEDAY: combine watches for the same key/value into a single watch
@@ -3521,6 +4410,14 @@ ACTOR Future<Void> storageServerCore( StorageServer* self, StorageServerInterfac
 				// Warning: This code is executed at extremely high priority (TaskPriority::LoadBalancedEndpoint), so downgrade before doing real work
 				actors.add(self->readGuard(req , getKeyValues));
 			}
+			when (GetKeyValuesStreamRequest req = waitNext(ssi.getKeyValuesStream.getFuture()) ) {
+				// Warning: This code is executed at extremely high priority (TaskPriority::LoadBalancedEndpoint), so downgrade before doing real work
+				actors.add(self->readGuard(req , getKeyValuesStreamQ));
+			}
+			when (GetRangeAggregateRequest req = waitNext(ssi.getRangeAggregate.getFuture()) ) {
+				// Warning: This code is executed at extremely high priority (TaskPriority::LoadBalancedEndpoint), so downgrade before doing real work
+				actors.add(self->readGuard(req , getRangeAggregateQ));
+			}
 			when (GetShardStateRequest req = waitNext(ssi.getShardState.getFuture()) ) {
 				if (req.mode == GetShardStateRequest::NO_WAIT ) {
 					if( self->isReadable( req.keys ) )
@@ -3857,3 +4754,175 @@ void versionedMapTest() {
 	printf("Memory used: %f MB\n",
 		 (after - before)/ 1e6);
 }
+
+TEST_CASE("/fdbserver/storageserver/HotKeyCache") {
+	HotKeyCache cache(1000);
+	Value big = makeString(300);
+
+	cache.insert( LiteralStringRef("a"), Optional<Value>(big) );
+	cache.insert( LiteralStringRef("b"), Optional<Value>() );
+	cache.insert( LiteralStringRef("c"), Optional<Value>(big) );
+	ASSERT( cache.get(LiteralStringRef("a")).present() );
+	ASSERT( cache.get(LiteralStringRef("b")).present() && !cache.get(LiteralStringRef("b")).get().present() );
+	ASSERT( !cache.get(LiteralStringRef("d")).present() );
+
+	// "c" is now the least recently used, so it is evicted to make room
+	cache.insert( LiteralStringRef("d"), Optional<Value>(big) );
+	ASSERT( !cache.get(LiteralStringRef("c")).present() );
+	ASSERT( cache.get(LiteralStringRef("a")).present() && cache.get(LiteralStringRef("d")).present() );
+	ASSERT( cache.size() <= 1000 );
+
+	cache.erase( KeyRangeRef(LiteralStringRef("b"), LiteralStringRef("d")) );
+	ASSERT( !cache.get(LiteralStringRef("b")).present() && cache.get(LiteralStringRef("d")).present() );
+	cache.erase( LiteralStringRef("d") );
+	cache.erase( LiteralStringRef("a") );
+	ASSERT( cache.size() == 0 );
+
+	// Entries larger than the whole cache are not kept
+	cache.insert( LiteralStringRef("e"), Optional<Value>(makeString(2000)) );
+	ASSERT( !cache.get(LiteralStringRef("e")).present() );
+
+	return Void();
+}
+
+// Applies mutations to data as version the way update() applies a version from the log, with eager reads taken under the
+// durableVersionLock, and lets updateStorage() make versions more than memoryVersions old durable.  The engine is asked
+// to keep the last engineVersions versions.
+ACTOR static Future<Void> applyTestVersion( StorageServer* data, Version version, Standalone<VectorRef<MutationRef>> mutations, Version memoryVersions, Version engineVersions ) {
+	wait( data->durableVersionLock.take() );
+	state FlowLock::Releaser holdingDVL( data->durableVersionLock );
+	state UpdateEagerReadInfo eager;
+	eager.addMutations( mutations );
+	wait( doEagerReads( data, &eager ) );
+
+	data->updateEagerReads = &eager;
+	StorageUpdater updater( data->lastVersionWithData, data->restoredVersion );
+	for(auto& m : mutations)
+		updater.applyMutation( data, m, version );
+	data->updateEagerReads = NULL;
+
+	data->lastVersionWithData = version;
+	data->mutableData().createNewVersion( version );
+	data->version.set( version );
+
+	data->desiredEngineOldestVersion = std::max( data->desiredEngineOldestVersion, version - engineVersions );
+	Version proposedOldestVersion = std::min( version - memoryVersions, version - 1 );
+	proposedOldestVersion = std::max( proposedOldestVersion, data->desiredOldestVersion.get() );
+	data->desiredOldestVersion.set( proposedOldestVersion );
+	return Void();
+}
+
+// Reads of a storage server on a versioned storage engine at every readable version, whether still in memory or only kept by
+// the engine, match the history of the sets and clears applied to it, and the engine only forgets versions once they are
+// durable.
+TEST_CASE("!/fdbserver/storageserver/versionedReads") {
+	state std::string fileName = "unittest_versionedReads";
+	deleteFile( fileName );
+	deleteFile( fileName + "0.pagerlog" );
+	deleteFile( fileName + "1.pagerlog" );
+
+	state IKeyValueStore* store = keyValueStoreRedwoodV1( fileName, UID() );
+	wait( store->init() );
+	ASSERT( store->isVersioned() );
+
+	state StorageServer* data = new StorageServer( store, Reference<AsyncVar<ServerDBInfo>>( new AsyncVar<ServerDBInfo>() ), StorageServerInterface() );
+	data->setInitialVersion( 10 );
+	data->addShard( ShardInfo::newReadWrite( normalKeys, data ) );
+	data->addShard( ShardInfo::newNotAssigned( systemKeys ) );
+	data->storage.makeNewStorageServerDurable();
+	wait( data->storage.commit() );
+	data->byteSampleRecovery = Void();
+	state Future<Void> updating = updateStorage( data );
+
+	// The contents of the database as of each version written
+	state std::map<Version, std::map<Key, Value>> history;
+	history[10] = std::map<Key, Value>();
+
+	state Version version = 10;
+	state int storageReads = 0;
+	state int i = 0;
+	for(; i < 200; ++i) {
+		state std::map<Key, Value> contents = history.rbegin()->second;
+		state Standalone<VectorRef<MutationRef>> mutations;
+		for(int m = deterministicRandom()->randomInt(1, 10); m; --m) {
+			int k = deterministicRandom()->randomInt(0, 200);
+			Key key( format("%05d", k) );
+			if(deterministicRandom()->random01() < 0.1) {
+				Key end( format("%05d", k + deterministicRandom()->randomInt(1, 20)) );
+				mutations.push_back_deep( mutations.arena(), MutationRef( MutationRef::ClearRange, key, end ) );
+				contents.erase( contents.lower_bound(key), contents.lower_bound(end) );
+			} else {
+				Value value( std::string(deterministicRandom()->randomInt(0, 100), 'a' + deterministicRandom()->randomInt(0, 26)) );
+				mutations.push_back_deep( mutations.arena(), MutationRef( MutationRef::SetValue, key, value ) );
+				contents[key] = value;
+			}
+		}
+		version += deterministicRandom()->randomInt(1, 4);
+		history[version] = contents;
+		wait( applyTestVersion( data, version, mutations, 5, 50 ) );
+
+		// Let updateStorage() commit now and then
+		wait( delay( deterministicRandom()->random01() * 0.05 ) );
+
+		// The engine only forgets versions which it has committed
+		ASSERT( data->engineOldestVersion <= data->durableVersion.get() );
+		ASSERT( data->oldestReadableVersion() <= data->storageVersion() );
+
+		// Read a random range at a random readable version, from memory or from the engine
+		state Version readVersion = deterministicRandom()->randomInt64( data->oldestReadableVersion(), version + 1 );
+		state int a = deterministicRandom()->randomInt(0, 220);
+		state int b = deterministicRandom()->randomInt(0, 220);
+		state KeyRange range = KeyRangeRef( Key(format("%05d", std::min(a, b))), Key(format("%05d", std::max(a, b) + 1)) );
+		state int limit = deterministicRandom()->randomInt(1, 50) * (deterministicRandom()->coinflip() ? 1 : -1);
+		state int limitBytes = 1<<30;
+		if (readVersion < data->storageVersion())
+			++storageReads;
+		GetKeyValuesReply reply = wait( readRange( data, readVersion, range, limit, &limitBytes ) );
+
+		const std::map<Key, Value>& expected = std::prev( history.upper_bound(readVersion) )->second;
+		std::vector<KeyValueRef> rows;
+		for(auto e = expected.lower_bound(range.begin); e != expected.end() && e->first < range.end; ++e)
+			rows.push_back( KeyValueRef(e->first, e->second) );
+		if (limit < 0)
+			std::reverse( rows.begin(), rows.end() );
+		rows.resize( std::min<size_t>( rows.size(), std::abs(limit) ) );
+		ASSERT( reply.data.size() == rows.size() );
+		for(int r = 0; r < rows.size(); r++)
+			ASSERT( reply.data[r] == rows[r] );
+
+		// Point reads at versions kept only by the engine
+		if (data->oldestReadableVersion() < data->storageVersion()) {
+			state Version engineVersion = deterministicRandom()->randomInt64( data->oldestReadableVersion(), data->storageVersion() );
+			state Key key( format("%05d", deterministicRandom()->randomInt(0, 200)) );
+			Optional<Value> value = wait( data->storage.readValueAtVersion( key, engineVersion ) );
+			const std::map<Key, Value>& atVersion = std::prev( history.upper_bound(engineVersion) )->second;
+			auto e = atVersion.find( key );
+			ASSERT( value == (e == atVersion.end() ? Optional<Value>() : Optional<Value>(e->second)) );
+		}
+
+		// Versions the engine has forgotten can't be read from it
+		if (data->engineOldestVersion > 10) {
+			try {
+				Standalone<VectorRef<KeyValueRef>> forgotten = wait( data->storage.readRangeAtVersion( normalKeys, deterministicRandom()->randomInt64( 10, data->engineOldestVersion ) ) );
+				ASSERT( false );
+			} catch (Error& e) {
+				if (e.code() != error_code_transaction_too_old)
+					throw;
+			}
+		}
+
+		// Versions before the memory and engine windows are no longer needed by the model
+		while (history.size() > 1 && std::next(history.begin())->first <= data->oldestReadableVersion())
+			history.erase( history.begin() );
+	}
+
+	ASSERT( storageReads > 0 );
+
+	updating.cancel();
+	delete data;
+	Future<Void> closed = store->onClosed();
+	store->dispose();
+	wait( closed );
+
+	return Void();
+}
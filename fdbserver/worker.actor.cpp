@@ -205,6 +205,7 @@ std::pair<KeyValueStoreType, std::string> bTreeV1Suffix  = std::make_pair( KeyVa
 std::pair<KeyValueStoreType, std::string> bTreeV2Suffix = std::make_pair(KeyValueStoreType::SSD_BTREE_V2,   ".sqlite");
 std::pair<KeyValueStoreType, std::string> memorySuffix = std::make_pair( KeyValueStoreType::MEMORY,         "-0.fdq" );
 std::pair<KeyValueStoreType, std::string> redwoodSuffix = std::make_pair( KeyValueStoreType::SSD_REDWOOD_V1,   ".redwood" );
+std::pair<KeyValueStoreType, std::string> tieredSuffix = std::make_pair( KeyValueStoreType::SSD_TIERED_V1,   ".tiered" );
 
 std::string validationFilename = "_validate";
 
@@ -218,6 +219,8 @@ std::string filenameFromSample( KeyValueStoreType storeType, std::string folder,
 	
 	else if ( storeType == KeyValueStoreType::SSD_REDWOOD_V1 )
 		return joinPath(folder, sample_filename);
+	else if ( storeType == KeyValueStoreType::SSD_TIERED_V1 )
+		return joinPath(folder, sample_filename);
 	UNREACHABLE();
 }
 
@@ -230,6 +233,8 @@ std::string filenameFromId( KeyValueStoreType storeType, std::string folder, std
 		return joinPath( folder, prefix + id.toString() + "-" );
 	else if (storeType == KeyValueStoreType::SSD_REDWOOD_V1)
 		return joinPath(folder, prefix + id.toString() + ".redwood");
+	else if (storeType == KeyValueStoreType::SSD_TIERED_V1)
+		return joinPath(folder, prefix + id.toString() + ".tiered");
 
 	UNREACHABLE();
 }
@@ -370,6 +375,8 @@ std::vector< DiskStore > getDiskStores( std::string folder ) {
 	result.insert( result.end(), result2.begin(), result2.end() );
 	auto result3 = getDiskStores( folder, redwoodSuffix.second, redwoodSuffix.first);
 	result.insert( result.end(), result3.begin(), result3.end() );
+	auto result4 = getDiskStores( folder, tieredSuffix.second, tieredSuffix.first);
+	result.insert( result.end(), result4.begin(), result4.end() );
 	return result;
 }
 
@@ -565,8 +572,11 @@ ACTOR Future<Void> storageServerRollbackRebooter( Future<Void> prevStorageServer
 
 		DUMPTOKEN(recruited.getVersion);
 		DUMPTOKEN(recruited.getValue);
+		DUMPTOKEN(recruited.getValues);
 		DUMPTOKEN(recruited.getKey);
 		DUMPTOKEN(recruited.getKeyValues);
+		DUMPTOKEN(recruited.getKeyValuesStream);
+		DUMPTOKEN(recruited.getRangeAggregate);
 		DUMPTOKEN(recruited.getShardState);
 		DUMPTOKEN(recruited.waitMetrics);
 		DUMPTOKEN(recruited.splitMetrics);
@@ -842,8 +852,11 @@ ACTOR Future<Void> workerServer(
 
 				DUMPTOKEN(recruited.getVersion);
 				DUMPTOKEN(recruited.getValue);
+				DUMPTOKEN(recruited.getValues);
 				DUMPTOKEN(recruited.getKey);
 				DUMPTOKEN(recruited.getKeyValues);
+				DUMPTOKEN(recruited.getKeyValuesStream);
+				DUMPTOKEN(recruited.getRangeAggregate);
 				DUMPTOKEN(recruited.getShardState);
 				DUMPTOKEN(recruited.waitMetrics);
 				DUMPTOKEN(recruited.splitMetrics);
@@ -1069,8 +1082,11 @@ ACTOR Future<Void> workerServer(
 
 					DUMPTOKEN(recruited.getVersion);
 					DUMPTOKEN(recruited.getValue);
+					DUMPTOKEN(recruited.getValues);
 					DUMPTOKEN(recruited.getKey);
 					DUMPTOKEN(recruited.getKeyValues);
+					DUMPTOKEN(recruited.getKeyValuesStream);
+					DUMPTOKEN(recruited.getRangeAggregate);
 					DUMPTOKEN(recruited.getShardState);
 					DUMPTOKEN(recruited.waitMetrics);
 					DUMPTOKEN(recruited.splitMetrics);
@@ -1143,6 +1159,7 @@ ACTOR Future<Void> workerServer(
 				startRole( Role::LOG_ROUTER, recruited.id(), interf.id(), details );
 
 				DUMPTOKEN( recruited.peekMessages );
+				DUMPTOKEN( recruited.peekStreamMessages );
 				DUMPTOKEN( recruited.popMessages );
 				DUMPTOKEN( recruited.commit );
 				DUMPTOKEN( recruited.lock );
@@ -1189,6 +1206,9 @@ ACTOR Future<Void> workerServer(
 						else if (d.storeType == KeyValueStoreType::SSD_REDWOOD_V1) {
 							included = fileExists(d.filename + "0.pagerlog") && fileExists(d.filename + "1.pagerlog");
 						}
+						else if (d.storeType == KeyValueStoreType::SSD_TIERED_V1) {
+							included = fileExists(d.filename + "-wal");
+						}
 						else {
 							ASSERT(d.storeType == KeyValueStoreType::MEMORY);
 							included = fileExists(d.filename + "1.fdq");
@@ -29,6 +29,7 @@
 
 #include "fdbserver/workloads/workloads.actor.h"
 #include "fdbrpc/IAsyncFile.h"
+#include "fdbrpc/ContinuousSample.h"
 #include "flow/actorcompiler.h"  // This must be the last #include.
 
 class RandomByteGenerator{
@@ -49,6 +50,7 @@ struct AsyncFileBuffer : public ReferenceCounted<AsyncFileBuffer>
 
 	unsigned char *buffer;
 	bool aligned;
+	bool fastAllocated;
 };
 
 struct AsyncFileHandle : public ReferenceCounted<AsyncFileHandle>
@@ -68,6 +70,8 @@ struct AsyncFileWorkload : TestWorkload
 	//If true, then the underlying AsyncFile will be assumed to be performing unbuffered IO, which requires special alignments
 	bool unbufferedIO;
 	bool uncachedIO;
+	//If true, unbuffered IO is performed with AsyncFileIOUring rather than AsyncFileKAIO when it is available
+	bool ioUring;
 	bool fillRandom;
 	bool enabled;
 	double testDuration;
@@ -77,6 +81,10 @@ struct AsyncFileWorkload : TestWorkload
 
 	std::string path;
 
+	//Completion latency of each individual IO, used to compare the tail latency of the different AsyncFile implementations
+	ContinuousSample<double> ioLatencies;
+	int64_t ioCount;
+
 	AsyncFileWorkload(WorkloadContext const&);
 	virtual ~AsyncFileWorkload() { }
 
@@ -85,6 +93,19 @@ struct AsyncFileWorkload : TestWorkload
 
 	virtual Future<bool> check(Database const& cx);
 
+	//Reports the number of IOs per second and their latency distribution
+	void getLatencyMetrics(std::vector<PerfMetric>& m);
+
+	//Records the time from now until io completes in ioLatencies
+	ACTOR static Future<Void> timeIO(AsyncFileWorkload *self, Future<Void> io)
+	{
+		state double begin = now();
+		wait(io);
+		self->ioLatencies.addSample(now() - begin);
+		self->ioCount++;
+		return Void();
+	}
+
 	//Opens a file for AsyncFile operations.  If the path is empty, then creates a file and fills it with random data
 	ACTOR Future<Void> openFile(AsyncFileWorkload *self, int64_t flags, int64_t mode, uint64_t size, bool fillFile = false)
 	{
@@ -113,6 +134,8 @@ struct AsyncFileWorkload : TestWorkload
 			flags |= IAsyncFile::OPEN_UNBUFFERED;
 		if(self->uncachedIO)
 			flags |= IAsyncFile::OPEN_UNCACHED;
+		if(self->ioUring)
+			flags |= IAsyncFile::OPEN_IO_URING;
 
 		try
 		{
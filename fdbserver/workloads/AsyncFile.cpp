@@ -63,13 +63,14 @@ void RandomByteGenerator::writeRandomBytesToBuffer(void *buf, int bytes){
 const int AsyncFileWorkload::_PAGE_SIZE = 4096;
 
 AsyncFileWorkload::AsyncFileWorkload(WorkloadContext const& wcx)
-	: TestWorkload(wcx), fileHandle(NULL)
+	: TestWorkload(wcx), fileHandle(NULL), ioLatencies(10000), ioCount(0)
 {
 	//Only run on one client
 	enabled = clientId == 0;
 	testDuration = getOption(options, LiteralStringRef("testDuration"), 10.0);
 	unbufferedIO = getOption(options, LiteralStringRef("unbufferedIO"), false);
 	uncachedIO = getOption(options, LiteralStringRef("uncachedIO"), false);
+	ioUring = getOption(options, LiteralStringRef("ioUring"), false);
 	fillRandom = getOption(options, LiteralStringRef("fillRandom"), false);
 	path = getOption(options, LiteralStringRef("fileName"), LiteralStringRef("")).toString();
 }
@@ -84,10 +85,27 @@ Future<bool> AsyncFileWorkload::check(Database const& cx)
 	return true;
 }
 
+void AsyncFileWorkload::getLatencyMetrics(std::vector<PerfMetric>& m)
+{
+	m.emplace_back("IOPS", ioCount / testDuration, false);
+	m.emplace_back("Mean Latency (ms)", 1000 * ioLatencies.mean(), true);
+	m.emplace_back("Median Latency (ms, averaged)", 1000 * ioLatencies.median(), true);
+	m.emplace_back("99% Latency (ms, averaged)", 1000 * ioLatencies.percentile(0.99), true);
+	m.emplace_back("99.9% Latency (ms, averaged)", 1000 * ioLatencies.percentile(0.999), true);
+	m.emplace_back("Max Latency (ms)", 1000 * ioLatencies.max(), true);
+}
+
 //Allocates a buffer of a given size.  If necessary, the buffer will be aligned to 4K
 AsyncFileBuffer::AsyncFileBuffer(size_t size, bool aligned)
+	: fastAllocated(false)
 {
-	if(aligned)
+	//Single pages come from the same allocator the storage engines use, so that AsyncFileIOUring can use its registered buffers for them
+	if(aligned && size == AsyncFileWorkload::_PAGE_SIZE)
+	{
+		buffer = (unsigned char*)FastAllocator<4096>::allocate();
+		fastAllocated = true;
+	}
+	else if(aligned)
 	{
 #ifdef WIN32
 		buffer = (unsigned char*)_aligned_malloc(size, AsyncFileWorkload::_PAGE_SIZE);
@@ -112,6 +130,12 @@ AsyncFileBuffer::AsyncFileBuffer(size_t size, bool aligned)
 //Special logic needed here to work with _aligned_malloc on windows
 AsyncFileBuffer::~AsyncFileBuffer()
 {
+	if(fastAllocated)
+	{
+		FastAllocator<4096>::release(buffer);
+		return;
+	}
+
 #ifdef WIN32
 	if(aligned)
 	{
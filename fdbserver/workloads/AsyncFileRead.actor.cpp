@@ -143,7 +143,7 @@ struct AsyncFileReadWorkload : public AsyncFileWorkload
 	std::vector<Reference<AsyncFileBuffer> > readBuffers;
 
 	//The futures for the asynchronous read operations
-	std::vector<Future<int> > readFutures;
+	std::vector<Future<Void> > readFutures;
 
 	//Number of reads to perform in parallel.  Read tests are performed only if this is greater than zero
 	int numParallelReads;
@@ -262,14 +262,14 @@ struct AsyncFileReadWorkload : public AsyncFileWorkload
 			begin = now();
 			if (self->ioLog)
 				self->ioLog->logIOIssue(writeFlag, begin);
-			wait(success( uncancellable
+			wait( uncancellable
 					(
 						holdWhile
 						(
 							self->fileHandle,
-							holdWhile(self->readBuffers[bufferIndex], r)
+							holdWhile(self->readBuffers[bufferIndex], timeIO(self, success(r)))
 						)
-					) ));
+					) );
 			if (self->ioLog)
 				self->ioLog->logIOCompletion(writeFlag, begin, now());
 			self->bytesRead += self->readSize;
@@ -320,7 +320,7 @@ struct AsyncFileReadWorkload : public AsyncFileWorkload
 						holdWhile
 						(
 							self->fileHandle,
-							holdWhile(self->readBuffers[i], self->fileHandle->file->read(self->readBuffers[i]->buffer, self->readSize, offset))
+							holdWhile(self->readBuffers[i], timeIO(self, success(self->fileHandle->file->read(self->readBuffers[i]->buffer, self->readSize, offset))))
 						)
 					)
 				);
@@ -339,6 +339,7 @@ struct AsyncFileReadWorkload : public AsyncFileWorkload
 		if (enabled) {
 			m.emplace_back("Bytes read/sec", bytesRead.getValue() / testDuration, false);
 			m.emplace_back("Average CPU Utilization (Percentage)", averageCpuUtilization * 100, false);
+			getLatencyMetrics(m);
 		}
 	}
 };
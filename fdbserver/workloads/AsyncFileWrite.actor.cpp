@@ -133,7 +133,7 @@ struct AsyncFileWriteWorkload : public AsyncFileWorkload
 						holdWhile
 						(
 							self->fileHandle,
-							holdWhile(self->writeBuffer, self->fileHandle->file->write(self->writeBuffer->buffer, std::min((int64_t)self->writeSize, self->fileSize - offset), offset))
+							holdWhile(self->writeBuffer, timeIO(self, self->fileHandle->file->write(self->writeBuffer->buffer, std::min((int64_t)self->writeSize, self->fileSize - offset), offset)))
 						)
 					)
 				);
@@ -168,6 +168,7 @@ struct AsyncFileWriteWorkload : public AsyncFileWorkload
 		{
 			m.push_back(PerfMetric("Bytes written/sec", bytesWritten.getValue() / testDuration, false));
 			m.push_back(PerfMetric("Average CPU Utilization (Percentage)", averageCpuUtilization * 100, false));
+			getLatencyMetrics(m);
 		}
 	}
  };
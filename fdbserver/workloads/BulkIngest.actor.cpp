@@ -0,0 +1,170 @@
+/*
+ * BulkIngest.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2019 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/NativeAPI.actor.h"
+#include "fdbclient/BulkIngest.actor.h"
+#include "fdbclient/SystemData.h"
+#include "fdbserver/TesterInterface.actor.h"
+#include "fdbserver/workloads/workloads.actor.h"
+#include "flow/actorcompiler.h"  // This must be the last #include.
+
+// Builds range files for keyCount keys and ingests them while writing writeCount more keys to the range, and checks that
+// all of the keys are readable afterwards and that a second ingest into the now non-empty range is refused.
+struct BulkIngestWorkload : TestWorkload {
+	int keyCount, batchSize, valueBytes, writeCount;
+	Key keyPrefix;
+	bool ingested;
+	int written;
+
+	BulkIngestWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), ingested(false), written(0)
+	{
+		keyCount = getOption( options, LiteralStringRef("keyCount"), 10000 );
+		batchSize = getOption( options, LiteralStringRef("batchSize"), 1000 );
+		valueBytes = getOption( options, LiteralStringRef("valueBytes"), 100 );
+		writeCount = getOption( options, LiteralStringRef("writeCount"), 100 );
+		keyPrefix = getOption( options, LiteralStringRef("keyPrefix"), LiteralStringRef("bulkingest/") );
+	}
+
+	virtual std::string description() { return "BulkIngest"; }
+
+	virtual Future<Void> setup( Database const& cx ) { return Void(); }
+
+	virtual Future<Void> start( Database const& cx ) {
+		if(clientId != 0)
+			return Void();
+		return _start( cx, this );
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		if(clientId != 0)
+			return true;
+		return _check( cx, this );
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {}
+
+	KeyRange range() const { return KeyRangeRef(keyPrefix, strinc(keyPrefix)); }
+	Key keyForIndex( int n ) const { return keyPrefix.withSuffix(format("%08d", n)); }
+	Value valueForIndex( int n ) const { return Value(format("%08d", n) + std::string(valueBytes, '.')); }
+
+	ACTOR static Future<std::vector<BulkIngestFile>> buildFiles( BulkIngestWorkload* self ) {
+		state Reference<IBackupContainer> container = IBackupContainer::openContainer("file://simfdb/bulkingest/ingest-" + deterministicRandom()->randomUniqueID().toString());
+		wait(container->create());
+
+		state BulkIngestFileBuilder builder(container, self->range());
+		state int i = 0;
+		for(; i < self->keyCount; i += self->batchSize) {
+			// Batches are sorted by the builder
+			Standalone<VectorRef<KeyValueRef>> kvs;
+			for(int j = std::min(i + self->batchSize, self->keyCount) - 1; j >= i; j--)
+				kvs.push_back_deep(kvs.arena(), KeyValueRef(self->keyForIndex(j), self->valueForIndex(j)));
+			wait(builder.add(kvs));
+		}
+
+		std::vector<BulkIngestFile> files = wait(builder.finish());
+		return files;
+	}
+
+	// Once the ingest of the file beginning at begin has started, writes the keys after the ingested ones, so that storage
+	// servers receive them while they are loading the file
+	ACTOR static Future<Void> writeDuringIngest( Database cx, BulkIngestWorkload* self, Key begin ) {
+		state Transaction tr(cx);
+		loop {
+			try {
+				tr.setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+				Optional<Value> marker = wait(tr.get(bulkIngestKeyFor(begin)));
+				if(marker.present() || self->ingested)
+					break;
+				wait(delay(0.1));
+				tr.reset();
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+
+		TraceEvent("BulkIngestWorkloadWriting").detail("Ingested", self->ingested);
+		while(self->written < self->writeCount) {
+			tr.reset();
+			loop {
+				try {
+					tr.set(self->keyForIndex(self->keyCount + self->written), self->valueForIndex(self->keyCount + self->written));
+					wait(tr.commit());
+					break;
+				} catch(Error& e) {
+					wait(tr.onError(e));
+				}
+			}
+			self->written++;
+		}
+		return Void();
+	}
+
+	ACTOR static Future<Void> _start( Database cx, BulkIngestWorkload* self ) {
+		state std::vector<BulkIngestFile> files = wait(buildFiles(self));
+		TraceEvent("BulkIngestWorkloadBuilt").detail("Files", files.size());
+
+		state Future<Void> writer = writeDuringIngest(cx, self, files.back().keys.begin);
+		wait(bulkIngest(cx, files));
+		self->ingested = true;
+		wait(writer);
+
+		// Ingesting the same files again is refused, because the range is no longer empty
+		try {
+			wait(bulkIngest(cx, files));
+			TraceEvent(SevError, "BulkIngestWorkloadNonEmptyAccepted");
+		} catch(Error& e) {
+			if(e.code() != error_code_restore_destination_not_empty)
+				throw;
+		}
+		return Void();
+	}
+
+	ACTOR static Future<bool> _check( Database cx, BulkIngestWorkload* self ) {
+		state Transaction tr(cx);
+		state Key begin = self->range().begin;
+		state int n = 0;
+		loop {
+			try {
+				Standalone<RangeResultRef> kvs = wait(tr.getRange(KeyRangeRef(begin, self->range().end), CLIENT_KNOBS->TOO_MANY));
+				for(auto& kv : kvs) {
+					if(n >= self->keyCount + self->written || kv.key != self->keyForIndex(n) || kv.value != self->valueForIndex(n)) {
+						TraceEvent(SevError, "BulkIngestWorkloadWrongData").detail("Index", n).detail("Key", kv.key);
+						return false;
+					}
+					n++;
+				}
+				if(!kvs.more)
+					break;
+				begin = keyAfter(kvs.back().key);
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+
+		if(n != self->keyCount + self->written) {
+			TraceEvent(SevError, "BulkIngestWorkloadMissingData").detail("Expected", self->keyCount + self->written).detail("Found", n);
+			return false;
+		}
+		return true;
+	}
+};
+
+WorkloadFactory<BulkIngestWorkload> BulkIngestWorkloadFactory("BulkIngest");
@@ -181,6 +181,20 @@ ACTOR Future<Void> testKVReadSaturation( KVTest* test, Histogram<float>* latency
 	}
 }
 
+// Repeatedly reads the whole store in order, like a backup or consistency check would
+ACTOR Future<Void> testKVScan( KVTest* test, PerfIntCounter* scans, PerfIntCounter* rows ) {
+	loop {
+		state Key k;
+		loop {
+			Standalone<VectorRef<KeyValueRef>> kv = wait( test->store->readRange( KeyRangeRef(k, LiteralStringRef("\xff\xff\xff\xff")), 1000 ) );
+			*rows += kv.size();
+			if (kv.size() < 1000) break;
+			k = keyAfter( kv[ kv.size()-1 ].key );
+		}
+		++*scans;
+	}
+}
+
 ACTOR Future<Void> testKVCommit( KVTest* test, Histogram<float>* latency, PerfIntCounter* count ) {
 	state Version v = test->lastSet;
 	test->lastCommit = v;
@@ -199,15 +213,17 @@ struct KVStoreTestWorkload : TestWorkload {
 	double testDuration, operationsPerSecond;
 	double commitFraction, setFraction;
 	int nodeCount, keyBytes, valueBytes;
-	bool doSetup, doClear, doCount;
+	double hotNodeFraction, hotReadFraction;
+	int scanActors;
+	bool doSetup, doClear, doCount, doRecover;
 	std::string filename;
-	PerfIntCounter reads, sets, commits;
+	PerfIntCounter reads, sets, commits, scans, scanRows;
 	Histogram<float> readLatency, commitLatency;
-	double setupTook;
+	double setupTook, recoveryTook;
 	std::string storeType;
 
 	KVStoreTestWorkload( WorkloadContext const& wcx )
-		: TestWorkload(wcx), reads("Reads"), sets("Sets"), commits("Commits"), setupTook(0)
+		: TestWorkload(wcx), reads("Reads"), sets("Sets"), commits("Commits"), scans("Scans"), scanRows("ScanRows"), setupTook(0), recoveryTook(0)
 	{
 		enabled = !clientId; // only do this on the "first" client
 		testDuration = getOption( options, LiteralStringRef("testDuration"), 10.0 );
@@ -217,9 +233,16 @@ struct KVStoreTestWorkload : TestWorkload {
 		nodeCount = getOption( options, LiteralStringRef("nodeCount"), 100000 );
 		keyBytes = getOption( options, LiteralStringRef("keyBytes"), 8 );
 		valueBytes = getOption( options, LiteralStringRef("valueBytes"), 8 );
+		// hotReadFraction of the reads go to the first hotNodeFraction of the keys
+		hotNodeFraction = getOption( options, LiteralStringRef("hotNodeFraction"), 1.0 );
+		hotReadFraction = getOption( options, LiteralStringRef("hotReadFraction"), 0.0 );
+		// Number of actors reading the whole store over and over during the test
+		scanActors = getOption( options, LiteralStringRef("scanActors"), 0 );
 		doSetup = getOption( options, LiteralStringRef("setup"), false );
 		doClear = getOption( options, LiteralStringRef("clear"), false );
 		doCount = getOption( options, LiteralStringRef("count"), false );
+		// Close and reopen the store at the end of the test and measure how long it takes to recover
+		doRecover = getOption( options, LiteralStringRef("recover"), false );
 		filename = getOption( options, LiteralStringRef("filename"), Value() ).toString();
 		saturation = getOption( options, LiteralStringRef("saturation"), false );
 		storeType = getOption( options, LiteralStringRef("storeType"), LiteralStringRef("ssd") ).toString();
@@ -241,10 +264,15 @@ struct KVStoreTestWorkload : TestWorkload {
 	}
 	virtual void getMetrics( vector<PerfMetric>& m ) {
 		if (setupTook) m.push_back( PerfMetric("SetupTook", setupTook, false) );
+		if (recoveryTook) m.push_back( PerfMetric("RecoveryTook", recoveryTook, false) );
 
 		m.push_back(reads.getMetric());
 		m.push_back(sets.getMetric());
 		m.push_back(commits.getMetric());
+		if (scanActors) {
+			m.push_back(scans.getMetric());
+			m.push_back(scanRows.getMetric());
+		}
 		metricsFromHistogram(m, "Read Latency (ms)", readLatency);
 		metricsFromHistogram(m, "Commit Latency (ms)", commitLatency);
 	}
@@ -302,6 +330,9 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 
 	state double t = now();
 	state double stopAt = t + workload->testDuration;
+	state std::vector<Future<Void>> scanners;
+	for(i=0; i<workload->scanActors; i++)
+		scanners.push_back( testKVScan( &test, &workload->scans, &workload->scanRows ) );
 	if (workload->saturation) {
 		if (workload->commitFraction) {
 			while (now() < stopAt) {
@@ -343,13 +374,17 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 					++workload->sets;
 				} else {
 					// Read
-					ac.add( testKVRead( &test, test.randomKey(), &workload->readLatency, &workload->reads ) );
+					Key key = deterministicRandom()->random01() < workload->hotReadFraction
+					              ? test.makeKey( deterministicRandom()->randomInt(0, std::max<int>(1, workload->nodeCount * workload->hotNodeFraction)) )
+					              : test.randomKey();
+					ac.add( testKVRead( &test, key, &workload->readLatency, &workload->reads ) );
 				}
 				if (t >= end) break;
 			}
 			wait( delayUntil(t) );
 		}
 	}
+	scanners.clear();
 
 	if (workload->doClear) {
 		state int chunk = 1000000;
@@ -364,6 +399,40 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 	return Void();
 }
 
+IKeyValueStore* openKVStore( KVStoreTestWorkload* workload, std::string const& fn, UID id ) {
+	if (workload->storeType == "ssd")
+		return keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V2);
+	else if (workload->storeType == "ssd-1")
+		return keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V1);
+	else if (workload->storeType == "ssd-2")
+		return keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_REDWOOD_V1);
+	else if (workload->storeType == "ssd-redwood-experimental")
+		return keyValueStoreRedwoodV1( fn, id );
+	else if (workload->storeType == "ssd-tiered-experimental")
+		return keyValueStoreTiered( keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V2 ), fn, id );
+	else if (workload->storeType == "memory")
+		return keyValueStoreMemory( fn, id, 500e6 );
+	ASSERT(false);
+	return NULL;
+}
+
+// Closes the store without deleting it and times how long it takes to open it again and serve a read
+ACTOR Future<Void> testKVRecovery( KVStoreTestWorkload* workload, KVTest* test, std::string fn, UID id ) {
+	state Future<Void> c = test->store->onClosed();
+	test->store->close();
+	test->store = NULL;
+	wait( c );
+
+	state double begin = timer();
+	test->store = openKVStore( workload, fn, id );
+	wait( test->store->init() );
+	Optional<Value> val = wait( test->store->readValue( test->makeKey(0) ) );
+	workload->recoveryTook = timer() - begin;
+	TraceEvent("KVStoreRecovery").detail("Took", workload->recoveryTook);
+	printf("Recovered in %0.3fs\n", workload->recoveryTook);
+	return Void();
+}
+
 ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 	state KVTest test( workload->nodeCount, !workload->filename.size(), workload->keyBytes );
 	state Error err;
@@ -371,20 +440,9 @@ ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 	//wait( delay(1) );
 	TraceEvent("GO");
 
-	UID id = deterministicRandom()->randomUniqueID();
-	std::string fn = workload->filename.size() ? workload->filename : id.toString();
-	if (workload->storeType == "ssd")
-		test.store = keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V2);
-	else if (workload->storeType == "ssd-1")
-		test.store = keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V1);
-	else if (workload->storeType == "ssd-2")
-		test.store = keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_REDWOOD_V1);
-	else if (workload->storeType == "ssd-redwood-experimental")
-		test.store = keyValueStoreRedwoodV1( fn, id );
-	else if (workload->storeType == "memory")
-		test.store = keyValueStoreMemory( fn, id, 500e6 );
-	else
-		ASSERT(false);
+	state UID id = deterministicRandom()->randomUniqueID();
+	state std::string fn = workload->filename.size() ? workload->filename : id.toString();
+	test.store = openKVStore( workload, fn, id );
 
 	wait(test.store->init());
 
@@ -394,14 +452,18 @@ ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 			when ( wait( main ) ) { }
 			when ( wait( test.store->getError() ) ) { ASSERT( false ); }
 		}
+		if (workload->doRecover)
+			wait( testKVRecovery( workload, &test, fn, id ) );
 	} catch (Error& e) {
 		err = e;
 	}
 	main.cancel();
 
-	Future<Void> c = test.store->onClosed();
-	test.close();
-	wait( c );
+	if (test.store) {
+		Future<Void> c = test.store->onClosed();
+		test.close();
+		wait( c );
+	}
 	if (err.code() != invalid_error_code) throw err;
 	return Void();
 }
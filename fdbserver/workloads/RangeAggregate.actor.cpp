@@ -0,0 +1,190 @@
+/*
+ * RangeAggregate.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2019 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/NativeAPI.actor.h"
+#include "fdbserver/Knobs.h"
+#include "fdbserver/TesterInterface.actor.h"
+#include "fdbserver/workloads/workloads.actor.h"
+#include "flow/actorcompiler.h"  // This must be the last #include.
+
+// Computes aggregates of random ranges, with and without a filter, on the storage servers and checks them against the
+// same fold over the rows of a getRange at the same version, while other transactions change the keys.
+struct RangeAggregateWorkload : TestWorkload {
+	int nodeCount, valueBytes, scanBytes;
+	double testDuration, writeFraction;
+	Key keyPrefix;
+	PerfIntCounter checks, scanLimitedChecks, writes, errors;
+
+	RangeAggregateWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), checks("Checks"), scanLimitedChecks("ScanLimitedChecks"), writes("Writes"), errors("Errors")
+	{
+		nodeCount = getOption( options, LiteralStringRef("nodeCount"), 5000 );
+		valueBytes = getOption( options, LiteralStringRef("valueBytes"), 12 );
+		testDuration = getOption( options, LiteralStringRef("testDuration"), 30.0 );
+		writeFraction = getOption( options, LiteralStringRef("writeFraction"), 0.5 );
+		keyPrefix = getOption( options, LiteralStringRef("keyPrefix"), LiteralStringRef("rangeaggregate/") );
+		scanBytes = getOption( options, LiteralStringRef("scanBytes"), 0 );
+	}
+
+	virtual std::string description() { return "RangeAggregate"; }
+
+	virtual Future<Void> setup( Database const& cx ) {
+		// Storage servers share the knobs of the simulator process, so a small scan limit makes requests stop at
+		// scannedThrough in the middle of a shard
+		if(scanBytes > 0 && g_network->isSimulated())
+			const_cast<ServerKnobs *>(SERVER_KNOBS)->RANGE_AGGREGATE_SCAN_BYTES = scanBytes;
+		if(clientId != 0)
+			return Void();
+		return _setup( cx, this );
+	}
+
+	virtual Future<Void> start( Database const& cx ) {
+		return timeout( _start( cx, this ), testDuration, Void() );
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		return !errors.getValue();
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		m.push_back( checks.getMetric() );
+		m.push_back( scanLimitedChecks.getMetric() );
+		m.push_back( writes.getMetric() );
+	}
+
+	Key keyForIndex( int n ) const { return keyPrefix.withSuffix(format("%08d", n)); }
+
+	// Random bytes, so that values shorter and longer than the eight bytes an aggregate reads, and negative ones, all occur
+	Value randomValue() const {
+		std::string v(deterministicRandom()->randomInt(0, valueBytes + 1), '\0');
+		for(auto& c : v)
+			c = deterministicRandom()->randomInt(0, 256);
+		return Value(v);
+	}
+
+	ACTOR static Future<Void> _setup( Database cx, RangeAggregateWorkload* self ) {
+		state int i = 0;
+		for(; i < self->nodeCount; i += 100) {
+			state Transaction tr(cx);
+			loop {
+				try {
+					for(int j = i; j < std::min(i + 100, self->nodeCount); j++)
+						tr.set(self->keyForIndex(j), self->randomValue());
+					wait(tr.commit());
+					break;
+				} catch(Error& e) {
+					wait(tr.onError(e));
+				}
+			}
+		}
+		return Void();
+	}
+
+	static bool sameAggregate( RangeAggregate const& a, RangeAggregate const& b ) {
+		return a.count == b.count && a.bytes == b.bytes && a.sum == b.sum && (!a.count || (a.minValue == b.minValue && a.maxValue == b.maxValue));
+	}
+
+	// Only rows whose values start with a random byte, truncated to a random length; or no filter at all
+	static Optional<RangeFilter> randomFilter() {
+		if(deterministicRandom()->coinflip())
+			return Optional<RangeFilter>();
+		RangeFilter filter;
+		if(deterministicRandom()->coinflip())
+			filter.valuePrefix = StringRef(filter.arena(), std::string(1, (char)deterministicRandom()->randomInt(0, 256)));
+		if(deterministicRandom()->coinflip())
+			filter.maxValueLength = deterministicRandom()->randomInt(0, 10);
+		return filter;
+	}
+
+	ACTOR static Future<Void> checkRange( Database cx, RangeAggregateWorkload* self ) {
+		state Transaction tr(cx);
+		state int a = deterministicRandom()->randomInt(0, self->nodeCount);
+		state int b = deterministicRandom()->randomInt(0, self->nodeCount);
+		state KeyRange range = KeyRangeRef(self->keyForIndex(std::min(a, b)), self->keyForIndex(std::max(a, b) + 1));
+		state Optional<RangeFilter> filter = randomFilter();
+		loop {
+			try {
+				state RangeAggregate aggregate = wait(tr.getRangeAggregate(range, filter));
+				Standalone<RangeResultRef> rows = wait(tr.getRange(range, CLIENT_KNOBS->TOO_MANY));
+				ASSERT(!rows.more);
+
+				RangeAggregate expected;
+				int64_t scannedBytes = 0;
+				for(auto& kv : rows) {
+					scannedBytes += kv.expectedSize();
+					if(!filter.present())
+						expected.add(kv);
+					else if(filter.get().matches(kv))
+						expected.add(filter.get().project(kv));
+				}
+				if(!sameAggregate(aggregate, expected)) {
+					TraceEvent(SevError, "RangeAggregateMismatch").detail("Begin", range.begin).detail("End", range.end)
+						.detail("Filter", filter.present() ? filter.get().toString() : "none")
+						.detail("Count", aggregate.count).detail("ExpectedCount", expected.count)
+						.detail("Bytes", aggregate.bytes).detail("ExpectedBytes", expected.bytes)
+						.detail("Sum", aggregate.sum).detail("ExpectedSum", expected.sum)
+						.detail("Min", aggregate.minValue).detail("ExpectedMin", expected.minValue)
+						.detail("Max", aggregate.maxValue).detail("ExpectedMax", expected.maxValue);
+					++self->errors;
+				}
+				++self->checks;
+				// When the range holds more than one request may scan, some shard was cut off at scannedThrough and
+				// continued, unless data distribution split the range into shards smaller than that
+				if(scannedBytes > SERVER_KNOBS->RANGE_AGGREGATE_SCAN_BYTES)
+					++self->scanLimitedChecks;
+				return Void();
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+	}
+
+	ACTOR static Future<Void> writeRange( Database cx, RangeAggregateWorkload* self ) {
+		state Transaction tr(cx);
+		loop {
+			try {
+				int n = deterministicRandom()->randomInt(0, self->nodeCount);
+				if(deterministicRandom()->random01() < 0.1) {
+					tr.clear(KeyRangeRef(self->keyForIndex(n), self->keyForIndex(n + deterministicRandom()->randomInt(1, 10))));
+				} else {
+					for(int i = deterministicRandom()->randomInt(1, 20); i; i--)
+						tr.set(self->keyForIndex(deterministicRandom()->randomInt(0, self->nodeCount)), self->randomValue());
+				}
+				wait(tr.commit());
+				++self->writes;
+				return Void();
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+	}
+
+	ACTOR static Future<Void> _start( Database cx, RangeAggregateWorkload* self ) {
+		loop {
+			if(deterministicRandom()->random01() < self->writeFraction) {
+				wait(writeRange(cx, self));
+			} else {
+				wait(checkRange(cx, self));
+			}
+		}
+	}
+};
+
+WorkloadFactory<RangeAggregateWorkload> RangeAggregateWorkloadFactory("RangeAggregate");
@@ -0,0 +1,163 @@
+/*
+ * RangeStream.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2019 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdbclient/NativeAPI.actor.h"
+#include "fdbserver/TesterInterface.actor.h"
+#include "fdbserver/workloads/workloads.actor.h"
+#include "flow/actorcompiler.h"  // This must be the last #include.
+
+// Reads random ranges both with limits large enough to be streamed from the storage servers and page by page with
+// limits that never are, at the same version, while other transactions change the keys, and checks that the results agree.
+struct RangeStreamWorkload : TestWorkload {
+	int nodeCount, valueBytes;
+	double testDuration, writeFraction;
+	Key keyPrefix;
+	PerfIntCounter checks, rowsChecked, writes, errors;
+
+	RangeStreamWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), checks("Checks"), rowsChecked("RowsChecked"), writes("Writes"), errors("Errors")
+	{
+		nodeCount = getOption( options, LiteralStringRef("nodeCount"), 5000 );
+		valueBytes = getOption( options, LiteralStringRef("valueBytes"), 500 );
+		testDuration = getOption( options, LiteralStringRef("testDuration"), 30.0 );
+		writeFraction = getOption( options, LiteralStringRef("writeFraction"), 0.5 );
+		keyPrefix = getOption( options, LiteralStringRef("keyPrefix"), LiteralStringRef("rangestream/") );
+	}
+
+	virtual std::string description() { return "RangeStream"; }
+
+	virtual Future<Void> setup( Database const& cx ) {
+		if(clientId != 0)
+			return Void();
+		return _setup( cx, this );
+	}
+
+	virtual Future<Void> start( Database const& cx ) {
+		return timeout( _start( cx, this ), testDuration, Void() );
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		return !errors.getValue();
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		m.push_back( checks.getMetric() );
+		m.push_back( rowsChecked.getMetric() );
+		m.push_back( writes.getMetric() );
+	}
+
+	Key keyForIndex( int n ) const { return keyPrefix.withSuffix(format("%08d", n)); }
+	Value randomValue() const { return Value(std::string(deterministicRandom()->randomInt(0, valueBytes + 1), 'v')); }
+
+	ACTOR static Future<Void> _setup( Database cx, RangeStreamWorkload* self ) {
+		state int i = 0;
+		for(; i < self->nodeCount; i += 100) {
+			state Transaction tr(cx);
+			loop {
+				try {
+					for(int j = i; j < std::min(i + 100, self->nodeCount); j++)
+						tr.set(self->keyForIndex(j), self->randomValue());
+					wait(tr.commit());
+					break;
+				} catch(Error& e) {
+					wait(tr.onError(e));
+				}
+			}
+		}
+		return Void();
+	}
+
+	// Reads range page by page with byte limits of at most one reply, which getRange never streams
+	ACTOR static Future<Standalone<RangeResultRef>> readPaged( Transaction* tr, KeyRange range ) {
+		state Standalone<RangeResultRef> result;
+		state Key begin = range.begin;
+		loop {
+			Standalone<RangeResultRef> page = wait(tr->getRange(KeyRangeRef(begin, range.end), GetRangeLimits(GetRangeLimits::ROW_LIMIT_UNLIMITED, CLIENT_KNOBS->REPLY_BYTE_LIMIT)));
+			result.arena().dependsOn(page.arena());
+			result.append(result.arena(), page.begin(), page.size());
+			if(!page.more)
+				return result;
+			begin = keyAfter(page.back().key);
+		}
+	}
+
+	ACTOR static Future<Void> checkRange( Database cx, RangeStreamWorkload* self ) {
+		state Transaction tr(cx);
+		state int a = deterministicRandom()->randomInt(0, self->nodeCount);
+		state int b = deterministicRandom()->randomInt(0, self->nodeCount);
+		state KeyRange range = KeyRangeRef(self->keyForIndex(std::min(a, b)), self->keyForIndex(std::max(a, b) + 1));
+		state bool reverse = deterministicRandom()->coinflip();
+		state int rows = deterministicRandom()->coinflip() ? CLIENT_KNOBS->TOO_MANY : deterministicRandom()->randomInt(CLIENT_KNOBS->RANGE_STREAM_MIN_ROWS + 1, CLIENT_KNOBS->RANGE_STREAM_MIN_ROWS * 2 + 2);
+		loop {
+			try {
+				state Standalone<RangeResultRef> streamed = wait(tr.getRange(range, GetRangeLimits(rows), false, reverse));
+				Standalone<RangeResultRef> paged = wait(readPaged(&tr, range));
+
+				int expectedSize = std::min<int>(rows, paged.size());
+				bool match = streamed.size() == expectedSize && (streamed.more || expectedSize == paged.size());
+				for(int i = 0; match && i < expectedSize; i++)
+					match = streamed[i] == paged[reverse ? paged.size() - 1 - i : i];
+				if(!match) {
+					TraceEvent(SevError, "RangeStreamMismatch").detail("Begin", range.begin).detail("End", range.end)
+						.detail("Reverse", reverse).detail("Rows", rows).detail("StreamedSize", streamed.size())
+						.detail("StreamedMore", streamed.more).detail("PagedSize", paged.size());
+					++self->errors;
+				}
+				++self->checks;
+				self->rowsChecked += expectedSize;
+				return Void();
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+	}
+
+	ACTOR static Future<Void> writeRange( Database cx, RangeStreamWorkload* self ) {
+		state Transaction tr(cx);
+		loop {
+			try {
+				int n = deterministicRandom()->randomInt(0, self->nodeCount);
+				if(deterministicRandom()->random01() < 0.1) {
+					tr.clear(KeyRangeRef(self->keyForIndex(n), self->keyForIndex(n + deterministicRandom()->randomInt(1, 10))));
+				} else {
+					for(int i = deterministicRandom()->randomInt(1, 20); i; i--)
+						tr.set(self->keyForIndex(deterministicRandom()->randomInt(0, self->nodeCount)), self->randomValue());
+				}
+				wait(tr.commit());
+				++self->writes;
+				return Void();
+			} catch(Error& e) {
+				wait(tr.onError(e));
+			}
+		}
+	}
+
+	ACTOR static Future<Void> _start( Database cx, RangeStreamWorkload* self ) {
+		loop {
+			if(deterministicRandom()->random01() < self->writeFraction) {
+				wait(writeRange(cx, self));
+			} else {
+				wait(checkRange(cx, self));
+			}
+		}
+	}
+};
+
+WorkloadFactory<RangeStreamWorkload> RangeStreamWorkloadFactory("RangeStream");
@@ -82,6 +82,14 @@ void setFastAllocatorThreadInitFunction( ThreadInitFunction f ) {
 	threadInitFunction = f; 
 }
 
+typedef void (*PageMagazineFunction)(void*, size_t);
+
+PageMagazineFunction pageMagazineFunction = 0;  // See AsyncFileIOUring, which registers page magazines with the kernel
+void setFastAllocatorPageMagazineFunction( PageMagazineFunction f ) {
+	ASSERT( !pageMagazineFunction );
+	pageMagazineFunction = f;
+}
+
 std::atomic<int64_t> g_hugeArenaMemory(0);
 
 double hugeArenaLastLogged = 0;
@@ -459,6 +467,9 @@ void FastAllocator<Size>::getMagazine() {
 		
 	block[(magazine_size-1)*PSize+1] = block[(magazine_size-1)*PSize] = nullptr;
 	check( &block[(magazine_size-1)*PSize], false );
+	if (Size == 4096 && pageMagazineFunction) {
+		pageMagazineFunction( block, magazine_size * Size );
+	}
 	threadData.freelist = block;
 	threadData.count = magazine_size;
 }
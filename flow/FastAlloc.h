@@ -158,6 +158,7 @@ void hugeArenaSample(int size);
 void releaseAllThreadMagazines();
 int64_t getTotalUnusedAllocatedMemory();
 void setFastAllocatorThreadInitFunction( void (*)() );  // The given function will be called at least once in each thread that allocates from a FastAllocator.  Currently just one such function is tracked.
+void setFastAllocatorPageMagazineFunction( void (*)(void*, size_t) );  // The given function will be called, from the allocating thread, with the memory of each magazine FastAllocator<4096> gets from the system allocator.  Currently just one such function is tracked.
 
 inline constexpr int nextFastAllocatedSize(int x) {
 	assert(x > 0 && x <= 8192);
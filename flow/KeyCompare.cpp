@@ -0,0 +1,253 @@
+/*
+ * KeyCompare.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/KeyCompare.h"
+#include "flow/UnitTest.h"
+#include "flow/Arena.h"
+
+#if defined(KEY_COMPARE_SSE2) && defined(__GNUC__)
+// The AVX2 implementation is compiled for AVX2 regardless of the flags the rest of the tree is built with and
+// is only called after checking that the CPU supports it
+#define KEY_COMPARE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// The implementations below require len >= 16
+
+static int commonPrefixLengthScalar(const uint8_t* a, const uint8_t* b, int len) {
+	int i = 0;
+	for(; i + 8 <= len; i += 8) {
+		int d = keyDifference8(a, b, i);
+		if (d >= 0)
+			return d;
+	}
+	// Finish with a word that overlaps the one before it rather than a byte at a time
+	if (i < len) {
+		int d = keyDifference8(a, b, len-8);
+		if (d >= 0)
+			return d;
+	}
+	return len;
+}
+
+#ifdef KEY_COMPARE_SSE2
+static int commonPrefixLengthSSE2(const uint8_t* a, const uint8_t* b, int len) {
+	int i = 0;
+	for(; i + 16 <= len; i += 16) {
+		uint32_t d = keyDifferences16(a, b, i);
+		if (d)
+			return i + ctz(d);
+	}
+	if (i < len) {
+		i = len - 16;
+		uint32_t d = keyDifferences16(a, b, i);
+		if (d)
+			return i + ctz(d);
+	}
+	return len;
+}
+#endif
+
+#ifdef KEY_COMPARE_AVX2
+__attribute__((target("avx2")))
+static int commonPrefixLengthAVX2(const uint8_t* a, const uint8_t* b, int len) {
+	int i = 0;
+	for(; i + 32 <= len; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b+i));
+		uint32_t d = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+		if (d)
+			return i + ctz(d);
+	}
+	if (i == len)
+		return len;
+	if (len >= 32) {
+		i = len - 32;
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b+i));
+		uint32_t d = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+		return d ? i + ctz(d) : len;
+	}
+
+	// 16 <= len < 32: two possibly overlapping 16 byte blocks
+	uint32_t d = keyDifferences16(a, b, 0);
+	if (d)
+		return ctz(d);
+	d = keyDifferences16(a, b, len - 16);
+	return d ? len - 16 + ctz(d) : len;
+}
+#endif
+
+typedef int (*CommonPrefixLengthFn)(const uint8_t*, const uint8_t*, int);
+
+static const char* implementationName = "scalar";
+
+static CommonPrefixLengthFn chooseImplementation() {
+#ifdef KEY_COMPARE_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		implementationName = "avx2";
+		return commonPrefixLengthAVX2;
+	}
+#endif
+#ifdef KEY_COMPARE_SSE2
+	implementationName = "sse2";
+	return commonPrefixLengthSSE2;
+#else
+	implementationName = "scalar";
+	return commonPrefixLengthScalar;
+#endif
+}
+
+// commonPrefixLengthVector starts out pointing here rather than being set by a dynamic initializer, so that key
+// comparisons made by other static initializers work regardless of initialization order.  Every thread that races
+// through here stores the same value.
+static int commonPrefixLengthResolve(const uint8_t* a, const uint8_t* b, int len) {
+	commonPrefixLengthVector = chooseImplementation();
+	return commonPrefixLengthVector(a, b, len);
+}
+
+int (*commonPrefixLengthVector)(const uint8_t* a, const uint8_t* b, int len) = commonPrefixLengthResolve;
+
+const char* keyCompareImplementation() {
+	if (commonPrefixLengthVector == commonPrefixLengthResolve)
+		commonPrefixLengthVector = chooseImplementation();
+	return implementationName;
+}
+
+static int commonPrefixLengthBytes(const uint8_t* a, const uint8_t* b, int len) {
+	for(int i=0; i<len; i++)
+		if (a[i] != b[i])
+			return i;
+	return len;
+}
+
+static std::vector<std::pair<const char*, CommonPrefixLengthFn>> implementations() {
+	std::vector<std::pair<const char*, CommonPrefixLengthFn>> impls;
+	impls.push_back(std::make_pair("scalar", commonPrefixLengthScalar));
+#ifdef KEY_COMPARE_SSE2
+	impls.push_back(std::make_pair("sse2", commonPrefixLengthSSE2));
+#endif
+#ifdef KEY_COMPARE_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		impls.push_back(std::make_pair("avx2", commonPrefixLengthAVX2));
+#endif
+	return impls;
+}
+
+TEST_CASE("/flow/KeyCompare/correctness") {
+	auto impls = implementations();
+	uint8_t a[200], b[200];
+	for(int i=0; i<100000; i++) {
+		int len = deterministicRandom()->randomInt(0, 150);
+		int offset = deterministicRandom()->randomInt(0, 50);
+		for(int j=0; j<len; j++)
+			a[offset+j] = b[offset+j] = deterministicRandom()->randomInt(0, 4);
+		// Make the strings differ at a random position (or not at all), sometimes in more than one place
+		int changes = deterministicRandom()->randomInt(0, 3);
+		for(int c=0; c<changes && len; c++)
+			b[offset+deterministicRandom()->randomInt(0, len)] = deterministicRandom()->randomInt(0, 256);
+
+		const uint8_t* ap = a+offset;
+		const uint8_t* bp = b+offset;
+		int expected = commonPrefixLengthBytes(ap, bp, len);
+		ASSERT(commonPrefixLength(ap, bp, len) == expected);
+		for(auto& impl : impls)
+			if (len >= 16)
+				ASSERT(impl.second(ap, bp, len) == expected);
+
+		int aLen = deterministicRandom()->randomInt(0, len+1);
+		int bLen = deterministicRandom()->randomInt(0, len+1);
+		int c = memcmp(ap, bp, std::min(aLen, bLen));
+		int expectedCompare = c < 0 ? -1 : c > 0 ? 1 : aLen < bLen ? -1 : aLen > bLen;
+		ASSERT(compareKeys(ap, aLen, bp, bLen) == expectedCompare);
+	}
+	return Void();
+}
+
+// Tuple encoded keys like those of the record layer: a subspace prefix, an integer and a string field padded to
+// about keyLength bytes.  Neighbouring keys share a long prefix, which is the common case in sorted data structures.
+static std::vector<Standalone<StringRef>> tupleKeys(int count, int keyLength) {
+	std::vector<Standalone<StringRef>> keys;
+	const char prefix[] = "\x02" "app" "\x00" "\x15\x07";
+	std::string subspace(prefix, sizeof(prefix)-1);
+	for(int i=0; i<count; i++) {
+		std::string k = subspace;
+		int64_t id = deterministicRandom()->randomInt(0, 1000);
+		k.push_back('\x16');
+		k.push_back((char)(id >> 8));
+		k.push_back((char)id);
+		k.push_back('\x02');
+		int suffix = std::max<int>(1, keyLength - k.size() - 1 + deterministicRandom()->randomInt(-4, 5));
+		for(int j=0; j<suffix; j++)
+			k.push_back('a' + deterministicRandom()->randomInt(0, 3));
+		k.push_back(0);
+		keys.push_back(StringRef(k));
+	}
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+// The comparisons this replaces: memcmp followed by a length comparison, and a byte at a time loop
+static int memcmpCompare(StringRef a, StringRef b) {
+	int c = memcmp(a.begin(), b.begin(), std::min(a.size(), b.size()));
+	if (c < 0) return -1;
+	if (c > 0) return 1;
+	return a.size() < b.size() ? -1 : a.size() > b.size();
+}
+
+static int byteCompare(StringRef a, StringRef b) {
+	int len = std::min(a.size(), b.size());
+	for(int i=0; i<len; i++)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return a.size() < b.size() ? -1 : a.size() > b.size();
+}
+
+template <class F>
+static void benchmarkCompare(const char* name, std::vector<Standalone<StringRef>> const& keys, F compare) {
+	const int passes = 10000;
+	int64_t total = 0;
+	double start = timer();
+	for(int p=0; p<passes; p++)
+		for(int i=1; i<keys.size(); i++)
+			total += compare(keys[i-1], keys[i]);
+	printf("  %-26s %7.1f M/s (%lld)\n", name, passes * (keys.size()-1) / (timer() - start) / 1e6, (long long)total);
+}
+
+TEST_CASE("!/flow/KeyCompare/performance") {
+	printf("Implementation for long keys: %s\n", keyCompareImplementation());
+	for(int keyLength : { 16, 32, 48, 64 }) {
+		auto keys = tupleKeys(1000, keyLength);
+		printf("Key length ~%d:\n", keyLength);
+		benchmarkCompare("memcmp compare", keys, memcmpCompare);
+		benchmarkCompare("byte loop compare", keys, byteCompare);
+		benchmarkCompare("compareKeys", keys, [](StringRef a, StringRef b) { return compareKeys(a.begin(), a.size(), b.begin(), b.size()); });
+		for(auto& impl : implementations()) {
+			auto f = impl.second;
+			benchmarkCompare(format("commonPrefixLength %s", impl.first).c_str(), keys, [f](StringRef a, StringRef b) {
+				int len = std::min(a.size(), b.size());
+				return len >= 16 ? f(a.begin(), b.begin(), len) : commonPrefixLength(a.begin(), b.begin(), len);
+			});
+		}
+		benchmarkCompare("commonPrefixLength inline", keys, [](StringRef a, StringRef b) { return commonPrefixLength(a.begin(), b.begin(), std::min(a.size(), b.size())); });
+	}
+	return Void();
+}
@@ -0,0 +1,112 @@
+/*
+ * KeyCompare.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLOW_KEYCOMPARE_H
+#define FLOW_KEYCOMPARE_H
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "flow/Platform.h"
+
+// Byte string comparison primitives shared by the hot key comparisons in the conflict set, the DeltaTree and
+// the storage server.  Strings of up to 64 bytes are compared inline, 16 bytes at a time where SSE2 is part
+// of the baseline instruction set and a word at a time elsewhere.  Longer strings go through an implementation
+// chosen once at startup according to the instruction sets the CPU supports (AVX2, SSE2 or plain words).
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KEY_COMPARE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Out of line implementation for strings longer than 64 bytes, selected at startup
+extern int (*commonPrefixLengthVector)(const uint8_t* a, const uint8_t* b, int len);
+
+// The name of the implementation commonPrefixLengthVector points to ("avx2", "sse2" or "scalar")
+const char* keyCompareImplementation();
+
+#ifdef KEY_COMPARE_SSE2
+// Returns a mask with a bit set for each of the 16 bytes at offset i that differ between a and b
+inline uint32_t keyDifferences16(const uint8_t* a, const uint8_t* b, int i) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+	__m128i y = _mm_loadu_si128((const __m128i*)(b+i));
+	return ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xffff;
+}
+#endif
+
+// Returns the index of the first difference between the 8 bytes at offset i of a and b, or -1 if they are equal
+inline int keyDifference8(const uint8_t* a, const uint8_t* b, int i) {
+	uint64_t x, y;
+	memcpy(&x, a+i, 8);
+	memcpy(&y, b+i, 8);
+	return x != y ? i + ctzll(x ^ y) / 8 : -1;
+}
+
+// Returns the number of leading bytes that the len byte strings a and b have in common
+inline int commonPrefixLength(const uint8_t* a, const uint8_t* b, int len) {
+	if (len > 64)
+		return commonPrefixLengthVector(a, b, len);
+
+	// The last block compared may overlap the one before it
+#ifdef KEY_COMPARE_SSE2
+	if (len >= 16) {
+		for(int i = 0; i + 16 <= len; i += 16) {
+			uint32_t d = keyDifferences16(a, b, i);
+			if (d)
+				return i + ctz(d);
+		}
+		uint32_t d = keyDifferences16(a, b, len-16);
+		return d ? len - 16 + ctz(d) : len;
+	}
+#else
+	if (len >= 16) {
+		for(int i = 0; i + 8 <= len; i += 8) {
+			int d = keyDifference8(a, b, i);
+			if (d >= 0)
+				return d;
+		}
+		int d = keyDifference8(a, b, len-8);
+		return d >= 0 ? d : len;
+	}
+#endif
+	if (len >= 8) {
+		int d = keyDifference8(a, b, 0);
+		if (d < 0)
+			d = keyDifference8(a, b, len-8);
+		return d >= 0 ? d : len;
+	}
+	for(int i = 0; i < len; i++)
+		if (a[i] != b[i])
+			return i;
+	return len;
+}
+
+// Compares two byte strings lexicographically, returning a value <0, 0 or >0 like memcmp.  Unlike memcmp the
+// result is always -1, 0 or 1 and a string orders before every longer string it is a prefix of.
+inline int compareKeys(const uint8_t* a, int aLen, const uint8_t* b, int bLen) {
+	int len = std::min(aLen, bLen);
+	int i = commonPrefixLength(a, b, len);
+	if (i < len)
+		return a[i] < b[i] ? -1 : 1;
+	return aLen < bLen ? -1 : aLen > bLen;
+}
+
+#endif
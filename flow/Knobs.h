@@ -99,8 +99,9 @@ public:
 	int64_t SIM_PAGE_CACHE_64K;
 	int64_t BUGGIFY_SIM_PAGE_CACHE_4K;
 	int64_t BUGGIFY_SIM_PAGE_CACHE_64K;
-	std::string CACHE_EVICTION_POLICY; // for now, "random", "lru", are supported
+	std::string CACHE_EVICTION_POLICY; // for now, "random", "lru", "slru" are supported
 	int MAX_EVICT_ATTEMPTS;
+	double CACHE_PROTECTED_FRACTION; // with "slru", the fraction of the cache that may hold pages hit since they were read
 	double PAGE_CACHE_TRUNCATE_LOOKUP_FRACTION;
 	double TOO_MANY_CONNECTIONS_CLOSED_RESET_DELAY;
 	int TOO_MANY_CONNECTIONS_CLOSED_TIMEOUT;
@@ -112,6 +113,10 @@ public:
 	int PAGE_WRITE_CHECKSUM_HISTORY;
 	int DISABLE_POSIX_KERNEL_AIO;
 
+	//AsyncFileIOUring
+	int ENABLE_IO_URING; // Open unbuffered files with AsyncFileIOUring instead of AsyncFileKAIO if the kernel supports it
+	int IO_URING_REGISTERED_BUFFERS; // Number of FastAllocator<4096> magazines which can be registered with the ring as fixed buffers
+
 	//AsyncFileNonDurable
 	double MAX_PRIOR_MODIFICATION_DELAY;
 
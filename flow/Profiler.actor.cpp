@@ -36,6 +36,7 @@
 
 extern volatile thread_local int profilingEnabled;
 
+#define gettid fdb_compat_gettid
 static uint64_t gettid() { return syscall(__NR_gettid); }
 
 struct SignalClosure {
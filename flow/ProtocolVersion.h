@@ -87,6 +87,11 @@ public: // introduced features
 	PROTOCOL_VERSION_FEATURE(0x0FDB00B061030000LL, TLogVersion);
 	PROTOCOL_VERSION_FEATURE(0x0FDB00B061070000LL, PseudoLocalities);
 	PROTOCOL_VERSION_FEATURE(0x0FDB00B061070000LL, ShardedTxsTags);
+	PROTOCOL_VERSION_FEATURE(0x0FDB00B062010001LL, MultiGet);
+	PROTOCOL_VERSION_FEATURE(0x0FDB00B062010002LL, RangeStream);
+	PROTOCOL_VERSION_FEATURE(0x0FDB00B062010004LL, RangeAggregate);
+	PROTOCOL_VERSION_FEATURE(0x0FDB00B062010005LL, CompressedTLogMessages);
+	PROTOCOL_VERSION_FEATURE(0x0FDB00B062010006LL, TLogQueueTagIndex);
 };
 
 // These impact both communications and the deserialization of certain database and IKeyValueStore keys.
@@ -96,7 +101,7 @@ public: // introduced features
 //
 //                                                         xyzdev
 //                                                         vvvv
-constexpr ProtocolVersion currentProtocolVersion(0x0FDB00B062010001LL);
+constexpr ProtocolVersion currentProtocolVersion(0x0FDB00B062010007LL);
 // This assert is intended to help prevent incrementing the leftmost digits accidentally. It will probably need to
 // change when we reach version 10.
 static_assert(currentProtocolVersion.version() < 0x0FDB00B100000000LL, "Unexpected protocol version");